@@ -0,0 +1,44 @@
+#!/bin/sh
+# Compare two runs of bench_rtp_core --json (e.g. before and after a change):
+# ns/op of each result and the change, slower results flagged.
+#
+#   ./bench/bench_rtp_core --json > base.json    # on the old build
+#   ./bench/bench_rtp_core --json > new.json     # on the new build
+#   bench/bench_compare.sh base.json new.json [THRESHOLD_PERCENT]
+#
+# Exits with status 1 if any result got slower by more than the threshold
+# (default 10%), so it can gate a script.
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 BASE.json NEW.json [THRESHOLD_PERCENT]" >&2
+    exit 2
+fi
+THRESHOLD=${3:-10}
+
+# One "name ns_per_op" line per result
+extract() {
+    sed -n 's/.*"name":"\([^"]*\)".*"ns_per_op":\([0-9.]*\).*/\1 \2/p' "$1"
+}
+
+extract "$1" > "${TMPDIR:-/tmp}/bench_compare.$$.base"
+trap 'rm -f "${TMPDIR:-/tmp}/bench_compare.$$.base"' EXIT
+extract "$2" | awk -v threshold="$THRESHOLD" -v base="${TMPDIR:-/tmp}/bench_compare.$$.base" '
+    BEGIN {
+        while ((getline line < base) > 0) {
+            split(line, f, " ")
+            old[f[1]] = f[2]
+        }
+        printf "%-32s %12s %12s %8s\n", "name", "base_ns_op", "new_ns_op", "change"
+    }
+    {
+        if (!($1 in old)) {
+            printf "%-32s %12s %12.2f %8s\n", $1, "-", $2, "new"
+            next
+        }
+        change = ($2 - old[$1]) / old[$1] * 100
+        flag = change > threshold ? "  SLOWER" : ""
+        if (change > threshold) slower++
+        printf "%-32s %12.2f %12.2f %+7.1f%%%s\n", $1, old[$1], $2, change, flag
+    }
+    END { exit slower > 0 }'
@@ -0,0 +1,287 @@
+// FEC benchmark: parity kernel throughput (scalar / SSE / AVX2), encode and
+// decode throughput per scheme, and the share of lost packets recovered
+// under random loss. Build with `make bench`.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../fec.h"
+#include "../fec_kernels.h"
+
+#define KERNEL_BYTES (1 << 20)
+#define KERNEL_ROUNDS 2000
+#define PAYLOAD_SIZE CHUNK_SIZE
+#define ENCODE_BLOCKS 20000
+#define LOSS_BLOCKS 4000
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// xorshift32: reproducible payloads and loss patterns
+static uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void bench_kernels(void) {
+    static const char *names[] = { "scalar", "sse", "avx2" };
+    unsigned char *dst = (unsigned char *)malloc(KERNEL_BYTES);
+    unsigned char *src = (unsigned char *)malloc(KERNEL_BYTES);
+    uint32_t seed = 1;
+    for (int i = 0; i < KERNEL_BYTES; i++) src[i] = (unsigned char)next_random(&seed);
+    memset(dst, 0, KERNEL_BYTES);
+
+    printf("Parity kernels (%d KB buffers):\n", KERNEL_BYTES / 1024);
+    for (int k = 0; k < 3; k++) {
+        if (fec_kernels_init(names[k]) < 0) {
+            printf("  %-7s not supported on this CPU\n", names[k]);
+            continue;
+        }
+        int64_t start = now_ns();
+        for (int r = 0; r < KERNEL_ROUNDS; r++) fec_xor(dst, src, KERNEL_BYTES);
+        double xor_gbps = (double)KERNEL_BYTES * KERNEL_ROUNDS / (now_ns() - start);
+
+        start = now_ns();
+        for (int r = 0; r < KERNEL_ROUNDS; r++) fec_mul_add(dst, src, (uint8_t)(r | 2), KERNEL_BYTES);
+        double mul_gbps = (double)KERNEL_BYTES * KERNEL_ROUNDS / (now_ns() - start);
+        printf("  %-7s XOR %6.2f GB/s   GF(256) multiply-add %6.2f GB/s\n", names[k], xor_gbps, mul_gbps);
+    }
+    fec_kernels_init(NULL);
+    printf("  (using %s)\n\n", fec_kernel_name());
+    free(dst);
+    free(src);
+}
+
+typedef struct {
+    const char *label;
+    int scheme;
+    int param;
+} SchemeCase;
+
+static const SchemeCase cases[] = {
+    { "xor L=5", FEC_SCHEME_XOR, 5 },
+    { "xor2d L=5", FEC_SCHEME_XOR_2D, 5 },
+    { "rs M=2", FEC_SCHEME_RS, 2 },
+    { "rs M=5", FEC_SCHEME_RS, 5 },
+};
+#define NUM_CASES (int)(sizeof(cases) / sizeof(cases[0]))
+
+// One block of datagrams (RTP header + payload) and their chunks
+typedef struct {
+    unsigned char packets[FEC_MAX_BLOCK][RTP_HEADER_SIZE + PAYLOAD_SIZE];
+    int lengths[FEC_MAX_BLOCK];
+    RTPChunk chunks[FEC_MAX_BLOCK];
+} Block;
+
+static void fill_block(Block *block, int block_size, uint16_t base_seq, uint32_t timestamp, uint32_t *seed) {
+    for (int i = 0; i < block_size; i++) {
+        unsigned char *p = block->packets[i];
+        int payload_size = 200 + next_random(seed) % (PAYLOAD_SIZE - 199);
+        int last = (i == block_size - 1);
+        uint16_t seq = (uint16_t)(base_seq + i);
+        p[0] = 0x80;
+        p[1] = (last ? 0x80 : 0) | RTP_PT_VIDEO;
+        p[2] = seq >> 8;
+        p[3] = seq & 0xFF;
+        p[4] = timestamp >> 24; p[5] = timestamp >> 16; p[6] = timestamp >> 8; p[7] = timestamp;
+        p[8] = 0x12; p[9] = 0x34; p[10] = 0x56; p[11] = 0x78;
+        for (int b = 0; b < payload_size; b++) p[RTP_HEADER_SIZE + b] = (unsigned char)next_random(seed);
+        block->lengths[i] = RTP_HEADER_SIZE + payload_size;
+        block->chunks[i].payload = p + RTP_HEADER_SIZE;
+        block->chunks[i].payload_size = payload_size;
+        block->chunks[i].is_last_packet = last;
+        block->chunks[i].prefix_size = 0;
+    }
+}
+
+// Store a datagram in a fresh pool slot
+static int to_slot(PacketPool *pool, const unsigned char *bytes, int length) {
+    int slot = packet_pool_acquire(pool);
+    if (slot < 0) {
+        fprintf(stderr, "Packet pool exhausted\n");
+        exit(1);
+    }
+    memcpy(packet_pool_data(pool, slot), bytes, length);
+    pool->lengths[slot] = length;
+    return slot;
+}
+
+static void parity_packet(const FecEncoder *encoder, int p, uint16_t base_seq, uint32_t timestamp,
+                          unsigned char *out, int *length) {
+    FecHeader header;
+    header.protected_ssrc = 0x12345678;
+    header.base_seq = base_seq;
+    header.timestamp_base = timestamp;
+    header.kind = encoder->kinds[p];
+    header.index = encoder->indices[p];
+    header.block_size = encoder->count;
+    header.columns = encoder->scheme == FEC_SCHEME_RS ? encoder->rs_parity : encoder->columns;
+    header.unit_size = encoder->unit_size;
+    memset(out, 0, RTP_HEADER_SIZE);
+    out[0] = 0x80;
+    out[1] = RTP_PT_FEC;
+    fec_pack_header(&header, out + RTP_HEADER_SIZE);
+    memcpy(out + RTP_HEADER_SIZE + FEC_HEADER_SIZE, encoder->parity_data[p], encoder->unit_size);
+    *length = RTP_HEADER_SIZE + FEC_HEADER_SIZE + encoder->unit_size;
+}
+
+static void bench_throughput(Block *block) {
+    printf("Encode / decode throughput (%d-packet blocks, payload bytes protected):\n", FEC_DEFAULT_BLOCK);
+    uint32_t seed = 7;
+    fill_block(block, FEC_DEFAULT_BLOCK, 1000, 0, &seed);
+    long block_bytes = 0;
+    for (int i = 0; i < FEC_DEFAULT_BLOCK; i++) block_bytes += block->chunks[i].payload_size;
+
+    for (int c = 0; c < NUM_CASES; c++) {
+        FecEncoder encoder;
+        fec_encoder_init(&encoder, cases[c].scheme, cases[c].param, FEC_DEFAULT_BLOCK, RTP_PT_VIDEO);
+        int64_t start = now_ns();
+        for (int b = 0; b < ENCODE_BLOCKS; b++) {
+            fec_encoder_add(&encoder, block->chunks, FEC_DEFAULT_BLOCK, 0);
+            fec_encoder_finish(&encoder);
+            if (b + 1 < ENCODE_BLOCKS) fec_encoder_begin(&encoder);
+        }
+        double encode_gbps = (double)block_bytes * ENCODE_BLOCKS / (now_ns() - start);
+
+        // Decode the worst case the scheme still repairs: one loss per row, or M losses
+        static unsigned char parity[FEC_MAX_BLOCK + FEC_MAX_COLUMNS][RTP_HEADER_SIZE + FEC_HEADER_SIZE + FEC_UNIT_MAX];
+        int parity_lengths[FEC_MAX_BLOCK + FEC_MAX_COLUMNS];
+        for (int p = 0; p < encoder.num_parity; p++) parity_packet(&encoder, p, 1000, 0, parity[p], &parity_lengths[p]);
+        int lost[FEC_MAX_BLOCK] = { 0 };
+        int num_lost = 0;
+        if (cases[c].scheme == FEC_SCHEME_RS) {
+            for (int i = 0; i < cases[c].param; i++) lost[1 + i * 3] = 1;
+            num_lost = cases[c].param;
+        } else {
+            for (int i = 1; i < FEC_DEFAULT_BLOCK; i += cases[c].param) lost[i] = 1;
+            num_lost = FEC_DEFAULT_BLOCK / cases[c].param;
+        }
+
+        PacketPool pool;
+        packet_pool_init(&pool, 4096);
+        int rounds = 2000;
+        long recovered_bytes = 0;
+        int64_t decode_ns = 0;
+        for (int r = 0; r < rounds; r++) {
+            FecDecoder *decoder = (FecDecoder *)malloc(sizeof(FecDecoder));
+            fec_decoder_init(decoder, &pool);
+            for (int i = 0; i < FEC_DEFAULT_BLOCK; i++) {
+                if (lost[i]) continue;
+                int slot = to_slot(&pool, block->packets[i], block->lengths[i]);
+                fec_decoder_add_media(decoder, slot);
+                packet_pool_release(&pool, slot);
+            }
+            int recovered[FEC_MAX_BLOCK];
+            int got = 0;
+            int64_t t = now_ns();
+            for (int p = 0; p < encoder.num_parity; p++) {
+                int slot = to_slot(&pool, parity[p], parity_lengths[p]);
+                got += fec_decoder_add_parity(decoder, slot, recovered + got, FEC_MAX_BLOCK - got);
+            }
+            decode_ns += now_ns() - t;
+            if (got != num_lost) {
+                fprintf(stderr, "%s: recovered %d of %d\n", cases[c].label, got, num_lost);
+                exit(1);
+            }
+            for (int i = 0; i < got; i++) {
+                recovered_bytes += pool.lengths[recovered[i]] - RTP_HEADER_SIZE;
+                packet_pool_release(&pool, recovered[i]);
+            }
+            fec_decoder_reset(decoder);
+            free(decoder);
+        }
+        packet_pool_destroy(&pool);
+        // Decode cost is charged per protected block: bytes of the whole block per decode time
+        double decode_gbps = (double)block_bytes * rounds / decode_ns;
+        printf("  %-10s encode %6.2f GB/s   decode (%2d lost) %6.2f GB/s   overhead %5.1f%%\n",
+               cases[c].label, encode_gbps, num_lost, decode_gbps,
+               100.0 * encoder.num_parity / FEC_DEFAULT_BLOCK);
+        (void)recovered_bytes;
+        fec_encoder_destroy(&encoder);
+    }
+    printf("\n");
+}
+
+static void bench_recovery(Block *block, double loss) {
+    printf("Random loss %.0f%% (media and parity), %d blocks of %d packets:\n", loss * 100, LOSS_BLOCKS, FEC_DEFAULT_BLOCK);
+    for (int c = 0; c < NUM_CASES; c++) {
+        uint32_t seed = 12345;
+        uint32_t loss_seed = 777;
+        uint32_t threshold = (uint32_t)(loss * 4294967295.0);
+        FecEncoder encoder;
+        fec_encoder_init(&encoder, cases[c].scheme, cases[c].param, FEC_DEFAULT_BLOCK, RTP_PT_VIDEO);
+        PacketPool pool;
+        packet_pool_init(&pool, 4096);
+        FecDecoder *decoder = (FecDecoder *)malloc(sizeof(FecDecoder));
+        fec_decoder_init(decoder, &pool);
+
+        long sent = 0, lost = 0, recovered_total = 0, parity_sent = 0;
+        static unsigned char parity[RTP_HEADER_SIZE + FEC_HEADER_SIZE + FEC_UNIT_MAX];
+        for (int b = 0; b < LOSS_BLOCKS; b++) {
+            uint16_t base_seq = (uint16_t)(60000 + b * FEC_DEFAULT_BLOCK);  // Wraps around
+            uint32_t timestamp = b * 3000;
+            fill_block(block, FEC_DEFAULT_BLOCK, base_seq, timestamp, &seed);
+            fec_encoder_begin(&encoder);
+            fec_encoder_add(&encoder, block->chunks, FEC_DEFAULT_BLOCK, timestamp);
+            fec_encoder_finish(&encoder);
+
+            for (int i = 0; i < FEC_DEFAULT_BLOCK; i++) {
+                sent++;
+                if (next_random(&loss_seed) < threshold) {
+                    lost++;
+                    continue;
+                }
+                int slot = to_slot(&pool, block->packets[i], block->lengths[i]);
+                fec_decoder_add_media(decoder, slot);
+                packet_pool_release(&pool, slot);
+            }
+            for (int p = 0; p < encoder.num_parity; p++) {
+                parity_sent++;
+                if (next_random(&loss_seed) < threshold) continue;
+                int length;
+                parity_packet(&encoder, p, base_seq, timestamp, parity, &length);
+                int recovered[FEC_MAX_BLOCK];
+                int got = fec_decoder_add_parity(decoder, to_slot(&pool, parity, length), recovered, FEC_MAX_BLOCK);
+                for (int i = 0; i < got; i++) {
+                    // Every rebuilt packet must match what was sent, byte for byte
+                    unsigned char *packet = packet_pool_data(&pool, recovered[i]);
+                    int index = (uint16_t)((packet[2] << 8 | packet[3]) - base_seq);
+                    if (index >= FEC_DEFAULT_BLOCK || pool.lengths[recovered[i]] != block->lengths[index] ||
+                        memcmp(packet, block->packets[index], block->lengths[index]) != 0) {
+                        fprintf(stderr, "%s: recovered packet %d does not match\n", cases[c].label, index);
+                        exit(1);
+                    }
+                    packet_pool_release(&pool, recovered[i]);
+                }
+                recovered_total += got;
+            }
+        }
+        printf("  %-10s lost %5ld of %ld media packets, recovered %5ld (%5.1f%%), residual loss %.3f%%, overhead %5.1f%%\n",
+               cases[c].label, lost, sent, recovered_total, lost ? 100.0 * recovered_total / lost : 100.0,
+               100.0 * (lost - recovered_total) / sent, 100.0 * parity_sent / sent);
+
+        fec_decoder_reset(decoder);
+        free(decoder);
+        packet_pool_destroy(&pool);
+        fec_encoder_destroy(&encoder);
+    }
+    printf("\n");
+}
+
+int main(void) {
+    Block *block = (Block *)malloc(sizeof(Block));
+    bench_kernels();
+    bench_throughput(block);
+    bench_recovery(block, 0.01);
+    bench_recovery(block, 0.05);
+    bench_recovery(block, 0.10);
+    free(block);
+    return 0;
+}
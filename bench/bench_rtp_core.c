@@ -0,0 +1,498 @@
+// RTP core benchmark: header pack/build/unpack, the rtp_codec writer and
+// parser (plain and with CSRCs plus an RFC 8285 extension), jitter buffer insert and
+// playout under in-order, reordered and lossy input, and end-to-end
+// packets/sec over loopback (send, receive, unpack, jitter buffer). Inputs
+// come from a seeded generator, so runs with the same seed do the same work.
+//
+//   bench_rtp_core [--seed N] [--packets N] [--repeat N] [--json]
+//
+// Each result is the fastest of --repeat runs (default 5), which filters out
+// most scheduler noise. --json prints one JSON object per result instead of
+// the table, for bench/bench_compare.sh. Build with `make bench`.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../rtp.h"
+#include "../jitter_buffer.h"
+#include "../packet_pool.h"
+#include "../rtp_codec.h"
+#include "../log.h"
+
+#define HEADER_VARIANTS 4096       // Distinct headers cycled through (power of two)
+#define HEADER_ROUNDS 20000000
+#define JB_POOL_SLOTS 4096
+#define JB_REORDER_PERCENT 10      // Share of packets swapped with a later one
+#define JB_REORDER_DISTANCE 8      // How far they move
+#define JB_LOSS_PERCENT 5
+#define JB_DRAIN_WINDOW 64         // Lossy input: skip gaps once this many packets wait behind one
+#define LOOPBACK_BATCH 32
+#define LOOPBACK_PORT 5400
+#define LOOPBACK_IDLE_MS 200
+
+static int json_output;
+static uint32_t bench_seed = 1;
+static int repeats = 5;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// xorshift32: reproducible headers and arrival orders
+static uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void report(const char *name, long ops, int64_t elapsed_ns, const char *note) {
+    double ns_per_op = (double)elapsed_ns / ops;
+    double ops_per_sec = ops * 1e9 / elapsed_ns;
+    if (json_output) {
+        printf("{\"bench\":\"rtp_core\",\"name\":\"%s\",\"seed\":%u,\"ops\":%ld,\"ns_per_op\":%.2f,"
+               "\"ops_per_sec\":%.0f}\n", name, bench_seed, ops, ns_per_op, ops_per_sec);
+    } else {
+        printf("  %-30s %9.1f ns/op %12.0f ops/s  %s\n", name, ns_per_op, ops_per_sec, note ? note : "");
+    }
+}
+
+static void bench_headers(void) {
+    RTPHeader *headers = (RTPHeader *)malloc(HEADER_VARIANTS * sizeof(RTPHeader));
+    unsigned char *packets = (unsigned char *)malloc((size_t)HEADER_VARIANTS * RTP_HEADER_SIZE);
+    unsigned char payload[CHUNK_SIZE];
+    unsigned char packet[RTP_HEADER_SIZE + CHUNK_SIZE];
+    uint32_t seed = bench_seed;
+    for (int i = 0; i < CHUNK_SIZE; i++) payload[i] = (unsigned char)next_random(&seed);
+    for (int i = 0; i < HEADER_VARIANTS; i++) {
+        uint32_t r = next_random(&seed);
+        headers[i].V = 2;
+        headers[i].P = 0;
+        headers[i].X = 0;
+        headers[i].CC = 0;
+        headers[i].M = r & 1;
+        headers[i].PT = 96;
+        headers[i].seq = (uint16_t)(r >> 8);
+        headers[i].timestamp = next_random(&seed);
+        headers[i].ssrc = next_random(&seed);
+    }
+    if (!json_output) printf("RTP header (%d distinct headers, %d-byte payload for build):\n", HEADER_VARIANTS, CHUNK_SIZE);
+
+    int64_t best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < HEADER_ROUNDS; i++) {
+            pack_rtp_header(&headers[i & (HEADER_VARIANTS - 1)],
+                            packets + (size_t)(i & (HEADER_VARIANTS - 1)) * RTP_HEADER_SIZE);
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    report("pack_rtp_header", HEADER_ROUNDS, best, NULL);
+
+    long build_rounds = HEADER_ROUNDS / 10;
+    unsigned check = 0;
+    best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < build_rounds; i++) {
+            build_rtp_packet(&headers[i & (HEADER_VARIANTS - 1)], payload, CHUNK_SIZE, packet);
+            check += packet[i & 15];
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    report("build_rtp_packet", build_rounds, best, NULL);
+
+    RTPHeader parsed;
+    best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < HEADER_ROUNDS; i++) {
+            unpack_rtp_header(packets + (size_t)(i & (HEADER_VARIANTS - 1)) * RTP_HEADER_SIZE, &parsed);
+            check += parsed.seq ^ parsed.timestamp;
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    report("unpack_rtp_header", HEADER_ROUNDS, best, NULL);
+
+    RtpHeaderFields fields;
+    memset(&fields, 0, sizeof(fields));
+    best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < HEADER_ROUNDS; i++) {
+            const RTPHeader *h = &headers[i & (HEADER_VARIANTS - 1)];
+            fields.marker = h->M;
+            fields.payload_type = h->PT;
+            fields.seq = h->seq;
+            fields.timestamp = h->timestamp;
+            fields.ssrc = h->ssrc;
+            rtp_write_header(&fields, packets + (size_t)(i & (HEADER_VARIANTS - 1)) * RTP_HEADER_SIZE,
+                             RTP_HEADER_SIZE);
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    report("rtp_write_header", HEADER_ROUNDS, best, NULL);
+
+    RtpPacketView view;
+    best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < HEADER_ROUNDS; i++) {
+            rtp_parse(packets + (size_t)(i & (HEADER_VARIANTS - 1)) * RTP_HEADER_SIZE, RTP_HEADER_SIZE, &view);
+            check += view.seq ^ view.timestamp;
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    report("rtp_parse", HEADER_ROUNDS, best, NULL);
+
+    // Mixer-style header: 2 CSRCs and a one-byte extension with two elements,
+    // parsed and searched for the second element
+    #define EXT_PACKET_SIZE 64
+    unsigned char *ext_packets = (unsigned char *)malloc((size_t)HEADER_VARIANTS * EXT_PACKET_SIZE);
+    uint8_t ext_body[16];
+    int ext_length = 0;
+    uint8_t audio_level = 0x25;
+    uint8_t abs_send_time[3] = { 0x12, 0x34, 0x56 };
+    rtp_ext_append(ext_body, sizeof(ext_body), &ext_length, 0, 1, &audio_level, 1);
+    rtp_ext_append(ext_body, sizeof(ext_body), &ext_length, 0, 3, abs_send_time, sizeof(abs_send_time));
+    fields.csrc_count = 2;
+    fields.has_extension = 1;
+    fields.ext_profile = RTP_EXT_PROFILE_ONE_BYTE;
+    fields.ext_data = ext_body;
+    fields.ext_length = ext_length;
+    int ext_header_size = 0;
+    for (int i = 0; i < HEADER_VARIANTS; i++) {
+        fields.seq = headers[i].seq;
+        fields.timestamp = headers[i].timestamp;
+        fields.ssrc = headers[i].ssrc;
+        fields.csrcs[0] = headers[i].ssrc + 1;
+        fields.csrcs[1] = headers[i].ssrc + 2;
+        ext_header_size = rtp_write_header(&fields, ext_packets + (size_t)i * EXT_PACKET_SIZE, EXT_PACKET_SIZE);
+        memset(ext_packets + (size_t)i * EXT_PACKET_SIZE + ext_header_size, 0, EXT_PACKET_SIZE - ext_header_size);
+    }
+    RtpExtElement element;
+    best = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        int64_t start = now_ns();
+        for (long i = 0; i < HEADER_ROUNDS; i++) {
+            rtp_parse(ext_packets + (size_t)(i & (HEADER_VARIANTS - 1)) * EXT_PACKET_SIZE, EXT_PACKET_SIZE, &view);
+            if (rtp_ext_find(&view, 3, &element) > 0) check += element.data[0];
+            check += view.payload_size ^ rtp_csrc(&view, 1);
+        }
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    char note[64];
+    snprintf(note, sizeof(note), "%d-byte header, find ext id 3", ext_header_size);
+    report("rtp_parse_csrc_ext", HEADER_ROUNDS, best, note);
+    free(ext_packets);
+    if (check == 0x12345678) printf(" ");  // Keeps the loops from being optimized away
+
+    free(headers);
+    free(packets);
+}
+
+// Arrival order of count packets: sequence offsets from 0, possibly
+// reordered and with some left out. Returns how many arrive.
+static int make_arrivals(int *order, int count, int reorder_percent, int loss_percent) {
+    uint32_t seed = bench_seed;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (loss_percent > 0 && (int)(next_random(&seed) % 100) < loss_percent) continue;
+        order[n++] = i;
+    }
+    for (int i = 0; i + JB_REORDER_DISTANCE < n; i++) {
+        if ((int)(next_random(&seed) % 100) < reorder_percent) {
+            int j = i + 1 + (int)(next_random(&seed) % JB_REORDER_DISTANCE);
+            int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+    }
+    return n;
+}
+
+// Insert every arrival and play out whatever is ready at once (playout at
+// line rate, no waiting on the playout delay). Returns the packets played.
+static long run_jitter_buffer(JitterBuffer *jb, PacketPool *pool, const int *order, int n, uint16_t base_seq) {
+    RTPStats stats;
+    memset(&stats, 0, sizeof(stats));
+    long played = 0;
+    int slot, size, is_last, skipped = 0;
+    for (int i = 0; i < n; i++) {
+        int handle = packet_pool_acquire(pool);
+        uint16_t seq = (uint16_t)(base_seq + order[i]);
+        uint32_t timestamp = (uint32_t)(order[i] / 10) * 3000;
+        if (add_to_jitter_buffer(jb, handle, CHUNK_SIZE, seq, timestamp, order[i] % 10 == 9, &stats) < 0) {
+            packet_pool_release(pool, handle);
+        }
+        while (get_from_jitter_buffer(jb, &slot, &size, &is_last, 1) > 0) {
+            packet_pool_release(pool, slot);
+            played++;
+        }
+        // A gap holds everything behind it until its timeout: skip it once enough waits
+        if (jb->buffer_count >= JB_DRAIN_WINDOW && drain_jitter_buffer_head(jb, &slot, &size, &is_last, &skipped)) {
+            packet_pool_release(pool, slot);
+            played++;
+        }
+    }
+    while (drain_jitter_buffer_head(jb, &slot, &size, &is_last, &skipped)) {
+        packet_pool_release(pool, slot);
+        played++;
+    }
+    return played;
+}
+
+static void bench_jitter_buffer(int packets) {
+    static const struct { const char *name; int reorder; int loss; } cases[] = {
+        { "jitter_buffer_in_order", 0, 0 },
+        { "jitter_buffer_reordered", JB_REORDER_PERCENT, 0 },
+        { "jitter_buffer_lossy", 0, JB_LOSS_PERCENT },
+        { "jitter_buffer_reordered_lossy", JB_REORDER_PERCENT, JB_LOSS_PERCENT },
+    };
+    PacketPool pool;
+    if (packet_pool_init(&pool, JB_POOL_SLOTS) < 0) {
+        fprintf(stderr, "Failed to allocate packet pool\n");
+        exit(1);
+    }
+    JitterBuffer *jb = (JitterBuffer *)malloc(sizeof(JitterBuffer));
+    int *order = (int *)malloc(packets * sizeof(int));
+    if (!json_output) {
+        printf("\nJitter buffer insert + playout (%d packets, %d%% swapped up to %d apart, %d%% loss):\n",
+               packets, JB_REORDER_PERCENT, JB_REORDER_DISTANCE, JB_LOSS_PERCENT);
+    }
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        int n = make_arrivals(order, packets, cases[c].reorder, cases[c].loss);
+        int64_t best = INT64_MAX;
+        long played = 0;
+        for (int r = 0; r < repeats; r++) {
+            init_jitter_buffer(jb, &pool);
+            int64_t start = now_ns();
+            played = run_jitter_buffer(jb, &pool, order, n, (uint16_t)bench_seed);
+            int64_t elapsed = now_ns() - start;
+            if (elapsed < best) best = elapsed;
+            reset_jitter_buffer(jb);
+        }
+        char note[96];
+        snprintf(note, sizeof(note), "(%ld of %d played)", played, n);
+        report(cases[c].name, n, best, note);
+    }
+    free(order);
+    free(jb);
+    packet_pool_destroy(&pool);
+}
+
+typedef struct {
+    int sockfd;
+    struct sockaddr_in to;
+    int packets;
+    int64_t elapsed_ns;
+} LoopbackSender;
+
+// Frames of 10 packets, sent with sendmmsg as fast as the socket takes them
+static void *loopback_send(void *arg) {
+    LoopbackSender *s = (LoopbackSender *)arg;
+    static unsigned char packets[LOOPBACK_BATCH][RTP_HEADER_SIZE + CHUNK_SIZE];
+    struct mmsghdr msgs[LOOPBACK_BATCH];
+    struct iovec iovs[LOOPBACK_BATCH];
+    uint32_t seed = bench_seed;
+    for (int i = 0; i < LOOPBACK_BATCH; i++) {
+        for (int b = RTP_HEADER_SIZE; b < RTP_HEADER_SIZE + CHUNK_SIZE; b++) packets[i][b] = (unsigned char)next_random(&seed);
+    }
+    RTPHeader header;
+    memset(&header, 0, sizeof(header));
+    header.V = 2;
+    header.PT = 96;
+    header.ssrc = next_random(&seed);
+    header.seq = (uint16_t)next_random(&seed);
+
+    int64_t start = now_ns();
+    for (int sent = 0; sent < s->packets; ) {
+        int batch = s->packets - sent < LOOPBACK_BATCH ? s->packets - sent : LOOPBACK_BATCH;
+        memset(msgs, 0, batch * sizeof(struct mmsghdr));
+        for (int i = 0; i < batch; i++) {
+            header.timestamp = (uint32_t)((sent + i) / 10) * 3000;
+            header.M = (sent + i) % 10 == 9;
+            pack_rtp_header(&header, packets[i]);
+            header.seq++;
+            iovs[i].iov_base = packets[i];
+            iovs[i].iov_len = sizeof(packets[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &s->to;
+            msgs[i].msg_hdr.msg_namelen = sizeof(s->to);
+        }
+        int n = sendmmsg(s->sockfd, msgs, batch, 0);
+        if (n <= 0) {
+            header.seq -= batch;
+            continue;
+        }
+        header.seq -= batch - n;
+        sent += n;
+    }
+    s->elapsed_ns = now_ns() - start;
+    return NULL;
+}
+
+typedef struct {
+    int64_t send_ns;
+    int64_t receive_ns;    // First send to the last packet received
+    long received;
+    long played;
+} LoopbackResult;
+
+// Sender thread to a receiving socket on loopback: recvmmsg into pool slots,
+// unpack, jitter buffer, playout. Counts what the receive side got through.
+static int run_loopback(int packets, LoopbackResult *result) {
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(LOOPBACK_PORT);
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (rx < 0 || tx < 0 || bind(rx, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("Loopback socket");
+        if (rx >= 0) close(rx);
+        if (tx >= 0) close(tx);
+        return -1;
+    }
+
+    PacketPool pool;
+    packet_pool_init(&pool, JB_POOL_SLOTS);
+    JitterBuffer *jb = (JitterBuffer *)malloc(sizeof(JitterBuffer));
+    init_jitter_buffer(jb, &pool);
+    RTPStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    LoopbackSender sender = { tx, addr, packets, 0 };
+    pthread_t thread;
+    int64_t start = now_ns();
+    pthread_create(&thread, NULL, loopback_send, &sender);
+
+    struct mmsghdr msgs[LOOPBACK_BATCH];
+    struct iovec iovs[LOOPBACK_BATCH];
+    int slots[LOOPBACK_BATCH];
+    long received = 0, played = 0;
+    int64_t last_ns = start;
+    int slot, size, is_last, skipped = 0;
+    for (;;) {
+        struct pollfd pfd = { rx, POLLIN, 0 };
+        if (poll(&pfd, 1, LOOPBACK_IDLE_MS) <= 0) break;
+        for (int i = 0; i < LOOPBACK_BATCH; i++) {
+            slots[i] = packet_pool_acquire(&pool);
+            iovs[i].iov_base = packet_pool_data(&pool, slots[i]);
+            iovs[i].iov_len = PACKET_SLOT_SIZE;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(rx, msgs, LOOPBACK_BATCH, MSG_DONTWAIT, NULL);
+        for (int i = 0; i < LOOPBACK_BATCH; i++) {
+            if (i >= n) {
+                packet_pool_release(&pool, slots[i]);
+                continue;
+            }
+            RTPHeader header;
+            unpack_rtp_header(packet_pool_data(&pool, slots[i]), &header);
+            if (add_to_jitter_buffer(jb, slots[i], msgs[i].msg_len - RTP_HEADER_SIZE, header.seq, header.timestamp,
+                                     header.M, &stats) < 0) {
+                packet_pool_release(&pool, slots[i]);
+            }
+        }
+        if (n > 0) {
+            received += n;
+            last_ns = now_ns();
+        }
+        while (get_from_jitter_buffer(jb, &slot, &size, &is_last, 1) > 0) {
+            packet_pool_release(&pool, slot);
+            played++;
+        }
+        if (jb->buffer_count >= JB_DRAIN_WINDOW && drain_jitter_buffer_head(jb, &slot, &size, &is_last, &skipped)) {
+            packet_pool_release(&pool, slot);
+            played++;
+        }
+    }
+    pthread_join(thread, NULL);
+    result->send_ns = sender.elapsed_ns;
+    result->receive_ns = last_ns - start;
+    result->received = received;
+    result->played = played;
+
+    close(rx);
+    close(tx);
+    reset_jitter_buffer(jb);
+    free(jb);
+    packet_pool_destroy(&pool);
+    return 0;
+}
+
+// Packets/sec are taken from the run that received the most in the least time
+static void bench_loopback(int packets) {
+    LoopbackResult best, run;
+    memset(&best, 0, sizeof(best));
+    int64_t best_send_ns = INT64_MAX;
+    for (int r = 0; r < repeats; r++) {
+        if (run_loopback(packets, &run) < 0) return;
+        if (run.send_ns < best_send_ns) best_send_ns = run.send_ns;
+        if (run.received > 0 && (best.received == 0 ||
+            (double)run.received / run.receive_ns > (double)best.received / best.receive_ns)) {
+            best = run;
+        }
+    }
+    if (!json_output) printf("\nLoopback end to end (%d packets of %d bytes, sendmmsg -> recvmmsg -> jitter buffer):\n",
+                             packets, RTP_HEADER_SIZE + CHUNK_SIZE);
+    report("loopback_send", packets, best_send_ns, NULL);
+    char note[96];
+    snprintf(note, sizeof(note), "(%ld of %d received, %ld played)", best.received, packets, best.played);
+    report("loopback_receive", best.received > 0 ? best.received : 1, best.receive_ns > 0 ? best.receive_ns : 1, note);
+}
+
+int main(int argc, char *argv[]) {
+    int packets = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            bench_seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (bench_seed == 0) bench_seed = 1;  // xorshift needs a nonzero state
+        } else if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) {
+            packets = atoi(argv[++i]);
+            if (packets < 1000) {
+                fprintf(stderr, "At least 1000 packets\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+            if (repeats < 1) {
+                fprintf(stderr, "At least 1 repetition\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json_output = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--seed N] [--packets N] [--repeat N] [--json]\n", argv[0]);
+            return 1;
+        }
+    }
+    log_set_level(LOG_LEVEL_ERROR);  // Gap skips log at info level
+
+    bench_headers();
+    bench_jitter_buffer(packets);
+    bench_loopback(packets / 4);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Sender fan-out cost: CPU time per destination per frame as the number of
+# destinations grows. Destinations are unused loopback ports, so only the
+# send side is measured.
+#
+#   bench/fanout_cpu.sh [VIDEO_FILE] [BYTES]
+set -e
+
+cd "$(dirname "$0")/.."
+VIDEO=${1:-reconstructed_vid.mp4}
+BYTES=${2:-204800}   # 20 frames at the default 10 x 1 KB packets per frame
+
+make -s sender
+RUN_DIR=$(mktemp -d)
+trap 'rm -rf "$RUN_DIR"' EXIT
+head -c "$BYTES" "$VIDEO" > "$RUN_DIR/input"
+
+echo "destinations  cpu_ms  us_per_dest_frame  slowest_frame_ms  late_frames"
+for n in 1 2 10 50 200 1000; do
+    : > "$RUN_DIR/dests"
+    i=0
+    while [ "$i" -lt "$n" ]; do
+        echo "127.0.0.1:$((20000 + i))" >> "$RUN_DIR/dests"
+        i=$((i + 1))
+    done
+    # The positional receiver plus --dest-file: force the fan-out path even for n = 1
+    ./sender "$RUN_DIR/input" 127.0.0.1:19999 --dest-file "$RUN_DIR/dests" --log-level warn > "$RUN_DIR/out"
+    cpu=$(sed -n 's/^CPU time: \([0-9.]*\) ms (\([0-9.]*\) us.*/\1 \2/p' "$RUN_DIR/out")
+    fan=$(sed -n 's/.*slowest frame \([0-9.]*\) ms.* \([0-9]*\) late frames.*/\1 \2/p' "$RUN_DIR/out")
+    printf "%12d  %6s  %17s  %16s  %11s\n" $((n + 1)) $cpu $fan
+done
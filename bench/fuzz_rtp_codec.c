@@ -0,0 +1,202 @@
+// Fuzz harness for rtp_codec. Every input is copied into a buffer of exactly
+// its length, so an over-read anywhere in rtp_parse or the extension walk
+// trips AddressSanitizer; the view is then checked against the input length.
+// Valid headers built with rtp_write_header/rtp_ext_append must also parse
+// back to the same fields.
+//
+//   fuzz_rtp_codec [--seed N] [--iterations N]
+//
+// The standalone run mutates seeded, mostly valid packets (flipped bits,
+// truncation, random CSRC/extension/padding lengths). Built with
+// FUZZ_LIBFUZZER=1 (clang) it is a libFuzzer target instead. Build with
+// `make bench/fuzz_rtp_codec`.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../rtp_codec.h"
+
+#define MAX_INPUT 1500
+#define DEFAULT_ITERATIONS 2000000
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "fuzz_rtp_codec: check failed at line %d: %s\n", __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+// Parse one input and check everything the view claims against its length
+static void check_packet(const uint8_t *data, int size) {
+    uint8_t *packet = (uint8_t *)malloc(size > 0 ? size : 1);
+    memcpy(packet, data, size);
+
+    RtpPacketView view;
+    if (rtp_parse(packet, size, &view) == RTP_PARSE_OK) {
+        CHECK(view.header_size >= RTP_HEADER_SIZE + 4 * view.csrc_count);
+        CHECK(view.payload == packet + view.header_size);
+        CHECK(view.payload_size >= 0);
+        CHECK(view.header_size + view.payload_size + view.padding == size);
+        volatile uint32_t sink = 0;
+        for (int i = 0; i < view.csrc_count; i++) sink += rtp_csrc(&view, i);
+        if (view.has_extension) {
+            CHECK(view.ext_data >= packet && view.ext_data + view.ext_length <= packet + view.header_size);
+            RtpExtIterator it;
+            RtpExtElement element;
+            rtp_ext_begin(&view, &it);
+            int result;
+            while ((result = rtp_ext_next(&it, &element)) > 0) {
+                CHECK(element.data >= view.ext_data && element.data + element.length <= view.ext_data + view.ext_length);
+                for (int i = 0; i < element.length; i++) sink += element.data[i];
+            }
+        }
+        if (view.payload_size > 0) sink += view.payload[view.payload_size - 1];
+        (void)sink;
+    }
+    free(packet);
+}
+
+#ifdef RTP_FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size > MAX_INPUT) return 0;
+    check_packet(data, (int)size);
+    return 0;
+}
+
+#else
+
+static uint64_t rng_state;
+
+// xorshift64*
+static uint32_t next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// Random header with CSRCs and RFC 8285 elements; the elements are kept in
+// ids/lengths so the parse can be compared against them
+static int build_valid(uint8_t *out, RtpHeaderFields *fields, int *ids, int *lengths, int *elements) {
+    memset(fields, 0, sizeof(*fields));
+    fields->marker = next_random() & 1;
+    fields->payload_type = next_random() & 0x7F;
+    fields->seq = (uint16_t)next_random();
+    fields->timestamp = next_random();
+    fields->ssrc = next_random();
+    fields->csrc_count = next_random() % (RTP_MAX_CSRC + 1);
+    for (int i = 0; i < fields->csrc_count; i++) fields->csrcs[i] = next_random();
+
+    static uint8_t ext_body[512];
+    int ext_length = 0;
+    *elements = 0;
+    if (next_random() & 1) {
+        int two_byte = next_random() & 1;
+        fields->has_extension = 1;
+        fields->ext_profile = two_byte ? RTP_EXT_PROFILE_TWO_BYTE | (next_random() & 0x0F) : RTP_EXT_PROFILE_ONE_BYTE;
+        int count = next_random() % 8;
+        for (int e = 0; e < count; e++) {
+            uint8_t data[RTP_EXT_TWO_BYTE_MAX];
+            int id = two_byte ? 1 + next_random() % 255 : 1 + next_random() % 14;
+            int length = two_byte ? next_random() % 40 : 1 + next_random() % RTP_EXT_ONE_BYTE_MAX;
+            for (int i = 0; i < length; i++) data[i] = (uint8_t)next_random();
+            if (rtp_ext_append(ext_body, sizeof(ext_body), &ext_length, two_byte, (uint8_t)id, data, length) < 0) break;
+            ids[*elements] = id;
+            lengths[*elements] = length;
+            (*elements)++;
+        }
+        fields->ext_data = ext_body;
+        fields->ext_length = ext_length;
+    }
+
+    int size = rtp_write_header(fields, out, MAX_INPUT);
+    CHECK(size > 0);
+    int payload = next_random() % 200;
+    for (int i = 0; i < payload; i++) out[size + i] = (uint8_t)next_random();
+    size += payload;
+    if (next_random() % 4 == 0) {
+        int padding = 1 + next_random() % 32;
+        memset(out + size, 0, padding - 1);
+        out[size + padding - 1] = (uint8_t)padding;
+        out[0] |= 0x20;
+        size += padding;
+    }
+    return size;
+}
+
+static void check_round_trip(const uint8_t *packet, int size, const RtpHeaderFields *fields,
+                             const int *ids, const int *lengths, int elements) {
+    RtpPacketView view;
+    CHECK(rtp_parse(packet, size, &view) == RTP_PARSE_OK);
+    CHECK(view.marker == fields->marker && view.payload_type == fields->payload_type);
+    CHECK(view.seq == fields->seq && view.timestamp == fields->timestamp && view.ssrc == fields->ssrc);
+    CHECK(view.csrc_count == fields->csrc_count);
+    for (int i = 0; i < fields->csrc_count; i++) CHECK(rtp_csrc(&view, i) == fields->csrcs[i]);
+    CHECK(view.has_extension == fields->has_extension);
+    if (!fields->has_extension) return;
+    CHECK(view.ext_profile == fields->ext_profile);
+
+    RtpExtIterator it;
+    RtpExtElement element;
+    rtp_ext_begin(&view, &it);
+    for (int e = 0; e < elements; e++) {
+        CHECK(rtp_ext_next(&it, &element) == 1);
+        CHECK(element.id == ids[e] && element.length == lengths[e]);
+        CHECK(memcmp(element.data, fields->ext_data + (element.data - view.ext_data), element.length) == 0);
+    }
+    CHECK(rtp_ext_next(&it, &element) == 0);
+}
+
+static void mutate(uint8_t *packet, int *size) {
+    int flips = next_random() % 4;
+    for (int i = 0; i < flips && *size > 0; i++) {
+        packet[next_random() % *size] ^= (uint8_t)(1 << (next_random() % 8));
+    }
+    // Bits that steer the parse: P, X, CC, the extension length, the padding count
+    if (next_random() % 4 == 0 && *size > 0) packet[0] = (uint8_t)(0x80 | (next_random() & 0x3F));
+    if (next_random() % 4 == 0 && *size > 0) packet[*size - 1] = (uint8_t)next_random();
+    if (next_random() % 3 == 0) *size = next_random() % (*size + 1);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t seed = 1;
+    long iterations = DEFAULT_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seed N] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+    rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    static uint8_t packet[MAX_INPUT + 512];
+    RtpHeaderFields fields;
+    int ids[8], lengths[8], elements;
+    long parsed = 0;
+    for (long n = 0; n < iterations; n++) {
+        int size;
+        if (next_random() % 8 == 0) {
+            // Unstructured bytes (forced to version 2 half the time)
+            size = next_random() % 128;
+            for (int i = 0; i < size; i++) packet[i] = (uint8_t)next_random();
+            if (size > 0 && (next_random() & 1)) packet[0] = (packet[0] & 0x3F) | 0x80;
+        } else {
+            size = build_valid(packet, &fields, ids, lengths, &elements);
+            check_round_trip(packet, size, &fields, ids, lengths, elements);
+            mutate(packet, &size);
+        }
+        RtpPacketView view;
+        if (rtp_parse(packet, size, &view) == RTP_PARSE_OK) parsed++;
+        check_packet(packet, size);
+    }
+    printf("fuzz_rtp_codec: %ld inputs (seed %llu), %ld parsed, %ld rejected, no failures\n",
+           iterations, (unsigned long long)seed, parsed, iterations - parsed);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,459 @@
+// Loopback network emulator between sender and receiver: a UDP proxy that
+// applies seeded, repeatable impairments to the media direction.
+//
+//   loss       Bernoulli (--loss) or Gilbert-Elliott bursts (--gilbert)
+//   delay      fixed propagation delay plus jitter drawn from a uniform,
+//              normal or Pareto distribution; jitter larger than the packet
+//              spacing reorders packets unless --in-order is given
+//   reorder    a share of packets held back so later ones overtake them
+//   duplicate  a share of packets delivered twice
+//   link       bottleneck rate with a drop-tail queue, optionally following
+//              a schedule to test adaptation
+//
+// Datagrams from the receiver (RTCP feedback) go back to the sender with the
+// fixed delay and no other impairment.
+//
+//   impair_proxy [--listen PORT] [--to IP:PORT] [--seed N] [--trace FILE]
+//                [--loss PERCENT] [--gilbert P,R[,BAD[,GOOD]]]
+//                [--delay MS] [--jitter MS] [--jitter-dist uniform|normal|pareto] [--in-order]
+//                [--reorder PERCENT] [--reorder-delay MS] [--duplicate PERCENT]
+//                [--rate KBPS] [--queue BYTES] [--schedule SEC:KBPS,...]
+//
+// Point the sender at the listen port (default 6000); packets go on to the
+// receiver (default 127.0.0.1:5000). Exits after 5 s without traffic.
+//
+// Each impairment draws from its own random stream derived from --seed, so
+// the n-th media datagram meets the same fate on every run, and enabling one
+// impairment does not change the decisions of another. Only queue drops at
+// the rate limit depend on timing. --trace writes one line per datagram
+// (index, size, fate, delay) to compare runs.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define PROXY_SLOTS 8192          // Datagrams in flight per direction
+#define PROXY_SLOT_SIZE 2048
+#define PROXY_IDLE_MS 5000
+#define PROXY_MAX_SCHEDULE 32
+#define PROXY_PARETO_SHAPE 3.0    // Tail index of the Pareto jitter
+
+#define JITTER_UNIFORM 0
+#define JITTER_NORMAL 1
+#define JITTER_PARETO 2
+
+// Datagrams in flight in one direction: a min-heap on delivery time (ties in
+// arrival order), since jitter and reordering deliver out of arrival order
+typedef struct {
+    unsigned char *data;
+    int lengths[PROXY_SLOTS];
+    int64_t deliver_ns[PROXY_SLOTS];
+    long order[PROXY_SLOTS];
+    int heap[PROXY_SLOTS];
+    int heap_size;
+    int free_slots[PROXY_SLOTS];
+    int free_count;
+    long pushed;
+} DelayQueue;
+
+typedef struct {
+    double at_s;
+    double kbps;
+} RateStep;
+
+// xorshift64*: one independent stream per impairment
+typedef struct {
+    uint64_t state;
+} Rng;
+
+// Gilbert-Elliott channel: per packet, move between the good and bad state
+// (probabilities p and r), then lose the packet with the state's loss rate
+typedef struct {
+    double p;
+    double r;
+    double loss_good;
+    double loss_bad;
+    int bad;
+} GilbertChannel;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// splitmix64 spreads the seed, so neighbouring seeds and streams are unrelated
+static void rng_seed(Rng *rng, uint64_t seed, uint64_t stream) {
+    uint64_t z = seed + stream * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    rng->state = (z ^ (z >> 31)) | 1;
+}
+
+static double random_unit(Rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (double)((rng->state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+// Jitter sample in ms: uniform in [-jitter, jitter], normal with standard
+// deviation jitter, or a one-sided Pareto tail with mean jitter
+static double random_jitter_ms(Rng *rng, int dist, double jitter_ms) {
+    if (dist == JITTER_NORMAL) {
+        // Box-Muller
+        double u1 = 1.0 - random_unit(rng);
+        double u2 = random_unit(rng);
+        return jitter_ms * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    }
+    if (dist == JITTER_PARETO) {
+        double u = 1.0 - random_unit(rng);
+        return jitter_ms * (PROXY_PARETO_SHAPE - 1) * (pow(u, -1.0 / PROXY_PARETO_SHAPE) - 1);
+    }
+    return jitter_ms * (2 * random_unit(rng) - 1);
+}
+
+static int gilbert_lose(GilbertChannel *channel, Rng *rng) {
+    if (channel->bad) {
+        if (random_unit(rng) < channel->r) channel->bad = 0;
+    } else {
+        if (random_unit(rng) < channel->p) channel->bad = 1;
+    }
+    return random_unit(rng) < (channel->bad ? channel->loss_bad : channel->loss_good);
+}
+
+static void delay_queue_init(DelayQueue *queue) {
+    memset(queue, 0, sizeof(*queue));
+    queue->data = (unsigned char *)malloc((size_t)PROXY_SLOTS * PROXY_SLOT_SIZE);
+    for (int i = 0; i < PROXY_SLOTS; i++) queue->free_slots[i] = PROXY_SLOTS - 1 - i;
+    queue->free_count = PROXY_SLOTS;
+}
+
+static int heap_before(DelayQueue *queue, int a, int b) {
+    if (queue->deliver_ns[a] != queue->deliver_ns[b]) return queue->deliver_ns[a] < queue->deliver_ns[b];
+    return queue->order[a] < queue->order[b];
+}
+
+static int delay_queue_push(DelayQueue *queue, const unsigned char *data, int length, int64_t deliver_ns) {
+    if (queue->free_count == 0) return -1;
+    int slot = queue->free_slots[--queue->free_count];
+    memcpy(queue->data + (size_t)slot * PROXY_SLOT_SIZE, data, length);
+    queue->lengths[slot] = length;
+    queue->deliver_ns[slot] = deliver_ns;
+    queue->order[slot] = queue->pushed++;
+
+    int i = queue->heap_size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heap_before(queue, slot, queue->heap[parent])) break;
+        queue->heap[i] = queue->heap[parent];
+        i = parent;
+    }
+    queue->heap[i] = slot;
+    return 0;
+}
+
+static void delay_queue_pop(DelayQueue *queue) {
+    queue->free_slots[queue->free_count++] = queue->heap[0];
+    int last = queue->heap[--queue->heap_size];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= queue->heap_size) break;
+        if (child + 1 < queue->heap_size && heap_before(queue, queue->heap[child + 1], queue->heap[child])) child++;
+        if (!heap_before(queue, queue->heap[child], last)) break;
+        queue->heap[i] = queue->heap[child];
+        i = child;
+    }
+    queue->heap[i] = last;
+}
+
+// Send everything due by now; returns the next delivery time, or -1
+static int64_t delay_queue_flush(DelayQueue *queue, int sockfd, struct sockaddr_in *to, int64_t now) {
+    while (queue->heap_size > 0) {
+        int slot = queue->heap[0];
+        if (queue->deliver_ns[slot] > now) return queue->deliver_ns[slot];
+        sendto(sockfd, queue->data + (size_t)slot * PROXY_SLOT_SIZE, queue->lengths[slot], 0,
+               (struct sockaddr *)to, sizeof(*to));
+        delay_queue_pop(queue);
+    }
+    return -1;
+}
+
+static int parse_schedule(char *spec, RateStep *steps) {
+    int count = 0;
+    for (char *step = strtok(spec, ","); step && count < PROXY_MAX_SCHEDULE; step = strtok(NULL, ",")) {
+        if (sscanf(step, "%lf:%lf", &steps[count].at_s, &steps[count].kbps) != 2) return -1;
+        count++;
+    }
+    return count;
+}
+
+// "P,R[,BAD[,GOOD]]" in percent; BAD defaults to 100, GOOD to 0
+static int parse_gilbert(const char *spec, GilbertChannel *channel) {
+    double p, r, bad = 100, good = 0;
+    int fields = sscanf(spec, "%lf,%lf,%lf,%lf", &p, &r, &bad, &good);
+    if (fields < 2 || p < 0 || p > 100 || r <= 0 || r > 100 || bad < 0 || bad > 100 || good < 0 || good > 100)
+        return -1;
+    channel->p = p / 100;
+    channel->r = r / 100;
+    channel->loss_bad = bad / 100;
+    channel->loss_good = good / 100;
+    channel->bad = 0;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int listen_port = 6000;
+    const char *to_spec = "127.0.0.1:5000";
+    double rate_kbps = 0;         // 0 = no bottleneck
+    long queue_bytes = 64 * 1024;
+    double delay_ms = 0;
+    double jitter_ms = 0;
+    int jitter_dist = JITTER_UNIFORM;
+    int in_order = 0;             // Jitter never lets a packet overtake an earlier one
+    double loss_percent = 0;
+    int gilbert = 0;
+    GilbertChannel channel = { 0, 1, 0, 1, 0 };
+    double reorder_percent = 0;
+    double reorder_delay_ms = 10;
+    double duplicate_percent = 0;
+    uint64_t seed = 1;
+    const char *trace_path = NULL;
+    RateStep schedule[PROXY_MAX_SCHEDULE];
+    int schedule_steps = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listen_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            to_spec = argv[++i];
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate_kbps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            queue_bytes = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            delay_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            jitter_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--jitter-dist") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "uniform") == 0) jitter_dist = JITTER_UNIFORM;
+            else if (strcmp(argv[i], "normal") == 0) jitter_dist = JITTER_NORMAL;
+            else if (strcmp(argv[i], "pareto") == 0) jitter_dist = JITTER_PARETO;
+            else {
+                fprintf(stderr, "Jitter distribution must be uniform, normal or pareto\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--in-order") == 0) {
+            in_order = 1;
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            loss_percent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--gilbert") == 0 && i + 1 < argc) {
+            if (parse_gilbert(argv[++i], &channel) < 0) {
+                fprintf(stderr, "Gilbert-Elliott loss must be P,R[,BAD[,GOOD]] in percent (R > 0)\n");
+                return 1;
+            }
+            gilbert = 1;
+        } else if (strcmp(argv[i], "--reorder") == 0 && i + 1 < argc) {
+            reorder_percent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--reorder-delay") == 0 && i + 1 < argc) {
+            reorder_delay_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--duplicate") == 0 && i + 1 < argc) {
+            duplicate_percent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc) {
+            schedule_steps = parse_schedule(argv[++i], schedule);
+            if (schedule_steps < 0) {
+                fprintf(stderr, "Schedule must be SEC:KBPS[,SEC:KBPS]...\n");
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--listen PORT] [--to IP:PORT] [--seed N] [--trace FILE] "
+                    "[--loss PERCENT] [--gilbert P,R[,BAD[,GOOD]]] [--delay MS] [--jitter MS] "
+                    "[--jitter-dist uniform|normal|pareto] [--in-order] [--reorder PERCENT] [--reorder-delay MS] "
+                    "[--duplicate PERCENT] [--rate KBPS] [--queue BYTES] [--schedule SEC:KBPS,...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (gilbert && loss_percent > 0) {
+        fprintf(stderr, "Use either --loss or --gilbert\n");
+        return 1;
+    }
+    Rng loss_rng, delay_rng, reorder_rng, duplicate_rng;
+    rng_seed(&loss_rng, seed, 1);
+    rng_seed(&delay_rng, seed, 2);
+    rng_seed(&reorder_rng, seed, 3);
+    rng_seed(&duplicate_rng, seed, 4);
+
+    struct sockaddr_in receiver;
+    memset(&receiver, 0, sizeof(receiver));
+    receiver.sin_family = AF_INET;
+    char host[64];
+    int port = 5000;
+    if (sscanf(to_spec, "%63[^:]:%d", host, &port) < 1 || inet_pton(AF_INET, host, &receiver.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid receiver address: %s\n", to_spec);
+        return 1;
+    }
+    receiver.sin_port = htons(port);
+
+    FILE *trace = NULL;
+    if (trace_path && !(trace = fopen(trace_path, "w"))) {
+        perror(trace_path);
+        return 1;
+    }
+
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(listen_port);
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sockfd < 0 || bind(sockfd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("Bind failed");
+        return 1;
+    }
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    DelayQueue forward, backward;
+    delay_queue_init(&forward);
+    delay_queue_init(&backward);
+
+    struct sockaddr_in sender;
+    int have_sender = 0;
+    int64_t start_ns = 0;
+    int64_t link_free_ns = 0;     // When the bottleneck finishes its backlog
+    int64_t last_deliver_ns = 0;  // Latest forward delivery, for --in-order
+    int64_t last_packet_ns = now_ns();
+    int64_t delay_ns = (int64_t)(delay_ms * 1e6);
+    long received = 0, forwarded = 0, random_drops = 0, queue_drops = 0, feedback = 0;
+    long reordered = 0, duplicated = 0, loss_bursts = 0;
+    int previous_lost = 0;
+    int64_t max_queue_ns = 0;
+    double delay_sum_ms = 0, max_delay_ms = 0;
+    unsigned char packet[PROXY_SLOT_SIZE];
+
+    for (;;) {
+        int64_t now = now_ns();
+        int64_t next_forward = delay_queue_flush(&forward, sockfd, &receiver, now);
+        int64_t next_backward = have_sender ? delay_queue_flush(&backward, sockfd, &sender, now) : -1;
+        if (now - last_packet_ns > PROXY_IDLE_MS * 1000000LL && next_forward < 0 && next_backward < 0) break;
+
+        int64_t wake = last_packet_ns + PROXY_IDLE_MS * 1000000LL;
+        if (next_forward >= 0 && next_forward < wake) wake = next_forward;
+        if (next_backward >= 0 && next_backward < wake) wake = next_backward;
+        int timeout_ms = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+        struct pollfd pfd = { sockfd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) <= 0) continue;
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n;
+        while ((n = recvfrom(sockfd, packet, sizeof(packet), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len)) >= 0) {
+            from_len = sizeof(from);
+            now = now_ns();
+            last_packet_ns = now;
+            if (from.sin_addr.s_addr == receiver.sin_addr.s_addr && from.sin_port == receiver.sin_port) {
+                feedback++;
+                delay_queue_push(&backward, packet, n, now + delay_ns);
+                continue;
+            }
+            if (!have_sender) {
+                sender = from;
+                have_sender = 1;
+                start_ns = now;
+            }
+            long index = received++;
+
+            // Every random draw happens for every datagram, whatever the
+            // outcome, so each stream stays aligned with the datagram index
+            int lost = gilbert ? gilbert_lose(&channel, &loss_rng) : random_unit(&loss_rng) * 100 < loss_percent;
+            double jitter = jitter_ms > 0 ? random_jitter_ms(&delay_rng, jitter_dist, jitter_ms) : 0;
+            double duplicate_jitter = jitter_ms > 0 ? random_jitter_ms(&delay_rng, jitter_dist, jitter_ms) : 0;
+            int reorder = random_unit(&reorder_rng) * 100 < reorder_percent;
+            int duplicate = random_unit(&duplicate_rng) * 100 < duplicate_percent;
+
+            if (lost) {
+                random_drops++;
+                if (!previous_lost) loss_bursts++;
+                previous_lost = 1;
+                if (trace) fprintf(trace, "%ld %d lost\n", index, n);
+                continue;
+            }
+            previous_lost = 0;
+
+            double kbps = rate_kbps;
+            for (int s = 0; s < schedule_steps; s++) {
+                if ((now - start_ns) / 1e9 >= schedule[s].at_s) kbps = schedule[s].kbps;
+            }
+            int64_t depart = now;
+            if (kbps > 0) {
+                // Drop-tail: the backlog ahead of this packet, in bytes at the current rate
+                int64_t backlog_ns = link_free_ns > now ? link_free_ns - now : 0;
+                if (backlog_ns * kbps / 8e6 + n > queue_bytes) {
+                    queue_drops++;
+                    if (trace) fprintf(trace, "%ld %d queue\n", index, n);
+                    continue;
+                }
+                if (backlog_ns > max_queue_ns) max_queue_ns = backlog_ns;
+                depart = (link_free_ns > now ? link_free_ns : now) + (int64_t)(n * 8e6 / kbps);
+                link_free_ns = depart;
+            }
+
+            int64_t deliver = depart + delay_ns + (int64_t)(jitter * 1e6);
+            if (deliver < depart) deliver = depart;
+            if (in_order && deliver < last_deliver_ns) deliver = last_deliver_ns;
+            if (reorder) {
+                deliver += (int64_t)(reorder_delay_ms * 1e6);
+                reordered++;
+            } else if (deliver > last_deliver_ns) {
+                last_deliver_ns = deliver;
+            }
+            if (delay_queue_push(&forward, packet, n, deliver) < 0) {
+                queue_drops++;
+                if (trace) fprintf(trace, "%ld %d queue\n", index, n);
+                continue;
+            }
+            forwarded++;
+            double packet_delay_ms = (deliver - now) / 1e6;
+            delay_sum_ms += packet_delay_ms;
+            if (packet_delay_ms > max_delay_ms) max_delay_ms = packet_delay_ms;
+            if (trace) fprintf(trace, "%ld %d %s %.3f\n", index, n, reorder ? "reordered" : "sent",
+                               (deliver - depart) / 1e6);
+
+            if (duplicate) {
+                int64_t copy = depart + delay_ns + (int64_t)(duplicate_jitter * 1e6);
+                if (copy < deliver) copy = deliver;
+                if (delay_queue_push(&forward, packet, n, copy) == 0) {
+                    duplicated++;
+                    if (trace) fprintf(trace, "%ld %d duplicate %.3f\n", index, n, (copy - depart) / 1e6);
+                }
+            }
+        }
+    }
+
+    printf("impair_proxy: forwarded %ld, dropped %ld random + %ld at the queue, %ld feedback, max queueing %.1f ms\n",
+           forwarded, random_drops, queue_drops, feedback, max_queue_ns / 1e6);
+    if (random_drops > 0) {
+        printf("impair_proxy: loss %.2f%% of %ld datagrams in %ld bursts (mean burst %.2f)\n",
+               100.0 * random_drops / received, received, loss_bursts, (double)random_drops / loss_bursts);
+    }
+    if (jitter_ms > 0 || reorder_percent > 0 || duplicate_percent > 0) {
+        printf("impair_proxy: delay mean %.2f ms, max %.2f ms; %ld reordered, %ld duplicated\n",
+               forwarded > 0 ? delay_sum_ms / forwarded : 0.0, max_delay_ms, reordered, duplicated);
+    }
+    if (trace) fclose(trace);
+    free(forward.data);
+    free(backward.data);
+    close(sockfd);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Loss recovery and playout under seeded impairments: streams the same input
+# through bench/impair_proxy once per scenario and reports what the receiver
+# saw. The impairments repeat exactly for a given seed, so two builds can be
+# compared on the same loss and delay pattern.
+#
+#   bench/impairment_matrix.sh [VIDEO_FILE] [BYTES] [SEED] [SENDER/RECEIVER OPTION]...
+#
+# Extra options go to both programs, e.g. --nack (the default) or --fec xor
+# for the sender only via SENDER_ARGS.
+set -e
+
+cd "$(dirname "$0")/.."
+REPO=$(pwd)
+VIDEO=${1:-reconstructed_vid.mp4}
+BYTES=${2:-307200}   # 30 frames at the default 10 x 1 KB packets per frame
+SEED=${3:-1}
+[ $# -gt 3 ] && shift 3 || set --
+BOTH_ARGS=${*:---nack}
+
+make -s sender receiver bench/impair_proxy
+RUN_DIR=$(mktemp -d)
+trap 'rm -rf "$RUN_DIR"' EXIT
+head -c "$BYTES" "$VIDEO" > "$RUN_DIR/input"
+
+echo "scenario        proxy_drops  lost  recovered  late  reordered  duplicates  jitter_p95_ms  buffering_ms  intact"
+run() {
+    name=$1
+    shift
+    (cd "$RUN_DIR" && rm -f reconstructed_vid*.mp4 &&
+        exec "$REPO/receiver" $BOTH_ARGS --log-level warn > /dev/null 2> receiver.log) &
+    receiver_pid=$!
+    ./bench/impair_proxy --seed "$SEED" "$@" > "$RUN_DIR/proxy.log" &
+    proxy_pid=$!
+    sleep 0.3
+    ./sender "$RUN_DIR/input" 127.0.0.1:6000 $BOTH_ARGS $SENDER_ARGS --log-level warn > /dev/null
+    wait "$proxy_pid" "$receiver_pid"
+
+    log="$RUN_DIR/receiver.log"
+    drops=$(sed -n 's/.*dropped \([0-9]*\) random + \([0-9]*\) at the queue.*/\1+\2/p' "$RUN_DIR/proxy.log")
+    lost=$(sed -n 's/^Lost packets: \([0-9]*\)/\1/p' "$log" | head -1)
+    recovered=$(sed -n 's/^Recovered packets ([a-z]*): \([0-9]*\).*/\1/p' "$log" | awk '{s += $1} END {print s + 0}')
+    late=$(sed -n 's/^Late packets (after playout): \([0-9]*\)/\1/p' "$log" | head -1)
+    reordered=$(sed -n 's/^Reordered packets: \([0-9]*\)/\1/p' "$log" | head -1)
+    duplicates=$(sed -n 's/^Duplicate packets: \([0-9]*\)/\1/p' "$log" | head -1)
+    p95=$(sed -n 's/.*p50\/p95\/p99 jitter [0-9]*\/\([0-9]*\)\/.*/\1/p' "$log" | head -1)
+    buffering=$(sed -n 's/^Mean buffering: \([0-9.]*\) ms.*/\1/p' "$log" | head -1)
+    intact=no
+    cmp -s "$RUN_DIR/input" "$RUN_DIR/reconstructed_vid.mp4" && intact=yes
+    printf "%-14s  %11s  %4s  %9s  %4s  %9s  %10s  %13s  %12s  %6s\n" "$name" "$drops" "${lost:-0}" \
+        "$recovered" "${late:-0}" "${reordered:-0}" "${duplicates:-0}" "${p95:--}" "${buffering:--}" "$intact"
+}
+
+run clean          --delay 10
+run bernoulli-2    --delay 10 --loss 2
+run gilbert-burst  --delay 10 --gilbert 2,30
+run jitter-normal  --delay 20 --jitter 8 --jitter-dist normal
+run jitter-pareto  --delay 20 --jitter 8 --jitter-dist pareto
+run reorder-5      --delay 10 --reorder 5 --reorder-delay 15
+run duplicate-5    --delay 10 --duplicate 5
+run combined       --delay 20 --jitter 5 --gilbert 1,40 --reorder 2 --duplicate 2
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Receiver throughput scaling over loopback: runs the receiver with 1..N
+# SO_REUSEPORT workers against rtp_loadgen and reports packets/sec per run.
+#
+#   bench/receiver_scaling.sh [MAX_WORKERS] [SECONDS] [STREAMS] [SENDER_THREADS]
+set -e
+
+cd "$(dirname "$0")/.."
+MAX_WORKERS=${1:-$(nproc)}
+SECONDS_PER_RUN=${2:-5}
+STREAMS=${3:-64}
+SENDER_THREADS=${4:-2}
+
+make -s receiver bench/rtp_loadgen
+RUN_DIR=$(mktemp -d)
+trap 'rm -rf "$RUN_DIR"' EXIT
+
+echo "workers  sent_pps  received_pps"
+w=1
+while [ "$w" -le "$MAX_WORKERS" ]; do
+    ./receiver --workers "$w" --pin --batch 64 --discard --log-level warn \
+        2> "$RUN_DIR/receiver.log" &
+    receiver_pid=$!
+    sleep 0.5
+    sent=$(./bench/rtp_loadgen --streams "$STREAMS" --threads "$SENDER_THREADS" \
+        --seconds "$SECONDS_PER_RUN" | sed -n 's/.*(\([0-9]*\) packets\/sec).*/\1/p')
+    wait "$receiver_pid"
+    received=$(sed -n 's/^Receive rate: \([0-9]*\) packets\/sec/\1/p' "$RUN_DIR/receiver.log")
+    printf "%7d  %8s  %12s\n" "$w" "$sent" "${received:-0}"
+    w=$((w + 1))
+done
@@ -0,0 +1,185 @@
+// RTP load generator for receiver benchmarks: blasts 1024-byte RTP packets
+// from S independent streams (own socket, source port and SSRC each) at a
+// receiver, as fast as possible or at a fixed total rate.
+//
+//   rtp_loadgen [--dest IP] [--streams S] [--threads T] [--seconds D] [--rate PPS]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../rtp.h"
+
+#define LOADGEN_BATCH 32
+#define LOADGEN_PAYLOAD CHUNK_SIZE
+#define LOADGEN_MAX_STREAMS 4096
+#define LOADGEN_MAX_THREADS 64
+
+typedef struct {
+    int sockfd;
+    uint32_t ssrc;
+    uint16_t seq;
+    uint32_t timestamp;
+} LoadStream;
+
+typedef struct {
+    LoadStream *streams;
+    int num_streams;
+    struct sockaddr_in dest;
+    int64_t end_ns;
+    double rate;         // Packets per second for this thread, 0 = unlimited
+    long packets_sent;
+    pthread_t thread;
+} LoadThread;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void write_header(unsigned char *packet, LoadStream *stream, int marker) {
+    packet[0] = 0x80;
+    packet[1] = (marker << 7) | 96;
+    packet[2] = stream->seq >> 8;
+    packet[3] = stream->seq & 0xFF;
+    packet[4] = stream->timestamp >> 24;
+    packet[5] = stream->timestamp >> 16;
+    packet[6] = stream->timestamp >> 8;
+    packet[7] = stream->timestamp;
+    packet[8] = stream->ssrc >> 24;
+    packet[9] = stream->ssrc >> 16;
+    packet[10] = stream->ssrc >> 8;
+    packet[11] = stream->ssrc;
+}
+
+static void *load_thread(void *arg) {
+    LoadThread *t = (LoadThread *)arg;
+    static unsigned char payload[LOADGEN_PAYLOAD];
+    unsigned char headers[LOADGEN_BATCH][RTP_HEADER_SIZE];
+    struct iovec iovs[LOADGEN_BATCH][2];
+    struct mmsghdr msgs[LOADGEN_BATCH];
+    int64_t start = now_ns();
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < LOADGEN_BATCH; i++) {
+        iovs[i][0].iov_base = headers[i];
+        iovs[i][0].iov_len = RTP_HEADER_SIZE;
+        iovs[i][1].iov_base = payload;
+        iovs[i][1].iov_len = LOADGEN_PAYLOAD;
+        msgs[i].msg_hdr.msg_iov = iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+        msgs[i].msg_hdr.msg_name = &t->dest;
+        msgs[i].msg_hdr.msg_namelen = sizeof(t->dest);
+    }
+
+    // Round-robin over the streams, one batch per stream per turn
+    for (int s = 0; now_ns() < t->end_ns; s = (s + 1) % t->num_streams) {
+        LoadStream *stream = &t->streams[s];
+        for (int i = 0; i < LOADGEN_BATCH; i++) {
+            int marker = (stream->seq % 10) == 9;
+            write_header(headers[i], stream, marker);
+            stream->seq++;
+            if (marker) stream->timestamp += 3000;
+        }
+        int sent = sendmmsg(stream->sockfd, msgs, LOADGEN_BATCH, 0);
+        if (sent > 0) t->packets_sent += sent;
+
+        if (t->rate > 0) {
+            int64_t due = start + (int64_t)(t->packets_sent * 1e9 / t->rate);
+            int64_t wait = due - now_ns();
+            if (wait > 0) {
+                struct timespec ts = { wait / 1000000000LL, wait % 1000000000LL };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dest_ip = "127.0.0.1";
+    int num_streams = 64;
+    int num_threads = 1;
+    double seconds = 5.0;
+    double rate = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dest") == 0 && i + 1 < argc) {
+            dest_ip = argv[++i];
+        } else if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+            num_streams = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--dest IP] [--streams S] [--threads T] [--seconds D] [--rate PPS]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_streams < 1 || num_streams > LOADGEN_MAX_STREAMS ||
+        num_threads < 1 || num_threads > LOADGEN_MAX_THREADS || num_threads > num_streams) {
+        fprintf(stderr, "Need 1..%d streams and 1..%d threads (no more threads than streams)\n",
+                LOADGEN_MAX_STREAMS, LOADGEN_MAX_THREADS);
+        return 1;
+    }
+
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(5000);
+    if (inet_pton(AF_INET, dest_ip, &dest.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid destination address: %s\n", dest_ip);
+        return 1;
+    }
+
+    // A socket per stream gives each its own source port, so SO_REUSEPORT
+    // hashing spreads the streams over the receiver workers
+    LoadStream *streams = (LoadStream *)calloc(num_streams, sizeof(LoadStream));
+    srand(time(NULL) ^ getpid());
+    for (int s = 0; s < num_streams; s++) {
+        streams[s].sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (streams[s].sockfd < 0) {
+            perror("Socket creation failed");
+            return 1;
+        }
+        streams[s].ssrc = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+        streams[s].seq = rand() & 0xFFFF;
+        streams[s].timestamp = rand();
+    }
+
+    LoadThread threads[LOADGEN_MAX_THREADS];
+    int64_t start = now_ns();
+    int64_t end_ns = start + (int64_t)(seconds * 1e9);
+    int per_thread = num_streams / num_threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads[t].streams = &streams[t * per_thread];
+        threads[t].num_streams = (t == num_threads - 1) ? num_streams - t * per_thread : per_thread;
+        threads[t].dest = dest;
+        threads[t].end_ns = end_ns;
+        threads[t].rate = rate / num_threads;
+        threads[t].packets_sent = 0;
+        pthread_create(&threads[t].thread, NULL, load_thread, &threads[t]);
+    }
+
+    long total = 0;
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t].thread, NULL);
+        total += threads[t].packets_sent;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    printf("Sent %ld packets on %d streams in %.2f s (%.0f packets/sec)\n",
+           total, num_streams, elapsed, total / elapsed);
+
+    for (int s = 0; s < num_streams; s++) {
+        close(streams[s].sockfd);
+    }
+    free(streams);
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "congestion.h"
+#include <math.h>
+#include <string.h>
+
+#define TRENDLINE_SMOOTHING 0.9
+#define TRENDLINE_GAIN 4.0
+#define TRENDLINE_MIN_GROUPS 5      // Slope from this many groups on (the gain ramps up with the count)
+#define THRESHOLD_INITIAL_MS 12.5
+#define THRESHOLD_K_UP 0.0087
+#define THRESHOLD_K_DOWN 0.039
+#define OVERUSE_TIME_MS 10.0
+#define BACKOFF_FACTOR 0.85
+#define INCREASE_PER_SECOND 1.08    // Multiplicative increase far from capacity
+#define MEASUREMENT_WINDOW_MS 500   // Acked rate and loss are measured over this much receiver time
+#define LOSS_HIGH 0.10
+#define LOSS_LOW 0.02
+#define DEFAULT_RTT_US 100000
+
+// --- Sender: send history ---
+
+void cc_history_add(CcSendHistory *history, const RTPChunk *chunks, int count, int64_t send_ns) {
+    for (int c = 0; c < count; c++) {
+        int pos = (int)(history->next_index++ & (CC_HISTORY - 1));
+        history->send_ns[pos] = send_ns;
+        history->sizes[pos] = (uint16_t)(RTP_HEADER_SIZE + chunks[c].prefix_size + chunks[c].payload_size);
+    }
+}
+
+static int history_lookup(const CcSendHistory *history, uint16_t next_seq, uint16_t seq) {
+    int age = (uint16_t)(next_seq - 1 - seq);
+    if (age >= CC_HISTORY || age >= history->next_index) return -1;
+    return (int)((history->next_index - 1 - age) & (CC_HISTORY - 1));
+}
+
+// --- Sender: delay-based detection ---
+
+void cc_estimator_init(CcEstimator *cc, double start_bps, double min_bps, double max_bps) {
+    memset(cc, 0, sizeof(CcEstimator));
+    cc->threshold_ms = THRESHOLD_INITIAL_MS;
+    cc->last_threshold_update_ms = -1;
+    cc->min_bps = min_bps;
+    cc->max_bps = max_bps;
+    cc->delay_bps = start_bps;
+    cc->loss_bps = max_bps;
+    cc->target_bps = start_bps;
+    cc->window_start_ms = -1;
+}
+
+const char *cc_signal_name(int signal) {
+    switch (signal) {
+        case CC_SIGNAL_OVERUSE: return "overuse";
+        case CC_SIGNAL_UNDERUSE: return "underuse";
+        default: return "normal";
+    }
+}
+
+// The threshold follows the trend slowly, so it tolerates the steady noise of
+// a path but still catches a queue that builds up
+static void update_threshold(CcEstimator *cc, double modified_trend, double now_ms) {
+    if (cc->last_threshold_update_ms < 0) cc->last_threshold_update_ms = now_ms;
+    double magnitude = fabs(modified_trend);
+    if (magnitude > cc->threshold_ms + 15) {
+        // A spike says nothing about the noise level
+        cc->last_threshold_update_ms = now_ms;
+        return;
+    }
+    double k = magnitude < cc->threshold_ms ? THRESHOLD_K_DOWN : THRESHOLD_K_UP;
+    double elapsed_ms = now_ms - cc->last_threshold_update_ms;
+    if (elapsed_ms > 100) elapsed_ms = 100;
+    cc->threshold_ms += k * (magnitude - cc->threshold_ms) * elapsed_ms;
+    if (cc->threshold_ms < 6) cc->threshold_ms = 6;
+    if (cc->threshold_ms > 600) cc->threshold_ms = 600;
+    cc->last_threshold_update_ms = now_ms;
+}
+
+static void detect(CcEstimator *cc, double trend, double send_delta_ms, double now_ms) {
+    double modified = (cc->num_deltas < 60 ? cc->num_deltas : 60) * trend * TRENDLINE_GAIN;
+    if (modified > cc->threshold_ms) {
+        // Overuse only once it lasts and the trend is not already turning
+        cc->overuse_ms += send_delta_ms;
+        cc->overuse_count++;
+        if (cc->overuse_ms > OVERUSE_TIME_MS && cc->overuse_count > 1 && trend >= cc->previous_trend) {
+            cc->overuse_ms = 0;
+            cc->overuse_count = 0;
+            if (cc->signal != CC_SIGNAL_OVERUSE) cc->overuses++;
+            cc->signal = CC_SIGNAL_OVERUSE;
+        }
+    } else if (modified < -cc->threshold_ms) {
+        cc->overuse_ms = 0;
+        cc->overuse_count = 0;
+        if (cc->signal != CC_SIGNAL_UNDERUSE) cc->underuses++;
+        cc->signal = CC_SIGNAL_UNDERUSE;
+    } else {
+        cc->overuse_ms = 0;
+        cc->overuse_count = 0;
+        cc->signal = CC_SIGNAL_NORMAL;
+    }
+    cc->previous_trend = trend;
+    update_threshold(cc, modified, now_ms);
+}
+
+// Least-squares slope of the smoothed accumulated delay over arrival time
+static void update_trendline(CcEstimator *cc, double delta_ms, double send_delta_ms, double arrival_ms) {
+    if (cc->num_deltas < 1000) cc->num_deltas++;
+    cc->accumulated_delay_ms += delta_ms;
+    cc->smoothed_delay_ms = TRENDLINE_SMOOTHING * cc->smoothed_delay_ms +
+                            (1 - TRENDLINE_SMOOTHING) * cc->accumulated_delay_ms;
+
+    if (cc->trend_count == CC_TRENDLINE_WINDOW) {
+        memmove(cc->trend_x, cc->trend_x + 1, (CC_TRENDLINE_WINDOW - 1) * sizeof(double));
+        memmove(cc->trend_y, cc->trend_y + 1, (CC_TRENDLINE_WINDOW - 1) * sizeof(double));
+        cc->trend_count--;
+    }
+    cc->trend_x[cc->trend_count] = arrival_ms - cc->first_arrival_ms;
+    cc->trend_y[cc->trend_count] = cc->smoothed_delay_ms;
+    cc->trend_count++;
+
+    double trend = cc->previous_trend;
+    if (cc->trend_count >= TRENDLINE_MIN_GROUPS) {
+        double x_mean = 0, y_mean = 0;
+        for (int i = 0; i < cc->trend_count; i++) {
+            x_mean += cc->trend_x[i];
+            y_mean += cc->trend_y[i];
+        }
+        x_mean /= cc->trend_count;
+        y_mean /= cc->trend_count;
+        double numerator = 0, denominator = 0;
+        for (int i = 0; i < cc->trend_count; i++) {
+            numerator += (cc->trend_x[i] - x_mean) * (cc->trend_y[i] - y_mean);
+            denominator += (cc->trend_x[i] - x_mean) * (cc->trend_x[i] - x_mean);
+        }
+        if (denominator != 0) trend = numerator / denominator;
+    }
+    detect(cc, trend, send_delta_ms, arrival_ms);
+}
+
+// Packets sent together are compared as a group: only the one-way delay
+// change between groups says something about queues
+static void add_packet(CcEstimator *cc, double send_ms, double arrival_ms) {
+    if (!cc->have_group) {
+        cc->have_group = 1;
+        cc->group_send_ms = send_ms;
+        cc->group_arrival_ms = arrival_ms;
+        cc->first_arrival_ms = arrival_ms;
+        return;
+    }
+    if (send_ms < cc->group_send_ms) return;  // Reordered from an earlier group
+    if (send_ms - cc->group_send_ms <= CC_GROUP_NS / 1e6) {
+        if (arrival_ms > cc->group_arrival_ms) cc->group_arrival_ms = arrival_ms;
+        return;
+    }
+
+    if (cc->have_previous) {
+        double send_delta = cc->group_send_ms - cc->previous_send_ms;
+        double arrival_delta = cc->group_arrival_ms - cc->previous_arrival_ms;
+        update_trendline(cc, arrival_delta - send_delta, send_delta, cc->group_arrival_ms);
+    }
+    cc->have_previous = 1;
+    cc->previous_send_ms = cc->group_send_ms;
+    cc->previous_arrival_ms = cc->group_arrival_ms;
+    cc->group_send_ms = send_ms;
+    cc->group_arrival_ms = arrival_ms;
+}
+
+// --- Sender: rate control ---
+
+static void update_delay_rate(CcEstimator *cc, int64_t rtt_us, int64_t now_ns) {
+    double elapsed_s = cc->last_update_ns ? (now_ns - cc->last_update_ns) / 1e9 : 0;
+    if (elapsed_s > 1) elapsed_s = 1;
+    cc->last_update_ns = now_ns;
+    int64_t response_us = (rtt_us > 0 ? rtt_us : DEFAULT_RTT_US) + 100000;
+
+    if (cc->signal == CC_SIGNAL_OVERUSE) {
+        // Once per round trip: back off below what actually got through
+        if (now_ns - cc->last_decrease_ns > response_us * 1000) {
+            double base = cc->acked_bps > 0 ? cc->acked_bps : cc->delay_bps;
+            if (BACKOFF_FACTOR * base < cc->delay_bps) cc->delay_bps = BACKOFF_FACTOR * base;
+            cc->capacity_bps = cc->acked_bps;
+            cc->last_decrease_ns = now_ns;
+        }
+    } else if (cc->signal == CC_SIGNAL_NORMAL) {
+        double previous_bps = cc->delay_bps;
+        if (cc->capacity_bps > 0 && cc->acked_bps > 1.5 * cc->capacity_bps) cc->capacity_bps = 0;
+        if (cc->capacity_bps > 0 && cc->delay_bps > 0.9 * cc->capacity_bps) {
+            // Close to where the queue built up last time: about a packet per response time
+            cc->delay_bps += 1200 * 8 * elapsed_s * 1e6 / response_us;
+        } else {
+            cc->delay_bps *= pow(INCREASE_PER_SECOND, elapsed_s);
+        }
+        // Never grow far ahead of what the receiver gets (the source may send
+        // less); a probe above that stands until the signals judge it
+        double limit_bps = 1.5 * cc->acked_bps + 10000;
+        if (cc->acked_bps > 0 && cc->delay_bps > limit_bps) {
+            cc->delay_bps = previous_bps > limit_bps ? previous_bps : limit_bps;
+        }
+    }
+    // Underuse: queues are draining, hold the rate until they are empty
+}
+
+void cc_estimator_probe(CcEstimator *cc, double probe_bps) {
+    if (probe_bps > cc->max_bps) probe_bps = cc->max_bps;
+    if (probe_bps > cc->delay_bps) cc->delay_bps = probe_bps;
+    // Without recent loss the loss-based estimate is only left over from earlier
+    if (cc->loss_fraction < LOSS_LOW && probe_bps > cc->loss_bps) cc->loss_bps = probe_bps;
+    if (probe_bps > cc->target_bps && cc->loss_bps >= probe_bps) cc->target_bps = probe_bps;
+    cc->capacity_bps = 0;
+}
+
+// Called once per measurement window of window_ms receiver time
+static void update_loss_rate(CcEstimator *cc, double loss, double window_ms, int64_t rtt_us, int64_t now_ns) {
+    int64_t response_us = (rtt_us > 0 ? rtt_us : DEFAULT_RTT_US) + 300000;
+    if (loss > LOSS_HIGH) {
+        if (now_ns - cc->last_loss_decrease_ns > response_us * 1000) {
+            cc->loss_bps = cc->target_bps * (1 - 0.5 * loss);
+            cc->last_loss_decrease_ns = now_ns;
+        }
+    } else if (loss < LOSS_LOW) {
+        cc->loss_bps *= pow(INCREASE_PER_SECOND, window_ms / 1000.0);
+        if (cc->loss_bps > cc->max_bps) cc->loss_bps = cc->max_bps;
+    }
+}
+
+double cc_estimator_on_feedback(CcEstimator *cc, CcSendHistory *history, uint16_t next_seq,
+                                uint16_t begin_seq, const int64_t *delays_us, int count,
+                                uint32_t report_timestamp, int64_t rtt_us, int64_t now_ns) {
+    cc->feedback_received++;
+    cc->last_feedback_ns = now_ns;
+
+    // Arrival times are on the receiver's clock; only their differences matter
+    double report_ms = report_timestamp * 1000.0 / 65536;
+    int received = 0, lost = 0;
+    long bytes = 0;
+    for (int i = 0; i < count; i++) {
+        int pos = history_lookup(history, next_seq, (uint16_t)(begin_seq + i));
+        if (pos < 0) continue;
+        if (delays_us[i] < 0) {
+            lost++;
+            continue;
+        }
+        received++;
+        bytes += history->sizes[pos];
+        add_packet(cc, history->send_ns[pos] / 1e6, report_ms - delays_us[i] / 1000.0);
+    }
+
+    // Acked rate and loss over windows of receiver time
+    if (cc->window_start_ms < 0) cc->window_start_ms = report_ms;
+    cc->window_bytes += bytes;
+    cc->window_received += received;
+    cc->window_lost += lost;
+    double window_ms = report_ms - cc->window_start_ms;
+    if (window_ms >= MEASUREMENT_WINDOW_MS) {
+        double sample = cc->window_bytes * 8 * 1000.0 / window_ms;
+        cc->acked_bps = cc->acked_bps > 0 ? 0.5 * cc->acked_bps + 0.5 * sample : sample;
+        long total = cc->window_received + cc->window_lost;
+        cc->loss_fraction = total > 0 ? (double)cc->window_lost / total : 0;
+        update_loss_rate(cc, cc->loss_fraction, window_ms, rtt_us, now_ns);
+        cc->window_start_ms = report_ms;
+        cc->window_bytes = 0;
+        cc->window_received = 0;
+        cc->window_lost = 0;
+    }
+
+    update_delay_rate(cc, rtt_us, now_ns);
+    double target = cc->delay_bps < cc->loss_bps ? cc->delay_bps : cc->loss_bps;
+    if (target < cc->min_bps) target = cc->min_bps;
+    if (target > cc->max_bps) target = cc->max_bps;
+    if (cc->delay_bps < cc->min_bps) cc->delay_bps = cc->min_bps;
+    if (cc->delay_bps > cc->max_bps) cc->delay_bps = cc->max_bps;
+    cc->target_bps = target;
+    return target;
+}
+
+int cc_select_rendition(const double *bitrates, int count, int current, double target_bps) {
+    if (bitrates[current] > 0.9 * target_bps) {
+        for (int i = current + 1; i < count; i++) {
+            if (bitrates[i] <= 0.85 * target_bps) return i;
+        }
+        return count - 1;
+    }
+    for (int i = 0; i < current; i++) {
+        if (bitrates[i] <= 0.7 * target_bps) return i;
+    }
+    return current;
+}
+
+// --- Receiver: arrival log ---
+
+void cc_arrival_log_add(CcArrivalLog *log, uint16_t seq, int64_t now_us) {
+    if (!log->started) {
+        log->started = 1;
+        log->begin_seq = seq;
+        log->end_seq = (uint16_t)(seq + 1);
+    } else if ((uint16_t)(seq - log->begin_seq) >= 0x8000) {
+        return;  // Already reported as missing
+    } else if ((uint16_t)(seq - log->end_seq) < 0x8000) {
+        log->end_seq = (uint16_t)(seq + 1);
+    }
+    int pos = seq & (RTCP_CCFB_MAX_REPORTS - 1);
+    log->seqs[pos] = seq;
+    log->arrival_us[pos] = now_us;
+}
+
+int cc_arrival_log_take(CcArrivalLog *log, int64_t now_us, uint16_t *begin_seq, int64_t *delays_us) {
+    if (!log->started || log->begin_seq == log->end_seq) return 0;
+    int count = (uint16_t)(log->end_seq - log->begin_seq);
+    if (count > RTCP_CCFB_MAX_REPORTS) {
+        // Too long since the last report: the oldest packets go unreported
+        log->begin_seq = (uint16_t)(log->end_seq - RTCP_CCFB_MAX_REPORTS);
+        count = RTCP_CCFB_MAX_REPORTS;
+    }
+    for (int i = 0; i < count; i++) {
+        uint16_t seq = (uint16_t)(log->begin_seq + i);
+        int pos = seq & (RTCP_CCFB_MAX_REPORTS - 1);
+        delays_us[i] = log->seqs[pos] == seq && log->arrival_us[pos] > 0 ? now_us - log->arrival_us[pos] : -1;
+    }
+    *begin_seq = log->begin_seq;
+    log->begin_seq = log->end_seq;
+    log->feedback_sent++;
+    return count;
+}
@@ -0,0 +1,129 @@
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include <stdint.h>
+#include "rtp.h"
+#include "rtcp.h"
+
+// Sender-side congestion control in the style of Google Congestion Control
+// (draft-ietf-rmcat-gcc), driven by RFC 8888 feedback from the receiver:
+//
+//   delay  packets are grouped by send time (a frame burst is one group); the
+//          change in one-way delay between groups feeds a trendline filter,
+//          whose slope is compared with an adaptive threshold to detect
+//          overuse (queues building up) or underuse (queues draining)
+//   rate   AIMD on the delay signal: multiplicative increase while the path
+//          is uncongested (additive near the last known capacity), back off
+//          to 85% of the rate the receiver actually got on overuse
+//   loss   above 10% loss the rate drops by half the loss fraction, below 2%
+//          it may grow again; the target is the lower of the two estimates
+
+#define CC_HISTORY 4096             // Sent media packets remembered (power of two)
+#define CC_GROUP_NS 5000000         // Packets sent within 5 ms form one group
+#define CC_TRENDLINE_WINDOW 20      // Groups in the delay trend regression
+#define CC_FEEDBACK_INTERVAL_MS 50  // Receiver feedback period
+#define CC_DEFAULT_MIN_KBPS 50
+#define CC_DEFAULT_MAX_KBPS 20000
+
+#define CC_SIGNAL_NORMAL 0
+#define CC_SIGNAL_OVERUSE 1
+#define CC_SIGNAL_UNDERUSE 2
+
+// Send times of recent media packets, shared by every destination: they are
+// sent the same packets in the same order, so a packet is found by its age
+// (packets sent after it), as in the retransmission history.
+typedef struct {
+    int64_t send_ns[CC_HISTORY];
+    uint16_t sizes[CC_HISTORY];
+    long next_index;
+} CcSendHistory;
+
+void cc_history_add(CcSendHistory *history, const RTPChunk *chunks, int count, int64_t send_ns);
+
+// Bandwidth estimate for the path to one receiver
+typedef struct {
+    // Current packet group and the one before (send time of the first
+    // packet, arrival of the last, both in ms)
+    int have_group;
+    int have_previous;
+    double group_send_ms;
+    double group_arrival_ms;
+    double previous_send_ms;
+    double previous_arrival_ms;
+    double first_arrival_ms;
+
+    // Trendline filter
+    double accumulated_delay_ms;
+    double smoothed_delay_ms;
+    double trend_x[CC_TRENDLINE_WINDOW];
+    double trend_y[CC_TRENDLINE_WINDOW];
+    int trend_count;
+    int num_deltas;
+    double previous_trend;
+    double threshold_ms;
+    double last_threshold_update_ms;
+    double overuse_ms;
+    int overuse_count;
+    int signal;
+
+    // Rates in bit/s
+    double delay_bps;           // AIMD estimate
+    double loss_bps;            // Loss-based estimate
+    double target_bps;          // min(delay_bps, loss_bps), within the bounds
+    double min_bps;
+    double max_bps;
+    double acked_bps;           // What the receiver got, 0 = not measured yet
+    double capacity_bps;        // Acked rate at the last backoff, 0 = unknown
+    // Measurement window of the acked rate and the loss estimate (receiver clock)
+    double window_start_ms;
+    long window_bytes;
+    long window_received;
+    long window_lost;
+    int64_t last_update_ns;
+    int64_t last_decrease_ns;
+    int64_t last_loss_decrease_ns;
+    int64_t last_feedback_ns;
+    double loss_fraction;       // Of the last feedback
+
+    long feedback_received;
+    long overuses;
+    long underuses;
+} CcEstimator;
+
+void cc_estimator_init(CcEstimator *cc, double start_bps, double min_bps, double max_bps);
+// One feedback report for this path. next_seq is the sequence number the
+// destination will use next (to find packets by age); delays_us and
+// report_timestamp come from rtcp_unpack_ccfb; rtt_us < 0 if unknown.
+// Returns the new target in bit/s.
+double cc_estimator_on_feedback(CcEstimator *cc, CcSendHistory *history, uint16_t next_seq,
+                                uint16_t begin_seq, const int64_t *delays_us, int count,
+                                uint32_t report_timestamp, int64_t rtt_us, int64_t now_ns);
+// The source is about to send probe_bps although the estimate is lower (it
+// has been sending less than the path allowed, which caps the estimate near
+// the acked rate). The delay and loss signals then judge the higher rate.
+void cc_estimator_probe(CcEstimator *cc, double probe_bps);
+const char *cc_signal_name(int signal);
+
+// Index of the rendition to send at target_bps. bitrates are in descending
+// order; current is the one being sent. Steps down as soon as the current one
+// no longer fits and up only with headroom to spare, so the choice does not
+// flap around the target.
+int cc_select_rendition(const double *bitrates, int count, int current, double target_bps);
+
+// Receiver side: arrival times of the packets not reported yet
+typedef struct {
+    int started;
+    uint16_t begin_seq;         // First sequence number of the next report
+    uint16_t end_seq;           // One past the highest received
+    uint16_t seqs[RTCP_CCFB_MAX_REPORTS];
+    int64_t arrival_us[RTCP_CCFB_MAX_REPORTS];
+    int64_t next_feedback_us;
+    long feedback_sent;
+} CcArrivalLog;
+
+void cc_arrival_log_add(CcArrivalLog *log, uint16_t seq, int64_t now_us);
+// Packets to report at now_us, from begin_seq up to the highest received:
+// how long ago each arrived (-1 = missing). Returns how many (0 = nothing new).
+int cc_arrival_log_take(CcArrivalLog *log, int64_t now_us, uint16_t *begin_seq, int64_t *delays_us);
+
+#endif // CONGESTION_H
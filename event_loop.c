@@ -0,0 +1,158 @@
+#include "event_loop.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
+
+#ifndef __linux__
+static int64_t monotonic_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+#endif
+
+int event_loop_init(EventLoop *loop) {
+    memset(loop, 0, sizeof(EventLoop));
+#ifdef __linux__
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+    loop->armed_us = -1;  // A new timerfd is disarmed
+    loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->timerfd < 0) {
+        perror("timerfd_create failed");
+        close(loop->epfd);
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;  // Index 0 is the timer
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->timerfd, &ev) < 0) {
+        perror("epoll_ctl failed");
+        close(loop->timerfd);
+        close(loop->epfd);
+        return -1;
+    }
+#else
+    loop->epfd = -1;
+    loop->timerfd = -1;
+#endif
+    return 0;
+}
+
+int event_loop_add_fd(EventLoop *loop, int fd) {
+    if (loop->num_fds == EVENT_MAX_FDS) return -1;
+    int index = loop->num_fds;
+#ifdef __linux__
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = index + 1;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+#endif
+    loop->fds[index] = fd;
+    loop->num_fds++;
+    return index;
+}
+
+int event_loop_wait(EventLoop *loop, int64_t deadline_us) {
+#ifdef __linux__
+    // Arm (or disarm) the timer for the absolute deadline, unless it already is
+    if (deadline_us == 0) deadline_us = 1;  // A zero it_value would disarm the timer
+    if (deadline_us < 0) deadline_us = -1;
+    if (deadline_us != loop->armed_us) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        if (deadline_us > 0) {
+            spec.it_value.tv_sec = deadline_us / 1000000;
+            spec.it_value.tv_nsec = (deadline_us % 1000000) * 1000;
+        }
+        loop->syscalls++;
+        if (timerfd_settime(loop->timerfd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+            perror("timerfd_settime failed");
+            loop->armed_us = -2;
+            return -1;
+        }
+        loop->armed_us = deadline_us;
+    }
+
+    struct epoll_event events[EVENT_MAX_FDS + 1];
+    int n;
+    do {
+        n = epoll_wait(loop->epfd, events, EVENT_MAX_FDS + 1, -1);
+        loop->syscalls++;
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("epoll_wait failed");
+        return -1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.u32 == 0) {
+            uint64_t expirations;
+            loop->syscalls++;
+            if (read(loop->timerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                perror("timerfd read failed");
+            }
+            loop->armed_us = -2;  // Expired: the same deadline again needs a fresh arm
+            result |= EVENT_TIMER;
+        } else {
+            result |= EVENT_FD(events[i].data.u32 - 1);
+        }
+    }
+    return result;
+#else
+    struct pollfd pfds[EVENT_MAX_FDS];
+    for (int i = 0; i < loop->num_fds; i++) {
+        pfds[i].fd = loop->fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+    }
+
+    int timeout_ms = -1;
+    if (deadline_us >= 0) {
+        int64_t remaining = deadline_us - monotonic_now_us();
+        timeout_ms = remaining <= 0 ? 0 : (int)((remaining + 999) / 1000);
+    }
+
+    int n;
+    do {
+        n = poll(pfds, loop->num_fds, timeout_ms);
+        loop->syscalls++;
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("poll failed");
+        return -1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < loop->num_fds; i++) {
+        if (pfds[i].revents & (POLLIN | POLLERR)) result |= EVENT_FD(i);
+    }
+    if (deadline_us >= 0 && monotonic_now_us() >= deadline_us) result |= EVENT_TIMER;
+    return result;
+#endif
+}
+
+void event_loop_close(EventLoop *loop) {
+#ifdef __linux__
+    close(loop->timerfd);
+    close(loop->epfd);
+#endif
+    loop->num_fds = 0;
+}
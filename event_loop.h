@@ -0,0 +1,34 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+#define EVENT_MAX_FDS 8
+
+// wait results (bit mask)
+#define EVENT_TIMER 0x1  // The deadline passed
+
+// Waits for readable descriptors or an absolute CLOCK_MONOTONIC deadline.
+// On Linux this is an epoll set plus a timerfd armed with TFD_TIMER_ABSTIME,
+// so timed work (playout, loss skips, idle detection) fires exactly at its
+// deadline instead of on the next packet arrival. Elsewhere it uses poll().
+typedef struct {
+    int epfd;
+    int timerfd;
+    int fds[EVENT_MAX_FDS];
+    int num_fds;
+    int64_t armed_us;  // Deadline the timerfd is armed for, -1 = disarmed, -2 = fired (re-arm)
+    long syscalls;  // Made by event_loop_wait, for syscall counts
+} EventLoop;
+
+int event_loop_init(EventLoop *loop);
+// Watch fd for readability; returns its index (the bit 1 << (index + 1) in wait results)
+int event_loop_add_fd(EventLoop *loop, int fd);
+// Block until a watched fd is readable or deadline_us passes (-1 = no deadline).
+// Returns a mask of EVENT_TIMER and EVENT_FD(index) bits, or -1 on error.
+int event_loop_wait(EventLoop *loop, int64_t deadline_us);
+void event_loop_close(EventLoop *loop);
+
+#define EVENT_FD(index) (1 << ((index) + 1))
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,469 @@
+#include "fec.h"
+#include "fec_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t read_u32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void write_u32(unsigned char *p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+void fec_pack_header(const FecHeader *header, unsigned char *bytes) {
+    write_u32(bytes, header->protected_ssrc);
+    bytes[4] = header->base_seq >> 8;
+    bytes[5] = header->base_seq & 0xFF;
+    write_u32(bytes + 6, header->timestamp_base);
+    bytes[10] = header->kind;
+    bytes[11] = header->index;
+    bytes[12] = header->block_size;
+    bytes[13] = header->columns;
+    bytes[14] = header->unit_size >> 8;
+    bytes[15] = header->unit_size & 0xFF;
+}
+
+void fec_unpack_header(const unsigned char *bytes, FecHeader *header) {
+    header->protected_ssrc = read_u32(bytes);
+    header->base_seq = (uint16_t)(bytes[4] << 8 | bytes[5]);
+    header->timestamp_base = read_u32(bytes + 6);
+    header->kind = bytes[10];
+    header->index = bytes[11];
+    header->block_size = bytes[12];
+    header->columns = bytes[13];
+    header->unit_size = (uint16_t)(bytes[14] << 8 | bytes[15]);
+}
+
+int fec_parse_scheme(const char *spec, int *param) {
+    const char *colon = strchr(spec, ':');
+    size_t name_len = colon ? (size_t)(colon - spec) : strlen(spec);
+    *param = colon ? atoi(colon + 1) : 0;
+
+    if (name_len == 3 && strncmp(spec, "xor", 3) == 0) return FEC_SCHEME_XOR;
+    if (name_len == 5 && strncmp(spec, "xor2d", 5) == 0) return FEC_SCHEME_XOR_2D;
+    if (name_len == 2 && strncmp(spec, "rs", 2) == 0) return FEC_SCHEME_RS;
+    return -1;
+}
+
+const char *fec_scheme_name(int scheme) {
+    switch (scheme) {
+        case FEC_SCHEME_XOR: return "XOR row parity";
+        case FEC_SCHEME_XOR_2D: return "XOR row+column parity";
+        case FEC_SCHEME_RS: return "Reed-Solomon";
+        default: return "none";
+    }
+}
+
+// Cauchy matrix entry for parity row j and media packet i: 1 / (x_j + y_i)
+// with x_j = 255 - j and y_i = i. Every square submatrix of a Cauchy matrix
+// is invertible, so any M losses in a block can be solved for.
+static uint8_t rs_coefficient(int j, int i) {
+    return gf256_inv((uint8_t)((255 - j) ^ i));
+}
+
+// --- Encoder ---
+
+int fec_encoder_init(FecEncoder *encoder, int scheme, int param, int max_block, uint8_t payload_type) {
+    memset(encoder, 0, sizeof(FecEncoder));
+
+    encoder->scheme = scheme;
+    encoder->payload_type = payload_type;
+    encoder->max_block = max_block > 0 ? max_block : FEC_DEFAULT_BLOCK;
+    if (encoder->max_block > FEC_MAX_BLOCK) return -1;
+
+    if (scheme == FEC_SCHEME_RS) {
+        encoder->rs_parity = param > 0 ? param : FEC_DEFAULT_RS_PARITY;
+        if (encoder->rs_parity > FEC_MAX_RS_PARITY) return -1;
+        encoder->max_parity = encoder->rs_parity;
+    } else if (scheme == FEC_SCHEME_XOR || scheme == FEC_SCHEME_XOR_2D) {
+        encoder->columns = param > 0 ? param : FEC_DEFAULT_COLUMNS;
+        if (encoder->columns > FEC_MAX_COLUMNS) return -1;
+        int rows = (encoder->max_block + encoder->columns - 1) / encoder->columns;
+        encoder->max_parity = rows + (scheme == FEC_SCHEME_XOR_2D ? encoder->columns : 0);
+    } else {
+        return -1;
+    }
+
+    encoder->parity = (unsigned char *)calloc(encoder->max_parity, FEC_UNIT_MAX);
+    return encoder->parity ? 0 : -1;
+}
+
+void fec_encoder_destroy(FecEncoder *encoder) {
+    free(encoder->parity);
+    memset(encoder, 0, sizeof(FecEncoder));
+}
+
+int fec_encoder_space(FecEncoder *encoder) {
+    return encoder->max_block - encoder->count;
+}
+
+// Fold one recovery unit (recovery header, payload header, payload) into a parity buffer
+static void accumulate_unit(unsigned char *parity, const unsigned char *recovery, const RTPChunk *chunk, uint8_t coef) {
+    fec_mul_add(parity, recovery, coef, FEC_RECOVERY_SIZE);
+    fec_mul_add(parity + FEC_RECOVERY_SIZE, chunk->prefix, coef, chunk->prefix_size);
+    fec_mul_add(parity + FEC_RECOVERY_SIZE + chunk->prefix_size, chunk->payload, coef, chunk->payload_size);
+}
+
+void fec_encoder_add(FecEncoder *encoder, const RTPChunk *chunks, int count, uint32_t timestamp) {
+    if (encoder->count == 0) encoder->first_timestamp = timestamp;
+    uint32_t offset = timestamp - encoder->first_timestamp;
+
+    for (int c = 0; c < count && encoder->count < encoder->max_block; c++) {
+        const RTPChunk *chunk = &chunks[c];
+        int length = chunk->prefix_size + chunk->payload_size;
+        unsigned char recovery[FEC_RECOVERY_SIZE];
+        recovery[0] = length >> 8;
+        recovery[1] = length & 0xFF;
+        recovery[2] = (chunk->is_last_packet ? 0x80 : 0) | encoder->payload_type;  // As RTP byte 1
+        recovery[3] = 0;
+        write_u32(recovery + 4, offset);
+
+        int index = encoder->count++;
+        if (FEC_RECOVERY_SIZE + length > encoder->unit_size) encoder->unit_size = FEC_RECOVERY_SIZE + length;
+
+        if (encoder->scheme == FEC_SCHEME_RS) {
+            for (int j = 0; j < encoder->rs_parity; j++) {
+                accumulate_unit(encoder->parity + j * FEC_UNIT_MAX, recovery, chunk, rs_coefficient(j, index));
+            }
+        } else {
+            int rows = (encoder->max_block + encoder->columns - 1) / encoder->columns;
+            accumulate_unit(encoder->parity + (index / encoder->columns) * FEC_UNIT_MAX, recovery, chunk, 1);
+            if (encoder->scheme == FEC_SCHEME_XOR_2D) {
+                accumulate_unit(encoder->parity + (rows + index % encoder->columns) * FEC_UNIT_MAX, recovery, chunk, 1);
+            }
+        }
+    }
+}
+
+int fec_encoder_finish(FecEncoder *encoder) {
+    encoder->num_parity = 0;
+    if (encoder->count == 0) return 0;
+
+    if (encoder->scheme == FEC_SCHEME_RS) {
+        for (int j = 0; j < encoder->rs_parity; j++) {
+            encoder->kinds[encoder->num_parity] = FEC_KIND_RS;
+            encoder->indices[encoder->num_parity] = j;
+            encoder->parity_data[encoder->num_parity++] = encoder->parity + j * FEC_UNIT_MAX;
+        }
+    } else {
+        int max_rows = (encoder->max_block + encoder->columns - 1) / encoder->columns;
+        int rows = (encoder->count + encoder->columns - 1) / encoder->columns;
+        for (int r = 0; r < rows; r++) {
+            encoder->kinds[encoder->num_parity] = FEC_KIND_ROW;
+            encoder->indices[encoder->num_parity] = r;
+            encoder->parity_data[encoder->num_parity++] = encoder->parity + r * FEC_UNIT_MAX;
+        }
+        // A column of a single packet would just repeat it: only send columns with 2+ members
+        if (encoder->scheme == FEC_SCHEME_XOR_2D) {
+            int columns = encoder->count - encoder->columns;
+            if (columns > encoder->columns) columns = encoder->columns;
+            for (int c = 0; c < columns; c++) {
+                encoder->kinds[encoder->num_parity] = FEC_KIND_COLUMN;
+                encoder->indices[encoder->num_parity] = c;
+                encoder->parity_data[encoder->num_parity++] = encoder->parity + (max_rows + c) * FEC_UNIT_MAX;
+            }
+        }
+    }
+
+    encoder->blocks++;
+    encoder->parity_packets += encoder->num_parity;
+    return encoder->num_parity;
+}
+
+void fec_encoder_begin(FecEncoder *encoder) {
+    // Only the bytes the block touched need clearing
+    for (int p = 0; p < encoder->max_parity; p++) {
+        memset(encoder->parity + p * FEC_UNIT_MAX, 0, encoder->unit_size);
+    }
+    encoder->count = 0;
+    encoder->unit_size = 0;
+    encoder->num_parity = 0;
+}
+
+// --- Decoder ---
+
+void fec_decoder_init(FecDecoder *decoder, PacketPool *pool) {
+    memset(decoder, 0, sizeof(FecDecoder));
+    decoder->pool = pool;
+    for (int i = 0; i < FEC_WINDOW; i++) decoder->media_slots[i] = -1;
+    for (int i = 0; i < FEC_PARITY_WINDOW; i++) decoder->parity_slots[i] = -1;
+}
+
+void fec_decoder_reset(FecDecoder *decoder) {
+    for (int i = 0; i < FEC_WINDOW; i++) {
+        if (decoder->media_slots[i] >= 0) packet_pool_release(decoder->pool, decoder->media_slots[i]);
+        decoder->media_slots[i] = -1;
+    }
+    for (int i = 0; i < FEC_PARITY_WINDOW; i++) {
+        if (decoder->parity_slots[i] >= 0) packet_pool_release(decoder->pool, decoder->parity_slots[i]);
+        decoder->parity_slots[i] = -1;
+    }
+    decoder->started = 0;
+}
+
+void fec_decoder_add_media(FecDecoder *decoder, int slot) {
+    unsigned char *packet = packet_pool_data(decoder->pool, slot);
+    uint16_t seq = (uint16_t)(packet[2] << 8 | packet[3]);
+
+    if (!decoder->started) {
+        decoder->started = 1;
+        decoder->window_full = 0;
+        decoder->first_seq = seq;
+        decoder->newest_seq = seq;
+    } else if ((int16_t)(seq - decoder->newest_seq) > 0) {
+        decoder->newest_seq = seq;
+        if ((uint16_t)(seq - decoder->first_seq) >= FEC_WINDOW) decoder->window_full = 1;
+    }
+
+    int idx = seq & FEC_WINDOW_MASK;
+    if (decoder->media_slots[idx] >= 0) {
+        // Keep the newer of the two packets sharing this window position
+        if ((int16_t)(seq - decoder->media_seqs[idx]) <= 0) return;
+        packet_pool_release(decoder->pool, decoder->media_slots[idx]);
+    }
+    packet_pool_retain(decoder->pool, slot);
+    decoder->media_slots[idx] = slot;
+    decoder->media_seqs[idx] = seq;
+}
+
+// Media packet seq if the window holds it, else NULL
+static const unsigned char *window_packet(FecDecoder *decoder, uint16_t seq, int *length) {
+    int idx = seq & FEC_WINDOW_MASK;
+    if (decoder->media_slots[idx] < 0 || decoder->media_seqs[idx] != seq) return NULL;
+    *length = decoder->pool->lengths[decoder->media_slots[idx]];
+    return packet_pool_data(decoder->pool, decoder->media_slots[idx]);
+}
+
+// Fold a received media packet's recovery unit into acc (the inverse of accumulate_unit)
+static void subtract_unit(unsigned char *acc, const unsigned char *packet, int length,
+                          uint32_t timestamp_base, uint8_t coef) {
+    int payload_size = length - RTP_HEADER_SIZE;
+    unsigned char recovery[FEC_RECOVERY_SIZE];
+    recovery[0] = payload_size >> 8;
+    recovery[1] = payload_size & 0xFF;
+    recovery[2] = packet[1];
+    recovery[3] = 0;
+    write_u32(recovery + 4, read_u32(packet + 4) - timestamp_base);
+    fec_mul_add(acc, recovery, coef, FEC_RECOVERY_SIZE);
+    fec_mul_add(acc + FEC_RECOVERY_SIZE, packet + RTP_HEADER_SIZE, coef, payload_size);
+}
+
+// Turn a recovered unit back into an RTP datagram in a new slot; -1 if it is implausible
+static int rebuild_packet(FecDecoder *decoder, const FecHeader *header, uint16_t seq, const unsigned char *unit) {
+    int payload_size = unit[0] << 8 | unit[1];
+    if (payload_size > header->unit_size - FEC_RECOVERY_SIZE ||
+        RTP_HEADER_SIZE + payload_size > PACKET_SLOT_SIZE) {
+        return -1;
+    }
+    int slot = packet_pool_acquire(decoder->pool);
+    if (slot < 0) return -1;
+
+    unsigned char *packet = packet_pool_data(decoder->pool, slot);
+    packet[0] = 0x80;  // V=2, no padding, extension or CSRCs
+    packet[1] = unit[2];
+    packet[2] = seq >> 8;
+    packet[3] = seq & 0xFF;
+    write_u32(packet + 4, header->timestamp_base + read_u32(unit + 4));
+    write_u32(packet + 8, header->protected_ssrc);
+    memcpy(packet + RTP_HEADER_SIZE, unit + FEC_RECOVERY_SIZE, payload_size);
+    decoder->pool->lengths[slot] = RTP_HEADER_SIZE + payload_size;
+
+    fec_decoder_add_media(decoder, slot);
+    decoder->recovered++;
+    return slot;
+}
+
+// Block positions covered by an XOR parity packet
+static int xor_members(const FecHeader *header, int *members) {
+    int count = 0;
+    int columns = header->columns ? header->columns : 1;
+    if (header->kind == FEC_KIND_ROW) {
+        for (int i = header->index * columns; i < (header->index + 1) * columns && i < header->block_size; i++) {
+            members[count++] = i;
+        }
+    } else {
+        for (int i = header->index; i < header->block_size; i += columns) {
+            members[count++] = i;
+        }
+    }
+    return count;
+}
+
+typedef struct {
+    FecHeader header;
+    const unsigned char *data;
+} FecParity;
+
+// Repeatedly use any XOR parity packet with exactly one missing member; a
+// recovered packet can complete a row or column that was missing two.
+static int recover_xor(FecDecoder *decoder, FecParity *parity, int num_parity, int *recovered, int max_recovered) {
+    int count = 0;
+    int progress = 1;
+    unsigned char unit[FEC_UNIT_MAX];
+    int members[FEC_MAX_BLOCK];
+
+    while (progress && count < max_recovered) {
+        progress = 0;
+        for (int p = 0; p < num_parity && count < max_recovered; p++) {
+            const FecHeader *header = &parity[p].header;
+            int num_members = xor_members(header, members);
+            int missing = -1;
+            int num_missing = 0;
+            for (int m = 0; m < num_members; m++) {
+                int length;
+                if (!window_packet(decoder, (uint16_t)(header->base_seq + members[m]), &length)) {
+                    missing = members[m];
+                    num_missing++;
+                }
+            }
+            if (num_missing != 1) continue;
+
+            memcpy(unit, parity[p].data, header->unit_size);
+            for (int m = 0; m < num_members; m++) {
+                if (members[m] == missing) continue;
+                int length = 0;
+                const unsigned char *packet = window_packet(decoder, (uint16_t)(header->base_seq + members[m]), &length);
+                subtract_unit(unit, packet, length, header->timestamp_base, 1);
+            }
+            int slot = rebuild_packet(decoder, header, (uint16_t)(header->base_seq + missing), unit);
+            if (slot < 0) continue;
+            recovered[count++] = slot;
+            progress = 1;
+        }
+    }
+    return count;
+}
+
+// Invert an n x n matrix over GF(2^8) with Gauss-Jordan elimination. Returns -1 if singular.
+static int gf256_invert(uint8_t matrix[FEC_MAX_RS_PARITY][FEC_MAX_RS_PARITY],
+                        uint8_t inverse[FEC_MAX_RS_PARITY][FEC_MAX_RS_PARITY], int n) {
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) inverse[r][c] = (r == c);
+    }
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && matrix[pivot][col] == 0) pivot++;
+        if (pivot == n) return -1;
+        if (pivot != col) {
+            for (int c = 0; c < n; c++) {
+                uint8_t t = matrix[col][c]; matrix[col][c] = matrix[pivot][c]; matrix[pivot][c] = t;
+                t = inverse[col][c]; inverse[col][c] = inverse[pivot][c]; inverse[pivot][c] = t;
+            }
+        }
+        uint8_t scale = gf256_inv(matrix[col][col]);
+        for (int c = 0; c < n; c++) {
+            matrix[col][c] = gf256_mul(matrix[col][c], scale);
+            inverse[col][c] = gf256_mul(inverse[col][c], scale);
+        }
+        for (int r = 0; r < n; r++) {
+            uint8_t factor = matrix[r][col];
+            if (r == col || factor == 0) continue;
+            for (int c = 0; c < n; c++) {
+                matrix[r][c] ^= gf256_mul(factor, matrix[col][c]);
+                inverse[r][c] ^= gf256_mul(factor, inverse[col][c]);
+            }
+        }
+    }
+    return 0;
+}
+
+// Solve for all missing packets of the block at once if we hold as many parity rows as there are losses
+static int recover_rs(FecDecoder *decoder, FecParity *parity, int num_parity, int *recovered, int max_recovered) {
+    const FecHeader *header = &parity[0].header;
+    int missing[FEC_MAX_RS_PARITY];
+    int num_missing = 0;
+    for (int i = 0; i < header->block_size; i++) {
+        int length;
+        if (!window_packet(decoder, (uint16_t)(header->base_seq + i), &length)) {
+            if (num_missing == FEC_MAX_RS_PARITY) return 0;
+            missing[num_missing++] = i;
+        }
+    }
+    if (num_missing == 0 || num_missing > num_parity || num_missing > max_recovered) return 0;
+
+    // Syndromes: each parity row minus the contribution of the packets we hold
+    static __thread unsigned char syndromes[FEC_MAX_RS_PARITY][FEC_UNIT_MAX];
+    static __thread unsigned char units[FEC_MAX_RS_PARITY][FEC_UNIT_MAX];
+    uint8_t matrix[FEC_MAX_RS_PARITY][FEC_MAX_RS_PARITY];
+    uint8_t inverse[FEC_MAX_RS_PARITY][FEC_MAX_RS_PARITY];
+    int unit_size = header->unit_size;
+
+    for (int r = 0; r < num_missing; r++) {
+        int row = parity[r].header.index;
+        memcpy(syndromes[r], parity[r].data, unit_size);
+        for (int i = 0; i < header->block_size; i++) {
+            int length;
+            const unsigned char *packet = window_packet(decoder, (uint16_t)(header->base_seq + i), &length);
+            if (packet) subtract_unit(syndromes[r], packet, length, header->timestamp_base, rs_coefficient(row, i));
+        }
+        for (int c = 0; c < num_missing; c++) matrix[r][c] = rs_coefficient(row, missing[c]);
+    }
+    if (gf256_invert(matrix, inverse, num_missing) < 0) return 0;
+
+    int count = 0;
+    for (int c = 0; c < num_missing; c++) {
+        memset(units[c], 0, unit_size);
+        for (int r = 0; r < num_missing; r++) fec_mul_add(units[c], syndromes[r], inverse[c][r], unit_size);
+        int slot = rebuild_packet(decoder, header, (uint16_t)(header->base_seq + missing[c]), units[c]);
+        if (slot >= 0) recovered[count++] = slot;
+    }
+    return count;
+}
+
+int fec_decoder_add_parity(FecDecoder *decoder, int slot, int *recovered, int max_recovered) {
+    int length = decoder->pool->lengths[slot];
+    unsigned char *packet = packet_pool_data(decoder->pool, slot);
+    FecHeader header;
+    if (length < RTP_HEADER_SIZE + FEC_HEADER_SIZE) {
+        packet_pool_release(decoder->pool, slot);
+        return 0;
+    }
+    fec_unpack_header(packet + RTP_HEADER_SIZE, &header);
+    if (header.unit_size > FEC_UNIT_MAX || header.block_size == 0 || header.block_size > FEC_MAX_BLOCK ||
+        RTP_HEADER_SIZE + FEC_HEADER_SIZE + header.unit_size > length ||
+        (header.kind != FEC_KIND_ROW && header.kind != FEC_KIND_COLUMN && header.kind != FEC_KIND_RS)) {
+        packet_pool_release(decoder->pool, slot);
+        return 0;
+    }
+
+    // Keep it for later parity packets of the same block
+    if (decoder->parity_slots[decoder->parity_next] >= 0) {
+        packet_pool_release(decoder->pool, decoder->parity_slots[decoder->parity_next]);
+    }
+    decoder->parity_slots[decoder->parity_next] = slot;
+    decoder->parity_next = (decoder->parity_next + 1) % FEC_PARITY_WINDOW;
+    decoder->parity_received++;
+
+    // Only blocks the window fully covers: older members may have been evicted,
+    // and packets from before the window started were never kept
+    if (!decoder->started ||
+        (!decoder->window_full && (int16_t)(header.base_seq - decoder->first_seq) < 0) ||
+        (int16_t)(decoder->newest_seq - header.base_seq) >= FEC_WINDOW) {
+        return 0;
+    }
+
+    // Every parity packet we hold for this block
+    FecParity parity[FEC_PARITY_WINDOW];
+    int num_parity = 0;
+    int is_rs = (header.kind == FEC_KIND_RS);
+    for (int i = 0; i < FEC_PARITY_WINDOW; i++) {
+        if (decoder->parity_slots[i] < 0) continue;
+        unsigned char *held = packet_pool_data(decoder->pool, decoder->parity_slots[i]);
+        FecParity *entry = &parity[num_parity];
+        fec_unpack_header(held + RTP_HEADER_SIZE, &entry->header);
+        if (entry->header.base_seq != header.base_seq || entry->header.block_size != header.block_size ||
+            (entry->header.kind == FEC_KIND_RS) != is_rs) {
+            continue;
+        }
+        entry->data = held + RTP_HEADER_SIZE + FEC_HEADER_SIZE;
+        num_parity++;
+    }
+
+    if (is_rs) return recover_rs(decoder, parity, num_parity, recovered, max_recovered);
+    return recover_xor(decoder, parity, num_parity, recovered, max_recovered);
+}
@@ -0,0 +1,126 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+#include "rtp.h"
+#include "packet_pool.h"
+
+// Forward error correction in the style of RFC 8627 (flexfec).
+// Media packets are grouped into blocks of up to FEC_MAX_BLOCK consecutive
+// packets. Parity packets travel as their own RTP stream (payload type
+// RTP_PT_FEC, own SSRC and sequence numbers) and name the protected SSRC and
+// the block's first sequence number, so the receiver can rebuild lost media
+// packets from the ones it holds.
+//
+// Each media packet is protected as a "recovery unit": an 8-byte recovery
+// header (payload length, marker/PT byte, timestamp offset from the block's
+// first packet) followed by the RTP payload, zero-padded to the longest unit
+// of the block. Schemes:
+//   xor    row parity: one XOR parity packet per L consecutive packets
+//   xor2d  row and column parity (L columns), recovers some burst losses
+//   rs     Reed-Solomon over GF(2^8): any M losses per block, M parity packets
+
+#define FEC_HEADER_SIZE 16      // After the RTP header of a parity packet
+#define FEC_RECOVERY_SIZE 8     // Recovery header in front of each protected payload
+#define FEC_UNIT_MAX (FEC_RECOVERY_SIZE + CHUNK_SIZE)
+#define FEC_MAX_BLOCK 128       // Media packets per block (Cauchy RS needs block + parity <= 256)
+#define FEC_DEFAULT_BLOCK 25
+#define FEC_DEFAULT_COLUMNS 5   // L for the XOR schemes
+#define FEC_MAX_COLUMNS 32
+#define FEC_DEFAULT_RS_PARITY 2 // M for Reed-Solomon
+#define FEC_MAX_RS_PARITY 16
+
+#define FEC_SCHEME_NONE 0
+#define FEC_SCHEME_XOR 1
+#define FEC_SCHEME_XOR_2D 2
+#define FEC_SCHEME_RS 3
+
+// Parity packet kinds on the wire
+#define FEC_KIND_ROW 1
+#define FEC_KIND_COLUMN 2
+#define FEC_KIND_RS 3
+
+typedef struct {
+    uint32_t protected_ssrc;
+    uint16_t base_seq;         // First media sequence number of the block
+    uint32_t timestamp_base;   // RTP timestamp of the block's first packet
+    uint8_t kind;
+    uint8_t index;             // Row, column or RS parity row
+    uint8_t block_size;        // Media packets in the block
+    uint8_t columns;           // L (XOR) or M (RS)
+    uint16_t unit_size;        // Bytes of parity after this header
+} FecHeader;
+
+void fec_pack_header(const FecHeader *header, unsigned char *bytes);
+void fec_unpack_header(const unsigned char *bytes, FecHeader *header);
+
+// Parse "xor", "xor2d" or "rs", optionally with ":N" (L or M). Returns the scheme or -1.
+int fec_parse_scheme(const char *spec, int *param);
+const char *fec_scheme_name(int scheme);
+
+// Sender side: parity is accumulated as packets are sent, so payloads are
+// never held on to (they may live in a moving read window).
+typedef struct {
+    int scheme;
+    uint8_t payload_type;  // Of the protected stream
+    int columns;           // L (XOR schemes)
+    int rs_parity;         // M (Reed-Solomon)
+    int max_block;
+    int count;             // Media packets in the open block
+    int unit_size;         // Longest recovery unit so far
+    uint32_t first_timestamp;  // Media timestamp of the block's first packet (without base)
+    unsigned char *parity; // max_parity buffers of FEC_UNIT_MAX bytes
+    int max_parity;
+    // Filled by fec_encoder_finish: the parity packets of the closed block
+    int num_parity;
+    uint8_t kinds[FEC_MAX_BLOCK + FEC_MAX_COLUMNS];
+    uint8_t indices[FEC_MAX_BLOCK + FEC_MAX_COLUMNS];
+    unsigned char *parity_data[FEC_MAX_BLOCK + FEC_MAX_COLUMNS];
+    long blocks;
+    long parity_packets;
+} FecEncoder;
+
+// Encoders and decoders use the parity kernels picked by fec_kernels_init,
+// which the program calls once before starting any threads
+int fec_encoder_init(FecEncoder *encoder, int scheme, int param, int max_block, uint8_t payload_type);
+void fec_encoder_destroy(FecEncoder *encoder);
+// Media packets that still fit into the open block
+int fec_encoder_space(FecEncoder *encoder);
+// Protect chunks that were just sent with the given media timestamp (no more than the space left)
+void fec_encoder_add(FecEncoder *encoder, const RTPChunk *chunks, int count, uint32_t timestamp);
+// Close the open block; returns its number of parity packets (0 if it is empty)
+int fec_encoder_finish(FecEncoder *encoder);
+// Start the next block after the parity of the closed one has been sent
+void fec_encoder_begin(FecEncoder *encoder);
+
+// Receiver side: a window of recent media packets of one stream, held by
+// reference in their pool slots, plus recent parity packets.
+#define FEC_WINDOW 256          // Media packets kept (power of two)
+#define FEC_WINDOW_MASK (FEC_WINDOW - 1)
+#define FEC_PARITY_WINDOW 64    // Parity packets kept
+
+typedef struct {
+    PacketPool *pool;
+    int32_t media_slots[FEC_WINDOW];   // -1 = empty
+    uint16_t media_seqs[FEC_WINDOW];
+    int32_t parity_slots[FEC_PARITY_WINDOW];
+    int parity_next;           // Ring position for the next parity packet
+    int started;
+    uint16_t first_seq;        // First sequence number the window has seen
+    int window_full;           // Has moved a whole window past first_seq
+    uint16_t newest_seq;
+    long parity_received;
+    long recovered;
+} FecDecoder;
+
+void fec_decoder_init(FecDecoder *decoder, PacketPool *pool);
+// Release every slot the decoder holds
+void fec_decoder_reset(FecDecoder *decoder);
+// Keep a reference to a received media packet
+void fec_decoder_add_media(FecDecoder *decoder, int slot);
+// Take ownership of a parity packet and rebuild what its block lets us. Each
+// recovered packet is returned as a complete datagram in a new pool slot owned
+// by the caller. Returns the number of recovered packets.
+int fec_decoder_add_parity(FecDecoder *decoder, int slot, int *recovered, int max_recovered);
+
+#endif // FEC_H
@@ -0,0 +1,189 @@
+#include "fec_kernels.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FEC_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+static uint8_t gf_exp[512];         // Doubled so exp[log a + log b] needs no modulo
+static uint8_t gf_log[256];
+static uint8_t gf_mul_table[256][256];  // Full product table for the scalar kernel
+static int tables_ready;
+
+typedef void (*xor_kernel)(unsigned char *, const unsigned char *, size_t);
+typedef void (*mul_add_kernel)(unsigned char *, const unsigned char *, uint8_t, size_t);
+
+static xor_kernel xor_impl;
+static mul_add_kernel mul_add_impl;
+static const char *kernel_name = "none";
+
+static void build_tables(void) {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= 0x11d;
+    }
+    for (int i = 255; i < 512; i++) gf_exp[i] = gf_exp[i - 255];
+
+    for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+            gf_mul_table[a][b] = (a && b) ? gf_exp[gf_log[a] + gf_log[b]] : 0;
+        }
+    }
+    tables_ready = 1;
+}
+
+uint8_t gf256_mul(uint8_t a, uint8_t b) {
+    return gf_mul_table[a][b];
+}
+
+uint8_t gf256_inv(uint8_t a) {
+    return gf_exp[255 - gf_log[a]];
+}
+
+// --- Scalar: eight bytes at a time for XOR, one table lookup per byte for multiply ---
+
+static void xor_scalar(unsigned char *dst, const unsigned char *src, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < length; i++) dst[i] ^= src[i];
+}
+
+static void mul_add_scalar(unsigned char *dst, const unsigned char *src, uint8_t coef, size_t length) {
+    const uint8_t *row = gf_mul_table[coef];
+    for (size_t i = 0; i < length; i++) dst[i] ^= row[src[i]];
+}
+
+#ifdef FEC_HAVE_X86
+// --- SSE2 XOR, SSSE3 multiply: split each byte into nibbles and look both up with PSHUFB ---
+
+__attribute__((target("sse2")))
+static void xor_sse2(unsigned char *dst, const unsigned char *src, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(a, b));
+    }
+    xor_scalar(dst + i, src + i, length - i);
+}
+
+// Products of coef with every low nibble and every high nibble value
+static void nibble_tables(uint8_t coef, uint8_t low[16], uint8_t high[16]) {
+    for (int n = 0; n < 16; n++) {
+        low[n] = gf_mul_table[coef][n];
+        high[n] = gf_mul_table[coef][n << 4];
+    }
+}
+
+__attribute__((target("ssse3")))
+static void mul_add_ssse3(unsigned char *dst, const unsigned char *src, uint8_t coef, size_t length) {
+    uint8_t low_bytes[16], high_bytes[16];
+    nibble_tables(coef, low_bytes, high_bytes);
+    __m128i low = _mm_loadu_si128((const __m128i *)low_bytes);
+    __m128i high = _mm_loadu_si128((const __m128i *)high_bytes);
+    __m128i mask = _mm_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_shuffle_epi8(low, _mm_and_si128(s, mask));
+        __m128i hi = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, _mm_xor_si128(lo, hi)));
+    }
+    mul_add_scalar(dst + i, src + i, coef, length - i);
+}
+
+// --- AVX2: the same with 32-byte vectors ---
+
+__attribute__((target("avx2")))
+static void xor_avx2(unsigned char *dst, const unsigned char *src, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a, b));
+    }
+    xor_scalar(dst + i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void mul_add_avx2(unsigned char *dst, const unsigned char *src, uint8_t coef, size_t length) {
+    uint8_t low_bytes[16], high_bytes[16];
+    nibble_tables(coef, low_bytes, high_bytes);
+    __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low_bytes));
+    __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high_bytes));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(s, mask));
+        __m256i hi = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(lo, hi)));
+    }
+    mul_add_scalar(dst + i, src + i, coef, length - i);
+}
+#endif
+
+int fec_kernels_init(const char *name) {
+    if (!tables_ready) build_tables();
+
+#ifdef FEC_HAVE_X86
+    __builtin_cpu_init();
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_ssse3 = __builtin_cpu_supports("ssse3");
+#else
+    int has_avx2 = 0;
+    int has_ssse3 = 0;
+#endif
+
+    if (name == NULL) {
+        name = has_avx2 ? "avx2" : has_ssse3 ? "sse" : "scalar";
+    }
+
+    if (strcmp(name, "scalar") == 0) {
+        xor_impl = xor_scalar;
+        mul_add_impl = mul_add_scalar;
+#ifdef FEC_HAVE_X86
+    } else if (strcmp(name, "sse") == 0 && has_ssse3) {
+        xor_impl = xor_sse2;
+        mul_add_impl = mul_add_ssse3;
+    } else if (strcmp(name, "avx2") == 0 && has_avx2) {
+        xor_impl = xor_avx2;
+        mul_add_impl = mul_add_avx2;
+#endif
+    } else {
+        return -1;
+    }
+    kernel_name = name;
+    return 0;
+}
+
+const char *fec_kernel_name(void) {
+    return kernel_name;
+}
+
+void fec_xor(unsigned char *dst, const unsigned char *src, size_t length) {
+    xor_impl(dst, src, length);
+}
+
+void fec_mul_add(unsigned char *dst, const unsigned char *src, uint8_t coef, size_t length) {
+    if (coef == 0) return;
+    if (coef == 1) {
+        xor_impl(dst, src, length);
+        return;
+    }
+    mul_add_impl(dst, src, coef, length);
+}
@@ -0,0 +1,24 @@
+#ifndef FEC_KERNELS_H
+#define FEC_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parity kernels shared by the FEC encoder and decoder. The best variant the
+// CPU supports (AVX2, SSSE3/SSE2 or portable scalar) is picked at run time.
+// Arithmetic is in GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11d).
+
+// Select the kernels: NULL picks the best available, or "scalar", "sse", "avx2".
+// Returns -1 if the requested variant is not supported by this CPU.
+int fec_kernels_init(const char *name);
+const char *fec_kernel_name(void);
+
+// dst ^= src
+void fec_xor(unsigned char *dst, const unsigned char *src, size_t length);
+// dst ^= coef * src, bytewise in GF(2^8)
+void fec_mul_add(unsigned char *dst, const unsigned char *src, uint8_t coef, size_t length);
+
+uint8_t gf256_mul(uint8_t a, uint8_t b);
+uint8_t gf256_inv(uint8_t a);  // a must not be 0
+
+#endif // FEC_KERNELS_H
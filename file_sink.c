@@ -0,0 +1,196 @@
+#include "file_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int file_sink_open(FileSink *sink, const char *path, PacketPool *pool) {
+    memset(sink, 0, sizeof(FileSink));
+    sink->pool = pool;
+
+    if (path == NULL) {
+        sink->fd = STDOUT_FILENO;
+        sink->owns_fd = 0;
+        return 0;
+    }
+
+    sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sink->fd < 0) {
+        perror("Failed to open output file");
+        return -1;
+    }
+    sink->owns_fd = 1;
+    return 0;
+}
+
+// Queue a payload that lives in a pool slot; the sink takes ownership of the slot
+int file_sink_write_slot(FileSink *sink, int slot, int offset, int length) {
+    if (sink->count == SINK_MAX_IOV && file_sink_flush(sink) < 0) {
+        packet_pool_release(sink->pool, slot);
+        return -1;
+    }
+
+    sink->iov[sink->count].iov_base = packet_pool_data(sink->pool, slot) + offset;
+    sink->iov[sink->count].iov_len = length;
+    sink->slots[sink->count] = slot;
+    sink->count++;
+    return 0;
+}
+
+int file_sink_write_data(FileSink *sink, const void *data, int length) {
+    if (sink->count == SINK_MAX_IOV && file_sink_flush(sink) < 0) {
+        return -1;
+    }
+
+    sink->iov[sink->count].iov_base = (void *)data;
+    sink->iov[sink->count].iov_len = length;
+    sink->slots[sink->count] = -1;
+    // Data inside a pool slot (an aggregated NAL unit) can land in an earlier
+    // io_uring flush than its slot's own payload: pin the slot for this write too
+    const unsigned char *p = (const unsigned char *)data;
+    PacketPool *pool = sink->pool;
+    if (sink->ring && p >= pool->slab && p < pool->slab + (size_t)pool->capacity * PACKET_SLOT_STRIDE) {
+        int slot = (int)((p - pool->slab) / PACKET_SLOT_STRIDE);
+        packet_pool_retain(pool, slot);
+        sink->slots[sink->count] = slot;
+    }
+    sink->count++;
+    return 0;
+}
+
+// Queue everything as positioned writes on the ring. Nothing is written until
+// the ring is submitted; the slots are released by file_sink_write_done.
+static int flush_uring(FileSink *sink) {
+    SinkWriteBatch *batch = (SinkWriteBatch *)calloc(1, sizeof(SinkWriteBatch));
+    if (!batch) {
+        perror("Failed to allocate write batch");
+        return -1;
+    }
+    batch->sink = sink;
+    batch->pool = sink->pool;
+    unsigned char *slab_end = sink->pool->slab + (size_t)sink->pool->capacity * PACKET_SLOT_STRIDE;
+    int result = 0;
+
+    for (int i = 0; i < sink->count; i++) {
+        if (sink->slots[i] >= 0) batch->slots[batch->slot_count++] = sink->slots[i];
+        unsigned char *base = (unsigned char *)sink->iov[i].iov_base;
+        size_t length = sink->iov[i].iov_len;
+        if (length == 0) continue;
+        int registered = sink->ring->buffers_registered && base >= sink->pool->slab && base < slab_end;
+        if (uring_write(sink->ring, sink->fd, base, (unsigned)length, (uint64_t)sink->offset,
+                        registered ? 0 : -1, (uint64_t)(uintptr_t)batch) == 0) {
+            batch->pending++;
+            batch->expected += length;
+            sink->writes_pending++;
+        } else if (pwrite(sink->fd, base, length, sink->offset) != (ssize_t)length) {
+            // The SQ stayed full: write this one directly
+            perror("Failed to write output");
+            result = -1;
+        }
+        sink->offset += length;
+        sink->bytes_written += length;
+    }
+    sink->count = 0;
+
+    if (batch->pending == 0) {
+        for (int i = 0; i < batch->slot_count; i++) packet_pool_release(batch->pool, batch->slots[i]);
+        free(batch);
+    }
+    return result;
+}
+
+// Write everything queued with as few writev calls as possible, then release the slots
+int file_sink_flush(FileSink *sink) {
+    if (sink->ring) return flush_uring(sink);
+    struct iovec *iov = sink->iov;
+    int remaining = sink->count;
+    int result = 0;
+
+    while (remaining > 0) {
+        ssize_t n = writev(sink->fd, iov, remaining);
+        sink->write_calls++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to write output");
+            result = -1;
+            break;
+        }
+        sink->bytes_written += n;
+
+        // Partial write (e.g. a full pipe): skip what went out and retry the rest
+        while (remaining > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            remaining--;
+        }
+        if (remaining > 0) {
+            iov->iov_base = (unsigned char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    for (int i = 0; i < sink->count; i++) {
+        if (sink->slots[i] >= 0) packet_pool_release(sink->pool, sink->slots[i]);
+    }
+    sink->count = 0;
+    return result;
+}
+
+void file_sink_close(FileSink *sink) {
+    file_sink_flush(sink);
+    // Queued writes name the descriptor and pin pool slots: see every one
+    // complete before the file closes and the sink goes away
+    while (sink->ring && sink->writes_pending > 0) {
+        if (uring_submit(sink->ring, 1, -1) < 0 && errno != EINTR) {
+            perror("io_uring_enter failed");
+            break;
+        }
+        sink->reap(sink->reap_arg);
+    }
+    if (sink->owns_fd) {
+        close(sink->fd);
+    }
+    sink->fd = -1;
+}
+
+int file_sink_use_uring(FileSink *sink, IoUring *ring, void (*reap)(void *arg), void *reap_arg) {
+    if (!ring) {
+        if (sink->ring) {
+            file_sink_flush(sink);
+            // Positioned writes leave the file position alone: continue after them
+            lseek(sink->fd, sink->offset, SEEK_SET);
+        }
+        sink->ring = NULL;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(sink->fd, &st) < 0 || !S_ISREG(st.st_mode)) return -1;
+    file_sink_flush(sink);
+    sink->offset = lseek(sink->fd, 0, SEEK_CUR);
+    if (sink->offset < 0) return -1;
+    sink->ring = ring;
+    sink->reap = reap;
+    sink->reap_arg = reap_arg;
+    return 0;
+}
+
+void file_sink_write_done(uint64_t user_data, int32_t res) {
+    SinkWriteBatch *batch = (SinkWriteBatch *)(uintptr_t)user_data;
+    if (res < 0) {
+        if (!batch->error) batch->error = -res;
+    } else {
+        batch->written += res;
+    }
+    batch->sink->writes_pending--;
+    if (--batch->pending > 0) return;
+
+    if (batch->error || batch->written != batch->expected) {
+        fprintf(stderr, "Failed to write output: %s (%ld of %ld bytes)\n",
+                batch->error ? strerror(batch->error) : "short write", batch->written, batch->expected);
+    }
+    for (int i = 0; i < batch->slot_count; i++) packet_pool_release(batch->pool, batch->slots[i]);
+    free(batch);
+}
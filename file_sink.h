@@ -0,0 +1,61 @@
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include "packet_pool.h"
+#include "uring.h"
+
+#define SINK_MAX_IOV 64  // Payloads gathered per writev call
+
+// Streaming output for in-order payloads.
+// Payloads are written straight from their packet pool slots with batched
+// writev calls; each slot is released once its bytes are on the file, so
+// memory use stays constant regardless of stream length.
+typedef struct {
+    int fd;
+    int owns_fd;          // Close fd on file_sink_close (not for stdout)
+    PacketPool *pool;
+    struct iovec iov[SINK_MAX_IOV];
+    int slots[SINK_MAX_IOV];  // Pool slots pinned until their iovec is written (-1 = not a slot)
+    int count;
+    long bytes_written;
+    long write_calls;     // writev syscalls
+    IoUring *ring;        // Set by file_sink_use_uring: flushes become queued positioned writes
+    long offset;          // File offset of the next byte (io_uring writes carry their position)
+    int writes_pending;   // io_uring writes queued or in flight
+    void (*reap)(void *arg);  // Dispatches the ring's completions, file_sink_write_done for sink writes
+    void *reap_arg;
+} FileSink;
+
+// One flush on an io_uring: its slots stay pinned until every write of it completes
+typedef struct {
+    FileSink *sink;
+    PacketPool *pool;
+    int slots[SINK_MAX_IOV];
+    int slot_count;
+    int pending;          // Writes not completed yet
+    long expected;        // Bytes queued
+    long written;
+    int error;            // errno of the first failed write
+} SinkWriteBatch;
+
+int file_sink_open(FileSink *sink, const char *path, PacketPool *pool);  // path NULL writes to stdout
+int file_sink_write_slot(FileSink *sink, int slot, int offset, int length);
+// Queue bytes the sink does not own; they must stay valid until the next flush
+int file_sink_write_data(FileSink *sink, const void *data, int length);
+int file_sink_flush(FileSink *sink);
+// Waits for the sink's io_uring writes to complete before closing the file
+void file_sink_close(FileSink *sink);
+// Regular files only: from now on flushes queue one write per payload on ring
+// (from the registered pool when the ring has it), submitted with the ring's
+// next uring_submit. The CQE user_data is the SinkWriteBatch to pass to
+// file_sink_write_done; reap(reap_arg) must do that for the ring's pending
+// completions, so file_sink_close can wait for its writes. ring NULL goes back
+// to writev, leaving writes in flight to the ring's owner. Returns -1 (and
+// stays on writev) for pipes and terminals, whose writes must stay in order.
+int file_sink_use_uring(FileSink *sink, IoUring *ring, void (*reap)(void *arg), void *reap_arg);
+// A write of an io_uring flush completed; releases the slots after the last one
+void file_sink_write_done(uint64_t user_data, int32_t res);
+
+#endif // FILE_SINK_H
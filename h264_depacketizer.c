@@ -0,0 +1,80 @@
+#include "h264_depacketizer.h"
+#include <string.h>
+#include "rtp.h"
+#include "h264_packetizer.h"
+
+static const unsigned char start_code[4] = { 0, 0, 0, 1 };
+// byte_values[i] == i: constant storage for a rebuilt NAL header
+#define BYTES_4(n) (n), (n) + 1, (n) + 2, (n) + 3
+#define BYTES_16(n) BYTES_4(n), BYTES_4((n) + 4), BYTES_4((n) + 8), BYTES_4((n) + 12)
+#define BYTES_64(n) BYTES_16(n), BYTES_16((n) + 16), BYTES_16((n) + 32), BYTES_16((n) + 48)
+static const unsigned char byte_values[256] = { BYTES_64(0), BYTES_64(64), BYTES_64(128), BYTES_64(192) };
+
+void h264_depacketizer_init(H264Depacketizer *depacketizer) {
+    memset(depacketizer, 0, sizeof(H264Depacketizer));
+}
+
+int h264_depacketize_slot(H264Depacketizer *depacketizer, FileSink *sink, int slot, int size) {
+    unsigned char *packet = packet_pool_data(sink->pool, slot);
+    unsigned char *payload = packet + RTP_HEADER_SIZE;
+
+    // A missing packet (skipped by the jitter buffer) breaks the NAL unit being reassembled
+    uint16_t seq = (uint16_t)(packet[2] << 8 | packet[3]);
+    if (depacketizer->have_seq && seq != depacketizer->next_seq) {
+        depacketizer->in_fragment = 0;
+    }
+    depacketizer->have_seq = 1;
+    depacketizer->next_seq = seq + 1;
+
+    int type = size > 0 ? payload[0] & 0x1F : 0;
+
+    if (type >= 1 && type <= 23) {
+        // Single NAL Unit packet
+        depacketizer->in_fragment = 0;
+        depacketizer->nal_units++;
+        file_sink_write_data(sink, start_code, sizeof(start_code));
+        return file_sink_write_slot(sink, slot, RTP_HEADER_SIZE, size);
+    }
+
+    if (type == H264_NAL_STAP_A) {
+        // Aggregate of 16-bit length-prefixed NAL units
+        depacketizer->in_fragment = 0;
+        int pos = 1;
+        while (pos + 2 <= size) {
+            int length = payload[pos] << 8 | payload[pos + 1];
+            pos += 2;
+            if (length == 0 || length > size - pos) break;
+            depacketizer->nal_units++;
+            file_sink_write_data(sink, start_code, sizeof(start_code));
+            file_sink_write_data(sink, payload + pos, length);
+            pos += length;
+        }
+        // Hand the slot over last (zero bytes) so it outlives the writes above
+        return file_sink_write_slot(sink, slot, RTP_HEADER_SIZE, 0);
+    }
+
+    if (type == H264_NAL_FU_A && size > 2) {
+        int start = payload[1] & 0x80;
+        int end = payload[1] & 0x40;
+        if (start) {
+            // Rebuild the NAL header: F/NRI from the indicator, type from the FU header. The
+            // slot is left untouched, since the FEC window may still hold it as a reference.
+            int nal_header = (payload[0] & 0xE0) | (payload[1] & 0x1F);
+            depacketizer->in_fragment = !end;
+            depacketizer->nal_units++;
+            depacketizer->fragmented_nal_units++;
+            file_sink_write_data(sink, start_code, sizeof(start_code));
+            file_sink_write_data(sink, &byte_values[nal_header], 1);
+            return file_sink_write_slot(sink, slot, RTP_HEADER_SIZE + 2, size - 2);
+        }
+        if (depacketizer->in_fragment) {
+            if (end) depacketizer->in_fragment = 0;
+            return file_sink_write_slot(sink, slot, RTP_HEADER_SIZE + 2, size - 2);
+        }
+    }
+
+    // Orphaned fragment, or an interleaved-mode type (STAP-B, MTAP, FU-B) we never negotiate
+    depacketizer->dropped_packets++;
+    packet_pool_release(sink->pool, slot);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef H264_DEPACKETIZER_H
+#define H264_DEPACKETIZER_H
+
+#include <stdint.h>
+#include "file_sink.h"
+
+// Turns in-order RFC 6184 payloads (Single NAL, STAP-A, FU-A) back into an
+// Annex-B byte stream that a decoder can consume as it arrives. NAL unit
+// bodies are written straight from their pool slots; only start codes and
+// rebuilt FU-A NAL headers are added. Fragments that follow a lost packet are
+// dropped until the next NAL unit starts.
+typedef struct {
+    int in_fragment;         // Inside an FU-A NAL unit whose fragments are all present
+    int have_seq;
+    uint16_t next_seq;
+    long nal_units;
+    long fragmented_nal_units;
+    long dropped_packets;    // Orphaned fragments and unsupported packet types
+} H264Depacketizer;
+
+void h264_depacketizer_init(H264Depacketizer *depacketizer);
+// Queue the payload held in slot (after the RTP header) on the sink; takes ownership of the slot
+int h264_depacketize_slot(H264Depacketizer *depacketizer, FileSink *sink, int slot, int size);
+
+#endif // H264_DEPACKETIZER_H
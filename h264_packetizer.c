@@ -0,0 +1,91 @@
+#include "h264_packetizer.h"
+#include <stdlib.h>
+#include <string.h>
+
+int h264_packetizer_init(H264Packetizer *packetizer) {
+    memset(packetizer, 0, sizeof(H264Packetizer));
+    packetizer->capacity = 256;
+    packetizer->chunks = (RTPChunk *)malloc(packetizer->capacity * sizeof(RTPChunk));
+    return packetizer->chunks ? 0 : -1;
+}
+
+void h264_packetizer_destroy(H264Packetizer *packetizer) {
+    free(packetizer->chunks);
+    memset(packetizer, 0, sizeof(H264Packetizer));
+}
+
+void h264_packetizer_begin(H264Packetizer *packetizer) {
+    packetizer->count = 0;
+}
+
+static RTPChunk *next_chunk(H264Packetizer *packetizer) {
+    if (packetizer->count == packetizer->capacity) {
+        // Large IDR frames: grow geometrically, the array is reused for every access unit
+        int capacity = packetizer->capacity * 2;
+        RTPChunk *chunks = (RTPChunk *)realloc(packetizer->chunks, capacity * sizeof(RTPChunk));
+        if (!chunks) return NULL;
+        packetizer->chunks = chunks;
+        packetizer->capacity = capacity;
+    }
+    RTPChunk *chunk = &packetizer->chunks[packetizer->count++];
+    chunk->is_last_packet = 0;
+    chunk->prefix_size = 0;
+    return chunk;
+}
+
+int h264_packetize_nal(H264Packetizer *packetizer, const unsigned char *nal, int size) {
+    if (size <= 0) return 0;
+
+    if (size <= H264_MAX_PAYLOAD) {
+        // Single NAL Unit packet: the payload is the NAL unit itself
+        RTPChunk *chunk = next_chunk(packetizer);
+        if (!chunk) return -1;
+        chunk->payload = (unsigned char *)nal;
+        chunk->payload_size = size;
+        packetizer->single_nal_packets++;
+        return 0;
+    }
+
+    // FU-A: the NAL header is folded into the FU indicator (F, NRI) and FU header (type)
+    unsigned char indicator = (nal[0] & 0xE0) | H264_NAL_FU_A;
+    unsigned char type = nal[0] & 0x1F;
+    const unsigned char *data = nal + 1;
+    int remaining = size - 1;
+    int first = 1;
+    while (remaining > 0) {
+        int length = remaining < H264_MAX_PAYLOAD - 2 ? remaining : H264_MAX_PAYLOAD - 2;
+        RTPChunk *chunk = next_chunk(packetizer);
+        if (!chunk) return -1;
+        chunk->prefix[0] = indicator;
+        chunk->prefix[1] = type | (first ? 0x80 : 0) | (length == remaining ? 0x40 : 0);
+        chunk->prefix_size = 2;
+        chunk->payload = (unsigned char *)data;
+        chunk->payload_size = length;
+        packetizer->fu_a_packets++;
+        data += length;
+        remaining -= length;
+        first = 0;
+    }
+    return 0;
+}
+
+int h264_packetize_sample(H264Packetizer *packetizer, const unsigned char *sample, size_t size,
+                          int nal_length_size) {
+    size_t pos = 0;
+    while (pos + nal_length_size <= size) {
+        size_t length = 0;
+        for (int i = 0; i < nal_length_size; i++) {
+            length = length << 8 | sample[pos + i];
+        }
+        pos += nal_length_size;
+        if (length > size - pos) return -1;
+        if (h264_packetize_nal(packetizer, sample + pos, (int)length) < 0) return -1;
+        pos += length;
+    }
+
+    // The marker bit flags the last packet of the access unit (RFC 6184 5.1)
+    if (packetizer->count > 0) {
+        packetizer->chunks[packetizer->count - 1].is_last_packet = 1;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef H264_PACKETIZER_H
+#define H264_PACKETIZER_H
+
+#include <stddef.h>
+#include "rtp.h"
+
+#define H264_MAX_PAYLOAD CHUNK_SIZE  // Largest RTP payload; bigger NAL units are sent as FU-A
+
+// NAL unit types (RFC 6184 section 5.2)
+#define H264_NAL_IDR 5
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H264_NAL_STAP_A 24
+#define H264_NAL_FU_A 28
+
+// RFC 6184 packetization (non-interleaved mode) of one access unit into
+// RTPChunks. NAL units that fit go out as Single NAL Unit packets, larger ones
+// as FU-A fragments. Payloads point into the caller's buffer; only the 2-byte
+// FU indicator/header is stored in the chunk's prefix, so nothing is copied.
+typedef struct {
+    RTPChunk *chunks;
+    int count;
+    int capacity;
+    long single_nal_packets;
+    long fu_a_packets;
+} H264Packetizer;
+
+int h264_packetizer_init(H264Packetizer *packetizer);
+void h264_packetizer_destroy(H264Packetizer *packetizer);
+// Start a new access unit
+void h264_packetizer_begin(H264Packetizer *packetizer);
+// Append one NAL unit (without start code or length prefix)
+int h264_packetize_nal(H264Packetizer *packetizer, const unsigned char *nal, int size);
+// Append every NAL unit of an MP4 (AVCC) sample and set the marker on the
+// last packet of the access unit. Returns -1 if the sample is malformed.
+int h264_packetize_sample(H264Packetizer *packetizer, const unsigned char *sample, size_t size,
+                          int nal_length_size);
+
+#endif // H264_PACKETIZER_H
@@ -0,0 +1,571 @@
+#include "jitter_buffer.h"
+#include "log.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static inline int slot_occupied(JitterBuffer *jb, int idx) {
+    return (jb->occupied[idx >> 6] >> (idx & 63)) & 1;
+}
+
+static inline void set_occupied(JitterBuffer *jb, int idx) {
+    jb->occupied[idx >> 6] |= (uint64_t)1 << (idx & 63);
+}
+
+static inline void clear_occupied(JitterBuffer *jb, int idx) {
+    jb->occupied[idx >> 6] &= ~((uint64_t)1 << (idx & 63));
+}
+
+// A gap holds up playout for as long as a jittered packet may still arrive,
+// and at least as long as FEC or NACK need to fill it
+static int gap_timeout_ms(JitterBuffer *jb) {
+    return jb->target_delay_ms > jb->missing_timeout_ms ? jb->target_delay_ms : jb->missing_timeout_ms;
+}
+
+int64_t jitter_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void init_jitter_buffer(JitterBuffer *jb, PacketPool *pool) {
+    memset(jb, 0, sizeof(JitterBuffer));
+    jb->pool = pool;
+    jb->missing_timeout_ms = MISSING_PACKET_TIMEOUT_MS;
+    for (int i = 0; i < JITTER_BUFFER_SIZE; i++) {
+        jb->slots[i] = -1;
+    }
+    jb->initialized = 0;
+    jb->buffer_count = 0;
+    jb->max_jitter_us = 0;
+    jb->avg_jitter_us = 0;
+    jb->jitter_samples = 0;
+    jb->last_timestamp = 0;
+    jb->last_arrival_us = 0;
+    jb->histogram_increment = 1;
+    jb->target_delay_ms = JITTER_INITIAL_DELAY_MS;
+    jb->min_target_ms = JITTER_INITIAL_DELAY_MS;
+    jb->max_target_ms = JITTER_INITIAL_DELAY_MS;
+}
+
+int jitter_buffer_quantile_ms(const JitterBuffer *jb, double quantile) {
+    long total = 0;
+    for (int i = 0; i < JITTER_HISTOGRAM_BINS; i++) total += jb->lifetime_counts[i];
+    long below = 0;
+    for (int i = 0; i < JITTER_HISTOGRAM_BINS; i++) {
+        below += jb->lifetime_counts[i];
+        if (below >= quantile * total) return i;
+    }
+    return JITTER_HISTOGRAM_BINS - 1;
+}
+
+double jitter_buffer_late_fraction(const JitterBuffer *jb, int delay_ms) {
+    long total = 0, late = 0;
+    for (int i = 0; i < JITTER_HISTOGRAM_BINS; i++) {
+        total += jb->lifetime_counts[i];
+        if (i >= delay_ms) late += jb->lifetime_counts[i];
+    }
+    return total > 0 ? (double)late / total : 0;
+}
+
+// Quantile of the recent jitter, from the decaying histogram
+static int recent_quantile_ms(JitterBuffer *jb, double quantile) {
+    double below = 0;
+    for (int i = 0; i < JITTER_HISTOGRAM_BINS; i++) {
+        below += jb->histogram[i];
+        if (below >= quantile * jb->histogram_weight) return i;
+    }
+    return JITTER_HISTOGRAM_BINS - 1;
+}
+
+// Take one jitter sample into the histogram and move the playout delay
+// target: straight up to cover a spike, back down slowly once the recent
+// distribution allows it
+static void update_playout_target(JitterBuffer *jb, long jitter_us, int64_t now_us) {
+    int bin = (int)(jitter_us / 1000);
+    if (bin >= JITTER_HISTOGRAM_BINS) bin = JITTER_HISTOGRAM_BINS - 1;
+    jb->lifetime_counts[bin]++;
+
+    // Older samples fade by the forget factor relative to each new one; the
+    // new sample's weight grows instead, and everything is rescaled rarely
+    jb->histogram[bin] += jb->histogram_increment;
+    jb->histogram_weight += jb->histogram_increment;
+    jb->histogram_increment /= JITTER_FORGET_FACTOR;
+    if (jb->histogram_increment > 1e12) {
+        for (int i = 0; i < JITTER_HISTOGRAM_BINS; i++) jb->histogram[i] /= jb->histogram_increment;
+        jb->histogram_weight /= jb->histogram_increment;
+        jb->histogram_increment = 1;
+    }
+
+    int spike = bin + JITTER_MARGIN_MS > jb->target_delay_ms;
+    if (!spike && jb->frame_samples % JITTER_TARGET_UPDATE != 0) return;
+
+    int target = recent_quantile_ms(jb, JITTER_TARGET_QUANTILE) + JITTER_MARGIN_MS;
+    if (spike && bin + JITTER_MARGIN_MS > target) target = bin + JITTER_MARGIN_MS;
+    if (target < jb->target_delay_ms && jb->target_updated_us > 0) {
+        // Approach the lower target exponentially over the shrink time constant
+        double elapsed_ms = (now_us - jb->target_updated_us) / 1000.0;
+        double keep = exp(-elapsed_ms / JITTER_SHRINK_TIME_MS);
+        target = target + (int)((jb->target_delay_ms - target) * keep);
+    }
+    if (target < JITTER_MIN_DELAY_MS) target = JITTER_MIN_DELAY_MS;
+    if (target > JITTER_DELAY_MS) target = JITTER_DELAY_MS;
+    if (target != jb->target_delay_ms) {
+        LOG_DEBUG("[JITTER] Playout delay target %d ms -> %d ms\n", jb->target_delay_ms, target);
+    }
+    jb->target_delay_ms = target;
+    jb->target_updated_us = now_us;
+    if (target < jb->min_target_ms) jb->min_target_ms = target;
+    if (target > jb->max_target_ms) jb->max_target_ms = target;
+}
+
+// Give every buffered slot back to the pool and start over from the next packet
+void reset_jitter_buffer(JitterBuffer *jb) {
+    for (int w = 0; w < JITTER_BITMAP_WORDS; w++) {
+        uint64_t bits = jb->occupied[w];
+        while (bits) {
+            int idx = w * 64 + __builtin_ctzll(bits);
+            packet_pool_release(jb->pool, jb->slots[idx]);
+            jb->slots[idx] = -1;
+            bits &= bits - 1;
+        }
+        jb->occupied[w] = 0;
+    }
+    jb->buffer_count = 0;
+    jb->initialized = 0;
+}
+
+// Distance from head to the next occupied slot (0 = head itself), looking at
+// most max_distance slots ahead. Returns -1 if none is found.
+int jitter_buffer_next_present(JitterBuffer *jb, int max_distance) {
+    if (jb->buffer_count == 0) return -1;
+    if (max_distance > JITTER_BUFFER_SIZE) max_distance = JITTER_BUFFER_SIZE;
+
+    int distance = 0;
+    while (distance < max_distance) {
+        int idx = (jb->head + distance) & JITTER_BUFFER_MASK;
+        int bit = idx & 63;
+        // Bits at and above idx in this word
+        uint64_t bits = jb->occupied[idx >> 6] >> bit;
+        if (bits) {
+            distance += __builtin_ctzll(bits);
+            return distance < max_distance ? distance : -1;
+        }
+        distance += 64 - bit;  // Whole rest of the word is empty
+    }
+    return -1;
+}
+
+static void store_packet(JitterBuffer *jb, int buffer_idx, int slot, int payload_size,
+                         uint16_t seq, uint32_t timestamp, int is_last, int64_t arrival_us) {
+    jb->slots[buffer_idx] = slot;
+    jb->payload_sizes[buffer_idx] = payload_size;
+    jb->seq_numbers[buffer_idx] = seq;
+    jb->timestamps[buffer_idx] = timestamp;
+    jb->is_last[buffer_idx] = is_last;
+    jb->arrival_us[buffer_idx] = arrival_us;
+    set_occupied(jb, buffer_idx);
+}
+
+// Takes ownership of the pool slot on success (returns 0); on -1 the caller keeps it
+int add_to_jitter_buffer(JitterBuffer *jb, int slot, int payload_size,
+                         uint16_t seq, uint32_t timestamp, int is_last, RTPStats *stats) {
+    stats->total_packets++;
+    
+    // Initialize base sequence on first packet
+    if (!jb->initialized) {
+        jb->base_seq = seq;
+        jb->head = 0;
+        jb->initialized = 1;
+        stats->last_seq = seq - 1;
+        LOG_INFO("First packet: seq=%u\n", seq);
+    }
+    
+    // Detect loss and reordering
+    if (stats->first_packet) {
+        stats->first_packet = 0;
+    } else {
+        uint16_t expected_seq = stats->last_seq + 1;
+        if (seq != expected_seq) {
+            int16_t gap = (int16_t)(seq - expected_seq);  // Signed for negative detection
+            
+            if (gap > 0 && gap < 100) {
+                // Forward jump (potential loss or out-of-order arrival)
+                // Don't immediately count as loss - jitter buffer will handle it
+                LOG_INFO("[SEQ] Forward jump: expected seq=%u, got seq=%u (gap=%d)\n", 
+                       expected_seq, seq, gap);
+                
+                // Mark as potential loss (jitter buffer will correct if packets arrive late)
+                stats->lost_packets += gap;
+                // Ask for them back while they can still be played out
+                if (jb->nack) {
+                    nack_list_add_gap(jb->nack, expected_seq, gap,
+                                      jitter_now_us() + gap_timeout_ms(jb) * 1000L);
+                }
+                
+            } else if (gap < 0) {
+                // Backward jump - packet arrived LATE (reordering!)
+                stats->reordered_packets++;
+                stats->lost_packets--;  // Correct the false loss detection
+                if (jb->nack) nack_list_remove(jb->nack, seq, 0, 0);
+                LOG_INFO("[REORDER] seq=%u arrived late (expected %u)\n", seq, expected_seq);
+                
+            } else if (gap >= 100) {
+                // Huge forward gap - definitely loss or wraparound
+                if (gap < 30000) {  // Not wraparound
+                    stats->lost_packets += gap;
+                    LOG_WARN("[LOSS] Large gap: expected seq=%u, got seq=%u (lost %d)\n", 
+                           expected_seq, seq, gap);
+                } else {
+                    // Likely sequence number wraparound or very late packet
+                    stats->reordered_packets++;
+                    LOG_INFO("[REORDER] seq=%u arrived very late (wraparound?)\n", seq);
+                }
+            }
+        }
+    }
+    
+    // Update last seen sequence (only if newer)
+    if (((int16_t)(seq - stats->last_seq)) > 0) {
+        stats->last_seq = seq;
+    }
+    
+    // Calculate buffer index (the ring size divides the sequence space, so this survives wraparound)
+    int relative_seq = (seq - jb->base_seq) & 0xFFFF;
+    int buffer_idx = relative_seq & JITTER_BUFFER_MASK;
+    
+    // Too late: this sequence number was already played out or skipped
+    if ((int16_t)(relative_seq - (jb->head & 0xFFFF)) < 0) {
+        jb->late_packets++;
+        LOG_INFO("[LATE] seq=%u arrived after its playout\n", seq);
+        return -1;
+    }
+    
+    int occupied = slot_occupied(jb, buffer_idx);
+    
+    // Check for duplicate
+    if (occupied && jb->seq_numbers[buffer_idx] == seq) {
+        stats->duplicate_packets++;
+        LOG_INFO("Duplicate packet: seq=%u\n", seq);
+        return -1;
+    }
+    
+    // Check for buffer overwrite (slot filled with different sequence)
+    if (occupied) {
+        uint16_t overwritten_seq = jb->seq_numbers[buffer_idx];
+        LOG_WARN("Buffer overflow: seq=%u overwrites seq=%u at idx=%d\n", 
+                seq, overwritten_seq, buffer_idx);
+        // This is effectively a lost packet (buffer too small)
+        stats->lost_packets++;
+        packet_pool_release(jb->pool, jb->slots[buffer_idx]);
+    }
+    
+    // Calculate actual network jitter (RFC 3550 algorithm)
+    int64_t arrival_us = jitter_now_us();
+    
+    if (jb->jitter_samples > 0) {
+        // Calculate inter-arrival time (in microseconds)
+        long arrival_diff_us = (long)(arrival_us - jb->last_arrival_us);
+        
+        // Calculate RTP timestamp difference (convert to microseconds, RTP clock = 90kHz)
+        long timestamp_diff = ((long)timestamp - (long)jb->last_timestamp);
+        long timestamp_diff_us = (timestamp_diff * 1000000) / 90000;
+        
+        // Jitter = variance in inter-arrival times
+        long jitter_us = arrival_diff_us - timestamp_diff_us;
+        if (jitter_us < 0) jitter_us = -jitter_us;  // Absolute value
+        
+        // Update max jitter
+        if (jitter_us > jb->max_jitter_us) {
+            jb->max_jitter_us = jitter_us;
+        }
+        
+        // RFC 3550 jitter calculation: J = J + (|D| - J) / 16
+        jb->avg_jitter_us = jb->avg_jitter_us + (jitter_us - jb->avg_jitter_us) / 16;
+        
+        LOG_DEBUG("[JITTER] Packet jitter: %.2f ms (max=%.2f ms, avg=%.2f ms)\n",
+                jitter_us / 1000.0, jb->max_jitter_us / 1000.0, jb->avg_jitter_us / 1000.0);
+    }
+    
+    // The playout target follows the jitter between frame starts: packets of
+    // one frame share a timestamp, and a sender that spreads them over the
+    // frame interval is pacing, not jittering. Only a timestamp ahead of the
+    // current frame starts a new one: a late packet of an earlier frame gives
+    // no frame sample.
+    if (jb->jitter_samples == 0 || (int32_t)(timestamp - jb->frame_timestamp) > 0) {
+        if (jb->frame_samples++ > 0) {
+            long frame_diff_us = (long)(int32_t)(timestamp - jb->frame_timestamp) * 1000000 / 90000;
+            long frame_jitter_us = (long)(arrival_us - jb->frame_arrival_us) - frame_diff_us;
+            if (frame_jitter_us < 0) frame_jitter_us = -frame_jitter_us;
+            update_playout_target(jb, frame_jitter_us, arrival_us);
+        }
+        jb->frame_arrival_us = arrival_us;
+        jb->frame_timestamp = timestamp;
+    }
+    
+    // Update last arrival info
+    jb->last_arrival_us = arrival_us;
+    jb->last_timestamp = timestamp;
+    jb->jitter_samples++;
+    
+    // Store in buffer
+    if (!occupied) {
+        jb->buffer_count++;  // Increment count for new entry
+    }
+    store_packet(jb, buffer_idx, slot, payload_size, seq, timestamp, is_last, arrival_us);
+    
+    LOG_DEBUG("[BUFFER] Occupancy: %d/%d (%.1f%%)\n", 
+            jb->buffer_count, JITTER_BUFFER_SIZE, 
+            (float)jb->buffer_count / JITTER_BUFFER_SIZE * 100.0);
+    
+    return 0;
+}
+
+// The packet fills a gap the loss statistics already counted. It inherits the
+// arrival time of the packet behind it, so rebuilding it late does not hold
+// back the playout of everything queued after it.
+int insert_recovered_packet(JitterBuffer *jb, int slot, int payload_size,
+                            uint16_t seq, uint32_t timestamp, int is_last) {
+    if (!jb->initialized) return -1;
+
+    int relative_seq = (seq - jb->base_seq) & 0xFFFF;
+    int buffer_idx = relative_seq & JITTER_BUFFER_MASK;
+    if ((int16_t)(relative_seq - (jb->head & 0xFFFF)) < 0) {
+        return -1;  // Already skipped
+    }
+    if (slot_occupied(jb, buffer_idx)) {
+        return 1;   // The original arrived after all
+    }
+
+    int next_idx = (buffer_idx + 1) & JITTER_BUFFER_MASK;
+    int64_t arrival_us = slot_occupied(jb, next_idx) ? jb->arrival_us[next_idx] : jitter_now_us();
+    jb->buffer_count++;
+    store_packet(jb, buffer_idx, slot, payload_size, seq, timestamp, is_last, arrival_us);
+    if (jb->nack) nack_list_remove(jb->nack, seq, 0, 0);
+    LOG_DEBUG("[JB] Recovered seq=%u\n", seq);
+    return 0;
+}
+
+// Adaptive playout delay: the jitter target, cut short when the buffer fills up
+static int playout_delay_ms(JitterBuffer *jb) {
+    float buffer_fill_ratio = (float)jb->buffer_count / JITTER_BUFFER_SIZE;
+    
+    if (buffer_fill_ratio > 0.8) {
+        // Buffer filling up - drain faster to avoid overflow
+        return jb->target_delay_ms / 4;
+    } else if (buffer_fill_ratio > 0.5) {
+        // Buffer moderately full - slightly reduce delay
+        return jb->target_delay_ms / 2;
+    }
+    return jb->target_delay_ms;
+}
+
+// Hand the head packet's pool slot to the caller and advance
+static void take_head(JitterBuffer *jb, int buffer_idx, int *slot, int *payload_size, int *is_last) {
+    *slot = jb->slots[buffer_idx];
+    *payload_size = jb->payload_sizes[buffer_idx];
+    *is_last = jb->is_last[buffer_idx];
+    jb->delay_sum_ms += (jitter_now_us() - jb->arrival_us[buffer_idx]) / 1000;
+    jb->played_packets++;
+    
+    LOG_DEBUG("[DEBUG JB] Successfully retrieved seq=%u, size=%d, is_last=%d\n", 
+            jb->seq_numbers[buffer_idx], *payload_size, *is_last);
+    
+    // Mark as empty and advance head
+    clear_occupied(jb, buffer_idx);
+    jb->slots[buffer_idx] = -1;
+    jb->buffer_count--;  // Decrement count
+    jb->head++;
+}
+
+// A packet a whole ring ahead overwrote the head slot: move the head up to it
+// and give back whatever is still buffered behind the new head
+static void skip_head_to(JitterBuffer *jb, int distance) {
+    jb->head += distance;
+    uint16_t head_seq = (jb->base_seq + jb->head) & 0xFFFF;
+    for (int w = 0; w < JITTER_BITMAP_WORDS; w++) {
+        uint64_t bits = jb->occupied[w];
+        while (bits) {
+            int idx = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if ((int16_t)(jb->seq_numbers[idx] - head_seq) < 0) {
+                packet_pool_release(jb->pool, jb->slots[idx]);
+                clear_occupied(jb, idx);
+                jb->slots[idx] = -1;
+                jb->buffer_count--;
+            }
+        }
+    }
+}
+
+// On success returns 1 and hands the packet's pool slot to the caller, who must release it
+int get_from_jitter_buffer(JitterBuffer *jb, int *slot, int *payload_size, int *is_last, int force_flush) {
+    if (!jb->initialized) {
+        LOG_DEBUG("[DEBUG JB] Buffer not initialized\n");
+        return 0;
+    }
+    
+    // Calculate expected sequence number
+    uint16_t expected_seq = (jb->base_seq + jb->head) & 0xFFFF;
+    int buffer_idx = jb->head & JITTER_BUFFER_MASK;
+    
+    LOG_DEBUG("[DEBUG JB] Looking for seq=%u at idx=%d, force_flush=%d\n", expected_seq, buffer_idx, force_flush);
+    
+    // Check if packet is available
+    if (!slot_occupied(jb, buffer_idx)) {
+        // --- Missing packet timeout logic ---
+        // The gap became visible when the first packet after it arrived
+        int next = jitter_buffer_next_present(jb, JITTER_BUFFER_SIZE);
+        if (next < 0) {
+            LOG_DEBUG("[JB] Slot empty for seq=%u, nothing buffered after it. Holding...\n", expected_seq);
+            return 0;
+        }
+        int next_idx = (jb->head + next) & JITTER_BUFFER_MASK;
+        long waited_us = (long)(jitter_now_us() - jb->arrival_us[next_idx]);
+        long waited_ms = waited_us / 1000;
+    
+        if (waited_us >= gap_timeout_ms(jb) * 1000L) {
+            // Skip the whole run of missing packets up to the next one we hold
+            LOG_INFO(
+                    "[JB] %d missing from seq=%u timed out after %ld ms → skipping\n",
+                    next, expected_seq, waited_ms);
+    
+            jb->head += next;  // MOVE ON → skip the missing packets
+            // The head now holds a packet: decide on it right away
+            return get_from_jitter_buffer(jb, slot, payload_size, is_last, force_flush);
+        }
+    
+        LOG_DEBUG(
+                "[JB] Slot empty for seq=%u, waited %ldms (< timeout). Holding...\n",
+                expected_seq, waited_ms);
+    
+        return 0;
+    }
+    
+    LOG_DEBUG("[DEBUG JB] Found seq=%u in slot (expected %u)\n", jb->seq_numbers[buffer_idx], expected_seq);
+    
+    if (jb->seq_numbers[buffer_idx] != expected_seq) {
+        int16_t ahead = (int16_t)(jb->seq_numbers[buffer_idx] - expected_seq);
+        if (ahead <= 0) {
+            LOG_DEBUG("[DEBUG JB] Sequence mismatch!\n");
+            return 0;  // Wrong packet in slot (shouldn't happen)
+        }
+        // Overflow put a newer packet in the head slot; waiting for
+        // expected_seq would hold the stream forever
+        LOG_WARN("[JB] seq=%u was overwritten by seq=%u → skipping %d\n",
+                 expected_seq, jb->seq_numbers[buffer_idx], ahead);
+        skip_head_to(jb, ahead);
+        return get_from_jitter_buffer(jb, slot, payload_size, is_last, force_flush);
+    }
+    
+    // Check jitter delay (wait a bit to allow reordering) unless forced
+    if (!force_flush) {
+        long elapsed_us = (long)(jitter_now_us() - jb->arrival_us[buffer_idx]);
+        long elapsed_ms = elapsed_us / 1000;
+        
+        int adaptive_delay_ms = playout_delay_ms(jb);
+        float buffer_fill_ratio = (float)jb->buffer_count / JITTER_BUFFER_SIZE;
+        if (adaptive_delay_ms < jb->target_delay_ms / 2) {
+            LOG_DEBUG("[JITTER] High buffer occupancy (%.1f%%) - reducing delay to %dms\n",
+                    buffer_fill_ratio * 100.0, adaptive_delay_ms);
+        }
+        
+        LOG_DEBUG("[DEBUG JB] Playout delay check: elapsed=%ldms, threshold=%dms, is_last=%d, buffer=%.1f%%\n", 
+                elapsed_ms, adaptive_delay_ms, jb->is_last[buffer_idx], buffer_fill_ratio * 100.0);
+        
+        if (elapsed_us < adaptive_delay_ms * 1000L && !jb->is_last[buffer_idx]) {
+            LOG_DEBUG("[DEBUG JB] Waiting for jitter delay (%ld/%d ms)\n", elapsed_ms, adaptive_delay_ms);
+            return 0;  // Wait longer for potential reordered packets
+        }
+    }
+    
+    // Retrieve packet (no copy: ownership of the slot moves to the caller)
+    take_head(jb, buffer_idx, slot, payload_size, is_last);
+    return 1;
+}
+
+// Absolute time (jitter_now_us clock) at which get_from_jitter_buffer's
+// decision for the head changes: the head packet's playout deadline, or the
+// moment a gap in front of a buffered packet times out. Returns -1 if
+// nothing is buffered (no deadline to wait for).
+int64_t jitter_buffer_next_deadline_us(JitterBuffer *jb) {
+    if (!jb->initialized) return -1;
+    
+    int next = jitter_buffer_next_present(jb, JITTER_BUFFER_SIZE);
+    if (next < 0) return -1;
+    
+    int buffer_idx = (jb->head + next) & JITTER_BUFFER_MASK;
+    if (next > 0) {
+        // Missing packets in front: the skip fires once the gap has waited long enough
+        return jb->arrival_us[buffer_idx] + gap_timeout_ms(jb) * 1000L;
+    }
+    if (jb->is_last[buffer_idx]) {
+        return jb->arrival_us[buffer_idx];  // Frame end plays out immediately
+    }
+    return jb->arrival_us[buffer_idx] + playout_delay_ms(jb) * 1000L;
+}
+
+// Play out the oldest buffered packet regardless of its playout delay,
+// skipping runs of missing sequence numbers with a bitmap scan.
+// Returns 0 once nothing is left.
+int drain_jitter_buffer_head(JitterBuffer *jb, int *slot, int *payload_size, int *is_last, int *skipped) {
+    // Bounded walk over one full lap of the ring (prevents an infinite loop)
+    int walked = 0;
+    while (jb->buffer_count > 0 && walked < JITTER_BUFFER_SIZE) {
+        int next = jitter_buffer_next_present(jb, JITTER_BUFFER_SIZE - walked);
+        if (next < 0) break;
+        
+        if (next > 0) {
+            // Missing packets - skip the whole run at once
+            uint16_t expected_seq = (jb->base_seq + jb->head) & 0xFFFF;
+            LOG_INFO("[DRAIN] Skipping %d missing from seq=%u\n", next, expected_seq);
+            jb->head += next;  // Move past missing packets
+            *skipped += next;
+            walked += next;
+        }
+        
+        uint16_t expected_seq = (jb->base_seq + jb->head) & 0xFFFF;
+        int buffer_idx = jb->head & JITTER_BUFFER_MASK;
+        if (jb->seq_numbers[buffer_idx] == expected_seq) {
+            // Packet available - drain it
+            take_head(jb, buffer_idx, slot, payload_size, is_last);
+            return 1;
+        }
+        
+        // Slot holds a packet from a later lap: treat this position as missing
+        jb->head++;
+        (*skipped)++;
+        walked++;
+    }
+    return 0;
+}
+
+// Add the counters of one stream (or worker) into a running total
+void accumulate_statistics(RTPStats *total, const RTPStats *stats) {
+    total->total_packets += stats->total_packets;
+    total->lost_packets += stats->lost_packets;
+    total->reordered_packets += stats->reordered_packets;
+    total->duplicate_packets += stats->duplicate_packets;
+    total->recovered_packets += stats->recovered_packets;
+    total->retransmitted_packets += stats->retransmitted_packets;
+    total->late_retransmissions += stats->late_retransmissions;
+}
+
+void print_statistics(RTPStats *stats) {
+    fprintf(stderr, "Total packets received: %d\n", stats->total_packets);
+    fprintf(stderr, "Lost packets: %d\n", stats->lost_packets);
+    fprintf(stderr, "Reordered packets: %d\n", stats->reordered_packets);
+    fprintf(stderr, "Duplicate packets: %d\n", stats->duplicate_packets);
+    if (stats->recovered_packets > 0) {
+        fprintf(stderr, "Recovered packets (FEC): %d\n", stats->recovered_packets);
+    }
+    if (stats->retransmitted_packets > 0 || stats->late_retransmissions > 0) {
+        fprintf(stderr, "Recovered packets (retransmission): %d, late retransmissions: %d\n",
+                stats->retransmitted_packets, stats->late_retransmissions);
+    }
+    if (stats->total_packets > 0) {
+        float loss_rate = (float)stats->lost_packets / (stats->total_packets + stats->lost_packets) * 100.0;
+        fprintf(stderr, "Packet loss rate: %.2f%%\n", loss_rate);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stdint.h>
+#include "packet_pool.h"
+#include "nack.h"
+
+#define JITTER_BUFFER_SIZE 8192  // Hold up to 8192 packets in buffer (must be a power of two)
+#define JITTER_BUFFER_MASK (JITTER_BUFFER_SIZE - 1)
+#define JITTER_BITMAP_WORDS (JITTER_BUFFER_SIZE / 64)
+#define JITTER_DELAY_MS 200      // Longest playout delay (the adaptive target stays below it)
+#define MAX_JITTER_MS 200        // Maximum jitter tolerance
+#define MISSING_PACKET_TIMEOUT_MS 50
+
+// Adaptive playout delay: a high quantile of the interarrival jitter, from a
+// histogram that forgets old samples, plus a margin
+#define JITTER_HISTOGRAM_BINS 256       // 1 ms bins, the last one takes everything longer
+#define JITTER_FORGET_FACTOR 0.995      // Weight kept by the older samples per new one (~200-sample memory)
+#define JITTER_TARGET_QUANTILE 0.97
+#define JITTER_MARGIN_MS 5
+#define JITTER_MIN_DELAY_MS 5
+#define JITTER_INITIAL_DELAY_MS 50      // Until the histogram says otherwise
+#define JITTER_SHRINK_TIME_MS 2000      // Time constant of the decrease (increases are immediate)
+#define JITTER_TARGET_UPDATE 16         // Samples between quantile updates without a spike
+
+#if (JITTER_BUFFER_SIZE & JITTER_BUFFER_MASK) != 0 || JITTER_BUFFER_SIZE > 65536
+#error "JITTER_BUFFER_SIZE must be a power of two no larger than the sequence space"
+#endif
+
+// Statistics tracking
+typedef struct {
+    int total_packets;
+    int lost_packets;
+    int reordered_packets;
+    int duplicate_packets;
+    int recovered_packets;  // Rebuilt from FEC parity (not counted as lost)
+    int retransmitted_packets;  // Filled in time by a retransmission (not counted as lost)
+    int late_retransmissions;   // Retransmissions that arrived after playout skipped the packet
+    uint16_t last_seq;
+    int first_packet;
+} RTPStats;
+
+// Jitter buffer: a power-of-two ring indexed by (sequence & mask).
+// Per-slot metadata is kept in separate arrays so scans only touch the
+// fields they need, and an occupancy bitmap (one bit per slot) finds the
+// next present packet or skips a run of loss with a few bit scans.
+// Payloads stay in their packet pool slots.
+typedef struct {
+    uint64_t occupied[JITTER_BITMAP_WORDS];  // Bit set = slot holds a packet
+    uint16_t seq_numbers[JITTER_BUFFER_SIZE];
+    uint32_t timestamps[JITTER_BUFFER_SIZE];
+    int64_t arrival_us[JITTER_BUFFER_SIZE];  // CLOCK_MONOTONIC arrival time
+    int32_t slots[JITTER_BUFFER_SIZE];       // Packet pool handle holding the whole datagram
+    uint16_t payload_sizes[JITTER_BUFFER_SIZE];
+    uint8_t is_last[JITTER_BUFFER_SIZE];
+
+    PacketPool *pool;  // Owner of the slots referenced above
+    int head;  // Next sequence to play out (relative to base_seq)
+    uint16_t base_seq;  // First sequence number received
+    int initialized;
+    int buffer_count;  // Number of filled slots
+    int late_packets;  // Arrived after their sequence was played out or skipped
+    int missing_timeout_ms;  // How long a gap holds up playout (longer when FEC or NACK can fill it)
+    NackList *nack;          // Gaps are reported here when set
+    long max_jitter_us;  // Maximum observed jitter (microseconds)
+    long avg_jitter_us;  // Average jitter (RFC 3550 calculation)
+    int jitter_samples;  // Number of jitter measurements
+    // Playout delay target and the jitter distribution (of frame starts) behind it
+    int64_t frame_arrival_us;    // First packet of the latest frame
+    uint32_t frame_timestamp;
+    int frame_samples;
+    double histogram[JITTER_HISTOGRAM_BINS];  // Decaying weights
+    double histogram_weight;     // Sum of the weights
+    double histogram_increment;  // Weight of the next sample (grows instead of decaying the rest)
+    int lifetime_counts[JITTER_HISTOGRAM_BINS];  // Every sample, for the late-loss trade-off
+    int target_delay_ms;
+    int min_target_ms;
+    int max_target_ms;
+    int64_t target_updated_us;
+    long delay_sum_ms;   // Playout delay of every played packet, for the mean
+    long played_packets;
+    int64_t last_arrival_us;  // Time of last packet arrival
+    uint32_t last_timestamp;  // RTP timestamp of last packet
+} JitterBuffer;
+
+void init_jitter_buffer(JitterBuffer *jb, PacketPool *pool);
+void reset_jitter_buffer(JitterBuffer *jb);
+int add_to_jitter_buffer(JitterBuffer *jb, int slot, int payload_size,
+                         uint16_t seq, uint32_t timestamp, int is_last, RTPStats *stats);
+// Insert a packet rebuilt by FEC or retransmitted. Returns 0 if stored (the buffer takes the slot),
+// 1 if the packet is already buffered, -1 if playout has already skipped it.
+int insert_recovered_packet(JitterBuffer *jb, int slot, int payload_size,
+                            uint16_t seq, uint32_t timestamp, int is_last);
+int get_from_jitter_buffer(JitterBuffer *jb, int *slot, int *payload_size, int *is_last, int force_flush);
+int drain_jitter_buffer_head(JitterBuffer *jb, int *slot, int *payload_size, int *is_last, int *skipped);
+int jitter_buffer_next_present(JitterBuffer *jb, int max_distance);
+int64_t jitter_buffer_next_deadline_us(JitterBuffer *jb);
+// Share of frame jitter samples above delay_ms: the packets that would be late at that playout delay
+double jitter_buffer_late_fraction(const JitterBuffer *jb, int delay_ms);
+// Jitter below which a share `quantile` of all samples fell, in ms
+int jitter_buffer_quantile_ms(const JitterBuffer *jb, double quantile);
+void accumulate_statistics(RTPStats *total, const RTPStats *stats);
+void print_statistics(RTPStats *stats);
+
+// Monotonic clock in microseconds, used for arrival times and playout deadlines
+int64_t jitter_now_us(void);
+
+#endif // JITTER_BUFFER_H
@@ -0,0 +1,213 @@
+#include "log.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define LOG_RING_SIZE 1024      // Records in flight (power of two)
+#define LOG_RECORD_SIZE 240     // Max formatted length of one record
+#define LOG_WRITE_BATCH 64      // Records per writev
+#define LOG_IDLE_WAIT_MS 100    // Writer wakes up at least this often
+
+// One ring slot. seq implements the bounded MPMC queue protocol (Vyukov):
+// seq == pos means free for the producer claiming pos,
+// seq == pos + 1 means filled and ready for the writer.
+typedef struct {
+    _Atomic size_t seq;
+    int length;
+    char text[LOG_RECORD_SIZE];
+} LogRecord;
+
+int log_runtime_level = LOG_LEVEL_INFO;
+
+static LogRecord ring[LOG_RING_SIZE];
+static _Atomic size_t enqueue_pos;
+static size_t dequeue_pos;           // Only touched by the writer thread
+static _Atomic unsigned long dropped;
+static _Atomic int writer_sleeping;
+static _Atomic int running;
+static sem_t wakeup;
+static pthread_t writer_thread;
+
+// Write every record that is ready, in ring order. Returns the number written.
+static int drain_ring(void) {
+    int total = 0;
+
+    for (;;) {
+        struct iovec iov[LOG_WRITE_BATCH];
+        int count = 0;
+
+        while (count < LOG_WRITE_BATCH) {
+            LogRecord *record = &ring[(dequeue_pos + count) & (LOG_RING_SIZE - 1)];
+            size_t seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+            if (seq != dequeue_pos + count + 1) break;  // Not published yet
+            iov[count].iov_base = record->text;
+            iov[count].iov_len = record->length;
+            count++;
+        }
+        if (count == 0) return total;
+
+        // Best effort: a failed write to stderr is not worth stalling for
+        struct iovec *next = iov;
+        int remaining = count;
+        while (remaining > 0) {
+            ssize_t n = writev(STDERR_FILENO, next, remaining);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            while (remaining > 0 && (size_t)n >= next->iov_len) {
+                n -= next->iov_len;
+                next++;
+                remaining--;
+            }
+            if (remaining > 0) {
+                next->iov_base = (char *)next->iov_base + n;
+                next->iov_len -= n;
+            }
+        }
+
+        // Hand the slots back to producers
+        for (int i = 0; i < count; i++) {
+            LogRecord *record = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+            atomic_store_explicit(&record->seq, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+            dequeue_pos++;
+        }
+        total += count;
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    while (atomic_load(&running)) {
+        if (drain_ring() > 0) continue;
+
+        // Nothing queued: announce that we sleep, re-check, then wait for a producer
+        atomic_store(&writer_sleeping, 1);
+        // Pairs with the fence in log_write: either we see its record or it sees us asleep
+        atomic_thread_fence(memory_order_seq_cst);
+        if (drain_ring() > 0) {
+            atomic_store(&writer_sleeping, 0);
+            continue;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        sem_timedwait(&wakeup, &deadline);
+        atomic_store(&writer_sleeping, 0);
+    }
+    drain_ring();
+    return NULL;
+}
+
+int log_init(int level) {
+    log_runtime_level = level;
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    atomic_store(&dropped, 0);
+
+    if (sem_init(&wakeup, 0, 0) != 0) return -1;
+    atomic_store(&running, 1);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        atomic_store(&running, 0);
+        sem_destroy(&wakeup);
+        return -1;
+    }
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!atomic_load(&running)) return;
+    atomic_store(&running, 0);
+    sem_post(&wakeup);
+    pthread_join(writer_thread, NULL);
+    sem_destroy(&wakeup);
+
+    unsigned long lost = atomic_load(&dropped);
+    if (lost > 0) {
+        fprintf(stderr, "[LOG] %lu log records dropped (ring full)\n", lost);
+    }
+}
+
+void log_set_level(int level) {
+    log_runtime_level = level;
+}
+
+int log_parse_level(const char *name) {
+    if (strcmp(name, "error") == 0) return LOG_LEVEL_ERROR;
+    if (strcmp(name, "warn") == 0) return LOG_LEVEL_WARN;
+    if (strcmp(name, "info") == 0) return LOG_LEVEL_INFO;
+    if (strcmp(name, "debug") == 0) return LOG_LEVEL_DEBUG;
+    return -1;
+}
+
+unsigned long log_dropped_count(void) {
+    return atomic_load(&dropped);
+}
+
+void log_write(int level, const char *fmt, ...) {
+    (void)level;
+    va_list args;
+
+    // Writer not running (startup, shutdown, tools): write synchronously
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) {
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    // Claim a slot; never wait for the writer, drop the record if the ring is full
+    LogRecord *record;
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        record = &ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    va_start(args, fmt);
+    int n = vsnprintf(record->text, LOG_RECORD_SIZE, fmt, args);
+    va_end(args);
+    if (n < 0) n = 0;
+    if (n >= LOG_RECORD_SIZE) {
+        // Truncated: keep the line terminated
+        n = LOG_RECORD_SIZE - 1;
+        record->text[n - 1] = '\n';
+    }
+    record->length = n;
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+
+    // Only pay for a wakeup when the writer is actually asleep. The store
+    // above and the load below must not be reordered (see writer_main).
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writer_sleeping, memory_order_relaxed) &&
+        atomic_exchange(&writer_sleeping, 0)) {
+        sem_post(&wakeup);
+    }
+}
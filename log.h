@@ -0,0 +1,45 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Log levels, most severe first
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+// Records above this level are compiled out entirely (arguments are never evaluated).
+// Override with e.g. make LOG_COMPILE_LEVEL=LOG_LEVEL_INFO
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Runtime threshold, set by log_init / log_set_level
+extern int log_runtime_level;
+
+#define LOG_AT(level, ...)                                                   \
+    do {                                                                     \
+        if ((level) <= LOG_COMPILE_LEVEL &&                                  \
+            __builtin_expect((level) <= log_runtime_level, 0)) {             \
+            log_write((level), __VA_ARGS__);                                 \
+        }                                                                    \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Start the background writer thread. Records go to stderr.
+int log_init(int level);
+// Flush everything still queued and stop the writer thread
+void log_shutdown(void);
+void log_set_level(int level);
+// Parse "error", "warn", "info" or "debug"; returns -1 if unknown
+int log_parse_level(const char *name);
+// Records dropped because the ring was full
+unsigned long log_dropped_count(void);
+
+// Enqueue one record without blocking (use the LOG_* macros instead)
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // LOG_H
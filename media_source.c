@@ -0,0 +1,124 @@
+#include "media_source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int media_source_open(MediaSource *src, const char *path, int follow, size_t window_size) {
+    memset(src, 0, sizeof(MediaSource));
+    src->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (src->fd < 0) {
+        perror("Unable to open input file");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(src->fd, &st) < 0) {
+        perror("fstat failed");
+        media_source_close(src);
+        return -1;
+    }
+    src->is_regular = S_ISREG(st.st_mode);
+
+    if (!follow && src->is_regular) {
+        src->map_size = st.st_size;
+        if (src->map_size == 0) return 0;  // Nothing to send
+        void *map = mmap(NULL, src->map_size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+        if (map != MAP_FAILED) {
+            src->map = (unsigned char *)map;
+            // Aggressive read-ahead, and pages behind us may be reclaimed early
+            madvise(src->map, src->map_size, MADV_SEQUENTIAL);
+            return 0;
+        }
+        // Fall through and stream it instead
+    }
+
+    src->follow = 1;
+    src->window_size = window_size > 0 ? window_size : MEDIA_WINDOW_SIZE;
+    src->window = (unsigned char *)malloc(src->window_size);
+    if (!src->window) {
+        media_source_close(src);
+        return -1;
+    }
+    return 0;
+}
+
+long media_source_size(MediaSource *src) {
+    return src->follow ? -1 : (long)src->map_size;
+}
+
+// Wait for a growing file to be written
+static void follow_sleep(void) {
+    struct timespec pause = { 0, MEDIA_FOLLOW_POLL_MS * 1000000L };
+    nanosleep(&pause, NULL);
+}
+
+// Drop mapped pages before offset in large steps so the resident set stays bounded
+static void drop_behind(MediaSource *src, long offset) {
+    if (offset - (long)src->dropped < MEDIA_DROP_BEHIND) return;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t end = (size_t)offset & ~(size_t)(page - 1);
+    madvise(src->map + src->dropped, end - src->dropped, MADV_DONTNEED);
+    src->dropped = end;
+}
+
+unsigned char *media_source_get(MediaSource *src, long offset, long length, long *available) {
+    *available = 0;
+
+    if (!src->follow) {
+        if (offset >= (long)src->map_size) return NULL;
+        drop_behind(src, offset);
+        long left = (long)src->map_size - offset;
+        *available = left < length ? left : length;
+        return src->map + offset;
+    }
+
+    if (length > (long)src->window_size) length = src->window_size;
+    int idle_polls = 0;
+    while (!src->eof && src->window_offset + (long)src->window_fill < offset + length) {
+        // Out of room: slide the window past the bytes already consumed
+        if (src->window_fill == src->window_size && offset > src->window_offset) {
+            size_t consumed = offset - src->window_offset;
+            memmove(src->window, src->window + consumed, src->window_fill - consumed);
+            src->window_fill -= consumed;
+            src->window_offset = offset;
+        }
+
+        // Read as much as fits: the window doubles as read-ahead
+        ssize_t n = read(src->fd, src->window + src->window_fill, src->window_size - src->window_fill);
+        if (n > 0) {
+            src->window_fill += n;
+            idle_polls = 0;
+        } else if (n == 0 && src->is_regular) {
+            // Growing file: wait for the writer, give up once it has been quiet for a while
+            if (++idle_polls * MEDIA_FOLLOW_POLL_MS >= MEDIA_FOLLOW_IDLE_MS) {
+                src->eof = 1;
+            } else {
+                follow_sleep();
+            }
+        } else if (n == 0) {
+            src->eof = 1;  // Pipe closed by the writer
+        } else if (errno != EINTR) {
+            perror("Input read failed");
+            src->eof = 1;
+        }
+    }
+
+    long end = src->window_offset + (long)src->window_fill;
+    if (offset < src->window_offset || offset >= end) return NULL;
+    *available = end - offset < length ? end - offset : length;
+    return src->window + (offset - src->window_offset);
+}
+
+void media_source_close(MediaSource *src) {
+    if (src->map) munmap(src->map, src->map_size);
+    free(src->window);
+    if (src->fd > STDIN_FILENO) close(src->fd);
+    memset(src, 0, sizeof(MediaSource));
+    src->fd = -1;
+}
@@ -0,0 +1,47 @@
+#ifndef MEDIA_SOURCE_H
+#define MEDIA_SOURCE_H
+
+#include <stddef.h>
+
+#define MEDIA_WINDOW_SIZE (1 << 20)   // Default read-ahead window in follow mode
+#define MEDIA_FOLLOW_POLL_MS 10       // Recheck a growing file this often
+#define MEDIA_FOLLOW_IDLE_MS 2000     // A growing file that stops growing this long has ended
+#define MEDIA_DROP_BEHIND (8 << 20)   // Unmap consumed input in steps of this many bytes
+
+// Sender input, read in order without loading the whole file first.
+//
+// Regular files are mmap'd with MADV_SEQUENTIAL and packetized straight out
+// of the mapping. Consumed ranges are dropped with MADV_DONTNEED, so files
+// larger than RAM stream through a bounded resident set. In follow mode
+// (growing files, pipes, "-" for stdin) data is read() into a bounded
+// read-ahead window instead and callers wait for bytes that have not been
+// written yet.
+typedef struct {
+    int fd;
+    int follow;
+    int is_regular;          // Regular file: EOF is only final after MEDIA_FOLLOW_IDLE_MS
+    int eof;
+
+    // mmap mode
+    unsigned char *map;
+    size_t map_size;
+    size_t dropped;          // Bytes already released to the kernel
+
+    // follow mode
+    unsigned char *window;
+    size_t window_size;
+    long window_offset;      // Input offset of window[0]
+    size_t window_fill;
+} MediaSource;
+
+// Open path ("-" = stdin). Inputs that cannot be mapped are followed.
+int media_source_open(MediaSource *src, const char *path, int follow, size_t window_size);
+// Total size if known up front, -1 when following
+long media_source_size(MediaSource *src);
+// Up to length bytes at offset; *available is how many are valid (0 = end of input).
+// Offsets only move forward: bytes before offset are released. In follow mode
+// this waits until the bytes are written or the input ends.
+unsigned char *media_source_get(MediaSource *src, long offset, long length, long *available);
+void media_source_close(MediaSource *src);
+
+#endif // MEDIA_SOURCE_H
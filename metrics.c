@@ -0,0 +1,144 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Every field is a 64-bit word, so slots can be copied word by word
+#define STREAM_WORDS (sizeof(MetricsStream) / sizeof(uint64_t))
+#define METRICS_READ_ATTEMPTS 100000
+
+static void segment_path(const char *name, char *path, size_t size) {
+    snprintf(path, size, "/rtp-%s", name);
+}
+
+static int64_t monotonic_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+MetricsSegment *metrics_create(const char *name, int role, int num_workers) {
+    char path[METRICS_NAME_MAX + 8];
+    segment_path(name, path, sizeof(path));
+    shm_unlink(path);
+    int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(MetricsSegment)) < 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+    MetricsSegment *segment = (MetricsSegment *)mmap(NULL, sizeof(MetricsSegment), PROT_READ | PROT_WRITE,
+                                                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(path);
+        return NULL;
+    }
+
+    // The file starts zeroed: every slot is free
+    segment->version = METRICS_VERSION;
+    segment->role = role;
+    segment->pid = getpid();
+    segment->max_streams = METRICS_MAX_STREAMS;
+    segment->stream_size = sizeof(MetricsStream);
+    segment->num_workers = num_workers;
+    segment->started_us = monotonic_us();
+    __atomic_store_n(&segment->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+    return segment;
+}
+
+void metrics_destroy(MetricsSegment *segment, const char *name) {
+    char path[METRICS_NAME_MAX + 8];
+    segment_path(name, path, sizeof(path));
+    munmap(segment, sizeof(MetricsSegment));
+    shm_unlink(path);
+}
+
+MetricsStream *metrics_claim_stream(MetricsSegment *segment, uint32_t ssrc, int worker) {
+    for (int i = 0; i < METRICS_MAX_STREAMS; i++) {
+        MetricsStream *stream = &segment->streams[i];
+        uint64_t expected = METRICS_SLOT_FREE;
+        if (!__atomic_compare_exchange_n(&stream->state, &expected, METRICS_SLOT_CLAIMED, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        // Fresh counters for the new stream, published as one update. The slot
+        // only turns USED inside it, so no reader sees the previous stream as live.
+        metrics_begin_update(stream);
+        uint64_t *words = (uint64_t *)stream;
+        for (size_t w = 2; w < STREAM_WORDS; w++) __atomic_store_n(&words[w], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&stream->state, METRICS_SLOT_USED, __ATOMIC_RELAXED);
+        METRICS_SET(stream, ssrc, ssrc);
+        METRICS_SET(stream, worker, worker);
+        METRICS_SET(stream, rtt_us, -1);
+        metrics_end_update(stream, monotonic_us());
+        return stream;
+    }
+    return NULL;
+}
+
+void metrics_release_stream(MetricsStream *stream) {
+    __atomic_store_n(&stream->state, METRICS_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+// One writer per slot: the owning thread
+void metrics_begin_update(MetricsStream *stream) {
+    __atomic_store_n(&stream->seq, stream->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void metrics_end_update(MetricsStream *stream, int64_t now_us) {
+    METRICS_SET(stream, updated_us, now_us);
+    __atomic_store_n(&stream->seq, stream->seq + 1, __ATOMIC_RELEASE);
+}
+
+MetricsSegment *metrics_attach(const char *name) {
+    char path[METRICS_NAME_MAX + 8];
+    segment_path(name, path, sizeof(path));
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(MetricsSegment)) {
+        close(fd);
+        return NULL;
+    }
+    MetricsSegment *segment = (MetricsSegment *)mmap(NULL, sizeof(MetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) return NULL;
+    if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC ||
+        segment->version != METRICS_VERSION || segment->stream_size != sizeof(MetricsStream)) {
+        munmap(segment, sizeof(MetricsSegment));
+        return NULL;
+    }
+    return segment;
+}
+
+void metrics_detach(MetricsSegment *segment) {
+    munmap(segment, sizeof(MetricsSegment));
+}
+
+int metrics_read_stream(const MetricsStream *stream, MetricsStream *copy) {
+    const uint64_t *words = (const uint64_t *)stream;
+    uint64_t *out = (uint64_t *)copy;
+    // A writer that died mid-update leaves the slot odd for good: give up eventually
+    for (int attempt = 0; attempt < METRICS_READ_ATTEMPTS; attempt++) {
+        uint64_t before = __atomic_load_n(&stream->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;  // Update in progress
+        for (size_t w = 0; w < STREAM_WORDS; w++) out[w] = __atomic_load_n(&words[w], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&stream->seq, __ATOMIC_RELAXED) == before) {
+            return copy->state == METRICS_SLOT_USED ? 0 : -1;
+        }
+    }
+    return -1;
+}
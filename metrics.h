@@ -0,0 +1,84 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Live counters in a POSIX shared-memory segment (/dev/shm/rtp-NAME), read
+// by rtpstat while the sender or receiver runs. Every field is a 64-bit
+// word written with relaxed atomics; each stream slot is guarded by a
+// seqlock so a reader never sees a half-updated stream. Writers publish on
+// their own schedule (a stream at most every METRICS_INTERVAL_US), never
+// per packet.
+
+#define METRICS_MAGIC 0x52545053u    // "RTPS"
+#define METRICS_VERSION 1            // Bumped whenever the layout changes
+#define METRICS_MAX_STREAMS 64
+#define METRICS_MAX_WORKERS 64
+#define METRICS_INTERVAL_US 100000
+#define METRICS_NAME_MAX 64
+
+#define METRICS_ROLE_SENDER 1
+#define METRICS_ROLE_RECEIVER 2
+
+#define METRICS_SLOT_FREE 0
+#define METRICS_SLOT_USED 1
+#define METRICS_SLOT_CLAIMED 2      // Taken by a writer that has not published it yet
+
+// One stream (SSRC). Counters are cumulative; the reader derives rates.
+// The sender fills what its receiver reports tell it (loss, jitter, RTT).
+typedef struct {
+    uint64_t seq;               // Seqlock: odd while the writer updates the slot
+    uint64_t state;             // METRICS_SLOT_FREE / METRICS_SLOT_USED / METRICS_SLOT_CLAIMED
+    uint64_t ssrc;
+    uint64_t worker;
+    int64_t updated_us;         // CLOCK_MONOTONIC
+    uint64_t packets;           // Received, or sent
+    uint64_t bytes;
+    int64_t lost;
+    uint64_t reordered;
+    uint64_t duplicates;
+    uint64_t recovered;         // FEC and retransmission
+    uint64_t late;              // Arrived after playout
+    int64_t occupancy;          // Packets in the jitter buffer
+    int64_t avg_jitter_us;
+    int64_t max_jitter_us;
+    int64_t playout_delay_ms;   // Adaptive playout target
+    int64_t rtt_us;             // -1 = unknown
+    int64_t fraction_lost;      // Of the last receiver report, in 1/256
+    int64_t target_bps;         // Congestion control target, 0 = none
+} MetricsStream;
+
+typedef struct {
+    uint64_t magic;             // Written last: a reader ignores a segment still being set up
+    uint64_t version;
+    uint64_t role;
+    uint64_t pid;
+    uint64_t max_streams;
+    uint64_t stream_size;       // sizeof(MetricsStream), checked by readers
+    uint64_t num_workers;
+    int64_t started_us;
+    uint64_t worker_packets[METRICS_MAX_WORKERS];
+    uint64_t worker_kernel_drops[METRICS_MAX_WORKERS];  // SO_RXQ_OVFL
+    MetricsStream streams[METRICS_MAX_STREAMS];
+} MetricsSegment;
+
+// Writer side. create() replaces a segment left behind under the same name.
+MetricsSegment *metrics_create(const char *name, int role, int num_workers);
+void metrics_destroy(MetricsSegment *segment, const char *name);
+// Slot for a new stream, or NULL when all are taken
+MetricsStream *metrics_claim_stream(MetricsSegment *segment, uint32_t ssrc, int worker);
+void metrics_release_stream(MetricsStream *stream);
+void metrics_begin_update(MetricsStream *stream);
+void metrics_end_update(MetricsStream *stream, int64_t now_us);
+
+#define METRICS_SET(object, field, value) __atomic_store_n(&(object)->field, (value), __ATOMIC_RELAXED)
+#define METRICS_GET(object, field) __atomic_load_n(&(object)->field, __ATOMIC_RELAXED)
+
+// Reader side
+MetricsSegment *metrics_attach(const char *name);
+void metrics_detach(MetricsSegment *segment);
+// Consistent copy of a stream slot. Returns 0, or -1 if the slot is free
+// (or stuck mid-update).
+int metrics_read_stream(const MetricsStream *stream, MetricsStream *copy);
+
+#endif // METRICS_H
@@ -0,0 +1,293 @@
+#include "mp4_demux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A box (atom) body: [start, end) within the file
+typedef struct {
+    const unsigned char *start;
+    const unsigned char *end;
+} Mp4Box;
+
+// Sample table boxes of the video track
+typedef struct {
+    Mp4Box stsd, stts, ctts, stss, stsz, stsc, stco, co64;
+    uint32_t timescale;
+    int is_video;
+} Mp4TrackBoxes;
+
+static uint32_t read_u16(const unsigned char *p) {
+    return (uint32_t)p[0] << 8 | p[1];
+}
+
+static uint32_t read_u32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t read_u64(const unsigned char *p) {
+    return (uint64_t)read_u32(p) << 32 | read_u32(p + 4);
+}
+
+// Find the first child box of type inside parent. Returns 0 if found.
+static int find_box(Mp4Box parent, const char *type, Mp4Box *out) {
+    const unsigned char *p = parent.start;
+    while (parent.end - p >= 8) {
+        uint64_t size = read_u32(p);
+        int header = 8;
+        if (size == 1) {
+            if (parent.end - p < 16) return -1;
+            size = read_u64(p + 8);
+            header = 16;
+        } else if (size == 0) {
+            size = parent.end - p;  // Box runs to the end of its parent
+        }
+        if (size < (uint64_t)header || size > (uint64_t)(parent.end - p)) return -1;
+
+        if (memcmp(p + 4, type, 4) == 0) {
+            out->start = p + header;
+            out->end = p + size;
+            return 0;
+        }
+        p += size;
+    }
+    return -1;
+}
+
+// Full boxes start with version (1 byte) and flags (3 bytes); check the
+// body holds at least need bytes after that
+static int full_box_ok(Mp4Box box, size_t need) {
+    return box.start && (size_t)(box.end - box.start) >= 4 + need;
+}
+
+static int parse_avcc(Mp4VideoTrack *track, Mp4Box avcc) {
+    const unsigned char *p = avcc.start;
+    const unsigned char *end = avcc.end;
+    if (end - p < 7) return -1;
+
+    track->nal_length_size = (p[4] & 0x3) + 1;
+    int count = p[5] & 0x1F;
+    p += 6;
+    for (int i = 0; i < count; i++) {
+        if (end - p < 2) return -1;
+        int length = read_u16(p);
+        if (end - p < 2 + length) return -1;
+        if (track->num_sps < MP4_MAX_PARAM_SETS) {
+            track->sps[track->num_sps] = p + 2;
+            track->sps_size[track->num_sps++] = length;
+        }
+        p += 2 + length;
+    }
+
+    if (end - p < 1) return -1;
+    count = *p++;
+    for (int i = 0; i < count; i++) {
+        if (end - p < 2) return -1;
+        int length = read_u16(p);
+        if (end - p < 2 + length) return -1;
+        if (track->num_pps < MP4_MAX_PARAM_SETS) {
+            track->pps[track->num_pps] = p + 2;
+            track->pps_size[track->num_pps++] = length;
+        }
+        p += 2 + length;
+    }
+    return 0;
+}
+
+static int parse_stsd(Mp4VideoTrack *track, Mp4Box stsd) {
+    if (!full_box_ok(stsd, 4)) return -1;
+    Mp4Box entries = { stsd.start + 8, stsd.end };
+
+    // avc1 and avc3 share the same layout (avc3 may carry parameter sets in-band)
+    Mp4Box entry;
+    if (find_box(entries, "avc1", &entry) < 0 && find_box(entries, "avc3", &entry) < 0) {
+        fprintf(stderr, "MP4: video track is not H.264 (avc1/avc3)\n");
+        return -1;
+    }
+
+    // VisualSampleEntry: 78 bytes of fixed fields before the child boxes
+    if (entry.end - entry.start < 78) return -1;
+    track->width = read_u16(entry.start + 24);
+    track->height = read_u16(entry.start + 26);
+
+    Mp4Box children = { entry.start + 78, entry.end };
+    Mp4Box avcc;
+    if (find_box(children, "avcC", &avcc) < 0 || parse_avcc(track, avcc) < 0) {
+        fprintf(stderr, "MP4: missing or invalid avcC decoder configuration\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Expand the run-length and chunk tables into one entry per sample
+static int build_samples(Mp4VideoTrack *track, Mp4TrackBoxes *boxes) {
+    // stsz: sample sizes
+    if (!full_box_ok(boxes->stsz, 8)) return -1;
+    uint32_t fixed_size = read_u32(boxes->stsz.start + 4);
+    uint32_t count = read_u32(boxes->stsz.start + 8);
+    if (fixed_size == 0 && (size_t)(boxes->stsz.end - boxes->stsz.start) < 12 + (size_t)count * 4) return -1;
+    if (count == 0 || count > MP4_MAX_SAMPLES) return -1;
+
+    track->samples = (Mp4Sample *)calloc(count, sizeof(Mp4Sample));
+    if (!track->samples) return -1;
+    track->num_samples = (int)count;  // Capped by MP4_MAX_SAMPLES
+    for (uint32_t i = 0; i < count; i++) {
+        track->samples[i].size = fixed_size ? fixed_size : read_u32(boxes->stsz.start + 12 + i * 4);
+    }
+
+    // stts: decode time deltas
+    if (!full_box_ok(boxes->stts, 4)) return -1;
+    uint32_t entries = read_u32(boxes->stts.start + 4);
+    if ((size_t)(boxes->stts.end - boxes->stts.start) < 8 + (size_t)entries * 8) return -1;
+    uint64_t dts = 0;
+    uint32_t s = 0;
+    for (uint32_t e = 0; e < entries && s < count; e++) {
+        uint32_t run = read_u32(boxes->stts.start + 8 + e * 8);
+        uint32_t delta = read_u32(boxes->stts.start + 12 + e * 8);
+        for (uint32_t k = 0; k < run && s < count; k++, s++) {
+            track->samples[s].dts = dts;
+            dts += delta;
+        }
+    }
+    if (s < count) return -1;  // Every sample needs a decode time
+
+    // ctts (optional): composition offsets, present when frames are reordered (B-frames)
+    if (full_box_ok(boxes->ctts, 4)) {
+        entries = read_u32(boxes->ctts.start + 4);
+        if ((size_t)(boxes->ctts.end - boxes->ctts.start) >= 8 + (size_t)entries * 8) {
+            s = 0;
+            for (uint32_t e = 0; e < entries && s < count; e++) {
+                uint32_t run = read_u32(boxes->ctts.start + 8 + e * 8);
+                int32_t offset = (int32_t)read_u32(boxes->ctts.start + 12 + e * 8);
+                for (uint32_t k = 0; k < run && s < count; k++, s++) {
+                    track->samples[s].cts_offset = offset;
+                }
+            }
+        }
+    }
+
+    // stss (optional): sync samples; without it every sample is a sync sample
+    if (full_box_ok(boxes->stss, 4)) {
+        entries = read_u32(boxes->stss.start + 4);
+        if ((size_t)(boxes->stss.end - boxes->stss.start) >= 8 + (size_t)entries * 4) {
+            for (uint32_t e = 0; e < entries; e++) {
+                uint32_t number = read_u32(boxes->stss.start + 8 + e * 4);
+                if (number >= 1 && number <= count) track->samples[number - 1].is_sync = 1;
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) track->samples[i].is_sync = 1;
+    }
+
+    // stco / co64: chunk offsets
+    int wide = 0;
+    Mp4Box chunk_box = boxes->stco;
+    if (!full_box_ok(chunk_box, 4)) {
+        chunk_box = boxes->co64;
+        wide = 1;
+        if (!full_box_ok(chunk_box, 4)) return -1;
+    }
+    uint32_t num_chunks = read_u32(chunk_box.start + 4);
+    if ((size_t)(chunk_box.end - chunk_box.start) < 8 + (size_t)num_chunks * (wide ? 8 : 4)) return -1;
+
+    // stsc: samples per chunk, as runs starting at first_chunk (1-based)
+    if (!full_box_ok(boxes->stsc, 4)) return -1;
+    entries = read_u32(boxes->stsc.start + 4);
+    if (entries == 0 || (size_t)(boxes->stsc.end - boxes->stsc.start) < 8 + (size_t)entries * 12) return -1;
+    // first_chunk is 1-based and strictly increasing; chunk - 1 indexes the offset table below
+    for (uint32_t e = 0, prev = 0; e < entries; e++) {
+        uint32_t first = read_u32(boxes->stsc.start + 8 + e * 12);
+        if (first <= prev) return -1;
+        prev = first;
+    }
+
+    s = 0;
+    for (uint32_t e = 0; e < entries && s < count; e++) {
+        uint32_t first = read_u32(boxes->stsc.start + 8 + e * 12);
+        uint32_t per_chunk = read_u32(boxes->stsc.start + 12 + e * 12);
+        uint32_t last = (e + 1 < entries) ? read_u32(boxes->stsc.start + 8 + (e + 1) * 12) : num_chunks + 1;
+        for (uint32_t chunk = first; chunk < last && chunk <= num_chunks && s < count; chunk++) {
+            uint64_t offset = wide ? read_u64(chunk_box.start + 8 + (chunk - 1) * 8)
+                                   : read_u32(chunk_box.start + 8 + (chunk - 1) * 4);
+            for (uint32_t k = 0; k < per_chunk && s < count; k++, s++) {
+                track->samples[s].offset = offset;
+                offset += track->samples[s].size;
+            }
+        }
+    }
+    if (s < count) return -1;  // Chunk tables do not cover every sample
+    return 0;
+}
+
+int mp4_open_video_track(Mp4VideoTrack *track, const unsigned char *data, size_t size) {
+    memset(track, 0, sizeof(Mp4VideoTrack));
+
+    Mp4Box file = { data, data + size };
+    Mp4Box moov;
+    if (find_box(file, "moov", &moov) < 0) {
+        fprintf(stderr, "MP4: no moov box (not an MP4 file?)\n");
+        return -1;
+    }
+
+    // Walk the tracks until a video handler turns up
+    Mp4Box rest = moov;
+    Mp4Box trak;
+    while (find_box(rest, "trak", &trak) == 0) {
+        rest.start = trak.end;
+
+        Mp4Box mdia, hdlr, mdhd, minf, stbl;
+        if (find_box(trak, "mdia", &mdia) < 0 || find_box(mdia, "hdlr", &hdlr) < 0 ||
+            !full_box_ok(hdlr, 8) || memcmp(hdlr.start + 8, "vide", 4) != 0) {
+            continue;
+        }
+        if (find_box(mdia, "mdhd", &mdhd) < 0 || find_box(mdia, "minf", &minf) < 0 ||
+            find_box(minf, "stbl", &stbl) < 0) {
+            continue;
+        }
+
+        // mdhd version 1 uses 64-bit creation/modification times
+        if (!full_box_ok(mdhd, 0) ||
+            (mdhd.start[0] == 1 ? !full_box_ok(mdhd, 20) : !full_box_ok(mdhd, 12))) {
+            continue;
+        }
+        track->timescale = read_u32(mdhd.start + (mdhd.start[0] == 1 ? 20 : 12));
+
+        Mp4TrackBoxes boxes;
+        memset(&boxes, 0, sizeof(boxes));
+        find_box(stbl, "stsd", &boxes.stsd);
+        find_box(stbl, "stts", &boxes.stts);
+        find_box(stbl, "ctts", &boxes.ctts);
+        find_box(stbl, "stss", &boxes.stss);
+        find_box(stbl, "stsz", &boxes.stsz);
+        find_box(stbl, "stsc", &boxes.stsc);
+        find_box(stbl, "stco", &boxes.stco);
+        find_box(stbl, "co64", &boxes.co64);
+
+        if (track->timescale == 0 || parse_stsd(track, boxes.stsd) < 0) {
+            mp4_close_video_track(track);
+            return -1;
+        }
+        if (build_samples(track, &boxes) < 0) {
+            fprintf(stderr, "MP4: invalid or missing sample tables (fragmented MP4 is not supported)\n");
+            mp4_close_video_track(track);
+            return -1;
+        }
+
+        // Samples must lie inside the file (64-bit co64 offsets must not wrap the sum)
+        for (int i = 0; i < track->num_samples; i++) {
+            if (track->samples[i].offset > size || track->samples[i].size > size - track->samples[i].offset) {
+                fprintf(stderr, "MP4: sample %d lies beyond the end of the file\n", i);
+                mp4_close_video_track(track);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    fprintf(stderr, "MP4: no video track found\n");
+    return -1;
+}
+
+void mp4_close_video_track(Mp4VideoTrack *track) {
+    free(track->samples);
+    memset(track, 0, sizeof(Mp4VideoTrack));
+}
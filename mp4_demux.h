@@ -0,0 +1,42 @@
+#ifndef MP4_DEMUX_H
+#define MP4_DEMUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MP4_MAX_PARAM_SETS 8  // SPS / PPS entries kept from avcC
+#define MP4_MAX_SAMPLES (1 << 24)  // Samples per track (over 6 days at 30 fps)
+
+// One coded video frame (access unit) as stored in mdat
+typedef struct {
+    uint64_t offset;      // File offset of the sample
+    uint32_t size;
+    uint64_t dts;         // Decode time in track timescale units
+    int32_t cts_offset;   // Composition (presentation) time - decode time
+    int is_sync;          // IDR / random access point
+} Mp4Sample;
+
+// The first H.264 video track of a non-fragmented MP4, read from the sample
+// tables (stts, ctts, stss, stsz, stsc, stco/co64) and the avcC decoder
+// configuration. All pointers refer into the caller's buffer (the input mapping).
+typedef struct {
+    uint32_t timescale;
+    uint32_t width;
+    uint32_t height;
+    int nal_length_size;  // Bytes in front of every NAL unit inside a sample
+    const unsigned char *sps[MP4_MAX_PARAM_SETS];
+    int sps_size[MP4_MAX_PARAM_SETS];
+    int num_sps;
+    const unsigned char *pps[MP4_MAX_PARAM_SETS];
+    int pps_size[MP4_MAX_PARAM_SETS];
+    int num_pps;
+    Mp4Sample *samples;   // In decode order
+    int num_samples;
+} Mp4VideoTrack;
+
+// Parse the file held in data[0..size). Returns 0, or -1 (with a message on
+// stderr) if there is no usable H.264 track.
+int mp4_open_video_track(Mp4VideoTrack *track, const unsigned char *data, size_t size);
+void mp4_close_video_track(Mp4VideoTrack *track);
+
+#endif // MP4_DEMUX_H
@@ -0,0 +1,149 @@
+#include "nack.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --- Sender: retransmission history ---
+
+int rtx_history_init(RtxHistory *history, int capacity) {
+    memset(history, 0, sizeof(RtxHistory));
+    int size = 1;
+    while (size < capacity) size <<= 1;
+    history->capacity = size;
+    history->payloads = (unsigned char *)malloc((size_t)size * RTX_PAYLOAD_MAX);
+    history->sizes = (uint16_t *)calloc(size, sizeof(uint16_t));
+    history->timestamps = (uint32_t *)calloc(size, sizeof(uint32_t));
+    history->markers = (uint8_t *)calloc(size, sizeof(uint8_t));
+    if (!history->payloads || !history->sizes || !history->timestamps || !history->markers) {
+        rtx_history_destroy(history);
+        return -1;
+    }
+    return 0;
+}
+
+void rtx_history_destroy(RtxHistory *history) {
+    free(history->payloads);
+    free(history->sizes);
+    free(history->timestamps);
+    free(history->markers);
+    memset(history, 0, sizeof(RtxHistory));
+}
+
+void rtx_history_add(RtxHistory *history, const RTPChunk *chunks, int count, uint32_t timestamp) {
+    for (int c = 0; c < count; c++) {
+        int pos = (int)(history->next_index++ & (history->capacity - 1));
+        unsigned char *copy = history->payloads + (size_t)pos * RTX_PAYLOAD_MAX;
+        // The payload header and payload go out as one RTX payload
+        memcpy(copy, chunks[c].prefix, chunks[c].prefix_size);
+        memcpy(copy + chunks[c].prefix_size, chunks[c].payload, chunks[c].payload_size);
+        history->sizes[pos] = (uint16_t)(chunks[c].prefix_size + chunks[c].payload_size);
+        history->timestamps[pos] = timestamp;
+        history->markers[pos] = (uint8_t)chunks[c].is_last_packet;
+    }
+}
+
+int rtx_history_lookup(RtxHistory *history, int age) {
+    if (age < 0 || age >= history->capacity || age >= history->next_index) return -1;
+    return (int)((history->next_index - 1 - age) & (history->capacity - 1));
+}
+
+// --- Receiver: pending requests ---
+
+void nack_list_init(NackList *list) {
+    memset(list, 0, sizeof(NackList));
+    list->rtt_us = NACK_DEFAULT_RTT_US;
+}
+
+void nack_list_add_gap(NackList *list, uint16_t first_seq, int count, int64_t deadline_us) {
+    for (int i = 0; i < count; i++) {
+        if (list->count == NACK_MAX_PENDING) {
+            // Full: the oldest entry has the nearest deadline, give it up first
+            memmove(list->seqs, list->seqs + 1, (NACK_MAX_PENDING - 1) * sizeof(list->seqs[0]));
+            memmove(list->deadline_us, list->deadline_us + 1, (NACK_MAX_PENDING - 1) * sizeof(list->deadline_us[0]));
+            memmove(list->sent_us, list->sent_us + 1, (NACK_MAX_PENDING - 1) * sizeof(list->sent_us[0]));
+            memmove(list->attempts, list->attempts + 1, (NACK_MAX_PENDING - 1) * sizeof(list->attempts[0]));
+            list->count--;
+            list->abandoned++;
+        }
+        int n = list->count++;
+        list->seqs[n] = (uint16_t)(first_seq + i);
+        list->deadline_us[n] = deadline_us;
+        list->sent_us[n] = 0;
+        list->attempts[n] = 0;
+    }
+}
+
+static void remove_entry(NackList *list, int i) {
+    int tail = list->count - i - 1;
+    memmove(list->seqs + i, list->seqs + i + 1, tail * sizeof(list->seqs[0]));
+    memmove(list->deadline_us + i, list->deadline_us + i + 1, tail * sizeof(list->deadline_us[0]));
+    memmove(list->sent_us + i, list->sent_us + i + 1, tail * sizeof(list->sent_us[0]));
+    memmove(list->attempts + i, list->attempts + i + 1, tail * sizeof(list->attempts[0]));
+    list->count--;
+}
+
+int nack_list_remove(NackList *list, uint16_t seq, int64_t now_us, int retransmitted) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->seqs[i] != seq) continue;
+        if (retransmitted && list->sent_us[i] > 0) {
+            // Time from the last request; RFC 6298-style smoothing (1/8 gain)
+            int64_t sample = now_us - list->sent_us[i];
+            list->rtt_us += (sample - list->rtt_us) / 8;
+        }
+        remove_entry(list, i);
+        return 1;
+    }
+    return 0;
+}
+
+int nack_list_pending(const NackList *list, uint16_t seq) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->seqs[i] == seq) return 1;
+    }
+    return 0;
+}
+
+// A request gets two round trips to be answered before it is repeated
+static int64_t retry_interval_us(const NackList *list) {
+    return 2 * list->rtt_us > NACK_MIN_RETRY_US ? 2 * list->rtt_us : NACK_MIN_RETRY_US;
+}
+
+int64_t nack_list_next_retry_us(const NackList *list) {
+    int64_t next = -1;
+    for (int i = 0; i < list->count; i++) {
+        if (list->sent_us[i] == 0 || list->attempts[i] >= NACK_MAX_ATTEMPTS) continue;
+        int64_t retry = list->sent_us[i] + retry_interval_us(list);
+        if (retry + list->rtt_us >= list->deadline_us[i]) continue;
+        if (next < 0 || retry < next) next = retry;
+    }
+    return next;
+}
+
+int nack_list_due(NackList *list, int64_t now_us, uint16_t *seqs, int max_seqs) {
+    int due = 0;
+    int i = 0;
+    while (i < list->count) {
+        int64_t remaining = list->deadline_us[i] - now_us;
+        int fresh = (list->sent_us[i] == 0);
+
+        // A retransmission requested now would arrive after playout skipped the packet
+        if (remaining <= list->rtt_us) {
+            if (fresh) list->abandoned++;
+            remove_entry(list, i);
+            continue;
+        }
+        int retry = !fresh && now_us - list->sent_us[i] >= retry_interval_us(list) &&
+                    list->attempts[i] < NACK_MAX_ATTEMPTS;
+        if ((fresh || retry) && due < max_seqs) {
+            seqs[due++] = list->seqs[i];
+            list->sent_us[i] = now_us;
+            list->attempts[i]++;
+            if (fresh) {
+                list->requested++;
+            } else {
+                list->retries++;
+            }
+        }
+        i++;
+    }
+    return due;
+}
@@ -0,0 +1,71 @@
+#ifndef NACK_H
+#define NACK_H
+
+#include <stdint.h>
+#include "rtp.h"
+
+// Selective retransmission: the receiver requests missing packets with RTCP
+// generic NACKs (RFC 4585) and the sender answers from a ring of recently
+// sent packets with RTX packets (RFC 4588): payload type RTP_PT_RTX on a
+// separate SSRC, the original sequence number (OSN) in front of the payload.
+
+#define RTX_OSN_SIZE 2              // Original sequence number in front of an RTX payload
+#define RTX_PAYLOAD_MAX (2 + CHUNK_SIZE)  // RTPChunk prefix (payload header) + payload
+#define RTX_DEFAULT_HISTORY 1024    // Packets the sender keeps for retransmission
+#define NACK_MAX_PENDING 256        // Missing packets the receiver tracks per stream
+#define NACK_MAX_ATTEMPTS 3         // Requests per missing packet
+#define NACK_DEFAULT_RTT_US 20000   // Round-trip estimate until the first retransmission is timed
+#define NACK_MIN_RETRY_US 5000      // Never repeat a request sooner than this
+
+// Sender side: copies of the last `capacity` packets, shared by every
+// destination. All destinations receive the same packets in the same order,
+// so a packet is found by its age (packets sent after it) and re-stamped with
+// the requesting destination's header.
+typedef struct {
+    int capacity;               // Power of two
+    long next_index;            // Stream index of the next packet added
+    unsigned char *payloads;    // capacity * RTX_PAYLOAD_MAX bytes (payload header included)
+    uint16_t *sizes;
+    uint32_t *timestamps;       // Media timestamp, without the destination's base
+    uint8_t *markers;
+    long nacks_received;
+    long retransmitted;
+    long expired;               // Requested packets that had already left the ring
+} RtxHistory;
+
+int rtx_history_init(RtxHistory *history, int capacity);
+void rtx_history_destroy(RtxHistory *history);
+// Keep copies of chunks that were just sent to every destination
+void rtx_history_add(RtxHistory *history, const RTPChunk *chunks, int count, uint32_t timestamp);
+// Ring position of the packet sent `age` packets before the newest (0 = newest), or -1
+int rtx_history_lookup(RtxHistory *history, int age);
+
+// Receiver side: missing sequence numbers of one stream and when playout
+// gives up on them. A request is only sent (or repeated) while the
+// retransmission can still arrive before that deadline.
+typedef struct {
+    uint16_t seqs[NACK_MAX_PENDING];
+    int64_t deadline_us[NACK_MAX_PENDING];  // Playout skips the gap at this time
+    int64_t sent_us[NACK_MAX_PENDING];      // Last request, 0 = not requested yet
+    uint8_t attempts[NACK_MAX_PENDING];
+    int count;
+    int64_t rtt_us;             // Smoothed request-to-retransmission time
+    long requested;             // Sequence numbers requested at least once
+    long retries;
+    long abandoned;             // Dropped without a request that could still make playout
+} NackList;
+
+void nack_list_init(NackList *list);
+// count packets starting at first_seq are missing and are skipped at deadline_us
+void nack_list_add_gap(NackList *list, uint16_t first_seq, int count, int64_t deadline_us);
+// seq arrived (retransmitted = 1 for an RTX packet, which also times the round trip).
+// Returns 1 if it was pending.
+int nack_list_remove(NackList *list, uint16_t seq, int64_t now_us, int retransmitted);
+// Sequence numbers to request now; entries that can no longer make playout are dropped
+int nack_list_due(NackList *list, int64_t now_us, uint16_t *seqs, int max_seqs);
+// When the next repeated request falls due (it could still make playout), or -1
+int64_t nack_list_next_retry_us(const NackList *list);
+// Whether seq is waiting for a retransmission
+int nack_list_pending(const NackList *list, uint16_t seq);
+
+#endif // NACK_H
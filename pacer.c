@@ -0,0 +1,116 @@
+#include "pacer.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+int64_t pacer_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void pacer_init(Pacer *pacer) {
+    memset(pacer, 0, sizeof(Pacer));
+    pacer->micro_burst = 1;
+    pacer->first_deadline_ns = -1;
+}
+
+void pacer_set_token_bucket(Pacer *pacer, double bitrate_bps, long burst_bytes) {
+    pacer->token_bucket = 1;
+    pacer->ns_per_byte = 8e9 / bitrate_bps;
+    pacer->burst_ns = (int64_t)(burst_bytes * pacer->ns_per_byte);
+}
+
+void pacer_set_micro_burst(Pacer *pacer, int packets) {
+    pacer->micro_burst = packets < 1 ? 1 : packets;
+    pacer->burst_position = 0;
+}
+
+void pacer_end_burst(Pacer *pacer) {
+    pacer->burst_position = 0;
+}
+
+int64_t pacer_schedule(Pacer *pacer, int64_t release_ns, int bytes) {
+    int64_t deadline = release_ns;
+
+    if (pacer->token_bucket) {
+        // GCRA: tokens refill while the source is idle, but never beyond the burst
+        if (pacer->tat_ns < release_ns) pacer->tat_ns = release_ns;
+        int64_t conforming = pacer->tat_ns - pacer->burst_ns;
+        if (conforming > deadline) deadline = conforming;
+        pacer->tat_ns += (int64_t)(bytes * pacer->ns_per_byte);
+    }
+
+    // Later packets of a micro-burst go out right behind the first one
+    if (pacer->micro_burst > 1) {
+        if (pacer->burst_position == 0) {
+            pacer->burst_deadline_ns = deadline;
+        } else if (deadline > pacer->burst_deadline_ns) {
+            deadline = pacer->burst_deadline_ns;
+        }
+        pacer->burst_position = (pacer->burst_position + 1) % pacer->micro_burst;
+    }
+
+    if (pacer->first_deadline_ns < 0) pacer->first_deadline_ns = deadline;
+    pacer->last_deadline_ns = deadline;
+    pacer->bytes_paced += bytes;
+    return deadline;
+}
+
+void pacer_wait_until(Pacer *pacer, int64_t deadline_ns) {
+    int64_t now = pacer_now_ns();
+    if (now < deadline_ns) {
+#ifdef TIMER_ABSTIME
+        struct timespec wake;
+        wake.tv_sec = deadline_ns / 1000000000LL;
+        wake.tv_nsec = deadline_ns % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+        }
+#else
+        // No absolute sleeps on this platform: recompute the remainder after every wakeup
+        while (now < deadline_ns) {
+            struct timespec rest;
+            rest.tv_sec = (deadline_ns - now) / 1000000000LL;
+            rest.tv_nsec = (deadline_ns - now) % 1000000000LL;
+            nanosleep(&rest, NULL);
+            now = pacer_now_ns();
+        }
+#endif
+        now = pacer_now_ns();
+    }
+
+    // Lateness against the schedule, including time lost before the call
+    int64_t error = now - deadline_ns;
+    int64_t bucket = error / 1000;
+    if (bucket >= PACER_HIST_BUCKETS) bucket = PACER_HIST_BUCKETS - 1;
+    pacer->histogram[bucket]++;
+    pacer->error_sum_ns += error;
+    if (error > pacer->max_error_ns) pacer->max_error_ns = error;
+    pacer->samples++;
+}
+
+void pacer_error_stats(Pacer *pacer, double *mean_us, double *p99_us, double *max_us) {
+    *mean_us = *p99_us = *max_us = 0;
+    if (pacer->samples == 0) return;
+
+    *mean_us = pacer->error_sum_ns / pacer->samples / 1000.0;
+    *max_us = pacer->max_error_ns / 1000.0;
+
+    long rank = (long)(pacer->samples * 0.99);
+    long seen = 0;
+    for (int i = 0; i < PACER_HIST_BUCKETS; i++) {
+        seen += pacer->histogram[i];
+        if (seen > rank) {
+            // Upper edge of the bucket; the last one is open-ended, so only the max bounds it
+            *p99_us = i < PACER_HIST_BUCKETS - 1 ? i + 1 : *max_us;
+            return;
+        }
+    }
+    *p99_us = *max_us;
+}
+
+double pacer_scheduled_bitrate(Pacer *pacer) {
+    int64_t span = pacer->last_deadline_ns - pacer->first_deadline_ns;
+    if (span <= 0) return 0;
+    return pacer->bytes_paced * 8e9 / span;
+}
@@ -0,0 +1,57 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+
+#define PACER_HIST_BUCKETS 10000  // Pacing error histogram, 1 us per bucket (last = overflow)
+
+// Schedules packets against absolute CLOCK_MONOTONIC deadlines and sleeps
+// with clock_nanosleep(TIMER_ABSTIME), so sleep slack and send time never
+// accumulate into drift.
+//
+// The caller gives each packet a release time (when it exists, e.g. the
+// start of its frame or its slot within the frame). In token-bucket mode the
+// deadline is additionally held back by a GCRA token bucket: a target bitrate
+// with a burst allowance in bytes. Micro-bursting releases groups of packets
+// together at the deadline of the group's first packet, trading a little
+// burstiness for fewer wakeups.
+typedef struct {
+    int token_bucket;        // Apply the bitrate limit
+    double ns_per_byte;      // 8e9 / bitrate
+    int64_t burst_ns;        // Burst allowance in bucket time
+    int64_t tat_ns;          // Theoretical arrival time of the next byte (GCRA)
+
+    int micro_burst;         // Packets released together (1 = off)
+    int burst_position;
+    int64_t burst_deadline_ns;
+
+    // Achieved pacing error (wakeup - deadline)
+    long samples;
+    double error_sum_ns;
+    int64_t max_error_ns;
+    long histogram[PACER_HIST_BUCKETS];
+    long bytes_paced;
+    int64_t first_deadline_ns;
+    int64_t last_deadline_ns;
+} Pacer;
+
+void pacer_init(Pacer *pacer);
+// Limit the rate to bitrate_bps with bursts of up to burst_bytes
+void pacer_set_token_bucket(Pacer *pacer, double bitrate_bps, long burst_bytes);
+// Release packets in groups of packets (1 = every packet on its own deadline)
+void pacer_set_micro_burst(Pacer *pacer, int packets);
+// Close the open micro-burst: the next packet starts a new group. Call it at
+// frame boundaries, so a group never pulls a frame's packets ahead of its release.
+void pacer_end_burst(Pacer *pacer);
+// Deadline for the next packet of bytes that becomes available at release_ns
+int64_t pacer_schedule(Pacer *pacer, int64_t release_ns, int bytes);
+// Sleep until deadline_ns and record how late the wakeup was
+void pacer_wait_until(Pacer *pacer, int64_t deadline_ns);
+// Mean, 99th percentile and maximum pacing error in microseconds. A p99 past
+// the histogram (10 ms) is reported as the maximum, not the bucket edge.
+void pacer_error_stats(Pacer *pacer, double *mean_us, double *p99_us, double *max_us);
+// Bitrate of the schedule (bits per second) over the paced interval
+double pacer_scheduled_bitrate(Pacer *pacer);
+int64_t pacer_now_ns(void);
+
+#endif // PACER_H
@@ -0,0 +1,58 @@
+#include "packet_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int packet_pool_init(PacketPool *pool, int capacity) {
+    memset(pool, 0, sizeof(PacketPool));
+    if (capacity <= 0) return -1;
+
+    // One contiguous, cache-line aligned slab for all slots
+    void *slab = NULL;
+    if (posix_memalign(&slab, 64, (size_t)capacity * PACKET_SLOT_STRIDE) != 0) {
+        return -1;
+    }
+    pool->slab = (unsigned char *)slab;
+    pool->lengths = (int *)calloc(capacity, sizeof(int));
+    pool->free_slots = (int *)malloc(capacity * sizeof(int));
+    pool->refs = (int *)calloc(capacity, sizeof(int));
+    if (!pool->lengths || !pool->free_slots || !pool->refs) {
+        packet_pool_destroy(pool);
+        return -1;
+    }
+
+    // Push handles in reverse so slot 0 is handed out first
+    for (int i = 0; i < capacity; i++) {
+        pool->free_slots[i] = capacity - 1 - i;
+    }
+    pool->free_count = capacity;
+    pool->capacity = capacity;
+    return 0;
+}
+
+void packet_pool_destroy(PacketPool *pool) {
+    free(pool->slab);
+    free(pool->lengths);
+    free(pool->free_slots);
+    free(pool->refs);
+    memset(pool, 0, sizeof(PacketPool));
+}
+
+int packet_pool_acquire(PacketPool *pool) {
+    if (pool->free_count == 0) return -1;
+    int handle = pool->free_slots[--pool->free_count];
+    pool->refs[handle] = 1;
+    return handle;
+}
+
+void packet_pool_retain(PacketPool *pool, int handle) {
+    if (handle < 0 || handle >= pool->capacity) return;
+    pool->refs[handle]++;
+}
+
+void packet_pool_release(PacketPool *pool, int handle) {
+    if (handle < 0 || handle >= pool->capacity) return;
+    if (--pool->refs[handle] > 0) return;  // Still held elsewhere
+    pool->lengths[handle] = 0;
+    pool->free_slots[pool->free_count++] = handle;
+}
@@ -0,0 +1,38 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stddef.h>
+#include "rtp.h"
+
+// Each slot holds one whole datagram (RTP header + payload), rounded up to a cache line
+#define PACKET_SLOT_SIZE (((RTP_HEADER_SIZE + CHUNK_SIZE) + 63) & ~63)
+// Room in front of every datagram, where an io_uring multishot recvmsg puts
+// its result header and the source address (see receiver.c)
+#define PACKET_SLOT_HEADROOM 64
+#define PACKET_SLOT_STRIDE (PACKET_SLOT_HEADROOM + PACKET_SLOT_SIZE)
+#define DEFAULT_POOL_SIZE 2048  // Slots allocated when no size is given
+
+// Fixed-size packet buffer pool (arena).
+// Packets are received straight into a slot and identified by an integer handle
+// until the consumer releases it, so payloads are never copied between stages.
+typedef struct {
+    unsigned char *slab;  // capacity * PACKET_SLOT_STRIDE bytes
+    int *lengths;         // Datagram length stored in each slot
+    int *refs;            // Holders of each slot; it is freed when the last one releases it
+    int *free_slots;      // Stack of free handles
+    int free_count;
+    int capacity;
+} PacketPool;
+
+int packet_pool_init(PacketPool *pool, int capacity);
+void packet_pool_destroy(PacketPool *pool);
+int packet_pool_acquire(PacketPool *pool);  // Returns a handle, or -1 if the pool is exhausted
+void packet_pool_retain(PacketPool *pool, int handle);  // Extra holder (e.g. the FEC window)
+void packet_pool_release(PacketPool *pool, int handle);
+
+// Start of the datagram stored in a slot
+static inline unsigned char *packet_pool_data(PacketPool *pool, int handle) {
+    return pool->slab + (size_t)handle * PACKET_SLOT_STRIDE + PACKET_SLOT_HEADROOM;
+}
+
+#endif // PACKET_POOL_H
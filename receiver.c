@@ -4,531 +4,1546 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <time.h>
+#include <sys/resource.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include "rtp.h"
-#include "rtp.c"
+#include "packet_pool.h"
+#include "file_sink.h"
+#include "log.h"
+#include "jitter_buffer.h"
+#include "event_loop.h"
+#include "session_table.h"
+#include "fec.h"
+#include "fec_kernels.h"
+#include "nack.h"
+#include "rtcp.h"
+#include "metrics.h"
+#include "rtp_codec.h"
+#include "uring.h"
 
-#define JITTER_BUFFER_SIZE 5000  // Hold up to 5000 packets in buffer
-#define JITTER_DELAY_MS 200      // Wait 100ms before playing out (handles reordering and jitter)
-#define MAX_JITTER_MS 200        // Maximum jitter tolerance
-#define MISSING_PACKET_TIMEOUT_MS 50
+#define MAX_RECV_BATCH 1024      // Upper bound for --batch
+#define MAX_BATCHES_PER_WAKEUP 16  // Receive batches before playout gets a turn
+#define STREAM_IDLE_TIMEOUT_MS 5000  // End of stream after this long without packets
+#define SESSION_IDLE_TIMEOUT_MS 5000  // Retire an SSRC after this long without packets
+#define MAX_WORKERS 64           // Upper bound for --workers
+#define RECEIVER_PORT 5000
+#define RECEIVE_BUFFER_BYTES (4 * 1024 * 1024)  // Room for a whole keyframe burst (capped by rmem_max)
+#define URING_ENTRIES 256        // io_uring submission queue (--io-uring)
+#define URING_CQ_ENTRIES 4096    // Completion queue: a CQE per datagram received between reaps
+#define URING_RECV_BUFFERS 1024  // Upper bound on pool slots lent to the multishot recvmsg
+#define URING_BUF_GROUP 0
+#define URING_TAG_RECV 1         // user_data of the multishot recvmsg (sink writes carry their batch)
+#define URING_TAG_CANCEL 2
+// A multishot recvmsg stores its result header, the source address and the
+// control data in front of each datagram: inside the slot's headroom
+#define URING_RECV_PREFIX (URING_RECVMSG_OUT_SIZE + sizeof(struct sockaddr_in) + CMSG_SPACE(sizeof(uint32_t)))
+_Static_assert(URING_RECV_PREFIX <= PACKET_SLOT_HEADROOM, "io_uring recvmsg prefix must fit the pool slot headroom");
+#define FEC_RECOVERY_WAIT_MS 200  // How long a gap first waits for parity before it is skipped
+#define FEC_MAX_RECOVERY_WAIT_MS 2000  // Upper bound as the wait adapts to late parity
+#define MAX_RECOVERED 32         // Packets rebuilt from one parity packet
+#define NACK_RECOVERY_WAIT_MS 200  // How long a gap waits for its retransmission
 
-// Jitter buffer entry
+// Options shared by all workers
 typedef struct {
-    unsigned char payload[CHUNK_SIZE];
-    int payload_size;
-    uint16_t seq_number;
-    uint32_t timestamp;
-    int is_last_packet;
-    int filled;
-    struct timeval arrival_time;
-} BufferEntry;
-
-// Statistics tracking
+    int output_to_stdout;
+    int discard_output;  // Play out without writing payloads (benchmarks)
+    int batch_size;      // Datagrams pulled per receive syscall
+    int pool_size;       // Packet buffers per worker
+    int max_sessions;    // Concurrent SSRCs per worker
+    int num_workers;
+    int pin_workers;     // Pin worker i to CPU i
+    int fec;             // Keep a FEC window for every stream from its first packet
+    int nack;            // Request missing packets from the sender (RTCP NACK)
+    int rtcp;            // Send receiver reports for every stream, not just those whose sender reports
+    int cc;              // Send RFC 8888 congestion control feedback for every stream
+    int io_uring;        // Receive and write through io_uring (--io-uring)
+    const char *metrics_name;  // Publish live counters to /dev/shm/rtp-NAME (--metrics)
+    MetricsSegment *metrics;
+    int primary_claimed; // Set by the first stream of any worker (atomic)
+} ReceiverConfig;
+
+// io_uring state of one worker. Free pool slots are lent to the kernel
+// through a provided-buffer ring, so the one multishot recvmsg fills them
+// without a syscall per batch; completions queue up here until the receive
+// loop takes them.
 typedef struct {
-    int total_packets;
-    int lost_packets;
-    int reordered_packets;
-    int duplicate_packets;
-    uint16_t last_seq;
-    int first_packet;
-} RTPStats;
-
-// Jitter buffer
+    IoUring ring;
+    UringBufRing buffers;
+    int buffers_posted;      // Slots the kernel holds
+    int armed;               // The multishot recvmsg is outstanding
+    struct msghdr msg;       // Address and control sizes for the multishot recvmsg
+    int *ready_slots;        // Received datagrams not taken yet (ring of buffers.entries)
+    struct sockaddr_in *ready_addrs;
+    int ready_head;
+    int ready_count;
+    long no_buffers;         // Times the kernel found the buffer ring empty
+} ReceiverUring;
+
+// One receive worker: its own socket, packet pool, sessions and statistics.
+// With --workers N every worker binds port 5000 with SO_REUSEPORT and the
+// kernel's flow hash keeps each sender on one worker, so nothing is shared
+// on the packet path.
 typedef struct {
-    BufferEntry entries[JITTER_BUFFER_SIZE];
-    int head;  // Next sequence to play out
-    int tail;  // Last received sequence
-    uint16_t base_seq;  // First sequence number received
-    int initialized;
-    int buffer_count;  // Number of filled slots
-    long max_jitter_us;  // Maximum observed jitter (microseconds)
-    long avg_jitter_us;  // Average jitter (RFC 3550 calculation)
-    int jitter_samples;  // Number of jitter measurements
-    struct timeval last_arrival_time;  // Time of last packet arrival
-    uint32_t last_timestamp;  // RTP timestamp of last packet
-} JitterBuffer;
+    ReceiverConfig *config;
+    int id;
+    int sockfd;
+    pthread_t thread;
+    PacketPool pool;
+    SessionTable sessions;
+    int has_primary;         // This worker writes the first stream to reconstructed_vid.mp4 / stdout
+    uint32_t primary_ssrc;
+    int sessions_opened;
+    int sessions_rejected;   // Packets dropped because the session table was full
+    uint32_t rtcp_ssrc;      // Sender SSRC of this worker's RTCP feedback
+    long nacks_sent;         // NACK packets
+    long rtx_unassociated;   // Retransmissions no stream could be matched to
+    char cname[96];          // RTCP canonical name of this worker
+    long reports_sent;       // RTCP receiver reports
+    long sender_reports;     // RTCP sender reports received
+    long feedback_sent;      // RTCP congestion control feedback packets
+    uint32_t kernel_drops;   // Datagrams the kernel dropped on a full socket queue (SO_RXQ_OVFL)
+    long malformed;          // Datagrams rtp_parse rejected
+    ReceiverUring *uring;    // NULL on the recvmmsg/epoll path
+    long wait_calls;         // Syscalls spent waiting (epoll_wait, timerfd)
+    long recv_calls;         // recvmsg/recvmmsg calls
+    long write_calls;        // writev calls of retired streams
+    long uring_enters;       // io_uring_enter calls
+    long uring_no_buffers;
+    RTPStats totals;         // Statistics of retired sessions
+    long total_bytes;
+    long batches_received;
+    long batched_packets;
+    int64_t first_packet_us; // Receive window, for the throughput figure
+    int64_t last_packet_us;
+} Receiver;
 
 // Function prototypes
-void init_jitter_buffer(JitterBuffer *jb);
-int add_to_jitter_buffer(JitterBuffer *jb, unsigned char *payload, int payload_size, 
-                         uint16_t seq, uint32_t timestamp, int is_last, RTPStats *stats);
-int get_from_jitter_buffer(JitterBuffer *jb, unsigned char *payload, int *payload_size, int *is_last, int force_flush);
-void print_statistics(RTPStats *stats);
+int receive_packet_batch(int sockfd, PacketPool *pool, int *slots, int batch_size,
+                         struct sockaddr_in *addrs, uint32_t *kernel_drops);
+void read_kernel_drops(struct msghdr *msg, uint32_t *kernel_drops);
+int open_receiver_socket(int reuse_port);
+ReceiverUring *open_receiver_uring(Receiver *rx);
+void close_receiver_uring(Receiver *rx);
+void refill_receive_buffers(Receiver *rx);
+void reap_uring_completions(Receiver *rx);
+void reap_sink_completions(void *arg);
+void finish_uring_writes(Receiver *rx);
+int receive_uring_batch(Receiver *rx, int *slots, int batch_size, struct sockaddr_in *addrs);
+int wait_receiver_uring(Receiver *rx, int64_t deadline_us);
+void *receiver_worker(void *arg);
+Session *open_session(Receiver *rx, uint32_t ssrc, int payload_type);
+void write_session_payload(Receiver *rx, Session *session, int slot, int size);
+void play_out_session(Receiver *rx, Session *session);
+void schedule_session(Receiver *rx, Session *session);
+void drain_session(Receiver *rx, Session *session);
+void close_session(Receiver *rx, Session *session, int print_report);
+int enable_session_fec(Receiver *rx, Session *session);
+void receive_fec_packet(Receiver *rx, int slot, Session **touched, int *touched_count);
+void receive_rtx_packet(Receiver *rx, int slot, RTPHeader *header, Session **touched, int *touched_count);
+void send_session_nacks(Receiver *rx, Session *session);
+void receive_rtcp_packet(Receiver *rx, unsigned char *packet, int length);
+void enable_session_reports(Session *session);
+void schedule_session_report(Session *session, int64_t now);
+void send_session_report(Receiver *rx, Session *session);
+void send_session_feedback(Receiver *rx, Session *session);
+void publish_session_metrics(Session *session, int64_t now);
+void print_session_report(Receiver *rx, Session *session);
 
 int main(int argc, char *argv[]) {
-    int output_to_stdout = 0;
+    ReceiverConfig config;
+    memset(&config, 0, sizeof(config));
+    config.batch_size = 1;
+    config.pool_size = DEFAULT_POOL_SIZE;
+    config.max_sessions = DEFAULT_MAX_SESSIONS;
+    config.num_workers = 1;
+    int log_level = LOG_LEVEL_INFO;
     
     // Parse command line arguments
-    if (argc > 1 && strcmp(argv[1], "--stdout") == 0) {
-        output_to_stdout = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stdout") == 0) {
+            config.output_to_stdout = 1;
+        } else if (strcmp(argv[i], "--discard") == 0) {
+            config.discard_output = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            config.batch_size = atoi(argv[++i]);
+            if (config.batch_size < 1 || config.batch_size > MAX_RECV_BATCH) {
+                fprintf(stderr, "Batch size must be between 1 and %d\n", MAX_RECV_BATCH);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+            config.pool_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+            config.max_sessions = atoi(argv[++i]);
+            if (config.max_sessions < 1) {
+                fprintf(stderr, "Max sessions must be at least 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            config.num_workers = atoi(argv[++i]);
+            if (config.num_workers < 1 || config.num_workers > MAX_WORKERS) {
+                fprintf(stderr, "Workers must be between 1 and %d\n", MAX_WORKERS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            config.pin_workers = 1;
+        } else if (strcmp(argv[i], "--fec") == 0) {
+            config.fec = 1;
+        } else if (strcmp(argv[i], "--nack") == 0) {
+            config.nack = 1;
+        } else if (strcmp(argv[i], "--rtcp") == 0) {
+            config.rtcp = 1;
+        } else if (strcmp(argv[i], "--cc") == 0) {
+            config.cc = 1;
+        } else if (strcmp(argv[i], "--io-uring") == 0) {
+            config.io_uring = 1;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            config.metrics_name = argv[++i];
+            if (strlen(config.metrics_name) >= METRICS_NAME_MAX || strchr(config.metrics_name, '/')) {
+                fprintf(stderr, "Metrics name must be shorter than %d characters, without '/'\n", METRICS_NAME_MAX);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = log_parse_level(argv[++i]);
+            if (log_level < 0) {
+                fprintf(stderr, "Log level must be one of error, warn, info, debug\n");
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--stdout | --discard] [--batch N] [--pool SLOTS] [--max-sessions N] "
+                    "[--workers N] [--pin] [--fec] [--nack] [--rtcp] [--cc] [--io-uring] [--metrics NAME] [--log-level LEVEL]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (config.pool_size <= config.batch_size) {
+        fprintf(stderr, "Pool size must be larger than the batch size (%d)\n", config.batch_size);
+        return 1;
     }
     
-    // Create UDP socket
-    int sockfd;
-    struct sockaddr_in server_addr, client_addr;
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    // Every stream has its own output file: allow as many descriptors as we are permitted
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    if (config.metrics_name) {
+        config.metrics = metrics_create(config.metrics_name, METRICS_ROLE_RECEIVER, config.num_workers);
+        if (!config.metrics) return 1;
+    }
+
+    // Set up all workers before any thread starts, so a bind failure exits cleanly
+    srand(time(NULL) ^ getpid());  // Only for the RTCP interval jitter; SSRCs come from getrandom
+    char host[48];
+    if (gethostname(host, sizeof(host)) < 0) strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+    Receiver *workers = (Receiver *)calloc(config.num_workers, sizeof(Receiver));
+    for (int w = 0; w < config.num_workers; w++) {
+        Receiver *rx = &workers[w];
+        rx->config = &config;
+        rx->id = w;
+        rx->rtcp_ssrc = rtp_random32();
+        snprintf(rx->cname, sizeof(rx->cname), "receiver-%d.%d@%s", (int)getpid(), w, host);
+        rx->sockfd = open_receiver_socket(config.num_workers > 1);
+        if (rx->sockfd < 0) {
+            return 1;
+        }
+
+        // Packets are received straight into pool slots and handed through the jitter buffers
+        if (packet_pool_init(&rx->pool, config.pool_size) < 0) {
+            fprintf(stderr, "Failed to allocate packet pool (%d slots)\n", config.pool_size);
+            return 1;
+        }
+
+        // One session (jitter buffer, statistics, output) per SSRC, created on its first packet
+        if (session_table_init(&rx->sessions, config.max_sessions) < 0) {
+            fprintf(stderr, "Failed to allocate session table (%d sessions)\n", config.max_sessions);
+            return 1;
+        }
+
+        if (config.io_uring) {
+            rx->uring = open_receiver_uring(rx);
+            if (!rx->uring) {
+                fprintf(stderr, "io_uring unavailable (%s) - using recvmmsg and writev\n", strerror(errno));
+                config.io_uring = 0;
+                for (int u = 0; u < w; u++) close_receiver_uring(&workers[u]);
+            }
+        }
+    }
+
+    // Parity kernels for streams that carry FEC (picked once, before any worker starts)
+    fec_kernels_init(NULL);
+
+    // Log records are formatted off the packet path and written by a background thread
+    log_init(log_level);
+
+    LOG_INFO("RTP Receiver started (port %d)\n", RECEIVER_PORT);
+    LOG_INFO("Output mode: %s\n", config.discard_output ? "discard" : config.output_to_stdout ? "stdout" : "file");
+    LOG_INFO("Receive batch size: %d\n", config.batch_size);
+    if (config.io_uring) {
+        LOG_INFO("I/O: io_uring (multishot recvmsg into %u pool slots, %s writes)\n",
+                 workers[0].uring->buffers.entries, workers[0].uring->ring.buffers_registered ? "fixed-buffer" : "plain");
+    }
+    LOG_INFO("Packet pool: %d slots of %d bytes\n", config.pool_size, PACKET_SLOT_SIZE);
+    LOG_INFO("Max concurrent streams (SSRCs): %d\n", config.max_sessions);
+    if (config.num_workers > 1) {
+        LOG_INFO("Workers: %d (SO_REUSEPORT%s)\n", config.num_workers, config.pin_workers ? ", pinned" : "");
+    }
+    LOG_INFO("FEC: %s (%s kernels)\n", config.fec ? "enabled for every stream" : "on first parity packet",
+             fec_kernel_name());
+    if (config.nack) {
+        LOG_INFO("NACK: requesting retransmissions (gaps wait up to %d ms)\n", NACK_RECOVERY_WAIT_MS);
+    }
+    LOG_INFO("RTCP: receiver reports %s\n", config.rtcp ? "for every stream" : "for streams whose sender reports");
+    if (config.cc) {
+        LOG_INFO("Congestion control: RFC 8888 feedback every %d ms\n", CC_FEEDBACK_INTERVAL_MS);
+    }
+    if (config.metrics) {
+        LOG_INFO("Metrics: /dev/shm/rtp-%s (read with ./rtpstat %s)\n", config.metrics_name, config.metrics_name);
+    }
+    LOG_INFO("Stream idle timeout set to %d seconds\n", STREAM_IDLE_TIMEOUT_MS / 1000);
+    LOG_INFO("Waiting for packets...\n\n");
+
+    for (int w = 0; w < config.num_workers; w++) {
+        if (pthread_create(&workers[w].thread, NULL, receiver_worker, &workers[w]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (int w = 0; w < config.num_workers; w++) {
+        pthread_join(workers[w].thread, NULL);
+    }
+
+    // Flush pending log records so the summary below comes last
+    log_shutdown();
+
+    // Per-stream reports, then the totals of every worker
+    RTPStats totals = {0};
+    long total_bytes = 0;
+    int sessions_opened = 0;
+    int sessions_reported = 0;  // Streams still open at the end; idle ones were retired without a report
+    int sessions_rejected = 0;
+    long batches_received = 0;
+    long batched_packets = 0;
+    long nacks_sent = 0;
+    long rtx_unassociated = 0;
+    long reports_sent = 0;
+    long sender_reports = 0;
+    long feedback_sent = 0;
+    long kernel_drops = 0;
+    long malformed = 0;
+    long wait_calls = 0;
+    long recv_calls = 0;
+    long write_calls = 0;
+    long uring_enters = 0;
+    long uring_no_buffers = 0;
+    int64_t first_packet_us = 0;
+    int64_t last_packet_us = 0;
+    for (int w = 0; w < config.num_workers; w++) {
+        Receiver *rx = &workers[w];
+        for (int i = 0; i < rx->sessions.max_sessions; i++) {
+            if (rx->sessions.sessions[i].jb) {
+                close_session(rx, &rx->sessions.sessions[i], 1);
+                sessions_reported++;
+            }
+        }
+        accumulate_statistics(&totals, &rx->totals);
+        total_bytes += rx->total_bytes;
+        sessions_opened += rx->sessions_opened;
+        sessions_rejected += rx->sessions_rejected;
+        batches_received += rx->batches_received;
+        nacks_sent += rx->nacks_sent;
+        rtx_unassociated += rx->rtx_unassociated;
+        reports_sent += rx->reports_sent;
+        sender_reports += rx->sender_reports;
+        feedback_sent += rx->feedback_sent;
+        kernel_drops += rx->kernel_drops;
+        malformed += rx->malformed;
+        wait_calls += rx->wait_calls;
+        recv_calls += rx->recv_calls;
+        write_calls += rx->write_calls;
+        uring_enters += rx->uring_enters;
+        uring_no_buffers += rx->uring_no_buffers;
+        batched_packets += rx->batched_packets;
+        if (rx->batched_packets > 0) {
+            if (first_packet_us == 0 || rx->first_packet_us < first_packet_us) first_packet_us = rx->first_packet_us;
+            if (rx->last_packet_us > last_packet_us) last_packet_us = rx->last_packet_us;
+        }
+    }
+
+    if (sessions_opened != 1 || sessions_reported != 1) {
+        fprintf(stderr, "\n=== All Streams ===\n");
+        fprintf(stderr, "Streams (SSRCs) seen: %d\n", sessions_opened);
+        if (sessions_rejected > 0) {
+            fprintf(stderr, "Packets dropped (session table full): %d\n", sessions_rejected);
+        }
+        print_statistics(&totals);
+        fprintf(stderr, "Total bytes received: %ld\n", total_bytes);
+    }
+    if (config.num_workers > 1) {
+        fprintf(stderr, "\n=== Workers ===\n");
+        for (int w = 0; w < config.num_workers; w++) {
+            fprintf(stderr, "Worker %d: %ld packets, %d streams\n",
+                    w, workers[w].batched_packets, workers[w].sessions_opened);
+        }
+    }
+    fprintf(stderr, "Receive batches: %ld (average fill %.2f/%d packets)\n",
+            batches_received,
+            batches_received > 0 ? (double)batched_packets / batches_received : 0.0,
+            config.batch_size);
+    if (config.nack) {
+        fprintf(stderr, "NACK packets sent: %ld (%ld retransmissions matched no stream)\n",
+                nacks_sent, rtx_unassociated);
+    }
+    if (reports_sent > 0 || sender_reports > 0) {
+        fprintf(stderr, "RTCP: %ld receiver reports sent, %ld sender reports received\n",
+                reports_sent, sender_reports);
+    }
+    if (config.cc) {
+        fprintf(stderr, "Congestion control feedback packets sent: %ld\n", feedback_sent);
+    }
+    if (kernel_drops > 0) {
+        fprintf(stderr, "Kernel receive queue drops: %ld (socket buffer full)\n", kernel_drops);
+    }
+    if (malformed > 0) {
+        fprintf(stderr, "Malformed packets dropped: %ld\n", malformed);
+    }
+    if (batched_packets > 0) {
+        long syscalls = wait_calls + recv_calls + write_calls + uring_enters;
+        fprintf(stderr, "I/O syscalls: %ld, %.3f per packet (%ld wait, %ld receive, %ld write, %ld io_uring_enter)\n",
+                syscalls, (double)syscalls / batched_packets, wait_calls, recv_calls, write_calls, uring_enters);
+    }
+    if (uring_no_buffers > 0) {
+        fprintf(stderr, "io_uring buffer ring ran dry: %ld times\n", uring_no_buffers);
+    }
+    if (last_packet_us > first_packet_us) {
+        fprintf(stderr, "Receive rate: %.0f packets/sec\n",
+                batched_packets * 1e6 / (last_packet_us - first_packet_us));
+    }
+    fflush(stderr);
+
+    // Clean up
+    for (int w = 0; w < config.num_workers; w++) {
+        close(workers[w].sockfd);
+        session_table_destroy(&workers[w].sessions);
+        packet_pool_destroy(&workers[w].pool);
+    }
+    free(workers);
+    if (config.metrics) metrics_destroy(config.metrics, config.metrics_name);
+
+    return 0;
+}
+
+// Create the non-blocking UDP socket bound to the receiver port. Workers share
+// the port through SO_REUSEPORT, which balances senders across their sockets.
+int open_receiver_socket(int reuse_port) {
+    struct sockaddr_in server_addr;
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("Socket creation failed");
-        return 1;
+        return -1;
+    }
+
+    if (reuse_port) {
+        int one = 1;
+        if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+            perror("SO_REUSEPORT failed");
+            close(sockfd);
+            return -1;
+        }
+    }
+
+    // H.264 keyframes arrive as one burst of a hundred or more packets,
+    // more than the default socket buffer holds
+    int rcvbuf = RECEIVE_BUFFER_BYTES;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        perror("SO_RCVBUF failed");
+    }
+#ifdef SO_RXQ_OVFL
+    // Every datagram then carries the socket's running count of queue overflows
+    int one = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0) {
+        perror("SO_RXQ_OVFL failed");
     }
+#endif
 
     // Set up server address
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(5000);
+    server_addr.sin_port = htons(RECEIVER_PORT);
     server_addr.sin_addr.s_addr = INADDR_ANY;
 
     // Bind socket
     if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("Bind failed");
-        return 1;
+        close(sockfd);
+        return -1;
     }
 
-    // Initialize jitter buffer and statistics
-    JitterBuffer jb;
-    RTPStats stats = {0};
-    stats.first_packet = 1;
-    init_jitter_buffer(&jb);
+    // The socket is driven by the event loop
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+    return sockfd;
+}
 
-    // Allocate memory for reconstructed video
-    unsigned char *reconstructed_video = (unsigned char *)malloc(10 * 1024 * 1024);  // 10MB buffer
-    int total_bytes = 0;
+// Set up io_uring for a worker: a provided-buffer ring the multishot recvmsg
+// fills with pool slots, and the pool slab registered for fixed-buffer writes
+// (plain writes if the memlock limit is too small for it). Returns NULL with
+// errno set if the kernel lacks any of it; the worker then stays on recvmmsg.
+ReceiverUring *open_receiver_uring(Receiver *rx) {
+    if (rx->pool.capacity > 65536) {
+        errno = ERANGE;  // Buffer ids, which are pool handles here, are 16 bits
+        return NULL;
+    }
+    ReceiverUring *ru = (ReceiverUring *)calloc(1, sizeof(ReceiverUring));
+    if (!ru) return NULL;
+    if (uring_init(&ru->ring, URING_ENTRIES, URING_CQ_ENTRIES) < 0) {
+        free(ru);
+        return NULL;
+    }
 
-    FILE *output_file = NULL;
-    if (output_to_stdout) {
-        output_file = stdout;
-        // stderr will naturally go to terminal (not piped)
+    // Lend at most an eighth of the pool: the rest is jitter buffer and FEC window room
+    unsigned entries = 1;
+    while (entries * 2 <= URING_RECV_BUFFERS && entries * 2 <= (unsigned)rx->pool.capacity / 8) entries *= 2;
+    ru->ready_slots = (int *)malloc(entries * sizeof(int));
+    ru->ready_addrs = (struct sockaddr_in *)malloc(entries * sizeof(struct sockaddr_in));
+    if (!ru->ready_slots || !ru->ready_addrs ||
+        uring_buf_ring_init(&ru->ring, &ru->buffers, URING_BUF_GROUP, entries) < 0) {
+        int errno_saved = errno;
+        free(ru->ready_slots);
+        free(ru->ready_addrs);
+        uring_close(&ru->ring);
+        free(ru);
+        errno = errno_saved;
+        return NULL;
     }
+    ru->msg.msg_namelen = sizeof(struct sockaddr_in);
+    ru->msg.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
 
-    fprintf(stderr, "RTP Receiver started (port 5000)\n");
-    fprintf(stderr, "Output mode: %s\n", output_to_stdout ? "stdout" : "file");
-    fprintf(stderr, "Waiting for packets...\n\n");
-    fflush(stderr);
+    if (uring_register_buffer(&ru->ring, rx->pool.slab, (size_t)rx->pool.capacity * PACKET_SLOT_STRIDE) < 0) {
+        perror("io_uring buffer registration failed (using plain writes)");
+    }
+    return ru;
+}
 
+// Stop receiving, complete every queued write and hand the sinks back to
+// writev; slots still lent to the kernel are left to packet_pool_destroy
+void close_receiver_uring(Receiver *rx) {
+    ReceiverUring *ru = rx->uring;
+    for (int i = 0; i < rx->sessions.max_sessions; i++) {
+        Session *session = &rx->sessions.sessions[i];
+        if (session->jb && session->has_sink) file_sink_use_uring(&session->sink, NULL, NULL, NULL);
+    }
+    if (ru->armed) uring_cancel(&ru->ring, URING_TAG_RECV, URING_TAG_CANCEL);
+    while (ru->ring.inflight > 0) {
+        if (uring_submit(&ru->ring, 1, -1) < 0 && errno != EINTR) {
+            perror("io_uring_enter failed");
+            break;
+        }
+        reap_uring_completions(rx);
+    }
+    while (ru->ready_count > 0) {
+        packet_pool_release(&rx->pool, ru->ready_slots[ru->ready_head]);
+        ru->ready_head = (ru->ready_head + 1) & (ru->buffers.entries - 1);
+        ru->ready_count--;
+    }
+
+    rx->uring_enters = ru->ring.enters;
+    rx->uring_no_buffers = ru->no_buffers;
+    uring_buf_ring_close(&ru->ring, &ru->buffers);
+    uring_close(&ru->ring);
+    free(ru->ready_slots);
+    free(ru->ready_addrs);
+    free(ru);
+    rx->uring = NULL;
+}
+
+// Lend free pool slots to the kernel until its buffer ring is full, keeping
+// room for what one parity packet can rebuild (but never lending none, or
+// receiving would stop), and re-arm the multishot recvmsg if it ended (it
+// does when the ring runs dry)
+void refill_receive_buffers(Receiver *rx) {
+    ReceiverUring *ru = rx->uring;
+    int added = 0;
+    // Received datagrams not taken yet count too: the ready queue has room for entries
+    while (ru->buffers_posted + ru->ready_count < (int)ru->buffers.entries && rx->pool.free_count > 0 &&
+           (rx->pool.free_count > MAX_RECOVERED || ru->buffers_posted == 0)) {
+        int slot = packet_pool_acquire(&rx->pool);
+        uring_buf_ring_add(&ru->buffers, packet_pool_data(&rx->pool, slot) - URING_RECV_PREFIX,
+                           URING_RECV_PREFIX + PACKET_SLOT_SIZE, (uint16_t)slot);
+        ru->buffers_posted++;
+        added++;
+    }
+    if (added > 0) uring_buf_ring_publish(&ru->buffers);
+    if (!ru->armed && ru->buffers_posted > 0 &&
+        uring_recvmsg_multishot(&ru->ring, rx->sockfd, &ru->msg, URING_BUF_GROUP, URING_TAG_RECV) == 0) {
+        ru->armed = 1;
+    }
+}
+
+// Queue received datagrams for receive_uring_batch and finish sink writes
+void reap_uring_completions(Receiver *rx) {
+    ReceiverUring *ru = rx->uring;
+    UringCompletion cqe;
+    while (uring_peek(&ru->ring, &cqe)) {
+        if (cqe.user_data == URING_TAG_CANCEL) continue;
+        if (cqe.user_data != URING_TAG_RECV) {
+            file_sink_write_done(cqe.user_data, cqe.res);
+            continue;
+        }
+        if (!cqe.more) ru->armed = 0;
+        if (cqe.buffer_id < 0) {
+            // No datagram: the buffer ring ran dry, or the receive was cancelled or failed
+            if (cqe.res == -ENOBUFS) {
+                ru->no_buffers++;
+            } else if (cqe.res < 0 && cqe.res != -ECANCELED) {
+                fprintf(stderr, "io_uring recvmsg failed: %s\n", strerror(-cqe.res));
+            }
+            continue;
+        }
+
+        int slot = cqe.buffer_id;
+        ru->buffers_posted--;
+        UringRecvmsg msg;
+        if (cqe.res < 0 ||
+            uring_recvmsg_parse(packet_pool_data(&rx->pool, slot) - URING_RECV_PREFIX, cqe.res, &ru->msg, &msg) < 0) {
+            packet_pool_release(&rx->pool, slot);
+            continue;
+        }
+        int tail = (ru->ready_head + ru->ready_count) & (ru->buffers.entries - 1);
+        ru->ready_slots[tail] = slot;
+        memset(&ru->ready_addrs[tail], 0, sizeof(struct sockaddr_in));
+        memcpy(&ru->ready_addrs[tail], msg.name, msg.namelen);
+        ru->ready_count++;
+        rx->pool.lengths[slot] = msg.payload_length;  // The payload sits where recvmmsg would have put it
+
+        struct msghdr control;
+        memset(&control, 0, sizeof(control));
+        control.msg_control = msg.control;
+        control.msg_controllen = msg.controllen;
+        read_kernel_drops(&control, &rx->kernel_drops);
+    }
+}
+
+// Reap callback of the worker's file sinks (arg is the Receiver)
+void reap_sink_completions(void *arg) {
+    reap_uring_completions((Receiver *)arg);
+}
+
+// Wait until no sink write is outstanding, so their slots are free again
+void finish_uring_writes(Receiver *rx) {
+    ReceiverUring *ru = rx->uring;
+    reap_uring_completions(rx);
+    while (ru->ring.inflight > ru->armed) {
+        if (uring_submit(&ru->ring, 1, -1) < 0 && errno != EINTR) {
+            perror("io_uring_enter failed");
+            return;
+        }
+        reap_uring_completions(rx);
+    }
+}
+
+// Take up to batch_size received datagrams. Returns -1 with errno EAGAIN if
+// none arrived since the last call.
+int receive_uring_batch(Receiver *rx, int *slots, int batch_size, struct sockaddr_in *addrs) {
+    ReceiverUring *ru = rx->uring;
+    reap_uring_completions(rx);
+    int count = 0;
+    while (count < batch_size && ru->ready_count > 0) {
+        slots[count] = ru->ready_slots[ru->ready_head];
+        addrs[count] = ru->ready_addrs[ru->ready_head];
+        ru->ready_head = (ru->ready_head + 1) & (ru->buffers.entries - 1);
+        ru->ready_count--;
+        count++;
+    }
+    if (count == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return count;
+}
+
+// io_uring counterpart of event_loop_wait: submit the refills and writes
+// queued since the last call and sleep until a completion arrives or the
+// deadline passes, all in one io_uring_enter. Returns -1 on error.
+int wait_receiver_uring(Receiver *rx, int64_t deadline_us) {
+    ReceiverUring *ru = rx->uring;
+    reap_uring_completions(rx);
+    refill_receive_buffers(rx);
+
+    int64_t timeout_us = deadline_us - jitter_now_us();
+    int result;
+    if (ru->ready_count > 0 || timeout_us <= 0) {
+        result = uring_submit(&ru->ring, 0, -1);
+    } else {
+        // Sink writes complete within microseconds: wait for them as well as
+        // the next datagram, so their completions do not each cost a wakeup
+        unsigned writes = (unsigned)(ru->ring.inflight - ru->armed);
+        result = uring_submit(&ru->ring, writes + 1, timeout_us);
+    }
+    if (result < 0 && errno != ETIME && errno != EINTR) {
+        perror("io_uring_enter failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Receive loop of one worker. Returns once its socket has been idle for
+// STREAM_IDLE_TIMEOUT_MS; the sessions it still holds are drained but left
+// open so main can report them.
+void *receiver_worker(void *arg) {
+    Receiver *rx = (Receiver *)arg;
+    int batch_size = rx->config->batch_size;
     int stream_ended = 0;
-    unsigned char recv_payload[CHUNK_SIZE];
-    
-    // Set socket timeout for end-of-stream detection
-    struct timeval timeout;
-    timeout.tv_sec = 5;   // 5 seconds timeout
-    timeout.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+#ifdef __linux__
+    if (rx->config->pin_workers) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(rx->id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            LOG_WARN("[WORKER %d] Could not pin to CPU %d\n", rx->id, rx->id);
+        }
+    }
+#endif
+
+    // Pool handles filled by one syscall per batch
+    int *batch_slots = (int *)malloc(batch_size * sizeof(int));
+    struct sockaddr_in *batch_addrs = (struct sockaddr_in *)malloc(batch_size * sizeof(struct sockaddr_in));
+    // Sessions that received packets in the current wakeup
+    Session **touched = (Session **)malloc(rx->sessions.max_sessions * sizeof(Session *));
     
-    fprintf(stderr, "Stream timeout set to 5 seconds\n");
-    fflush(stderr);
+    // A timer armed for the earliest session deadline (playout, loss skip or
+    // idle retirement) lets playout happen while the network is quiet.
+    EventLoop loop;
+    if (event_loop_init(&loop) < 0) {
+        free(batch_slots);
+        free(batch_addrs);
+        free(touched);
+        return NULL;
+    }
+    int sock_index = event_loop_add_fd(&loop, rx->sockfd);
+    int64_t last_packet_us = jitter_now_us();
     
-    // Receive loop
+    // Event loop
     while (!stream_ended) {
         int payload_size;
         int is_last_packet;
+        int touched_count = 0;
         
-        fprintf(stderr, "[DEBUG] Waiting for packet...\n");
-        fflush(stderr);
+        // Sleep until a packet arrives, the earliest session deadline, or the idle timeout
+        int64_t idle_deadline = last_packet_us + STREAM_IDLE_TIMEOUT_MS * 1000L;
+        int64_t deadline = idle_deadline;
+        Session *earliest = session_table_earliest(&rx->sessions);
+        if (earliest && earliest->deadline_us < deadline) deadline = earliest->deadline_us;
         
-        // Receive packet (this internally handles RTP header parsing)
-        unsigned char packet[RTP_HEADER_SIZE + CHUNK_SIZE];
-        socklen_t addr_len = sizeof(client_addr);
-        int n = recvfrom(sockfd, packet, RTP_HEADER_SIZE + CHUNK_SIZE, 0, 
-                        (struct sockaddr *)&client_addr, &addr_len);
+        LOG_DEBUG("[DEBUG] Waiting for packet or deadline...\n");
+        int events;
+        if (rx->uring) {
+            // One io_uring_enter submits the refills and writes queued since the last one
+            events = wait_receiver_uring(rx, deadline) < 0 ? -1 : EVENT_FD(sock_index);
+        } else {
+            events = event_loop_wait(&loop, deadline);
+        }
+        if (events < 0) break;
         
-        // Check for timeout (end of stream)
-        if (n < 0) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                fprintf(stderr, "[STREAM] No packets received for 5 seconds - stream ended\n");
-                fflush(stderr);
-                stream_ended = 1;
-                break;
+        // Pull everything queued on the socket, a batch at a time
+        for (int round = 0; (events & EVENT_FD(sock_index)) && round < MAX_BATCHES_PER_WAKEUP; round++) {
+            // The jitter buffers hold every pool slot: play out the most urgent stream early.
+            // With io_uring the slots refill the kernel's buffer ring instead of a batch.
+            int forced_slot, forced_size, forced_last, forced_skipped = 0;
+            ReceiverUring *ru = rx->uring;
+            int wanted = ru ? (int)ru->buffers.entries - ru->buffers_posted - ru->ready_count + MAX_RECOVERED
+                            : batch_size;
+            int forced_writes = 0;  // Slots freed once their io_uring writes complete
+            while (rx->pool.free_count + forced_writes < wanted) {
+                Session *victim = session_table_earliest(&rx->sessions);
+                if (!victim || !drain_jitter_buffer_head(victim->jb, &forced_slot, &forced_size,
+                                                         &forced_last, &forced_skipped)) {
+                    break;
+                }
+                write_session_payload(rx, victim, forced_slot, forced_size);
+                if (victim->has_sink) file_sink_flush(&victim->sink);  // Free the slot right away
+                if (rx->uring && victim->has_sink) forced_writes++;
+                schedule_session(rx, victim);
+            }
+            if (forced_writes > 0) finish_uring_writes(rx);
+            if (rx->pool.free_count == 0) {
+                LOG_WARN("[POOL] Packet pool exhausted - resetting jitter buffers\n");
+                for (int i = 0; i < rx->sessions.max_sessions; i++) {
+                    if (rx->sessions.sessions[i].jb) reset_jitter_buffer(rx->sessions.sessions[i].jb);
+                    if (rx->sessions.sessions[i].fec) fec_decoder_reset(rx->sessions.sessions[i].fec);
+                }
+            }
+            
+            // Receive up to batch_size packets straight into pool slots (RTP headers are parsed below)
+            int count;
+            if (rx->uring) {
+                count = receive_uring_batch(rx, batch_slots, batch_size, batch_addrs);
             } else {
-                perror("recvfrom error");
-                break;
+                count = receive_packet_batch(rx->sockfd, &rx->pool, batch_slots, batch_size, batch_addrs,
+                                             &rx->kernel_drops);
+                rx->recv_calls++;
+            }
+            if (count < 0) {
+                if (errno != EWOULDBLOCK && errno != EAGAIN) {
+                    perror("recvfrom error");
+                    stream_ended = 1;
+                }
+                break;  // Socket queue is empty
+            }
+            last_packet_us = jitter_now_us();
+            if (rx->batched_packets == 0) rx->first_packet_us = last_packet_us;
+            rx->last_packet_us = last_packet_us;
+            rx->batches_received++;
+            rx->batched_packets += count;
+            if (rx->config->metrics) {
+                METRICS_SET(rx->config->metrics, worker_packets[rx->id], rx->batched_packets);
+                METRICS_SET(rx->config->metrics, worker_kernel_drops[rx->id], rx->kernel_drops);
+            }
+            
+            // Insert the whole batch before trying to play anything out
+            for (int p = 0; p < count; p++) {
+                int slot = batch_slots[p];
+                unsigned char *packet = packet_pool_data(&rx->pool, slot);
+                int n = rx->pool.lengths[slot];
+                
+                LOG_DEBUG("[DEBUG] Received %d bytes\n", n);
+                
+                if (n < RTP_HEADER_SIZE) {
+                    packet_pool_release(&rx->pool, slot);
+                    continue;
+                }
+                
+                // RTCP shares the port: sender reports feed our receiver reports
+                if (rtcp_is_rtcp(packet, n)) {
+                    receive_rtcp_packet(rx, packet, n);
+                    packet_pool_release(&rx->pool, slot);
+                    continue;
+                }
+                
+                // Full header parse: CSRCs, extension and padding are validated here
+                RtpPacketView view;
+                int parsed = rtp_parse(packet, n, &view);
+                if (parsed != RTP_PARSE_OK) {
+                    LOG_DEBUG("[DEBUG] Dropping malformed packet: %s\n", rtp_parse_error(parsed));
+                    rx->malformed++;
+                    packet_pool_release(&rx->pool, slot);
+                    continue;
+                }
+                // Everything downstream expects the payload right after a 12-byte
+                // header: move it down over CSRCs/extension and cut the padding
+                if (view.header_size != RTP_HEADER_SIZE || view.padding) {
+                    memmove(packet + RTP_HEADER_SIZE, view.payload, view.payload_size);
+                    packet[0] &= 0xC0;  // Clear P, X and CC
+                    rx->pool.lengths[slot] = RTP_HEADER_SIZE + view.payload_size;
+                }
+                RTPHeader header = { .V = RTP_VERSION, .M = view.marker, .PT = view.payload_type,
+                                     .seq = view.seq, .timestamp = view.timestamp, .ssrc = view.ssrc };
+                
+                payload_size = view.payload_size;
+                is_last_packet = header.M;
+                
+                LOG_DEBUG("[DEBUG] Packet ssrc=0x%08x seq=%u, M=%d, payload=%d bytes\n",
+                          header.ssrc, header.seq, header.M, payload_size);
+                
+                // Parity travels on its own SSRC: route it to the stream it protects
+                if (header.PT == RTP_PT_FEC) {
+                    receive_fec_packet(rx, slot, touched, &touched_count);
+                    continue;
+                }
+                // So do retransmissions, which answer our NACKs
+                if (header.PT == RTP_PT_RTX) {
+                    receive_rtx_packet(rx, slot, &header, touched, &touched_count);
+                    continue;
+                }
+                
+                // Demultiplex by SSRC: each stream has its own jitter buffer and statistics
+                Session *session = session_table_lookup(&rx->sessions, header.ssrc);
+                if (!session) {
+                    session = open_session(rx, header.ssrc, header.PT);
+                    if (!session) {
+                        rx->sessions_rejected++;
+                        packet_pool_release(&rx->pool, slot);
+                        continue;
+                    }
+                }
+                session->last_packet_us = last_packet_us;
+                session->peer = batch_addrs[p];
+                rtcp_reception_update(&session->reception, header.seq, payload_size, last_packet_us);
+                if (session->cc) cc_arrival_log_add(session->cc, header.seq, last_packet_us);
+                if (!session->touched) {
+                    session->touched = 1;
+                    touched[touched_count++] = session;
+                }
+                
+                // Hand the slot to the jitter buffer (it keeps ownership unless rejected);
+                // the FEC window keeps its own reference for rebuilding lost neighbours
+                if (add_to_jitter_buffer(session->jb, slot, payload_size, header.seq,
+                                         header.timestamp, is_last_packet, &session->stats) < 0) {
+                    packet_pool_release(&rx->pool, slot);
+                } else if (session->fec) {
+                    fec_decoder_add_media(session->fec, slot);
+                }
+                
+                // M=1 marks end of FRAME, not end of stream
+                if (is_last_packet) {
+                    LOG_DEBUG("[FRAME] End of frame marker (M=1) at seq=%u, ts=%u\n", header.seq, header.timestamp);
+                }
             }
+            if (count < batch_size) break;  // Took the last queued datagrams
         }
         
-        fprintf(stderr, "[DEBUG] Received %d bytes\n", n);
-        fflush(stderr);
-        
-        if (n < RTP_HEADER_SIZE) continue;
-        
-        // Manually unpack header to get sequence number and timestamp
-        RTPHeader header;
-        unpack_rtp_header(packet, &header);
-        
-        payload_size = n - RTP_HEADER_SIZE;
-        memcpy(recv_payload, packet + RTP_HEADER_SIZE, payload_size);
-        is_last_packet = header.M;
-        
-        fprintf(stderr, "[DEBUG] Packet seq=%u, M=%d, payload=%d bytes\n", header.seq, header.M, payload_size);
-        fflush(stderr);
-        
-        // Add to jitter buffer
-        add_to_jitter_buffer(&jb, recv_payload, payload_size, header.seq, 
-                            header.timestamp, is_last_packet, &stats);
-        
-        // M=1 marks end of FRAME, not end of stream
-        if (is_last_packet) {
-            fprintf(stderr, "[FRAME] End of frame marker (M=1) at seq=%u, ts=%u\n", header.seq, header.timestamp);
-            fflush(stderr);
+        // Play out the streams that just received packets (once per wakeup)
+        for (int i = 0; i < touched_count; i++) {
+            touched[i]->touched = 0;
+            play_out_session(rx, touched[i]);
         }
         
-        // Try to retrieve packets from jitter buffer in order (normal operation)
-        unsigned char ordered_payload[CHUNK_SIZE];
-        int ordered_size;
-        int ordered_last;
-        
-        int packets_retrieved = 0;
-        while (get_from_jitter_buffer(&jb, ordered_payload, &ordered_size, &ordered_last, 0)) {
-            packets_retrieved++;
-            fprintf(stderr, "[DEBUG] Retrieved packet from buffer (count=%d, last=%d)\n", packets_retrieved, ordered_last);
-            fflush(stderr);
-            
-            // Write payload to output
-            if (output_to_stdout) {
-                fwrite(ordered_payload, 1, ordered_size, output_file);
-                fflush(output_file);
+        // End of stream: the idle timer fired with nothing received
+        int64_t now = jitter_now_us();
+        if (now >= last_packet_us + STREAM_IDLE_TIMEOUT_MS * 1000L) {
+            if (rx->config->num_workers > 1) {
+                LOG_INFO("[STREAM] Worker %d: no packets received for %d seconds - stream ended\n",
+                         rx->id, STREAM_IDLE_TIMEOUT_MS / 1000);
             } else {
-                memcpy(reconstructed_video + total_bytes, ordered_payload, ordered_size);
+                LOG_INFO("[STREAM] No packets received for %d seconds - stream ended\n", STREAM_IDLE_TIMEOUT_MS / 1000);
             }
-            
-            total_bytes += ordered_size;
+            stream_ended = 1;
+            break;  // Remaining sessions are drained below and reported by main
         }
         
-        fprintf(stderr, "[DEBUG] Retrieved %d packets this iteration. stream_ended=%d\n", packets_retrieved, stream_ended);
-        fflush(stderr);
+        // Play out (or retire) every stream whose deadline has passed
+        Session *due;
+        while ((due = session_table_earliest(&rx->sessions)) && due->deadline_us <= now) {
+            if (now >= due->last_packet_us + SESSION_IDLE_TIMEOUT_MS * 1000L) {
+                // Stream went quiet: flush what it still holds and retire it
+                drain_session(rx, due);
+                close_session(rx, due, 0);
+            } else {
+                play_out_session(rx, due);
+            }
+        }
     }
+    rx->wait_calls = loop.syscalls;
+    event_loop_close(&loop);
     
-    fprintf(stderr, "[DEBUG] Exited receive loop\n");
-    fflush(stderr);
+    LOG_DEBUG("[DEBUG] Exited receive loop\n");
     
-    // Drain remaining packets from jitter buffer
-    fprintf(stderr, "[STREAM] Draining jitter buffer (skipping missing packets)...\n");
-    fflush(stderr);
+    // Drain remaining packets from every jitter buffer
+    LOG_INFO("[STREAM] Draining jitter buffers (skipping missing packets)...\n");
+    for (int i = 0; i < rx->sessions.max_sessions; i++) {
+        if (rx->sessions.sessions[i].jb) drain_session(rx, &rx->sessions.sessions[i]);
+    }
+    // Queued writes refer to pool slots and open files: complete them and hand
+    // the sinks back to writev before main closes them
+    if (rx->uring) close_receiver_uring(rx);
+
+    free(batch_slots);
+    free(batch_addrs);
+    free(touched);
+    return NULL;
+}
+
+// Create the per-stream state for a new SSRC. Returns NULL if the table is full.
+Session *open_session(Receiver *rx, uint32_t ssrc, int payload_type) {
+    Session *session = session_table_insert(&rx->sessions, ssrc);
+    if (!session) {
+        LOG_WARN("[SESSION] Table full (%d streams) - dropping ssrc=0x%08x\n", rx->sessions.max_sessions, ssrc);
+        return NULL;
+    }
     
-    unsigned char drain_payload[CHUNK_SIZE];
-    int drain_size, drain_last;
-    int drained_count = 0;
-    int skipped_count = 0;
-    int max_drain_attempts = JITTER_BUFFER_SIZE;  // Prevent infinite loop
+    // Jitter buffers are heap allocated, far too large for the stack
+    session->jb = (JitterBuffer *)malloc(sizeof(JitterBuffer));
+    if (!session->jb) {
+        session_table_remove(&rx->sessions, session);
+        return NULL;
+    }
+    init_jitter_buffer(session->jb, &rx->pool);
+    session->stats.first_packet = 1;
+    session->payload_type = (uint8_t)payload_type;
+    session->is_h264 = (payload_type == RTP_PT_H264);
+    h264_depacketizer_init(&session->depacketizer);
+    const char *extension = session->is_h264 ? "h264" : "mp4";
     
-    for (int attempt = 0; attempt < max_drain_attempts && jb.buffer_count > 0; attempt++) {
-        uint16_t expected_seq = (jb.base_seq + jb.head) & 0xFFFF;
-        int buffer_idx = jb.head % JITTER_BUFFER_SIZE;
-        
-        if (jb.entries[buffer_idx].filled) {
-            // Packet available - drain it
-            if (get_from_jitter_buffer(&jb, drain_payload, &drain_size, &drain_last, 1)) {
-                drained_count++;
-                if (output_to_stdout) {
-                    fwrite(drain_payload, 1, drain_size, output_file);
-                    fflush(output_file);
-                } else {
-                    memcpy(reconstructed_video + total_bytes, drain_payload, drain_size);
-                }
-                total_bytes += drain_size;
+    // In-order payloads stream straight to the output as they are played out, so
+    // the file is usable while the stream is still running. The first stream keeps
+    // the classic output (stdout or reconstructed_vid.mp4), later ones get a file per SSRC.
+    // H.264 streams are written as a raw Annex-B .h264 file that plays while it grows.
+    // (stderr will naturally go to terminal when stdout is piped)
+    const char *path = NULL;
+    char name[64];
+    char primary_name[32];
+    int primary = !rx->has_primary &&
+                  !__atomic_exchange_n(&rx->config->primary_claimed, 1, __ATOMIC_ACQ_REL);
+    if (!primary) {
+        snprintf(name, sizeof(name), "reconstructed_vid_%08x.%s", ssrc, extension);
+        path = name;
+    } else if (!rx->config->output_to_stdout) {
+        snprintf(primary_name, sizeof(primary_name), "reconstructed_vid.%s", extension);
+        path = primary_name;
+    }
+    if (!rx->config->discard_output && file_sink_open(&session->sink, path, &rx->pool) == 0) {
+        session->has_sink = 1;
+        // Payloads then go out with the worker's next io_uring submission (files only, not stdout)
+        if (rx->uring) file_sink_use_uring(&session->sink, &rx->uring->ring, reap_sink_completions, rx);
+    }
+    if (primary) {
+        rx->has_primary = 1;
+        rx->primary_ssrc = ssrc;
+    }
+    
+    if (rx->config->fec) enable_session_fec(rx, session);
+    if (rx->config->rtcp) enable_session_reports(session);
+    if (rx->config->metrics) {
+        session->metrics = metrics_claim_stream(rx->config->metrics, ssrc, rx->id);
+        session->metrics_published_us = 0;
+        if (!session->metrics) LOG_WARN("[METRICS] No free slot for ssrc=0x%08x\n", ssrc);
+    }
+    if (rx->config->cc) {
+        session->cc = (CcArrivalLog *)calloc(1, sizeof(CcArrivalLog));
+        if (session->cc) session->cc->next_feedback_us = jitter_now_us() + CC_FEEDBACK_INTERVAL_MS * 1000L;
+    }
+    if (rx->config->nack) {
+        session->nack = (NackList *)malloc(sizeof(NackList));
+        if (session->nack) {
+            nack_list_init(session->nack);
+            session->jb->nack = session->nack;
+            if (session->jb->missing_timeout_ms < NACK_RECOVERY_WAIT_MS) {
+                session->jb->missing_timeout_ms = NACK_RECOVERY_WAIT_MS;
             }
+        }
+    }
+    
+    rx->sessions_opened++;
+    LOG_INFO("[SESSION] New stream ssrc=0x%08x (%d active)\n", ssrc, rx->sessions.count);
+    return session;
+}
+
+// Start keeping a FEC window for this stream. Gaps now wait long enough for
+// the parity of their block to arrive before playout skips them.
+int enable_session_fec(Receiver *rx, Session *session) {
+    session->fec = (FecDecoder *)malloc(sizeof(FecDecoder));
+    if (!session->fec) return -1;
+    fec_decoder_init(session->fec, &rx->pool);
+    if (session->jb->missing_timeout_ms < FEC_RECOVERY_WAIT_MS) {
+        session->jb->missing_timeout_ms = FEC_RECOVERY_WAIT_MS;
+    }
+    LOG_INFO("[FEC] Protecting stream ssrc=0x%08x\n", session->ssrc);
+    return 0;
+}
+
+// A parity packet: rebuild what it can of the stream it protects and slot the
+// recovered packets into that stream's jitter buffer. Parity never opens a
+// session of its own.
+void receive_fec_packet(Receiver *rx, int slot, Session **touched, int *touched_count) {
+    unsigned char *packet = packet_pool_data(&rx->pool, slot);
+    if (rx->pool.lengths[slot] < RTP_HEADER_SIZE + FEC_HEADER_SIZE) {
+        packet_pool_release(&rx->pool, slot);
+        return;
+    }
+    FecHeader fec_header;
+    fec_unpack_header(packet + RTP_HEADER_SIZE, &fec_header);
+    Session *session = session_table_lookup(&rx->sessions, fec_header.protected_ssrc);
+    if (!session || (!session->fec && enable_session_fec(rx, session) < 0)) {
+        packet_pool_release(&rx->pool, slot);
+        return;
+    }
+    
+    int recovered[MAX_RECOVERED];
+    int count = fec_decoder_add_parity(session->fec, slot, recovered, MAX_RECOVERED);
+    int too_late = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned char *rebuilt = packet_pool_data(&rx->pool, recovered[i]);
+        RTPHeader header;
+        unpack_rtp_header(rebuilt, &header);
+        int result = insert_recovered_packet(session->jb, recovered[i], rx->pool.lengths[recovered[i]] - RTP_HEADER_SIZE,
+                                             header.seq, header.timestamp, header.M);
+        if (result == 0) {
+            session->stats.lost_packets--;
+            session->stats.recovered_packets++;
         } else {
-            // Missing packet - skip it
-            fprintf(stderr, "[DRAIN] Skipping missing seq=%u\n", expected_seq);
-            fflush(stderr);
-            jb.head++;  // Move past missing packet
-            skipped_count++;
+            packet_pool_release(&rx->pool, recovered[i]);
+            if (result < 0) too_late++;
         }
     }
     
-    fprintf(stderr, "[STREAM] Drained %d packets, skipped %d missing, final occupancy: %d\n", 
-            drained_count, skipped_count, jb.buffer_count);
-    fflush(stderr);
+    // Playout gave up on a gap before its parity arrived: blocks span more
+    // time than we wait, so wait longer from now on
+    JitterBuffer *jb = session->jb;
+    if (too_late > 0 && jb->missing_timeout_ms < FEC_MAX_RECOVERY_WAIT_MS) {
+        jb->missing_timeout_ms += jb->missing_timeout_ms / 2;
+        if (jb->missing_timeout_ms > FEC_MAX_RECOVERY_WAIT_MS) jb->missing_timeout_ms = FEC_MAX_RECOVERY_WAIT_MS;
+        LOG_INFO("[FEC] ssrc=0x%08x: %d recovered packets arrived after playout skipped them - gaps now wait %d ms\n",
+                 session->ssrc, too_late, jb->missing_timeout_ms);
+    }
+    if (count > 0 && !session->touched) {
+        session->touched = 1;
+        touched[(*touched_count)++] = session;
+    }
+}
 
-    // Write to file if not stdout mode
-    if (!output_to_stdout) {
-        FILE *out = fopen("reconstructed_vid.mp4", "wb");
-        fwrite(reconstructed_video, 1, total_bytes, out);
-        fclose(out);
-        fprintf(stderr, "\nVideo saved to reconstructed_vid.mp4\n");
+// A retransmission (RFC 4588): strip the original sequence number, restore
+// the original header and slot the packet into its stream's jitter buffer.
+// The RTX SSRC is tied to a stream on its first packet, by the one stream
+// with an outstanding request for that sequence number (RFC 4588 section 5.3).
+void receive_rtx_packet(Receiver *rx, int slot, RTPHeader *header, Session **touched, int *touched_count) {
+    unsigned char *packet = packet_pool_data(&rx->pool, slot);
+    int length = rx->pool.lengths[slot];
+    if (length < RTP_HEADER_SIZE + RTX_OSN_SIZE) {
+        packet_pool_release(&rx->pool, slot);
+        return;
     }
+    uint16_t osn = (uint16_t)(packet[RTP_HEADER_SIZE] << 8 | packet[RTP_HEADER_SIZE + 1]);
 
-    fprintf(stderr, "\n=== RTP Statistics ===\n");
-    print_statistics(&stats);
-    fprintf(stderr, "Total bytes received: %d\n", total_bytes);
-    fprintf(stderr, "\n=== Jitter Buffer Statistics ===\n");
-    fprintf(stderr, "Maximum jitter observed: %.2f ms\n", jb.max_jitter_us / 1000.0);
-    fprintf(stderr, "Average jitter: %.2f ms\n", jb.avg_jitter_us / 1000.0);
-    fprintf(stderr, "Jitter measurements: %d\n", jb.jitter_samples);
-    fprintf(stderr, "Final buffer occupancy: %d packets\n", jb.buffer_count);
-    fflush(stderr);
+    Session *session = session_table_lookup(&rx->sessions, header->ssrc);
+    if (!session) {
+        Session *match = NULL;
+        int matches = 0;
+        for (int i = 0; i < rx->sessions.max_sessions && matches < 2; i++) {
+            Session *candidate = &rx->sessions.sessions[i];
+            if (candidate->jb && candidate->nack && !candidate->has_rtx_ssrc &&
+                nack_list_pending(candidate->nack, osn)) {
+                match = candidate;
+                matches++;
+            }
+        }
+        if (matches != 1 || session_table_alias(&rx->sessions, match, header->ssrc) < 0) {
+            rx->rtx_unassociated++;
+            packet_pool_release(&rx->pool, slot);
+            return;
+        }
+        session = match;
+        LOG_INFO("[NACK] Retransmissions for ssrc=0x%08x arrive on ssrc=0x%08x\n", session->ssrc, header->ssrc);
+    }
+    if (session->ssrc == header->ssrc) {
+        // Payload type 99 on the media SSRC itself: not ours to unwrap
+        packet_pool_release(&rx->pool, slot);
+        return;
+    }
 
-    // Clean up
-    close(sockfd);
-    free(reconstructed_video);
+    // Back to the original packet: the payload moves over the OSN
+    RTPHeader original = *header;
+    original.seq = osn;
+    original.ssrc = session->ssrc;
+    original.PT = session->payload_type;
+    memmove(packet + RTP_HEADER_SIZE, packet + RTP_HEADER_SIZE + RTX_OSN_SIZE, length - RTP_HEADER_SIZE - RTX_OSN_SIZE);
+    pack_rtp_header(&original, packet);
+    length -= RTX_OSN_SIZE;
+    rx->pool.lengths[slot] = length;
 
-    return 0;
+    int64_t now = jitter_now_us();
+    if (session->nack) nack_list_remove(session->nack, osn, now, 1);
+    int result = insert_recovered_packet(session->jb, slot, length - RTP_HEADER_SIZE,
+                                         osn, original.timestamp, original.M);
+    if (result == 0) {
+        session->stats.lost_packets--;
+        session->stats.retransmitted_packets++;
+        if (session->fec) fec_decoder_add_media(session->fec, slot);
+        session->last_packet_us = now;
+        if (!session->touched) {
+            session->touched = 1;
+            touched[(*touched_count)++] = session;
+        }
+    } else {
+        // Too late for playout, or the packet got here another way (reordering, FEC)
+        if (result < 0) session->stats.late_retransmissions++;
+        packet_pool_release(&rx->pool, slot);
+    }
 }
 
-void init_jitter_buffer(JitterBuffer *jb) {
-    memset(jb, 0, sizeof(JitterBuffer));
-    for (int i = 0; i < JITTER_BUFFER_SIZE; i++) {
-        jb->entries[i].filled = 0;
-    }
-    jb->initialized = 0;
-    jb->buffer_count = 0;
-    jb->max_jitter_us = 0;
-    jb->avg_jitter_us = 0;
-    jb->jitter_samples = 0;
-    jb->last_timestamp = 0;
-    memset(&jb->last_arrival_time, 0, sizeof(struct timeval));
+// Send one generic NACK for every missing packet that is due a (repeated) request
+void send_session_nacks(Receiver *rx, Session *session) {
+    uint16_t seqs[RTCP_NACK_MAX_SEQS];
+    int count = nack_list_due(session->nack, jitter_now_us(), seqs, RTCP_NACK_MAX_SEQS);
+    if (count == 0) return;
+
+    unsigned char packet[RTCP_MAX_PACKET];
+    int length = rtcp_pack_nack(packet, sizeof(packet), rx->rtcp_ssrc, session->ssrc, seqs, count);
+    if (length < 0) return;
+    if (sendto(rx->sockfd, packet, length, 0, (struct sockaddr *)&session->peer, sizeof(session->peer)) < 0) {
+        LOG_WARN("[NACK] sendto failed: %s\n", strerror(errno));
+        return;
+    }
+    rx->nacks_sent++;
+    LOG_DEBUG("[NACK] ssrc=0x%08x: requested %d packets from seq=%u\n", session->ssrc, count, seqs[0]);
 }
 
-int add_to_jitter_buffer(JitterBuffer *jb, unsigned char *payload, int payload_size,
-                         uint16_t seq, uint32_t timestamp, int is_last, RTPStats *stats) {
-    stats->total_packets++;
-    
-    // Initialize base sequence on first packet
-    if (!jb->initialized) {
-        jb->base_seq = seq;
-        jb->head = 0;
-        jb->tail = 0;
-        jb->initialized = 1;
-        stats->last_seq = seq - 1;
-        fprintf(stderr, "First packet: seq=%u\n", seq);
-        fflush(stderr);
+// An RTCP packet from a sender: remember its last SR for the LSR/DLSR of our
+// reports. A stream whose sender reports gets receiver reports back.
+void receive_rtcp_packet(Receiver *rx, unsigned char *packet, int length) {
+    RtcpReport report;
+    if (rtcp_unpack_report(packet, length, &report) < 0 || !report.is_sender_report) return;
+    Session *session = session_table_lookup(&rx->sessions, report.sender.ssrc);
+    if (!session || session->ssrc != report.sender.ssrc) return;
+
+    rtcp_reception_sender_report(&session->reception, &report.sender, jitter_now_us());
+    session->sender_reports++;
+    session->sender_packet_count = report.sender.packet_count;
+    rx->sender_reports++;
+    if (!session->reports) {
+        enable_session_reports(session);
+        schedule_session(rx, session);
     }
-    
-    // Detect loss and reordering
-    if (stats->first_packet) {
-        stats->first_packet = 0;
-    } else {
-        uint16_t expected_seq = stats->last_seq + 1;
-        if (seq != expected_seq) {
-            int16_t gap = (int16_t)(seq - expected_seq);  // Signed for negative detection
-            
-            if (gap > 0 && gap < 100) {
-                // Forward jump (potential loss or out-of-order arrival)
-                // Don't immediately count as loss - jitter buffer will handle it
-                fprintf(stderr, "[SEQ] Forward jump: expected seq=%u, got seq=%u (gap=%d)\n", 
-                       expected_seq, seq, gap);
-                fflush(stderr);
-                
-                // Mark as potential loss (jitter buffer will correct if packets arrive late)
-                stats->lost_packets += gap;
-                
-            } else if (gap < 0) {
-                // Backward jump - packet arrived LATE (reordering!)
-                stats->reordered_packets++;
-                stats->lost_packets--;  // Correct the false loss detection
-                fprintf(stderr, "[REORDER] seq=%u arrived late (expected %u)\n", seq, expected_seq);
-                fflush(stderr);
-                
-            } else if (gap >= 100) {
-                // Huge forward gap - definitely loss or wraparound
-                if (gap < 30000) {  // Not wraparound
-                    stats->lost_packets += gap;
-                    fprintf(stderr, "[LOSS] Large gap: expected seq=%u, got seq=%u (lost %d)\n", 
-                           expected_seq, seq, gap);
-                    fflush(stderr);
-                } else {
-                    // Likely sequence number wraparound or very late packet
-                    stats->reordered_packets++;
-                    fprintf(stderr, "[REORDER] seq=%u arrived very late (wraparound?)\n", seq);
-                    fflush(stderr);
-                }
-            }
-        }
+    LOG_DEBUG("[RTCP] ssrc=0x%08x: sender report, %u packets, %u octets\n",
+              report.sender.ssrc, report.sender.packet_count, report.sender.octet_count);
+}
+
+void enable_session_reports(Session *session) {
+    session->reports = 1;
+    session->reports_initial = 1;
+    session->avg_rtcp_size = RTCP_UDP_IP_OVERHEAD + 8 + 24 + 12 + 20;  // RR with one block, SDES
+    schedule_session_report(session, jitter_now_us());
+}
+
+// Next receiver report after the RFC 3550 interval, from the bandwidth the
+// stream has used so far (5% of it for RTCP, three quarters of that for us)
+void schedule_session_report(Session *session, int64_t now) {
+    RtcpReception *reception = &session->reception;
+    double bandwidth = 0;
+    if (reception->started && now > reception->first_us) {
+        bandwidth = (reception->octets + (double)reception->received * RTP_HEADER_SIZE) * 1e6 /
+                    (now - reception->first_us);
     }
-    
-    // Update last seen sequence (only if newer)
-    if (((int16_t)(seq - stats->last_seq)) > 0) {
-        stats->last_seq = seq;
+    double interval = rtcp_interval(2, 1, bandwidth * RTCP_BANDWIDTH_FRACTION, 0, session->avg_rtcp_size,
+                                    rtcp_reduced_min_interval(bandwidth), session->reports_initial);
+    session->next_report_us = now + (int64_t)(interval * 1e6);
+}
+
+// One receiver report (plus CNAME) about this stream back to its sender
+void send_session_report(Receiver *rx, Session *session) {
+    int64_t now = jitter_now_us();
+    schedule_session_report(session, now);
+    if (!session->reception.started) return;
+
+    // Jitter is kept in microseconds; reports carry timestamp units (90 kHz)
+    RtcpReportBlock block;
+    rtcp_reception_block(&session->reception, session->ssrc, (uint32_t)(session->jb->avg_jitter_us * 90 / 1000),
+                         now, &block);
+    unsigned char packet[RTCP_MAX_PACKET];
+    int length = rtcp_pack_report(packet, sizeof(packet), NULL, rx->rtcp_ssrc, &block, 1, rx->cname);
+    if (length < 0) return;
+    if (sendto(rx->sockfd, packet, length, 0, (struct sockaddr *)&session->peer, sizeof(session->peer)) < 0) {
+        LOG_WARN("[RTCP] sendto failed: %s\n", strerror(errno));
+        return;
     }
-    
-    // Calculate buffer index
-    int relative_seq = (seq - jb->base_seq) & 0xFFFF;
-    int buffer_idx = relative_seq % JITTER_BUFFER_SIZE;
-    
-    // Check for duplicate
-    if (jb->entries[buffer_idx].filled && jb->entries[buffer_idx].seq_number == seq) {
-        stats->duplicate_packets++;
-        fprintf(stderr, "Duplicate packet: seq=%u\n", seq);
-        fflush(stderr);
-        return -1;
+    session->avg_rtcp_size += (length + RTCP_UDP_IP_OVERHEAD - session->avg_rtcp_size) / 16;
+    session->reports_initial = 0;
+    session->reports_sent++;
+    rx->reports_sent++;
+    LOG_DEBUG("[RTCP] ssrc=0x%08x: receiver report, loss %u/256, %d lost in total, highest seq %u\n",
+              session->ssrc, block.fraction_lost, block.cumulative_lost, block.highest_seq);
+}
+
+// Arrival times of everything received since the last feedback, so the
+// sender can follow the queueing delay on the path
+void send_session_feedback(Receiver *rx, Session *session) {
+    int64_t now = jitter_now_us();
+    session->cc->next_feedback_us = now + CC_FEEDBACK_INTERVAL_MS * 1000L;
+
+    uint16_t begin_seq;
+    int64_t delays_us[RTCP_CCFB_MAX_REPORTS];
+    int count = cc_arrival_log_take(session->cc, now, &begin_seq, delays_us);
+    if (count == 0) return;
+    unsigned char packet[RTCP_MAX_PACKET];
+    int length = rtcp_pack_ccfb(packet, sizeof(packet), rx->rtcp_ssrc, session->ssrc, begin_seq, delays_us, count,
+                                rtcp_ntp_short(rtcp_ntp_now()));
+    if (length < 0) return;
+    if (sendto(rx->sockfd, packet, length, 0, (struct sockaddr *)&session->peer, sizeof(session->peer)) < 0) {
+        LOG_WARN("[CC] sendto failed: %s\n", strerror(errno));
+        return;
     }
-    
-    // Check for buffer overwrite (slot filled with different sequence)
-    if (jb->entries[buffer_idx].filled && jb->entries[buffer_idx].seq_number != seq) {
-        uint16_t overwritten_seq = jb->entries[buffer_idx].seq_number;
-        fprintf(stderr, "Buffer overflow: seq=%u overwrites seq=%u at idx=%d\n", 
-                seq, overwritten_seq, buffer_idx);
-        fflush(stderr);
-        // This is effectively a lost packet (buffer too small)
-        stats->lost_packets++;
+    session->cc->feedback_sent++;
+    rx->feedback_sent++;
+}
+
+// Requeue a session for its next playout/loss deadline or idle retirement
+void schedule_session(Receiver *rx, Session *session) {
+    int64_t deadline = jitter_buffer_next_deadline_us(session->jb);
+    if (session->nack) {
+        // A request that went unanswered is repeated on time even when no packets arrive
+        int64_t retry = nack_list_next_retry_us(session->nack);
+        if (retry >= 0 && (deadline < 0 || retry < deadline)) deadline = retry;
+    }
+    if (session->reports && (deadline < 0 || session->next_report_us < deadline)) {
+        deadline = session->next_report_us;
     }
+    if (session->cc && (deadline < 0 || session->cc->next_feedback_us < deadline)) {
+        deadline = session->cc->next_feedback_us;
+    }
+    int64_t idle = session->last_packet_us + SESSION_IDLE_TIMEOUT_MS * 1000L;
+    session->deadline_us = (deadline < 0 || deadline > idle) ? idle : deadline;
+    session_table_update_deadline(&rx->sessions, session);
+}
+
+// Hand one played-out payload to the stream's output; the slot is released once written
+void write_session_payload(Receiver *rx, Session *session, int slot, int size) {
+    if (!session->has_sink) {
+        packet_pool_release(&rx->pool, slot);
+    } else if (session->is_h264) {
+        h264_depacketize_slot(&session->depacketizer, &session->sink, slot, size);
+    } else {
+        file_sink_write_slot(&session->sink, slot, RTP_HEADER_SIZE, size);
+    }
+    session->total_bytes += size;
+}
+
+// Play out everything of this stream whose deadline has passed
+void play_out_session(Receiver *rx, Session *session) {
+    int ordered_slot;
+    int ordered_size;
+    int ordered_last;
     
-    // Calculate actual network jitter (RFC 3550 algorithm)
-    struct timeval arrival_time;
-    gettimeofday(&arrival_time, NULL);
+    // Ask for what went missing first, while the retransmission can still make playout
+    if (session->nack) send_session_nacks(rx, session);
+    if (session->reports && jitter_now_us() >= session->next_report_us) send_session_report(rx, session);
+    if (session->cc && jitter_now_us() >= session->cc->next_feedback_us) send_session_feedback(rx, session);
+    if (session->metrics && jitter_now_us() - session->metrics_published_us >= METRICS_INTERVAL_US) {
+        publish_session_metrics(session, jitter_now_us());
+    }
     
-    if (jb->jitter_samples > 0) {
-        // Calculate inter-arrival time (in microseconds)
-        long arrival_diff_us = (arrival_time.tv_sec - jb->last_arrival_time.tv_sec) * 1000000 +
-                               (arrival_time.tv_usec - jb->last_arrival_time.tv_usec);
-        
-        // Calculate RTP timestamp difference (convert to microseconds, RTP clock = 90kHz)
-        long timestamp_diff = ((long)timestamp - (long)jb->last_timestamp);
-        long timestamp_diff_us = (timestamp_diff * 1000000) / 90000;
-        
-        // Jitter = variance in inter-arrival times
-        long jitter_us = arrival_diff_us - timestamp_diff_us;
-        if (jitter_us < 0) jitter_us = -jitter_us;  // Absolute value
-        
-        // Update max jitter
-        if (jitter_us > jb->max_jitter_us) {
-            jb->max_jitter_us = jitter_us;
-        }
+    int packets_retrieved = 0;
+    while (get_from_jitter_buffer(session->jb, &ordered_slot, &ordered_size, &ordered_last, 0)) {
+        packets_retrieved++;
+        LOG_DEBUG("[DEBUG] Retrieved packet from buffer (count=%d, last=%d)\n", packets_retrieved, ordered_last);
         
-        // RFC 3550 jitter calculation: J = J + (|D| - J) / 16
-        jb->avg_jitter_us = jb->avg_jitter_us + (jitter_us - jb->avg_jitter_us) / 16;
-        
-        fprintf(stderr, "[JITTER] Packet jitter: %.2f ms (max=%.2f ms, avg=%.2f ms)\n",
-                jitter_us / 1000.0, jb->max_jitter_us / 1000.0, jb->avg_jitter_us / 1000.0);
-        fflush(stderr);
+        // Queue the payload in place; the sink releases the slot once written
+        write_session_payload(rx, session, ordered_slot, ordered_size);
     }
     
-    // Update last arrival info
-    jb->last_arrival_time = arrival_time;
-    jb->last_timestamp = timestamp;
-    jb->jitter_samples++;
-    
-    // Store in buffer
-    if (!jb->entries[buffer_idx].filled) {
-        jb->buffer_count++;  // Increment count for new entry
-    }
+    // One writev for everything played out this pass
+    if (session->has_sink) file_sink_flush(&session->sink);
     
-    memcpy(jb->entries[buffer_idx].payload, payload, payload_size);
-    jb->entries[buffer_idx].payload_size = payload_size;
-    jb->entries[buffer_idx].seq_number = seq;
-    jb->entries[buffer_idx].timestamp = timestamp;
-    jb->entries[buffer_idx].is_last_packet = is_last;
-    jb->entries[buffer_idx].filled = 1;
-    jb->entries[buffer_idx].arrival_time = arrival_time;
+    LOG_DEBUG("[DEBUG] Retrieved %d packets for ssrc=0x%08x\n", packets_retrieved, session->ssrc);
+    schedule_session(rx, session);
+}
+
+// Force out everything still buffered for this stream, skipping missing packets
+void drain_session(Receiver *rx, Session *session) {
+    int drain_slot, drain_size, drain_last;
+    int drained_count = 0;
+    int skipped_count = 0;
     
-    fprintf(stderr, "[BUFFER] Occupancy: %d/%d (%.1f%%)\n", 
-            jb->buffer_count, JITTER_BUFFER_SIZE, 
-            (float)jb->buffer_count / JITTER_BUFFER_SIZE * 100.0);
-    fflush(stderr);
+    while (drain_jitter_buffer_head(session->jb, &drain_slot, &drain_size, &drain_last, &skipped_count)) {
+        drained_count++;
+        write_session_payload(rx, session, drain_slot, drain_size);
+    }
+    if (session->has_sink) file_sink_flush(&session->sink);
     
-    return 0;
+    LOG_INFO("[STREAM] ssrc=0x%08x: drained %d packets, skipped %d missing, final occupancy: %d\n", 
+            session->ssrc, drained_count, skipped_count, session->jb->buffer_count);
 }
 
-int get_from_jitter_buffer(JitterBuffer *jb, unsigned char *payload, int *payload_size, int *is_last, int force_flush) {
-    if (!jb->initialized) {
-        fprintf(stderr, "[DEBUG JB] Buffer not initialized\n");
-        fflush(stderr);
-        return 0;
+// Retire a drained stream: fold its statistics into the totals and free it
+void close_session(Receiver *rx, Session *session, int print_report) {
+    if (session->has_sink) {
+        file_sink_close(&session->sink);
+        rx->write_calls += session->sink.write_calls;
     }
     
+    if (print_report) {
+        print_session_report(rx, session);
+    } else {
+        LOG_INFO("[SESSION] Retired idle stream ssrc=0x%08x: %d packets, %d lost, %ld bytes\n",
+                 session->ssrc, session->stats.total_packets, session->stats.lost_packets,
+                 session->total_bytes);
+    }
     
-    // Calculate expected sequence number
-    uint16_t expected_seq = (jb->base_seq + jb->head) & 0xFFFF;
-    int buffer_idx = jb->head % JITTER_BUFFER_SIZE;
-    
-    fprintf(stderr, "[DEBUG JB] Looking for seq=%u at idx=%d, force_flush=%d\n", expected_seq, buffer_idx, force_flush);
-    fflush(stderr);
-    
-    // Check if packet is available
-    if (!jb->entries[buffer_idx].filled) {
-        // --- Missing packet timeout logic ---
-        struct timeval now;
-        gettimeofday(&now, NULL);
-    
-        long waited_us =
-            (now.tv_sec - jb->last_arrival_time.tv_sec) * 1000000 +
-            (now.tv_usec - jb->last_arrival_time.tv_usec);
-    
-        long waited_ms = waited_us / 1000;
+    accumulate_statistics(&rx->totals, &session->stats);
+    rx->total_bytes += session->total_bytes;
+    if (session->metrics) {
+        metrics_release_stream(session->metrics);
+        session->metrics = NULL;
+    }
     
-        if (waited_ms > MISSING_PACKET_TIMEOUT_MS) {
-            fprintf(stderr,
-                    "[JB] Missing packet seq=%u timed out after %ld ms → skipping\n",
-                    expected_seq, waited_ms);
+    reset_jitter_buffer(session->jb);
+    free(session->jb);
+    session->jb = NULL;
+    if (session->fec) {
+        fec_decoder_reset(session->fec);
+        free(session->fec);
+        session->fec = NULL;
+    }
+    free(session->nack);
+    session->nack = NULL;
+    free(session->cc);
+    session->cc = NULL;
+    session_table_remove(&rx->sessions, session);
+}
+
+// Counters of one stream into its shared-memory slot, for rtpstat
+void publish_session_metrics(Session *session, int64_t now) {
+    MetricsStream *m = session->metrics;
+    JitterBuffer *jb = session->jb;
+    metrics_begin_update(m);
+    METRICS_SET(m, packets, session->stats.total_packets);
+    METRICS_SET(m, bytes, session->reception.octets);
+    METRICS_SET(m, lost, session->stats.lost_packets);
+    METRICS_SET(m, reordered, session->stats.reordered_packets);
+    METRICS_SET(m, duplicates, session->stats.duplicate_packets);
+    METRICS_SET(m, recovered, session->stats.recovered_packets + session->stats.retransmitted_packets);
+    METRICS_SET(m, late, jb->late_packets);
+    METRICS_SET(m, occupancy, jb->buffer_count);
+    METRICS_SET(m, avg_jitter_us, jb->avg_jitter_us);
+    METRICS_SET(m, max_jitter_us, jb->max_jitter_us);
+    METRICS_SET(m, playout_delay_ms, jb->target_delay_ms);
+    metrics_end_update(m, now);
+    session->metrics_published_us = now;
+}
+
+void print_session_report(Receiver *rx, Session *session) {
+    JitterBuffer *jb = session->jb;
     
-            jb->head++;  // MOVE ON → skip the missing packet
-            return 0;
+    const char *extension = session->is_h264 ? "h264" : "mp4";
+    if (session->has_sink && session->sink.owns_fd) {
+        if (rx->has_primary && session->ssrc == rx->primary_ssrc) {
+            fprintf(stderr, "\nVideo saved to reconstructed_vid.%s\n", extension);
+        } else {
+            fprintf(stderr, "\nVideo saved to reconstructed_vid_%08x.%s\n", session->ssrc, extension);
         }
-    
-        fprintf(stderr,
-                "[JB] Slot empty for seq=%u, waited %ldms (< timeout). Holding...\n",
-                expected_seq, waited_ms);
-    
-        return 0;
     }
-    
-    
-    fprintf(stderr, "[DEBUG JB] Found seq=%u in slot (expected %u)\n", jb->entries[buffer_idx].seq_number, expected_seq);
-    fflush(stderr);
-    
-    if (jb->entries[buffer_idx].seq_number != expected_seq) {
-        fprintf(stderr, "[DEBUG JB] Sequence mismatch!\n");
-        fflush(stderr);
-        return 0;  // Wrong packet in slot (shouldn't happen)
+
+    fprintf(stderr, "\n=== RTP Statistics (SSRC 0x%08x) ===\n", session->ssrc);
+    print_statistics(&session->stats);
+    fprintf(stderr, "Total bytes received: %ld\n", session->total_bytes);
+    if (session->is_h264) {
+        fprintf(stderr, "H.264 NAL units: %ld (%ld reassembled from FU-A), %ld packets dropped\n",
+                session->depacketizer.nal_units, session->depacketizer.fragmented_nal_units,
+                session->depacketizer.dropped_packets);
+    }
+    if (session->fec) {
+        fprintf(stderr, "FEC: %ld parity packets received, %ld media packets recovered\n",
+                session->fec->parity_received, session->fec->recovered);
+    }
+    if (session->nack) {
+        fprintf(stderr, "NACK: %ld packets requested (%ld repeated requests, %ld given up), RTT %.1f ms\n",
+                session->nack->requested, session->nack->retries, session->nack->abandoned,
+                session->nack->rtt_us / 1000.0);
+    }
+    if (session->reports) {
+        fprintf(stderr, "RTCP: %ld receiver reports sent, %ld sender reports received",
+                session->reports_sent, session->sender_reports);
+        if (session->sender_reports > 0) {
+            fprintf(stderr, " (sender counted %u packets, we received %u)",
+                    session->sender_packet_count, session->reception.received);
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\n=== Jitter Buffer Statistics ===\n");
+    fprintf(stderr, "Maximum jitter observed: %.2f ms\n", jb->max_jitter_us / 1000.0);
+    fprintf(stderr, "Average jitter: %.2f ms\n", jb->avg_jitter_us / 1000.0);
+    fprintf(stderr, "Jitter measurements: %d\n", jb->jitter_samples);
+    fprintf(stderr, "Late packets (after playout): %d\n", jb->late_packets);
+    if (jb->jitter_samples > 1) {
+        // What the adaptive delay cost and what other delays would have cost in late packets
+        fprintf(stderr, "Playout delay target: %d ms at the end (%d-%d ms), p50/p95/p99 jitter %d/%d/%d ms\n",
+                jb->target_delay_ms, jb->min_target_ms, jb->max_target_ms, jitter_buffer_quantile_ms(jb, 0.5),
+                jitter_buffer_quantile_ms(jb, 0.95), jitter_buffer_quantile_ms(jb, 0.99));
+        fprintf(stderr, "Mean buffering: %.1f ms over %ld packets\n",
+                jb->played_packets > 0 ? (double)jb->delay_sum_ms / jb->played_packets : 0.0, jb->played_packets);
+        fprintf(stderr, "Late share at a fixed delay of");
+        static const int delays_ms[] = { 10, 20, 50, 100, 200 };
+        for (int i = 0; i < 5; i++) {
+            fprintf(stderr, " %d ms: %.2f%%%s", delays_ms[i], 100 * jitter_buffer_late_fraction(jb, delays_ms[i]),
+                    i < 4 ? "," : "\n");
+        }
+    }
+    fprintf(stderr, "Final buffer occupancy: %d packets\n", jb->buffer_count);
+}
+
+// Socket overflow count carried by a received datagram, if any
+void read_kernel_drops(struct msghdr *msg, uint32_t *kernel_drops) {
+#ifdef SO_RXQ_OVFL
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(kernel_drops, CMSG_DATA(cmsg), sizeof(*kernel_drops));
+        }
+    }
+#else
+    (void)msg;
+    (void)kernel_drops;
+#endif
+}
+
+// Receive up to batch_size datagrams straight into packet pool slots.
+// Uses one recvmmsg call per batch and takes whatever is already queued
+// (the socket is non-blocking). Slots that end up
+// unused go back to the pool; the caller owns the ones returned in slots.
+// addrs[i] receives the source address of datagram i. *kernel_drops is
+// updated to the socket's overflow count (SO_RXQ_OVFL) when the kernel
+// reports it.
+// Returns the number of datagrams received, or -1 with errno set.
+int receive_packet_batch(int sockfd, PacketPool *pool, int *slots, int batch_size,
+                         struct sockaddr_in *addrs, uint32_t *kernel_drops) {
+    if (batch_size > pool->free_count) batch_size = pool->free_count;
+    for (int i = 0; i < batch_size; i++) {
+        slots[i] = packet_pool_acquire(pool);
     }
     
-    // Check jitter delay (wait a bit to allow reordering) unless forced
-    if (!force_flush) {
-        struct timeval now;
-        gettimeofday(&now, NULL);
-        long elapsed_us = (now.tv_sec - jb->entries[buffer_idx].arrival_time.tv_sec) * 1000000 +
-                          (now.tv_usec - jb->entries[buffer_idx].arrival_time.tv_usec);
-        long elapsed_ms = elapsed_us / 1000;
-        
-        
-        // Adaptive playout delay based on buffer occupancy
-        int adaptive_delay_ms = JITTER_DELAY_MS;
-        float buffer_fill_ratio = (float)jb->buffer_count / JITTER_BUFFER_SIZE;
-        
-        if (buffer_fill_ratio > 0.8) {
-            // Buffer filling up - drain faster to avoid overflow
-            adaptive_delay_ms = JITTER_DELAY_MS / 4;
-            fprintf(stderr, "[JITTER] High buffer occupancy (%.1f%%) - reducing delay to %dms\n",
-                    buffer_fill_ratio * 100.0, adaptive_delay_ms);
-            fflush(stderr);
-        } else if (buffer_fill_ratio > 0.5) {
-            // Buffer moderately full - slightly reduce delay
-            adaptive_delay_ms = JITTER_DELAY_MS / 2;
+    int count;
+    if (batch_size == 1) {
+        struct iovec iov = { packet_pool_data(pool, slots[0]), PACKET_SLOT_SIZE };
+        union { char buf[CMSG_SPACE(sizeof(uint32_t))]; struct cmsghdr align; } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &addrs[0];
+        msg.msg_namelen = sizeof(addrs[0]);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        int n = recvmsg(sockfd, &msg, 0);
+        if (n >= 0) {
+            pool->lengths[slots[0]] = n;
+            read_kernel_drops(&msg, kernel_drops);
+        }
+        count = n < 0 ? -1 : 1;
+    } else {
+#ifdef __linux__
+        struct mmsghdr msgs[MAX_RECV_BATCH];
+        struct iovec iovs[MAX_RECV_BATCH];
+        union { char buf[CMSG_SPACE(sizeof(uint32_t))]; struct cmsghdr align; } controls[MAX_RECV_BATCH];
+        memset(msgs, 0, batch_size * sizeof(struct mmsghdr));
+        for (int i = 0; i < batch_size; i++) {
+            iovs[i].iov_base = packet_pool_data(pool, slots[i]);
+            iovs[i].iov_len = PACKET_SLOT_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            msgs[i].msg_hdr.msg_control = controls[i].buf;
+            msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
         }
         
-        fprintf(stderr, "[DEBUG JB] Playout delay check: elapsed=%ldms, threshold=%dms, is_last=%d, buffer=%.1f%%\n", 
-                elapsed_ms, adaptive_delay_ms, jb->entries[buffer_idx].is_last_packet, buffer_fill_ratio * 100.0);
-        fflush(stderr);
-        
-        if (elapsed_ms < adaptive_delay_ms && !jb->entries[buffer_idx].is_last_packet) {
-            fprintf(stderr, "[DEBUG JB] Waiting for jitter delay (%ld/%d ms)\n", elapsed_ms, adaptive_delay_ms);
-            fflush(stderr);
-            return 0;  // Wait longer for potential reordered packets
+        count = recvmmsg(sockfd, msgs, batch_size, MSG_WAITFORONE, NULL);
+        for (int i = 0; i < count; i++) {
+            pool->lengths[slots[i]] = msgs[i].msg_len;
         }
+        // The count is cumulative: the last datagram has the latest
+        if (count > 0) read_kernel_drops(&msgs[count - 1].msg_hdr, kernel_drops);
+#else
+        // No recvmmsg: one recvfrom per datagram until the queue is empty
+        count = 0;
+        while (count < batch_size) {
+            socklen_t addr_len = sizeof(addrs[count]);
+            int n = recvfrom(sockfd, packet_pool_data(pool, slots[count]), PACKET_SLOT_SIZE,
+                             count == 0 ? 0 : MSG_DONTWAIT,
+                             (struct sockaddr *)&addrs[count], &addr_len);
+            if (n < 0) {
+                if (count == 0) count = -1;
+                break;
+            }
+            pool->lengths[slots[count++]] = n;
+        }
+#endif
     }
     
-    // Retrieve packet
-    memcpy(payload, jb->entries[buffer_idx].payload, jb->entries[buffer_idx].payload_size);
-    *payload_size = jb->entries[buffer_idx].payload_size;
-    *is_last = jb->entries[buffer_idx].is_last_packet;
-    
-    fprintf(stderr, "[DEBUG JB] Successfully retrieved seq=%u, size=%d, is_last=%d\n", 
-            jb->entries[buffer_idx].seq_number, *payload_size, *is_last);
-    fflush(stderr);
-    
-    // Mark as empty and advance head
-    jb->entries[buffer_idx].filled = 0;
-    jb->buffer_count--;  // Decrement count
-    jb->head++;
-    
-    return 1;
-}
-
-void print_statistics(RTPStats *stats) {
-    fprintf(stderr, "Total packets received: %d\n", stats->total_packets);
-    fprintf(stderr, "Lost packets: %d\n", stats->lost_packets);
-    fprintf(stderr, "Reordered packets: %d\n", stats->reordered_packets);
-    fprintf(stderr, "Duplicate packets: %d\n", stats->duplicate_packets);
-    if (stats->total_packets > 0) {
-        float loss_rate = (float)stats->lost_packets / (stats->total_packets + stats->lost_packets) * 100.0;
-        fprintf(stderr, "Packet loss rate: %.2f%%\n", loss_rate);
+    // Give back the slots this batch did not fill
+    int errno_saved = errno;
+    for (int i = count < 0 ? 0 : count; i < batch_size; i++) {
+        packet_pool_release(pool, slots[i]);
     }
+    errno = errno_saved;
+    return count;
 }
@@ -0,0 +1,342 @@
+#include "rtcp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NTP_UNIX_OFFSET 2208988800ULL  // Seconds from 1900 to 1970
+
+static void write_u32(unsigned char *bytes, uint32_t value) {
+    bytes[0] = value >> 24;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+static uint32_t read_u32(const unsigned char *bytes) {
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+int rtcp_is_rtcp(const unsigned char *packet, int length) {
+    return length >= 4 && (packet[0] >> 6) == 2 && packet[1] >= 192 && packet[1] <= 223;
+}
+
+int rtcp_pack_nack(unsigned char *packet, int max_length, uint32_t sender_ssrc, uint32_t media_ssrc,
+                   const uint16_t *seqs, int count) {
+    if (max_length < 12) return -1;
+    write_u32(packet + 4, sender_ssrc);
+    write_u32(packet + 8, media_ssrc);
+
+    // Each sequence number joins an FCI entry whose PID lies at most 16 before it
+    int length = 12;
+    for (int i = 0; i < count; i++) {
+        int merged = 0;
+        for (int fci = 12; fci < length; fci += 4) {
+            uint16_t pid = (uint16_t)(packet[fci] << 8 | packet[fci + 1]);
+            uint16_t offset = (uint16_t)(seqs[i] - pid);
+            if (offset == 0) {
+                merged = 1;
+            } else if (offset <= 16) {
+                packet[fci + 2 + (offset <= 8)] |= 1 << ((offset - 1) & 7);
+                merged = 1;
+            }
+            if (merged) break;
+        }
+        if (merged) continue;
+        if (length + 4 > max_length) return -1;
+        packet[length] = seqs[i] >> 8;
+        packet[length + 1] = seqs[i] & 0xFF;
+        packet[length + 2] = 0;  // BLP: bit i set = PID + i + 1 is missing too
+        packet[length + 3] = 0;
+        length += 4;
+    }
+
+    packet[0] = (2 << 6) | RTCP_FMT_NACK;
+    packet[1] = RTCP_PT_RTPFB;
+    packet[2] = ((length / 4 - 1) >> 8) & 0xFF;
+    packet[3] = (length / 4 - 1) & 0xFF;
+    return length;
+}
+
+int rtcp_unpack_nack(const unsigned char *packet, int length, uint32_t *media_ssrc,
+                     uint16_t *seqs, int max_seqs) {
+    // Walk the compound packet
+    int pos = 0;
+    while (pos + 4 <= length) {
+        int size = ((packet[pos + 2] << 8 | packet[pos + 3]) + 1) * 4;
+        if ((packet[pos] >> 6) != 2 || pos + size > length) return -1;
+        if (packet[pos + 1] == RTCP_PT_RTPFB && (packet[pos] & 0x1F) == RTCP_FMT_NACK && size >= 12) {
+            *media_ssrc = read_u32(packet + pos + 8);
+            int count = 0;
+            for (int fci = pos + 12; fci + 4 <= pos + size; fci += 4) {
+                uint16_t pid = (uint16_t)(packet[fci] << 8 | packet[fci + 1]);
+                uint16_t blp = (uint16_t)(packet[fci + 2] << 8 | packet[fci + 3]);
+                if (count < max_seqs) seqs[count++] = pid;
+                for (int bit = 0; bit < 16; bit++) {
+                    if ((blp & (1 << bit)) && count < max_seqs) seqs[count++] = (uint16_t)(pid + bit + 1);
+                }
+            }
+            return count;
+        }
+        pos += size;
+    }
+    return -1;
+}
+
+#define CCFB_ATO_UNAVAILABLE 0x1FFF  // Arrival time offset field values with a meaning of their own
+#define CCFB_ATO_MAX 0x1FFE
+
+int rtcp_pack_ccfb(unsigned char *packet, int max_length, uint32_t sender_ssrc, uint32_t media_ssrc,
+                   uint16_t begin_seq, const int64_t *delays_us, int count, uint32_t report_timestamp) {
+    if (count < 1 || count > RTCP_CCFB_MAX_REPORTS) return -1;
+    // Metric blocks are 16 bits each, padded to a 32-bit boundary
+    int length = 16 + ((count * 2 + 3) & ~3) + 4;
+    if (length > max_length) return -1;
+
+    memset(packet, 0, length);
+    packet[0] = (2 << 6) | RTCP_FMT_CCFB;
+    packet[1] = RTCP_PT_RTPFB;
+    packet[2] = ((length / 4 - 1) >> 8) & 0xFF;
+    packet[3] = (length / 4 - 1) & 0xFF;
+    write_u32(packet + 4, sender_ssrc);
+    write_u32(packet + 8, media_ssrc);
+    packet[12] = begin_seq >> 8;
+    packet[13] = begin_seq & 0xFF;
+    packet[14] = (count >> 8) & 0xFF;
+    packet[15] = count & 0xFF;
+    for (int i = 0; i < count; i++) {
+        uint16_t metric = 0;  // R = 0: not received
+        if (delays_us[i] >= 0) {
+            int64_t ato = delays_us[i] * 1024 / 1000000;
+            metric = 0x8000 | (uint16_t)(ato > CCFB_ATO_MAX ? CCFB_ATO_MAX : ato);
+        }
+        packet[16 + 2 * i] = metric >> 8;
+        packet[17 + 2 * i] = metric & 0xFF;
+    }
+    write_u32(packet + length - 4, report_timestamp);
+    return length;
+}
+
+int rtcp_unpack_ccfb(const unsigned char *packet, int length, uint32_t *media_ssrc, uint16_t *begin_seq,
+                     int64_t *delays_us, int max_count, uint32_t *report_timestamp) {
+    int pos = 0;
+    while (pos + 4 <= length) {
+        int size = ((packet[pos + 2] << 8 | packet[pos + 3]) + 1) * 4;
+        if ((packet[pos] >> 6) != 2 || pos + size > length) return -1;
+        if (packet[pos + 1] == RTCP_PT_RTPFB && (packet[pos] & 0x1F) == RTCP_FMT_CCFB && size >= 20) {
+            const unsigned char *bytes = packet + pos;
+            *media_ssrc = read_u32(bytes + 8);
+            *begin_seq = (uint16_t)(bytes[12] << 8 | bytes[13]);
+            int count = bytes[14] << 8 | bytes[15];
+            if (16 + count * 2 + 4 > size) return -1;
+            *report_timestamp = read_u32(bytes + size - 4);
+            if (count > max_count) count = max_count;
+            for (int i = 0; i < count; i++) {
+                uint16_t metric = (uint16_t)(bytes[16 + 2 * i] << 8 | bytes[17 + 2 * i]);
+                uint16_t ato = metric & 0x1FFF;
+                delays_us[i] = (!(metric & 0x8000) || ato == CCFB_ATO_UNAVAILABLE) ? -1 : (int64_t)ato * 1000000 / 1024;
+            }
+            return count;
+        }
+        pos += size;
+    }
+    return -1;
+}
+
+// --- Sender and receiver reports ---
+
+static void write_report_block(unsigned char *bytes, const RtcpReportBlock *block) {
+    write_u32(bytes, block->ssrc);
+    // Cumulative loss is clamped to the 24-bit signed range
+    int32_t lost = block->cumulative_lost;
+    if (lost > 0x7FFFFF) lost = 0x7FFFFF;
+    if (lost < -0x800000) lost = -0x800000;
+    write_u32(bytes + 4, (uint32_t)block->fraction_lost << 24 | ((uint32_t)lost & 0xFFFFFF));
+    write_u32(bytes + 8, block->highest_seq);
+    write_u32(bytes + 12, block->jitter);
+    write_u32(bytes + 16, block->lsr);
+    write_u32(bytes + 20, block->dlsr);
+}
+
+static void read_report_block(const unsigned char *bytes, RtcpReportBlock *block) {
+    block->ssrc = read_u32(bytes);
+    uint32_t loss = read_u32(bytes + 4);
+    block->fraction_lost = loss >> 24;
+    block->cumulative_lost = (int32_t)(loss << 8) >> 8;  // Sign-extend 24 bits
+    block->highest_seq = read_u32(bytes + 8);
+    block->jitter = read_u32(bytes + 12);
+    block->lsr = read_u32(bytes + 16);
+    block->dlsr = read_u32(bytes + 20);
+}
+
+int rtcp_pack_report(unsigned char *packet, int max_length, const RtcpSenderInfo *info, uint32_t ssrc,
+                     const RtcpReportBlock *blocks, int count, const char *cname) {
+    if (count > RTCP_MAX_BLOCKS) count = RTCP_MAX_BLOCKS;
+    int cname_length = (int)strlen(cname);
+    if (cname_length > 255) cname_length = 255;
+    int report_length = (info ? 28 : 8) + 24 * count;
+    // SDES: header, SSRC, CNAME item, null terminator, padded to 32 bits
+    int sdes_length = (4 + 4 + 2 + cname_length + 1 + 3) & ~3;
+    if (report_length + sdes_length > max_length) return -1;
+
+    unsigned char *report = packet;
+    report[0] = (2 << 6) | count;
+    report[1] = info ? RTCP_PT_SR : RTCP_PT_RR;
+    report[2] = ((report_length / 4 - 1) >> 8) & 0xFF;
+    report[3] = (report_length / 4 - 1) & 0xFF;
+    int pos = 8;
+    if (info) {
+        write_u32(report + 4, info->ssrc);
+        write_u32(report + 8, (uint32_t)(info->ntp_time >> 32));
+        write_u32(report + 12, (uint32_t)info->ntp_time);
+        write_u32(report + 16, info->rtp_timestamp);
+        write_u32(report + 20, info->packet_count);
+        write_u32(report + 24, info->octet_count);
+        pos = 28;
+    } else {
+        write_u32(report + 4, ssrc);
+    }
+    for (int i = 0; i < count; i++, pos += 24) {
+        write_report_block(report + pos, &blocks[i]);
+    }
+
+    unsigned char *sdes = packet + report_length;
+    memset(sdes, 0, sdes_length);
+    sdes[0] = (2 << 6) | 1;
+    sdes[1] = RTCP_PT_SDES;
+    sdes[2] = ((sdes_length / 4 - 1) >> 8) & 0xFF;
+    sdes[3] = (sdes_length / 4 - 1) & 0xFF;
+    write_u32(sdes + 4, info ? info->ssrc : ssrc);
+    sdes[8] = 1;  // CNAME
+    sdes[9] = (unsigned char)cname_length;
+    memcpy(sdes + 10, cname, cname_length);
+    return report_length + sdes_length;
+}
+
+int rtcp_unpack_report(const unsigned char *packet, int length, RtcpReport *report) {
+    int pos = 0;
+    while (pos + 4 <= length) {
+        int size = ((packet[pos + 2] << 8 | packet[pos + 3]) + 1) * 4;
+        if ((packet[pos] >> 6) != 2 || pos + size > length) return -1;
+        int type = packet[pos + 1];
+        if ((type == RTCP_PT_SR && size >= 28) || (type == RTCP_PT_RR && size >= 8)) {
+            const unsigned char *bytes = packet + pos;
+            memset(report, 0, sizeof(RtcpReport));
+            report->is_sender_report = (type == RTCP_PT_SR);
+            report->sender.ssrc = read_u32(bytes + 4);
+            int block_pos = 8;
+            if (report->is_sender_report) {
+                report->sender.ntp_time = (uint64_t)read_u32(bytes + 8) << 32 | read_u32(bytes + 12);
+                report->sender.rtp_timestamp = read_u32(bytes + 16);
+                report->sender.packet_count = read_u32(bytes + 20);
+                report->sender.octet_count = read_u32(bytes + 24);
+                block_pos = 28;
+            }
+            int count = bytes[0] & 0x1F;
+            for (int i = 0; i < count && block_pos + 24 <= size; i++, block_pos += 24) {
+                read_report_block(bytes + block_pos, &report->blocks[report->num_blocks++]);
+            }
+            return 0;
+        }
+        pos += size;
+    }
+    return -1;
+}
+
+uint64_t rtcp_ntp_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t fraction = ((uint64_t)now.tv_nsec << 32) / 1000000000ULL;
+    return ((uint64_t)now.tv_sec + NTP_UNIX_OFFSET) << 32 | fraction;
+}
+
+uint32_t rtcp_ntp_short(uint64_t ntp_time) {
+    return (uint32_t)(ntp_time >> 16);
+}
+
+int64_t rtcp_round_trip_us(const RtcpReportBlock *block, uint64_t ntp_now) {
+    if (block->lsr == 0) return -1;
+    // All three are 16.16 seconds; the difference is right across an NTP wrap
+    uint32_t rtt = rtcp_ntp_short(ntp_now) - block->lsr - block->dlsr;
+    if (rtt & 0x80000000u) return -1;  // The receiver's delay exceeds our clock: bogus
+    return (int64_t)rtt * 1000000 / 65536;
+}
+
+// --- Reception statistics ---
+
+void rtcp_reception_update(RtcpReception *reception, uint16_t seq, int payload_size, int64_t now_us) {
+    if (!reception->started) {
+        reception->started = 1;
+        reception->max_seq = seq;
+        reception->base_seq = seq;
+        reception->first_us = now_us;
+    } else {
+        uint16_t delta = (uint16_t)(seq - reception->max_seq);
+        if (delta < 0x8000) {
+            // In order, possibly past a gap: count a wrap when the number drops
+            if (seq < reception->max_seq) reception->cycles += 65536;
+            reception->max_seq = seq;
+        }
+        // Older packets (reordered or duplicated) only count as received
+    }
+    reception->received++;
+    reception->octets += payload_size;
+}
+
+void rtcp_reception_sender_report(RtcpReception *reception, const RtcpSenderInfo *info, int64_t now_us) {
+    reception->lsr = rtcp_ntp_short(info->ntp_time);
+    reception->lsr_arrival_us = now_us;
+}
+
+void rtcp_reception_block(RtcpReception *reception, uint32_t ssrc, uint32_t jitter, int64_t now_us,
+                          RtcpReportBlock *block) {
+    uint32_t extended_max = reception->cycles + reception->max_seq;
+    uint32_t expected = extended_max - reception->base_seq + 1;
+    uint32_t expected_interval = expected - reception->expected_prior;
+    uint32_t received_interval = reception->received - reception->received_prior;
+    int32_t lost_interval = (int32_t)(expected_interval - received_interval);
+    reception->expected_prior = expected;
+    reception->received_prior = reception->received;
+
+    block->ssrc = ssrc;
+    block->cumulative_lost = (int32_t)(expected - reception->received);
+    block->fraction_lost = (expected_interval == 0 || lost_interval <= 0)
+                           ? 0 : (uint8_t)(((uint32_t)lost_interval << 8) / expected_interval);
+    block->highest_seq = extended_max;
+    block->jitter = jitter;
+    block->lsr = reception->lsr;
+    block->dlsr = reception->lsr ? (uint32_t)((now_us - reception->lsr_arrival_us) * 65536 / 1000000) : 0;
+}
+
+// --- Report interval ---
+
+double rtcp_interval(int members, int senders, double rtcp_bandwidth, int we_sent,
+                     double avg_rtcp_size, double min_interval, int initial) {
+    const double sender_fraction = 0.25;
+    const double compensation = 2.71828 - 1.5;  // e - 3/2, for the timer reconsideration
+    if (initial) min_interval /= 2;
+
+    // Senders share a quarter of the RTCP bandwidth unless they are that many
+    int n = members;
+    if (senders <= members * sender_fraction) {
+        if (we_sent) {
+            rtcp_bandwidth *= sender_fraction;
+            n = senders;
+        } else {
+            rtcp_bandwidth *= 1 - sender_fraction;
+            n -= senders;
+        }
+    }
+    double interval = rtcp_bandwidth > 0 ? avg_rtcp_size * n / rtcp_bandwidth : min_interval;
+    if (interval < min_interval) interval = min_interval;
+
+    // Spread reports over [0.5, 1.5] of the interval so members do not synchronize
+    interval *= (double)rand() / RAND_MAX + 0.5;
+    return interval / compensation;
+}
+
+double rtcp_reduced_min_interval(double session_bandwidth) {
+    double kbps = session_bandwidth * 8 / 1000;
+    if (kbps <= 0) return RTCP_MIN_INTERVAL_S;
+    double interval = 360 / kbps;
+    return interval < RTCP_MIN_INTERVAL_S ? interval : RTCP_MIN_INTERVAL_S;
+}
@@ -0,0 +1,121 @@
+#ifndef RTCP_H
+#define RTCP_H
+
+#include <stdint.h>
+
+// RTCP packets exchanged on the RTP port (RFC 5761 multiplexing: an RTCP
+// packet type occupies the byte where RTP keeps marker and payload type).
+
+#define RTCP_PT_SR 200           // Sender report (RFC 3550 section 6.4.1)
+#define RTCP_PT_RR 201           // Receiver report (section 6.4.2)
+#define RTCP_PT_SDES 202         // Source description (section 6.5)
+#define RTCP_PT_RTPFB 205        // Transport-layer feedback (RFC 4585)
+#define RTCP_FMT_NACK 1          // Generic NACK
+#define RTCP_FMT_CCFB 11         // Congestion control feedback (RFC 8888)
+#define RTCP_MAX_PACKET 1200     // Largest RTCP packet we build
+#define RTCP_NACK_MAX_SEQS 256   // Sequence numbers reported by one NACK
+#define RTCP_MAX_BLOCKS 31       // Report blocks in one SR/RR (5-bit count)
+#define RTCP_CCFB_MAX_REPORTS 256  // Packets covered by one congestion control feedback
+#define RTCP_UDP_IP_OVERHEAD 28  // Lower-layer bytes the interval calculation counts
+#define RTCP_BANDWIDTH_FRACTION 0.05  // Share of the session bandwidth RTCP may use
+#define RTCP_MIN_INTERVAL_S 5.0  // Minimum report interval (halved for the first report)
+
+// Is this datagram RTCP rather than RTP? (packet types 192-223)
+int rtcp_is_rtcp(const unsigned char *packet, int length);
+
+// Generic NACK for the given sequence numbers (in any order; each FCI entry
+// covers a PID and the 16 that follow it). Returns the packet length, or -1
+// if it does not fit into max_length bytes.
+int rtcp_pack_nack(unsigned char *packet, int max_length, uint32_t sender_ssrc, uint32_t media_ssrc,
+                   const uint16_t *seqs, int count);
+// Find the first generic NACK in a (compound) RTCP packet and expand it.
+// Returns the number of sequence numbers, or -1 if there is none.
+int rtcp_unpack_nack(const unsigned char *packet, int length, uint32_t *media_ssrc,
+                     uint16_t *seqs, int max_seqs);
+
+// Congestion control feedback for one stream (RFC 8888): whether each packet
+// from begin_seq on arrived, and how long before report_timestamp (NTP
+// short format) it did. delays_us[i] < 0 marks a lost packet. Offsets travel
+// in 1/1024 s. Returns the packet length, or -1 if it does not fit.
+int rtcp_pack_ccfb(unsigned char *packet, int max_length, uint32_t sender_ssrc, uint32_t media_ssrc,
+                   uint16_t begin_seq, const int64_t *delays_us, int count, uint32_t report_timestamp);
+// Find the first congestion control feedback in a compound packet and expand
+// its first stream. Returns the number of packets covered, or -1.
+int rtcp_unpack_ccfb(const unsigned char *packet, int length, uint32_t *media_ssrc, uint16_t *begin_seq,
+                     int64_t *delays_us, int max_count, uint32_t *report_timestamp);
+
+// --- Sender and receiver reports (RFC 3550 section 6) ---
+
+// Sender info of an SR
+typedef struct {
+    uint32_t ssrc;
+    uint64_t ntp_time;         // Wallclock, NTP 32.32 fixed point
+    uint32_t rtp_timestamp;    // The same instant on the media clock
+    uint32_t packet_count;
+    uint32_t octet_count;      // Payload octets
+} RtcpSenderInfo;
+
+// Reception report about one source
+typedef struct {
+    uint32_t ssrc;
+    uint8_t fraction_lost;     // Since the previous report, in 1/256
+    int32_t cumulative_lost;   // 24-bit signed on the wire
+    uint32_t highest_seq;      // Extended highest sequence number received
+    uint32_t jitter;           // Interarrival jitter in timestamp units
+    uint32_t lsr;              // Middle 32 bits of the NTP time of the last SR, 0 = none
+    uint32_t dlsr;             // Delay since that SR, 1/65536 s
+} RtcpReportBlock;
+
+// The SR or RR of a compound packet
+typedef struct {
+    int is_sender_report;
+    RtcpSenderInfo sender;     // ssrc is the reporter's in both cases
+    int num_blocks;
+    RtcpReportBlock blocks[RTCP_MAX_BLOCKS];
+} RtcpReport;
+
+// SR (with info) or RR (info == NULL, then ssrc names the reporter), followed
+// by an SDES CNAME chunk as every compound packet needs. Returns the length,
+// or -1 if it does not fit into max_length bytes.
+int rtcp_pack_report(unsigned char *packet, int max_length, const RtcpSenderInfo *info, uint32_t ssrc,
+                     const RtcpReportBlock *blocks, int count, const char *cname);
+// Find the SR or RR in a compound packet. Returns 0, or -1 if there is none.
+int rtcp_unpack_report(const unsigned char *packet, int length, RtcpReport *report);
+
+// NTP time now, and its middle 32 bits as carried in LSR
+uint64_t rtcp_ntp_now(void);
+uint32_t rtcp_ntp_short(uint64_t ntp_time);
+// Round trip from a report block received at ntp_now (RFC 3550 section 6.4.1), -1 if unknown
+int64_t rtcp_round_trip_us(const RtcpReportBlock *block, uint64_t ntp_now);
+
+// Reception statistics of one source (RFC 3550 appendix A.1 and A.3)
+typedef struct {
+    int started;
+    uint16_t max_seq;
+    uint32_t cycles;           // Sequence number wraps, times 65536
+    uint32_t base_seq;
+    uint32_t received;
+    uint32_t expected_prior;   // At the previous report
+    uint32_t received_prior;
+    uint64_t octets;           // Payload octets, for the session bandwidth estimate
+    int64_t first_us;
+    uint32_t lsr;              // From the last SR of this source
+    int64_t lsr_arrival_us;
+} RtcpReception;
+
+void rtcp_reception_update(RtcpReception *reception, uint16_t seq, int payload_size, int64_t now_us);
+void rtcp_reception_sender_report(RtcpReception *reception, const RtcpSenderInfo *info, int64_t now_us);
+// Fill a report block and start the next report interval
+void rtcp_reception_block(RtcpReception *reception, uint32_t ssrc, uint32_t jitter, int64_t now_us,
+                          RtcpReportBlock *block);
+
+// Randomized report interval in seconds (RFC 3550 appendix A.7). rtcp_bandwidth
+// is in octets/s (RTCP_BANDWIDTH_FRACTION of the session), avg_rtcp_size
+// includes RTCP_UDP_IP_OVERHEAD, min_interval is RTCP_MIN_INTERVAL_S or the
+// reduced minimum of section 6.2.
+double rtcp_interval(int members, int senders, double rtcp_bandwidth, int we_sent,
+                     double avg_rtcp_size, double min_interval, int initial);
+// The reduced minimum: 360 / session bandwidth in kbit/s, never above RTCP_MIN_INTERVAL_S
+double rtcp_reduced_min_interval(double session_bandwidth);
+
+#endif // RTCP_H
@@ -1,62 +1,102 @@
 #include "rtp.h"
-#include "rtpheaders.c"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/time.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
 
-#define RTP_CLOCK_RATE 90000  // Standard RTP clock rate for video (90 kHz)
+uint32_t rtp_random32(void) {
+    uint32_t value;
+#ifdef __linux__
+    if (getrandom(&value, sizeof(value), 0) == (ssize_t)sizeof(value)) return value;
+#else
+    arc4random_buf(&value, sizeof(value));
+    return value;
+#endif
+    // No getrandom (pre-3.17 kernel, seccomp): mix the clock with a counter (splitmix64)
+    static uint64_t counter;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t z = ((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec) ^
+                 (__atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED) + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)(z ^ (z >> 31));
+}
 
-// High-level function to send an RTP packet
-int send_rtp_packet(int sockfd, struct sockaddr_in *server_addr, unsigned char *payload, int payload_size, int is_last_packet) {
-    static struct timeval start_time;
-    static int initialized = 0;
-    static uint32_t base_timestamp = 0;
-    
-    // Initialize timing on first call
-    if (!initialized) {
-        gettimeofday(&start_time, NULL);
-        base_timestamp = (uint32_t)(rand() & 0xFFFFFFFF);  // Random initial timestamp
-        initialized = 1;
+// Random SSRC, first sequence number and timestamp base (RFC 3550 section 5.1)
+void rtp_session_init(RtpSession *session, uint8_t payload_type) {
+    memset(session, 0, sizeof(*session));
+    session->ssrc = rtp_random32();
+    session->seq = (uint16_t)rtp_random32();
+    session->timestamp_base = rtp_random32();
+    session->payload_type = payload_type;
+}
+
+// Fill in the header of the session's next packet; timestamp is media time
+void rtp_session_next_header(RtpSession *session, RTPHeader *header, uint32_t timestamp, int is_last_packet) {
+    header->V = 2;
+    header->P = 0;
+    header->X = 0;
+    header->CC = 0;
+    header->M = is_last_packet ? 1 : 0;
+    header->PT = session->payload_type;
+    assign_sequence_number(session, header);
+    assign_ssrc(session, header);
+    assign_timestamp(header, session->timestamp_base + timestamp);
+}
+
+// Point msg at a two-element iovec: serialized header, then the caller's payload.
+// The payload is never copied in user space.
+void fill_rtp_msghdr(struct msghdr *msg, struct iovec iov[2], struct sockaddr_in *server_addr,
+                     unsigned char *header_bytes, unsigned char *payload, int payload_size) {
+    iov[0].iov_base = header_bytes;
+    iov[0].iov_len = RTP_HEADER_SIZE;
+    iov[1].iov_base = payload;
+    iov[1].iov_len = payload_size;
+
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_name = server_addr;
+    msg->msg_namelen = sizeof(*server_addr);
+    msg->msg_iov = iov;
+    msg->msg_iovlen = 2;
+}
+
+// Same for a chunk: header, optional payload header (prefix), then the payload
+static void fill_rtp_chunk_msghdr(struct msghdr *msg, struct iovec iov[3], struct sockaddr_in *server_addr,
+                                  unsigned char *header_bytes, RTPChunk *chunk) {
+    fill_rtp_msghdr(msg, iov, server_addr, header_bytes, chunk->payload, chunk->payload_size);
+    if (chunk->prefix_size > 0) {
+        iov[2] = iov[1];
+        iov[1].iov_base = chunk->prefix;
+        iov[1].iov_len = chunk->prefix_size;
+        msg->msg_iovlen = 3;
     }
-    
-    // Create and populate RTP header
-    RTPHeader header;
-    header.V = 2;   // RTP version 2
-    header.P = 0;   // No padding
-    header.X = 0;   // No extension
-    header.CC = 0;  // No CSRC
-    header.M = is_last_packet ? 1 : 0;  // Marker bit (set for last packet)
-    header.PT = 0;  // Payload type 0
-    
-    // Assign sequence number and SSRC
-    assign_sequence_number(&header);
-    assign_ssrc(&header);
-    
-    // Calculate timestamp based on elapsed time and RTP clock rate
+}
+
+// High-level function to send an RTP packet, timestamped with the wall clock
+// time since the session's first packet
+int send_rtp_packet(RtpSession *session, int sockfd, struct sockaddr_in *server_addr,
+                    unsigned char *payload, int payload_size, int is_last_packet) {
     struct timeval current_time;
     gettimeofday(&current_time, NULL);
-    long elapsed_us = (current_time.tv_sec - start_time.tv_sec) * 1000000 +
-                      (current_time.tv_usec - start_time.tv_usec);
-    uint32_t timestamp = base_timestamp + (uint32_t)((elapsed_us * RTP_CLOCK_RATE) / 1000000);
-    assign_timestamp(&header, timestamp);
-    printf("Sequence Number: %d, Timestamp: %u\n", header.seq, timestamp);
-    // Build packet
-    unsigned char packet[RTP_HEADER_SIZE + payload_size];
-    build_rtp_packet(&header, payload, payload_size, packet);
-    
-    // Send packet
-    int packet_size = RTP_HEADER_SIZE + payload_size;
-    int bytes_sent = sendto(sockfd, packet, packet_size, 0, (struct sockaddr *)server_addr, sizeof(*server_addr));
-    if (bytes_sent < 0) {
-        perror("Failed to send RTP packet");
-        return -1;
-    }
-    return bytes_sent;
+    int64_t now_us = (int64_t)current_time.tv_sec * 1000000 + current_time.tv_usec;
+    if (session->start_us == 0) session->start_us = now_us;
+    uint32_t timestamp = (uint32_t)((now_us - session->start_us) * RTP_CLOCK_RATE / 1000000);
+    return send_rtp_packet_with_timestamp(session, sockfd, server_addr, payload, payload_size,
+                                          timestamp, is_last_packet);
 }
 
 int send_rtp_packet_with_timestamp(
+    RtpSession *session,
     int sockfd,
     struct sockaddr_in *server_addr,
     unsigned char *payload,
@@ -65,23 +105,352 @@ int send_rtp_packet_with_timestamp(
     int is_last_packet) {
     // Build header
     RTPHeader header;
-    header.V = 2;
-    header.P = 0;
-    header.X = 0;
-    header.CC = 0;
-    header.M = is_last_packet ? 1 : 0;
-    header.PT = 96;  // Dynamic PT for video
-
-    assign_sequence_number(&header);
-    assign_ssrc(&header);
-    assign_timestamp(&header, timestamp);
-
-    unsigned char packet[RTP_HEADER_SIZE + payload_size];
-    build_rtp_packet(&header, payload, payload_size, packet);
-
-    int packet_size = RTP_HEADER_SIZE + payload_size;
-    return sendto(sockfd, packet, packet_size, 0,
-                  (struct sockaddr *)server_addr, sizeof(*server_addr));
+    rtp_session_next_header(session, &header, timestamp, is_last_packet);
+
+    // Serialize the header only; the payload goes out straight from the caller's buffer
+    unsigned char header_bytes[RTP_HEADER_SIZE];
+    pack_rtp_header(&header, header_bytes);
+
+    struct msghdr msg;
+    struct iovec iov[2];
+    fill_rtp_msghdr(&msg, iov, server_addr, header_bytes, payload, payload_size);
+    int bytes_sent = sendmsg(sockfd, &msg, 0);
+    session->send_calls++;
+    if (bytes_sent < 0) {
+        session->send_errors++;
+        return -1;
+    }
+    session->packets_sent++;
+    session->octets_sent += payload_size;
+    return bytes_sent;
+}
+
+// Send a whole batch of chunks sharing one RTP timestamp (typically one frame).
+// Headers are built in a single pass and handed to the kernel with sendmmsg,
+// so a frame costs one syscall instead of one per packet.
+// Returns the number of packets sent. A send error stops the batch and gives
+// the unsent packets' sequence numbers back, so the stream shows no gap;
+// -1 if nothing was sent.
+int send_rtp_batch_with_timestamp(
+    RtpSession *session,
+    int sockfd,
+    struct sockaddr_in *server_addr,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp) {
+    int total_sent = 0;
+
+    while (total_sent < num_chunks) {
+        int batch = num_chunks - total_sent;
+        if (batch > RTP_MAX_BATCH) batch = RTP_MAX_BATCH;
+
+        unsigned char header_bytes[RTP_MAX_BATCH][RTP_HEADER_SIZE];
+        struct iovec iovs[RTP_MAX_BATCH][3];
+#ifdef __linux__
+        struct mmsghdr msgs[RTP_MAX_BATCH];
+#else
+        struct msghdr msgs[RTP_MAX_BATCH];
+#endif
+
+        // Build all headers for this batch in one pass; payloads are referenced, not copied
+        for (int i = 0; i < batch; i++) {
+            RTPChunk *chunk = &chunks[total_sent + i];
+            RTPHeader header;
+            rtp_session_next_header(session, &header, timestamp, chunk->is_last_packet);
+            pack_rtp_header(&header, header_bytes[i]);
+#ifdef __linux__
+            fill_rtp_chunk_msghdr(&msgs[i].msg_hdr, iovs[i], server_addr, header_bytes[i], chunk);
+            msgs[i].msg_len = 0;
+#else
+            fill_rtp_chunk_msghdr(&msgs[i], iovs[i], server_addr, header_bytes[i], chunk);
+#endif
+        }
+
+#ifdef __linux__
+        // sendmmsg may stop early (e.g. full socket buffer), keep going until the batch is out
+        int done = 0;
+        while (done < batch) {
+            int n = sendmmsg(sockfd, msgs + done, batch - done, 0);
+            session->send_calls++;
+            if (n < 0) {
+                perror("Failed to send RTP batch");
+                session->send_errors++;
+                session->seq -= (uint16_t)(batch - done);
+                total_sent += done;
+                return total_sent > 0 ? total_sent : -1;
+            }
+            for (int i = done; i < done + n; i++) session->octets_sent += msgs[i].msg_len - RTP_HEADER_SIZE;
+            session->packets_sent += n;
+            done += n;
+        }
+#else
+        // No sendmmsg on this platform: fall back to one sendmsg per packet
+        for (int i = 0; i < batch; i++) {
+            int n = sendmsg(sockfd, &msgs[i], 0);
+            session->send_calls++;
+            if (n < 0) {
+                perror("Failed to send RTP packet");
+                session->send_errors++;
+                session->seq -= (uint16_t)(batch - i);
+                total_sent += i;
+                return total_sent > 0 ? total_sent : -1;
+            }
+            session->packets_sent++;
+            session->octets_sent += n - RTP_HEADER_SIZE;
+        }
+#endif
+        total_sent += batch;
+    }
+
+    return total_sent;
+}
+
+// Give a fan-out destination its own media session plus FEC and RTX streams
+void init_rtp_destination(RtpDestination *dest, struct sockaddr_in *addr) {
+    memset(dest, 0, sizeof(*dest));
+    dest->addr = *addr;
+    rtp_session_init(&dest->media, RTP_PT_VIDEO);
+    dest->fec_ssrc = rtp_random32();
+    dest->fec_seq = (uint16_t)rtp_random32();
+    dest->rtx_ssrc = rtp_random32();
+    dest->rtx_seq = (uint16_t)rtp_random32();
+    dest->rtt_us = -1;
+}
+
+#ifdef __linux__
+typedef struct mmsghdr RtpMessage;
+#define RTP_MESSAGE_HDR(m) (&(m)->msg_hdr)
+#else
+typedef struct msghdr RtpMessage;
+#define RTP_MESSAGE_HDR(m) (m)
+#endif
+
+// Send msgs in as few syscalls as the platform allows: sendmmsg, continued
+// after a short send, or one sendmsg per packet. A message that fails is
+// charged to its owner and skipped, it does not stop the others. With media
+// set, owners also count the packets and payload octets sent.
+// Returns the number of packets sent.
+static int send_message_batch(int sockfd, RtpMessage *msgs, RtpSession **owners, int count, int media) {
+    int total_sent = 0;
+#ifdef __linux__
+    int done = 0;
+    while (done < count) {
+        int n = sendmmsg(sockfd, msgs + done, count - done, 0);
+        owners[done]->send_calls++;
+        if (n < 0) {
+            // The first unsent message failed: charge it to its owner and move on
+            owners[done]->send_errors++;
+            done++;
+            continue;
+        }
+        if (media) {
+            for (int i = done; i < done + n; i++) {
+                owners[i]->packets_sent++;
+                owners[i]->octets_sent += msgs[i].msg_len - RTP_HEADER_SIZE;
+            }
+        }
+        total_sent += n;
+        done += n;
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        int n = sendmsg(sockfd, &msgs[i], 0);
+        owners[i]->send_calls++;
+        if (n < 0) {
+            owners[i]->send_errors++;
+            continue;
+        }
+        if (media) {
+            owners[i]->packets_sent++;
+            owners[i]->octets_sent += n - RTP_HEADER_SIZE;
+        }
+        total_sent++;
+    }
+#endif
+    return total_sent;
+}
+
+// Send the same chunks (one frame) to every destination. The payload is
+// packetized once: all destinations reference the same payload bytes and only
+// the 12-byte headers differ. Packets go out chunk by chunk across all
+// destinations, so no receiver consistently gets its frame last.
+// A destination that fails to send is counted and skipped, it does not stop
+// the others. Returns the number of packets sent.
+int send_rtp_fanout_with_timestamp(
+    int sockfd,
+    RtpDestination *dests,
+    int num_dests,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp) {
+    int total = num_dests * num_chunks;
+    int total_sent = 0;
+
+    for (int base = 0; base < total; base += RTP_MAX_BATCH) {
+        int batch = total - base;
+        if (batch > RTP_MAX_BATCH) batch = RTP_MAX_BATCH;
+
+        unsigned char header_bytes[RTP_MAX_BATCH][RTP_HEADER_SIZE];
+        struct iovec iovs[RTP_MAX_BATCH][3];
+        RtpSession *owners[RTP_MAX_BATCH];
+        RtpMessage msgs[RTP_MAX_BATCH];
+
+        for (int i = 0; i < batch; i++) {
+            RTPChunk *chunk = &chunks[(base + i) / num_dests];
+            RtpDestination *dest = &dests[(base + i) % num_dests];
+            RTPHeader header;
+            rtp_session_next_header(&dest->media, &header, timestamp, chunk->is_last_packet);
+            pack_rtp_header(&header, header_bytes[i]);
+            owners[i] = &dest->media;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            fill_rtp_chunk_msghdr(RTP_MESSAGE_HDR(&msgs[i]), iovs[i], &dest->addr, header_bytes[i], chunk);
+        }
+        total_sent += send_message_batch(sockfd, msgs, owners, batch, 1);
+    }
+
+    return total_sent;
+}
+
+// Packets with caller-built headers, e.g. FEC parity: the header bytes are
+// sent as they are and neither packets nor octets count as media.
+int send_rtp_prebuilt(int sockfd, RTPPrebuiltPacket *packets, int num_packets) {
+    int total_sent = 0;
+
+    for (int base = 0; base < num_packets; base += RTP_MAX_BATCH) {
+        int batch = num_packets - base;
+        if (batch > RTP_MAX_BATCH) batch = RTP_MAX_BATCH;
+
+        struct iovec iovs[RTP_MAX_BATCH][2];
+        RtpSession *owners[RTP_MAX_BATCH];
+        RtpMessage msgs[RTP_MAX_BATCH];
+
+        for (int i = 0; i < batch; i++) {
+            RTPPrebuiltPacket *packet = &packets[base + i];
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            fill_rtp_msghdr(RTP_MESSAGE_HDR(&msgs[i]), iovs[i], packet->addr, packet->header,
+                            packet->payload, packet->payload_size);
+            iovs[i][0].iov_len = packet->header_size;
+            owners[i] = packet->owner;
+        }
+        total_sent += send_message_batch(sockfd, msgs, owners, batch, 0);
+    }
+
+    return total_sent;
+}
+
+// Queue one SENDMSG per message and submit them with an io_uring_enter that
+// also waits for all of their completions, since the headers and msghdrs
+// live on the caller's stack. It does not return before every queued message
+// has completed or been withdrawn. owners[i] is charged for message i.
+// Returns the number of packets sent.
+static int send_uring_messages(IoUring *ring, int sockfd, struct msghdr *msgs, RtpSession **owners, int count) {
+    int order[RTP_URING_BATCH];  // Message index of each queued SQE
+    int queued = 0;
+    for (int i = 0; i < count; i++) {
+        if (uring_sendmsg(ring, sockfd, &msgs[i], (uint64_t)i) < 0) {
+            owners[i]->send_errors++;
+            continue;
+        }
+        order[queued++] = i;
+    }
+
+    int reaped = 0;
+    int sent = 0;
+    int failed = 0;
+    while (reaped < queued) {
+        if (uring_submit(ring, queued - reaped, failed ? 1000 : -1) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+            if (!failed) {
+                perror("Failed to submit RTP batch");
+                // What the kernel did not take never runs; the rest must still complete
+                unsigned withdrawn = uring_unqueue(ring);
+                for (unsigned k = 0; k < withdrawn; k++) owners[order[--queued]]->send_errors++;
+                failed = 1;
+            } else {
+                usleep(1000);
+            }
+        }
+        UringCompletion cqe;
+        while (uring_peek(ring, &cqe)) {
+            if (cqe.user_data >= (uint64_t)count) continue;
+            RtpSession *owner = owners[cqe.user_data];
+            reaped++;
+            if (cqe.res < 0) {
+                owner->send_errors++;
+                continue;
+            }
+            owner->packets_sent++;
+            owner->octets_sent += cqe.res - RTP_HEADER_SIZE;
+            sent++;
+        }
+    }
+    return sent;
+}
+
+int send_rtp_batch_uring(
+    RtpSession *session,
+    IoUring *ring,
+    int sockfd,
+    struct sockaddr_in *server_addr,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp) {
+    int total_sent = 0;
+
+    for (int base = 0; base < num_chunks; base += RTP_URING_BATCH) {
+        int batch = num_chunks - base;
+        if (batch > RTP_URING_BATCH) batch = RTP_URING_BATCH;
+
+        unsigned char header_bytes[RTP_URING_BATCH][RTP_HEADER_SIZE];
+        struct iovec iovs[RTP_URING_BATCH][3];
+        struct msghdr msgs[RTP_URING_BATCH];
+        RtpSession *owners[RTP_URING_BATCH];
+        for (int i = 0; i < batch; i++) {
+            RTPChunk *chunk = &chunks[base + i];
+            RTPHeader header;
+            rtp_session_next_header(session, &header, timestamp, chunk->is_last_packet);
+            pack_rtp_header(&header, header_bytes[i]);
+            fill_rtp_chunk_msghdr(&msgs[i], iovs[i], server_addr, header_bytes[i], chunk);
+            owners[i] = session;
+        }
+        int sent = send_uring_messages(ring, sockfd, msgs, owners, batch);
+        total_sent += sent;
+        if (sent < batch) return total_sent > 0 ? total_sent : -1;
+    }
+    return total_sent;
+}
+
+int send_rtp_fanout_uring(
+    IoUring *ring,
+    int sockfd,
+    RtpDestination *dests,
+    int num_dests,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp) {
+    int total = num_dests * num_chunks;
+    int total_sent = 0;
+
+    for (int base = 0; base < total; base += RTP_URING_BATCH) {
+        int batch = total - base;
+        if (batch > RTP_URING_BATCH) batch = RTP_URING_BATCH;
+
+        unsigned char header_bytes[RTP_URING_BATCH][RTP_HEADER_SIZE];
+        struct iovec iovs[RTP_URING_BATCH][3];
+        struct msghdr msgs[RTP_URING_BATCH];
+        RtpSession *owners[RTP_URING_BATCH];
+        for (int i = 0; i < batch; i++) {
+            RTPChunk *chunk = &chunks[(base + i) / num_dests];
+            RtpDestination *dest = &dests[(base + i) % num_dests];
+            RTPHeader header;
+            rtp_session_next_header(&dest->media, &header, timestamp, chunk->is_last_packet);
+            pack_rtp_header(&header, header_bytes[i]);
+            fill_rtp_chunk_msghdr(&msgs[i], iovs[i], &dest->addr, header_bytes[i], chunk);
+            owners[i] = &dest->media;
+        }
+        total_sent += send_uring_messages(ring, sockfd, msgs, owners, batch);
+    }
+    return total_sent;
 }
 
 // High-level function to receive an RTP packet
@@ -2,9 +2,21 @@
 #define RTP_H
 
 #include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "uring.h"
 
 #define RTP_HEADER_SIZE 12  // Fixed RTP header size (in bytes)
 #define CHUNK_SIZE 1024     // Max payload size for each packet
+#define RTP_MAX_BATCH 64    // Max packets handed to the kernel per batched send
+#define RTP_URING_BATCH 256 // Max packets per io_uring_enter (the ring needs this many entries)
+#define RTP_CLOCK_RATE 90000  // Standard RTP clock rate for video (90 kHz)
+
+// Dynamic payload types used by this project (there is no SDP negotiation)
+#define RTP_PT_VIDEO 96     // Opaque file chunks
+#define RTP_PT_H264 97      // H.264, RFC 6184 packetization
+#define RTP_PT_FEC 98       // FEC parity stream (see fec.h)
+#define RTP_PT_RTX 99       // Retransmissions, RFC 4588 (see nack.h)
 
 // RTP Header Structure
 typedef struct {
@@ -19,21 +31,121 @@ typedef struct {
     uint32_t ssrc;        // SSRC (Synchronization Source) (32 bits)
 } RTPHeader;
 
-// High-level API (Application Layer)
-int send_rtp_packet(int sockfd, struct sockaddr_in *server_addr, unsigned char *payload, int payload_size, int is_last_packet);
+// One payload chunk of a batched send
+typedef struct {
+    unsigned char *payload;
+    int payload_size;
+    int is_last_packet;   // Sets the marker bit on this packet
+    unsigned char prefix[2];  // Payload header sent in front of payload (e.g. FU-A)
+    int prefix_size;          // 0 for plain chunks
+} RTPChunk;
+
+// One outgoing RTP stream: SSRC, sequence space, timestamp base and send
+// counters. All per-stream state lives here rather than in statics, so a
+// process can run any number of streams, one per thread if it likes.
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;             // Next sequence number
+    uint32_t timestamp_base;  // Random per-SSRC offset added to the media timestamp
+    uint8_t payload_type;
+    int64_t start_us;         // Wall clock of the first send_rtp_packet, 0 = not sent yet
+    long packets_sent;
+    long octets_sent;         // Payload octets (RTCP sender reports)
+    long send_errors;
+    long send_calls;          // sendmsg/sendmmsg/sendto calls for this session (a batch is charged to its first packet)
+} RtpSession;
+
+// One packet whose header the caller serialized (RTP header plus any payload
+// header, e.g. FEC). Many packets may share one payload.
+typedef struct {
+    struct sockaddr_in *addr;
+    unsigned char *header;
+    int header_size;
+    unsigned char *payload;
+    int payload_size;
+    RtpSession *owner;        // Charged for send errors
+} RTPPrebuiltPacket;
+
+// One receiver of a fan-out send: own address and media session
+typedef struct {
+    struct sockaddr_in addr;
+    RtpSession media;
+    uint32_t fec_ssrc;        // SSRC and sequence space of the FEC parity stream
+    uint16_t fec_seq;
+    uint32_t rtx_ssrc;        // SSRC and sequence space of the retransmission stream
+    uint16_t rtx_seq;
+    // From the destination's RTCP receiver reports
+    long reports_received;
+    int64_t rtt_us;           // Last round trip, -1 = not measured yet
+    uint8_t fraction_lost;    // In 1/256, over the last report interval
+    int32_t cumulative_lost;
+    uint32_t jitter;          // In timestamp units
+} RtpDestination;
+
+// Unpredictable 32 bits (RFC 3550 section 5.1) from the kernel's generator,
+// with no process-wide generator state, so any thread may call it
+uint32_t rtp_random32(void);
+
+// Sessions. rtp_session_init draws the SSRC, first sequence number and
+// timestamp base from rtp_random32.
+void rtp_session_init(RtpSession *session, uint8_t payload_type);
+void rtp_session_next_header(RtpSession *session, RTPHeader *header, uint32_t timestamp, int is_last_packet);
+
+// High-level API (Application Layer). Timestamps are media time; the
+// session adds its timestamp base.
+int send_rtp_packet(RtpSession *session, int sockfd, struct sockaddr_in *server_addr,
+    unsigned char *payload, int payload_size, int is_last_packet);
 int receive_rtp_packet(int sockfd, unsigned char *payload, int *payload_size, int *is_last_packet, struct sockaddr_in *client_addr);
-//int send_rtp_packet_with_timestamp(int sockfd, struct sockaddr_in *server_addr, unsigned char *payload, int payload_size, uint32_t timestamp, int is_last_packet);
-int send_rtp_packet_with_timestamp(int sockfd,
+int send_rtp_packet_with_timestamp(RtpSession *session,
+    int sockfd,
     struct sockaddr_in *server_addr,
     unsigned char *payload,
     int payload_size,
     uint32_t timestamp,
     int is_last_packet);
+int send_rtp_batch_with_timestamp(RtpSession *session,
+    int sockfd,
+    struct sockaddr_in *server_addr,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp);
+void init_rtp_destination(RtpDestination *dest, struct sockaddr_in *addr);
+int send_rtp_fanout_with_timestamp(int sockfd,
+    RtpDestination *dests,
+    int num_dests,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp);
+// Send prebuilt packets (e.g. FEC parity for every destination) in sendmmsg
+// batches. Like the fan-out, a failed packet is charged to its owner and
+// skipped. Returns the number of packets sent.
+int send_rtp_prebuilt(int sockfd, RTPPrebuiltPacket *packets, int num_packets);
+// io_uring versions of the two batched sends: one SENDMSG per packet, up to
+// RTP_URING_BATCH of them submitted and reaped with a single io_uring_enter.
+// ring must not have other requests in flight.
+int send_rtp_batch_uring(RtpSession *session,
+    IoUring *ring,
+    int sockfd,
+    struct sockaddr_in *server_addr,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp);
+int send_rtp_fanout_uring(IoUring *ring,
+    int sockfd,
+    RtpDestination *dests,
+    int num_dests,
+    RTPChunk *chunks,
+    int num_chunks,
+    uint32_t timestamp);
 // Low-level API (Internal/Library use)
+void pack_rtp_header(RTPHeader *header, unsigned char *packet);
 void build_rtp_packet(RTPHeader *header, unsigned char *payload, int payload_size, unsigned char *packet);
 void unpack_rtp_header(unsigned char *packet, RTPHeader *header);
-void assign_sequence_number(RTPHeader *header);
+void assign_sequence_number(RtpSession *session, RTPHeader *header);
 void assign_timestamp(RTPHeader *header, uint32_t timestamp);
-void assign_ssrc(RTPHeader *header);
+void assign_ssrc(RtpSession *session, RTPHeader *header);
+// Point msg at header_bytes + payload (no copy), for callers building their own sendmmsg batches
+void fill_rtp_msghdr(struct msghdr *msg, struct iovec iov[2], struct sockaddr_in *server_addr,
+                     unsigned char *header_bytes, unsigned char *payload, int payload_size);
 
 #endif // RTP_H
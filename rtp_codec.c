@@ -0,0 +1,173 @@
+#include "rtp_codec.h"
+#include <string.h>
+
+// Unaligned big-endian loads and stores: memcpy compiles to one move, the
+// swap to one bswap
+static inline uint32_t load_be32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t load_be64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+static inline void store_be32(uint8_t *p, uint32_t v) {
+    v = __builtin_bswap32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void store_be64(uint8_t *p, uint64_t v) {
+    v = __builtin_bswap64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+int rtp_parse(const uint8_t *packet, int length, RtpPacketView *view) {
+    if (length < RTP_HEADER_SIZE) return RTP_PARSE_TOO_SHORT;
+    uint32_t first = load_be32(packet);        // V P X CC | M PT | sequence number
+    uint64_t second = load_be64(packet + 4);   // Timestamp | SSRC
+    if ((first >> 30) != RTP_VERSION) return RTP_PARSE_BAD_VERSION;
+
+    int csrc_count = (first >> 24) & 0x0F;
+    int has_extension = (first >> 28) & 1;
+    int offset = RTP_HEADER_SIZE + 4 * csrc_count;
+    view->marker = (first >> 23) & 1;
+    view->payload_type = (first >> 16) & 0x7F;
+    view->seq = (uint16_t)first;
+    view->timestamp = (uint32_t)(second >> 32);
+    view->ssrc = (uint32_t)second;
+    view->csrc_count = (uint8_t)csrc_count;
+    view->csrcs = packet + RTP_HEADER_SIZE;
+    view->has_extension = (uint8_t)has_extension;
+    view->ext_profile = 0;
+    view->ext_data = NULL;
+    view->ext_length = 0;
+
+    // The extension header needs 4 bytes after the CSRCs, then its body
+    if (has_extension) {
+        if (offset + 4 > length) return RTP_PARSE_TOO_SHORT;
+        uint32_t ext = load_be32(packet + offset);
+        view->ext_profile = (uint16_t)(ext >> 16);
+        view->ext_length = (int)(ext & 0xFFFF) * 4;
+        view->ext_data = packet + offset + 4;
+        offset += 4 + view->ext_length;
+    }
+    if (offset > length) return RTP_PARSE_TOO_SHORT;
+
+    // The last byte counts the padding, itself included
+    int padding = 0;
+    if ((first >> 29) & 1) {
+        padding = packet[length - 1];
+        if (padding == 0 || padding > length - offset) return RTP_PARSE_BAD_PADDING;
+    }
+    view->padding = (uint8_t)padding;
+    view->header_size = offset;
+    view->payload = packet + offset;
+    view->payload_size = length - offset - padding;
+    return RTP_PARSE_OK;
+}
+
+const char *rtp_parse_error(int result) {
+    switch (result) {
+    case RTP_PARSE_OK: return "ok";
+    case RTP_PARSE_TOO_SHORT: return "truncated header";
+    case RTP_PARSE_BAD_VERSION: return "not RTP version 2";
+    case RTP_PARSE_BAD_PADDING: return "invalid padding";
+    default: return "unknown error";
+    }
+}
+
+uint32_t rtp_csrc(const RtpPacketView *view, int index) {
+    return load_be32(view->csrcs + 4 * index);
+}
+
+void rtp_ext_begin(const RtpPacketView *view, RtpExtIterator *it) {
+    it->pos = it->end = view->ext_data;
+    if (view->has_extension) it->end += view->ext_length;
+    if (view->ext_profile == RTP_EXT_PROFILE_ONE_BYTE) it->two_byte = 0;
+    else if ((view->ext_profile & 0xFFF0) == RTP_EXT_PROFILE_TWO_BYTE) it->two_byte = 1;
+    else it->two_byte = -1;
+}
+
+int rtp_ext_next(RtpExtIterator *it, RtpExtElement *element) {
+    if (it->pos == it->end) return 0;
+    if (it->two_byte < 0) return -1;
+    while (it->pos < it->end && *it->pos == 0) it->pos++;  // Padding
+    if (it->pos == it->end) return 0;
+
+    int id, length;
+    if (it->two_byte) {
+        if (it->end - it->pos < 2) return -1;
+        id = it->pos[0];
+        length = it->pos[1];
+        it->pos += 2;
+    } else {
+        id = it->pos[0] >> 4;
+        length = (it->pos[0] & 0x0F) + 1;
+        // Id 15 is reserved: stop processing the extension there
+        if (id == 15) {
+            it->pos = it->end;
+            return 0;
+        }
+        it->pos++;
+    }
+    if (length > it->end - it->pos) return -1;
+    element->id = (uint8_t)id;
+    element->length = (uint8_t)length;
+    element->data = it->pos;
+    it->pos += length;
+    return 1;
+}
+
+int rtp_ext_find(const RtpPacketView *view, uint8_t id, RtpExtElement *element) {
+    RtpExtIterator it;
+    rtp_ext_begin(view, &it);
+    int result;
+    while ((result = rtp_ext_next(&it, element)) > 0) {
+        if (element->id == id) return 1;
+    }
+    return result;
+}
+
+int rtp_write_header(const RtpHeaderFields *fields, uint8_t *out, int capacity) {
+    if (fields->csrc_count < 0 || fields->csrc_count > RTP_MAX_CSRC || fields->payload_type > 0x7F) return -1;
+    int ext_words = fields->has_extension ? (fields->ext_length + 3) / 4 : 0;
+    if (ext_words > 0xFFFF) return -1;
+    int size = RTP_HEADER_SIZE + 4 * fields->csrc_count + (fields->has_extension ? 4 + 4 * ext_words : 0);
+    if (size > capacity) return -1;
+
+    uint32_t first = (uint32_t)RTP_VERSION << 30 | (uint32_t)(fields->has_extension ? 1 : 0) << 28 |
+                     (uint32_t)fields->csrc_count << 24 | (uint32_t)(fields->marker ? 1 : 0) << 23 |
+                     (uint32_t)fields->payload_type << 16 | fields->seq;
+    store_be32(out, first);
+    store_be64(out + 4, (uint64_t)fields->timestamp << 32 | fields->ssrc);
+    uint8_t *p = out + RTP_HEADER_SIZE;
+    for (int i = 0; i < fields->csrc_count; i++, p += 4) store_be32(p, fields->csrcs[i]);
+    if (fields->has_extension) {
+        store_be32(p, (uint32_t)fields->ext_profile << 16 | (uint32_t)ext_words);
+        p += 4;
+        if (fields->ext_length > 0) memcpy(p, fields->ext_data, fields->ext_length);
+        memset(p + fields->ext_length, 0, ext_words * 4 - fields->ext_length);
+    }
+    return size;
+}
+
+int rtp_ext_append(uint8_t *buf, int capacity, int *length, int two_byte,
+                   uint8_t id, const uint8_t *data, int data_length) {
+    if (two_byte) {
+        if (id == 0 || data_length < 0 || data_length > RTP_EXT_TWO_BYTE_MAX) return -1;
+        if (*length + 2 + data_length > capacity) return -1;
+        buf[(*length)++] = id;
+        buf[(*length)++] = (uint8_t)data_length;
+    } else {
+        if (id == 0 || id == 15 || data_length < 1 || data_length > RTP_EXT_ONE_BYTE_MAX) return -1;
+        if (*length + 1 + data_length > capacity) return -1;
+        buf[(*length)++] = (uint8_t)(id << 4 | (data_length - 1));
+    }
+    memcpy(buf + *length, data, data_length);
+    *length += data_length;
+    return 0;
+}
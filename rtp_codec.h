@@ -0,0 +1,94 @@
+#ifndef RTP_CODEC_H
+#define RTP_CODEC_H
+
+#include <stdint.h>
+#include "rtp.h"
+
+// Full RFC 3550 header codec: version check, CSRC list, header extension
+// (RFC 8285 one-byte and two-byte elements) and padding removal. Parsing
+// reads the fixed header with two wide big-endian loads and returns views
+// into the packet, so nothing is copied or allocated. Structural errors
+// (lengths that do not add up) are caught by rtp_parse with a handful of
+// compares; extension elements are only walked when asked for.
+
+#define RTP_VERSION 2
+#define RTP_MAX_CSRC 15
+#define RTP_EXT_PROFILE_ONE_BYTE 0xBEDE    // RFC 8285 section 4.2
+#define RTP_EXT_PROFILE_TWO_BYTE 0x1000    // Low 4 bits are application bits (section 4.3)
+#define RTP_EXT_ONE_BYTE_MAX 16            // Data bytes per one-byte element (ids 1-14)
+#define RTP_EXT_TWO_BYTE_MAX 255           // Data bytes per two-byte element (ids 1-255)
+
+// rtp_parse results
+#define RTP_PARSE_OK 0
+#define RTP_PARSE_TOO_SHORT -1      // Shorter than the fixed header, CSRCs or extension
+#define RTP_PARSE_BAD_VERSION -2
+#define RTP_PARSE_BAD_PADDING -3    // Padding count of 0 or past the header
+
+// One parsed packet; the pointers point into the packet passed to rtp_parse
+typedef struct {
+    uint8_t marker;
+    uint8_t payload_type;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t csrc_count;
+    uint8_t has_extension;
+    uint8_t padding;            // Padding bytes removed from the end (0 = none)
+    uint16_t ext_profile;       // "Defined by profile" field, 0xBEDE for one-byte elements
+    const uint8_t *csrcs;       // csrc_count big-endian words, read with rtp_csrc
+    const uint8_t *ext_data;    // Extension body (after the 4-byte extension header)
+    int ext_length;             // In bytes, a multiple of 4
+    const uint8_t *payload;
+    int payload_size;           // Without padding
+    int header_size;            // Fixed header + CSRCs + extension
+} RtpPacketView;
+
+// One header extension element (a view into the extension body)
+typedef struct {
+    uint8_t id;
+    uint8_t length;
+    const uint8_t *data;
+} RtpExtElement;
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    int two_byte;               // 0 = one-byte elements, 1 = two-byte, -1 = other profile
+} RtpExtIterator;
+
+// Fields for rtp_write_header
+typedef struct {
+    uint8_t marker;
+    uint8_t payload_type;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    int csrc_count;
+    uint32_t csrcs[RTP_MAX_CSRC];
+    int has_extension;
+    uint16_t ext_profile;
+    const uint8_t *ext_data;    // Extension body, e.g. built with rtp_ext_append
+    int ext_length;             // Zero-padded to a multiple of 4 on the wire
+} RtpHeaderFields;
+
+int rtp_parse(const uint8_t *packet, int length, RtpPacketView *view);
+const char *rtp_parse_error(int result);
+uint32_t rtp_csrc(const RtpPacketView *view, int index);
+
+// Walk the extension elements. rtp_ext_next returns 1 with an element, 0 at
+// the end, -1 if the elements overrun the extension (or the profile is not
+// RFC 8285). Padding bytes between elements are skipped.
+void rtp_ext_begin(const RtpPacketView *view, RtpExtIterator *it);
+int rtp_ext_next(RtpExtIterator *it, RtpExtElement *element);
+// First element with this id: 1 if found, 0 if not, -1 if malformed
+int rtp_ext_find(const RtpPacketView *view, uint8_t id, RtpExtElement *element);
+
+// Serialize the header (fixed part, CSRCs, extension). Returns its size, or
+// -1 if it does not fit in capacity or a field is out of range.
+int rtp_write_header(const RtpHeaderFields *fields, uint8_t *out, int capacity);
+// Append one RFC 8285 element to an extension body being built in buf.
+// Returns 0, or -1 if it does not fit or the id/length are invalid for the form.
+int rtp_ext_append(uint8_t *buf, int capacity, int *length, int two_byte,
+                   uint8_t id, const uint8_t *data, int data_length);
+
+#endif // RTP_CODEC_H
@@ -3,33 +3,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
-#include <time.h>
 
-
-
-
-// Function to assign the timestamp
-void assign_sequence_number(RTPHeader *header) {
-    //random initial sequence number then increment by 1 for each packet
-    static uint16_t seq = 0;  // Static variable to persist sequence number across function calls
-    static int initialized = 0;
-    if (!initialized) {
-        srand(time(NULL));
-        seq = (uint16_t)(rand() & 0xFFFF);  // Random initial sequence number
-        initialized = 1;
-    }
-    header->seq = seq++;
+// Next sequence number of the session's stream
+void assign_sequence_number(RtpSession *session, RTPHeader *header) {
+    header->seq = session->seq++;
 }
 
 void assign_timestamp(RTPHeader *header, uint32_t timestamp) {
     header->timestamp = timestamp;
 }
 
-void assign_ssrc(RTPHeader *header) {
-    header->ssrc = (uint32_t)rand() << 16 | (uint32_t)rand();
+// The SSRC identifies the stream, so it is chosen once per session (rtp_session_init)
+void assign_ssrc(RtpSession *session, RTPHeader *header) {
+    header->ssrc = session->ssrc;
 }
 
-void build_rtp_packet(RTPHeader *header, unsigned char *payload, int payload_size, unsigned char *packet) {
+// Serialize only the 12-byte RTP header (the payload can then be sent separately via iovec)
+void pack_rtp_header(RTPHeader *header, unsigned char *packet) {
     // Manually pack RTP header fields into bytes (bitfield layout is compiler-dependent)
     packet[0] = (header->V << 6) | (header->P << 5) | (header->X << 4) | header->CC;
     packet[1] = (header->M << 7) | header->PT;
@@ -43,6 +33,11 @@ void build_rtp_packet(RTPHeader *header, unsigned char *payload, int payload_siz
     packet[9] = (header->ssrc >> 16) & 0xFF;
     packet[10] = (header->ssrc >> 8) & 0xFF;
     packet[11] = header->ssrc & 0xFF;
+}
+
+// Build a contiguous packet (header + copy of the payload) for callers that need one
+void build_rtp_packet(RTPHeader *header, unsigned char *payload, int payload_size, unsigned char *packet) {
+    pack_rtp_header(header, packet);
 
     // Copy payload data after header (starting from index 12)
     memcpy(packet + RTP_HEADER_SIZE, payload, payload_size);
@@ -0,0 +1,158 @@
+// Live view of a sender or receiver started with --metrics NAME: reads its
+// shared-memory counters without touching the process.
+//
+//   rtpstat                   list the segments in /dev/shm
+//   rtpstat NAME [--interval MS] [--count N]
+//
+// Every interval prints one line per stream, with packet and bit rates over
+// the interval and the cumulative counters.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <dirent.h>
+#include "metrics.h"
+
+#define RTPSTAT_DEFAULT_INTERVAL_MS 1000
+
+static int64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static const char *role_name(uint64_t role) {
+    return role == METRICS_ROLE_SENDER ? "sender" : role == METRICS_ROLE_RECEIVER ? "receiver" : "?";
+}
+
+// Segments whose owner is gone are left behind by a crash: flag them.
+// EPERM means the process exists but belongs to another user.
+static int process_alive(uint64_t pid) {
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+static int list_segments(void) {
+    DIR *dir = opendir("/dev/shm");
+    if (!dir) {
+        perror("/dev/shm");
+        return 1;
+    }
+    int found = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "rtp-", 4) != 0) continue;
+        const char *name = entry->d_name + 4;
+        MetricsSegment *segment = metrics_attach(name);
+        if (!segment) continue;
+        int streams = 0;
+        MetricsStream copy;
+        for (int i = 0; i < METRICS_MAX_STREAMS; i++) {
+            if (metrics_read_stream(&segment->streams[i], &copy) == 0) streams++;
+        }
+        printf("%-20s %-8s pid %-8lu %d streams, up %.0f s%s\n", name, role_name(segment->role),
+               (unsigned long)segment->pid, streams, (now_us() - segment->started_us) / 1e6,
+               process_alive(segment->pid) ? "" : " (stale)");
+        metrics_detach(segment);
+        found++;
+    }
+    closedir(dir);
+    if (found == 0) printf("No metrics segments (start the sender or receiver with --metrics NAME)\n");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *name = NULL;
+    int interval_ms = RTPSTAT_DEFAULT_INTERVAL_MS;
+    long count = 0;  // 0 = until the process goes away
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+            if (interval_ms < 10) {
+                fprintf(stderr, "Interval must be at least 10 ms\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = atol(argv[++i]);
+        } else if (argv[i][0] != '-' && !name) {
+            name = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [NAME] [--interval MS] [--count N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!name) return list_segments();
+
+    MetricsSegment *segment = metrics_attach(name);
+    if (!segment) {
+        fprintf(stderr, "No metrics segment /dev/shm/rtp-%s (or a different layout version)\n", name);
+        return 1;
+    }
+    int receiver = segment->role == METRICS_ROLE_RECEIVER;
+    printf("%s pid %lu", role_name(segment->role), (unsigned long)segment->pid);
+    if (receiver) printf(", %lu worker(s)", (unsigned long)segment->num_workers);
+    printf("\n");
+
+    // Previous sample of each slot, to turn counters into rates
+    MetricsStream previous[METRICS_MAX_STREAMS];
+    int have_previous[METRICS_MAX_STREAMS];
+    memset(have_previous, 0, sizeof(have_previous));
+    int64_t previous_us = now_us();
+
+    for (long tick = 0; count == 0 || tick < count; tick++) {
+        usleep(interval_ms * 1000);
+        if (!process_alive(segment->pid)) {
+            printf("%s pid %lu exited\n", role_name(segment->role), (unsigned long)segment->pid);
+            break;
+        }
+        int64_t now = now_us();
+        double seconds = (now - previous_us) / 1e6;
+        previous_us = now;
+
+        if (receiver) {
+            uint64_t packets = 0, drops = 0;
+            for (uint64_t w = 0; w < segment->num_workers && w < METRICS_MAX_WORKERS; w++) {
+                packets += METRICS_GET(segment, worker_packets[w]);
+                drops += METRICS_GET(segment, worker_kernel_drops[w]);
+            }
+            printf("-- %.1f s: %lu packets received, %lu kernel drops\n", (now - segment->started_us) / 1e6,
+                   (unsigned long)packets, (unsigned long)drops);
+        } else {
+            printf("-- %.1f s\n", (now - segment->started_us) / 1e6);
+        }
+
+        for (int i = 0; i < METRICS_MAX_STREAMS; i++) {
+            MetricsStream s;
+            if (metrics_read_stream(&segment->streams[i], &s) < 0) {
+                have_previous[i] = 0;
+                continue;
+            }
+            // A slot reused by a new stream starts its rates over
+            if (have_previous[i] && previous[i].ssrc != s.ssrc) have_previous[i] = 0;
+            double pps = have_previous[i] ? (s.packets - previous[i].packets) / seconds : 0;
+            double kbps = have_previous[i] ? (s.bytes - previous[i].bytes) * 8 / seconds / 1000 : 0;
+            previous[i] = s;
+            have_previous[i] = 1;
+
+            printf("  ssrc 0x%08lx w%lu %8.0f pkt/s %8.0f kbit/s  pkts %lu lost %ld",
+                   (unsigned long)s.ssrc, (unsigned long)s.worker, pps, kbps, (unsigned long)s.packets, (long)s.lost);
+            if (receiver) {
+                printf(" reord %lu dup %lu rec %lu late %lu  buf %ld  jitter %.2f/%.2f ms  delay %ld ms\n",
+                       (unsigned long)s.reordered, (unsigned long)s.duplicates, (unsigned long)s.recovered,
+                       (unsigned long)s.late, (long)s.occupancy, s.avg_jitter_us / 1000.0, s.max_jitter_us / 1000.0,
+                       (long)s.playout_delay_ms);
+            } else {
+                printf(" (%.1f%% last report)  jitter %.2f ms", s.fraction_lost * 100.0 / 256, s.avg_jitter_us / 1000.0);
+                if (s.rtt_us >= 0) printf("  RTT %.1f ms", s.rtt_us / 1000.0);
+                if (s.target_bps > 0) printf("  target %.0f kbit/s", s.target_bps / 1000.0);
+                printf("\n");
+            }
+        }
+        fflush(stdout);
+    }
+    metrics_detach(segment);
+    return 0;
+}
@@ -1,127 +1,1245 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <time.h>
+#include <poll.h>
 #include "rtp.h"
-#include "rtp.c"
+#include "log.h"
+#include "pacer.h"
+#include "media_source.h"
+#include "mp4_demux.h"
+#include "h264_packetizer.h"
+#include "fec.h"
+#include "fec_kernels.h"
+#include "nack.h"
+#include "rtcp.h"
+#include "congestion.h"
+#include "metrics.h"
 
 // Video streaming parameters
 #define VIDEO_FPS 5
 #define FRAME_DURATION_US (1000000 / VIDEO_FPS)  // ~33333 microseconds per frame
+#define FRAME_DURATION_NS (1000000000LL / VIDEO_FPS)
 #define PACKETS_PER_FRAME 10  // Simulate 10 packets per video frame
-#define RTP_CLOCK_RATE 90000  // Standard RTP clock rate for video (90 kHz)
+#define FRAME_BYTES (PACKETS_PER_FRAME * CHUNK_SIZE)
+#define RECEIVER_PORT 5000
+#define MAX_DESTINATIONS 4096  // Fan-out limit (--dest / --dest-file)
+#define FEEDBACK_LINGER_MS 500  // Keep answering NACKs and reading reports this long after the last frame
+#define MAX_RENDITIONS 8       // The input plus --rendition files
+#define RENDITION_HOLD_NS 2000000000LL  // Stay on a rendition this long before stepping up
+#define RENDITION_PROBE_NS 5000000000LL // Quiet time on a lower rendition before probing the next one up
+#define CC_UPDATE_NS 100000000LL        // Combine the destinations' estimates this often
+#define CC_STALE_NS 2000000000LL        // Estimates without feedback this long are left out
+
+// Microseconds spent so far, used to measure the cost of the send path
+static long elapsed_since_us(struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec);
+}
+
+// User + system CPU time of this process in microseconds
+static long cpu_time_us(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Parse "IP" or "IP:PORT" (default port 5000). Returns 0 on success, -1 if invalid.
+static int parse_destination(const char *spec, struct sockaddr_in *addr) {
+    char host[64];
+    int port = RECEIVER_PORT;
+    const char *colon = strchr(spec, ':');
+    size_t host_len = colon ? (size_t)(colon - spec) : strlen(spec);
+    if (host_len == 0 || host_len >= sizeof(host)) return -1;
+    memcpy(host, spec, host_len);
+    host[host_len] = '\0';
+    if (colon) {
+        port = atoi(colon + 1);
+        if (port < 1 || port > 65535) return -1;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+// Track time (timescale units) to nanoseconds
+static int64_t sample_time_ns(const Mp4VideoTrack *track, uint64_t time) {
+    return (int64_t)((double)time * 1e9 / track->timescale);
+}
+
+// One encoding of the asset. All renditions share the frame timeline: frame
+// f of every rendition covers the same media time, so the sender can switch
+// between them at any frame boundary (at sync samples for H.264).
+typedef struct {
+    const char *path;
+    MediaSource *source;
+    Mp4VideoTrack *track;     // --h264
+    long size;
+} Rendition;
+
+// Average bitrate of an H.264 track over its duration
+static double track_bitrate(const Mp4VideoTrack *track) {
+    double bytes = 0;
+    for (int i = 0; i < track->num_samples; i++) bytes += track->samples[i].size;
+    uint64_t span = track->samples[track->num_samples - 1].dts - track->samples[0].dts;
+    double seconds = sample_time_ns(track, span) / 1e9;
+    if (track->num_samples > 1) seconds += seconds / (track->num_samples - 1);  // The last sample's duration
+    return seconds > 0 ? bytes * 8 / seconds : 0;
+}
+
+// Counters of one destination into its shared-memory slot, for rtpstat.
+// Loss, jitter and RTT are what the destination's receiver reports said.
+static void publish_destination_metrics(MetricsStream *m, RtpDestination *dest, CcEstimator *cc, int64_t now_ns) {
+    metrics_begin_update(m);
+    METRICS_SET(m, packets, dest->media.packets_sent);
+    METRICS_SET(m, bytes, dest->media.octets_sent);
+    METRICS_SET(m, lost, dest->cumulative_lost);
+    METRICS_SET(m, avg_jitter_us, (int64_t)dest->jitter * 1000000 / RTP_CLOCK_RATE);
+    METRICS_SET(m, rtt_us, dest->rtt_us);
+    METRICS_SET(m, fraction_lost, dest->fraction_lost);
+    if (cc) METRICS_SET(m, target_bps, (int64_t)cc->target_bps);
+    metrics_end_update(m, now_ns / 1000);
+}
+
+// Send syscalls made so far: socket calls charged to the destinations'
+// sessions plus io_uring_enter calls
+static long count_send_calls(RtpDestination *dests, int num_dests, IoUring *uring) {
+    long calls = uring ? uring->enters : 0;
+    for (int d = 0; d < num_dests; d++) calls += dests[d].media.send_calls;
+    return calls;
+}
+
+// Send the parity packets of the closed FEC block to every destination. Each
+// destination gets its own FEC header (its SSRC, the block's first sequence
+// number and timestamp); the parity bytes are shared. Returns packets sent.
+static int send_fec_parity(int sockfd, RtpDestination *dests, int num_dests, FecEncoder *fec) {
+    int total = fec->num_parity * num_dests;
+    int total_sent = 0;
+
+    for (int base = 0; base < total; base += RTP_MAX_BATCH) {
+        int batch = total - base;
+        if (batch > RTP_MAX_BATCH) batch = RTP_MAX_BATCH;
+
+        unsigned char header_bytes[RTP_MAX_BATCH][RTP_HEADER_SIZE + FEC_HEADER_SIZE];
+        RTPPrebuiltPacket packets[RTP_MAX_BATCH];
+
+        for (int i = 0; i < batch; i++) {
+            int p = (base + i) / num_dests;
+            RtpDestination *dest = &dests[(base + i) % num_dests];
+            uint32_t block_timestamp = dest->media.timestamp_base + fec->first_timestamp;
+
+            RTPHeader header;
+            header.V = 2;
+            header.P = 0;
+            header.X = 0;
+            header.CC = 0;
+            header.M = 0;
+            header.PT = RTP_PT_FEC;
+            header.seq = dest->fec_seq++;
+            header.ssrc = dest->fec_ssrc;
+            assign_timestamp(&header, block_timestamp);
+            pack_rtp_header(&header, header_bytes[i]);
+
+            FecHeader fec_header;
+            fec_header.protected_ssrc = dest->media.ssrc;
+            fec_header.base_seq = (uint16_t)(dest->media.seq - fec->count);  // The block was just sent to this destination
+            fec_header.timestamp_base = block_timestamp;
+            fec_header.kind = fec->kinds[p];
+            fec_header.index = fec->indices[p];
+            fec_header.block_size = fec->count;
+            fec_header.columns = fec->scheme == FEC_SCHEME_RS ? fec->rs_parity : fec->columns;
+            fec_header.unit_size = fec->unit_size;
+            fec_pack_header(&fec_header, header_bytes[i] + RTP_HEADER_SIZE);
+
+            packets[i].addr = &dest->addr;
+            packets[i].header = header_bytes[i];
+            packets[i].header_size = RTP_HEADER_SIZE + FEC_HEADER_SIZE;
+            packets[i].payload = fec->parity_data[p];
+            packets[i].payload_size = fec->unit_size;
+            packets[i].owner = &dest->media;
+        }
+        total_sent += send_rtp_prebuilt(sockfd, packets, batch);
+    }
+    return total_sent;
+}
+
+// Retransmit one packet from the history to the destination that asked for it
+// (RFC 4588: own SSRC and sequence numbers, original sequence number in front
+// of the payload). Returns the bytes sent, or 0 if it left the history.
+static int send_rtx_packet(int sockfd, RtpDestination *dest, RtxHistory *history, uint16_t seq) {
+    // Every destination has been sent the same packets, so the age is the same for all
+    int pos = rtx_history_lookup(history, (uint16_t)(dest->media.seq - 1 - seq));
+    if (pos < 0) {
+        history->expired++;
+        return 0;
+    }
+
+    unsigned char header_bytes[RTP_HEADER_SIZE + RTX_OSN_SIZE];
+    RTPHeader header;
+    header.V = 2;
+    header.P = 0;
+    header.X = 0;
+    header.CC = 0;
+    header.M = history->markers[pos];
+    header.PT = RTP_PT_RTX;
+    header.seq = dest->rtx_seq++;
+    header.ssrc = dest->rtx_ssrc;
+    assign_timestamp(&header, dest->media.timestamp_base + history->timestamps[pos]);
+    pack_rtp_header(&header, header_bytes);
+    header_bytes[RTP_HEADER_SIZE] = seq >> 8;
+    header_bytes[RTP_HEADER_SIZE + 1] = seq & 0xFF;
+
+    struct msghdr msg;
+    struct iovec iov[2];
+    fill_rtp_msghdr(&msg, iov, &dest->addr, header_bytes,
+                    history->payloads + (size_t)pos * RTX_PAYLOAD_MAX, history->sizes[pos]);
+    iov[0].iov_len = sizeof(header_bytes);
+    int sent = sendmsg(sockfd, &msg, 0);
+    dest->media.send_calls++;
+    if (sent < 0) {
+        dest->media.send_errors++;
+        return 0;
+    }
+    history->retransmitted++;
+    return sent;
+}
+
+// Feedback of the fan-out path: NACKs answered from the history, RTCP sender
+// reports out and receiver reports in. Each destination is its own RTP
+// session of two members (us and the receiver).
+typedef struct {
+    int sockfd;
+    RtpDestination *dests;
+    int num_dests;
+    Pacer *pacer;
+    RtxHistory *history;       // NULL without --nack
+    int reports;               // Send SRs and read RRs (--rtcp)
+    char cname[96];
+    double session_bandwidth;  // Octets/s to one destination, for the report interval
+    double avg_rtcp_size;      // Octets per compound RTCP packet, UDP/IP headers included
+    int initial;               // No report sent yet
+    int64_t next_report_ns;
+    uint32_t media_timestamp;  // Last frame sent (without the destination's base) and when
+    int64_t media_sent_ns;
+    long reports_sent;
+    long reports_received;
+    // Congestion control (--cc): one estimate per destination, the pacer
+    // follows the lowest of those with recent feedback
+    CcSendHistory *cc_history;
+    CcEstimator *cc;
+    double cc_target_bps;
+    double cc_lowest_bps;      // Over the whole stream
+    int64_t cc_next_update_ns;
+    long burst_bytes;
+    long feedback_received;
+} SenderFeedback;
+
+// Next SR after the RFC 3550 interval: 5% of the session bandwidth, a quarter
+// of that for the sender, no shorter than the reduced minimum of section 6.2
+static void schedule_sender_report(SenderFeedback *fb) {
+    double interval = rtcp_interval(2, 1, fb->session_bandwidth * RTCP_BANDWIDTH_FRACTION, 1, fb->avg_rtcp_size,
+                                    rtcp_reduced_min_interval(fb->session_bandwidth), fb->initial);
+    fb->next_report_ns = pacer_now_ns() + (int64_t)(interval * 1e9);
+}
+
+// One SR (plus CNAME) to every destination, stamped with the media time of now
+static void send_sender_reports(SenderFeedback *fb) {
+    if (fb->media_sent_ns == 0) {
+        schedule_sender_report(fb);  // Nothing sent yet, nothing to report
+        return;
+    }
+    unsigned char packet[RTCP_MAX_PACKET];
+    int64_t now_ns = pacer_now_ns();
+    uint32_t media_now = fb->media_timestamp + (uint32_t)((now_ns - fb->media_sent_ns) * RTP_CLOCK_RATE / 1000000000LL);
+    int length = 0;
+    for (int d = 0; d < fb->num_dests; d++) {
+        RtpDestination *dest = &fb->dests[d];
+        RtcpSenderInfo info;
+        info.ssrc = dest->media.ssrc;
+        info.ntp_time = rtcp_ntp_now();
+        info.rtp_timestamp = dest->media.timestamp_base + media_now;
+        info.packet_count = (uint32_t)dest->media.packets_sent;
+        info.octet_count = (uint32_t)dest->media.octets_sent;
+        length = rtcp_pack_report(packet, sizeof(packet), &info, 0, NULL, 0, fb->cname);
+        dest->media.send_calls++;
+        if (sendto(fb->sockfd, packet, length, 0, (struct sockaddr *)&dest->addr, sizeof(dest->addr)) < 0) {
+            dest->media.send_errors++;
+            continue;
+        }
+        fb->reports_sent++;
+    }
+    fb->avg_rtcp_size += (length + RTCP_UDP_IP_OVERHEAD - fb->avg_rtcp_size) / 16;
+    fb->initial = 0;
+    schedule_sender_report(fb);
+}
+
+// Take what a receiver report says about our destinations
+static void receive_receiver_report(SenderFeedback *fb, const RtcpReport *report, int length) {
+    uint64_t ntp_now = rtcp_ntp_now();
+    for (int b = 0; b < report->num_blocks; b++) {
+        const RtcpReportBlock *block = &report->blocks[b];
+        RtpDestination *dest = NULL;
+        for (int d = 0; d < fb->num_dests && !dest; d++) {
+            if (fb->dests[d].media.ssrc == block->ssrc) dest = &fb->dests[d];
+        }
+        if (!dest) continue;
+        dest->reports_received++;
+        dest->fraction_lost = block->fraction_lost;
+        dest->cumulative_lost = block->cumulative_lost;
+        dest->jitter = block->jitter;
+        int64_t rtt = rtcp_round_trip_us(block, ntp_now);
+        if (rtt >= 0) dest->rtt_us = rtt;
+
+        if (fb->num_dests == 1) {
+            LOG_INFO("[RTCP] Receiver report: loss %.1f%% (%d total), jitter %.2f ms, highest seq %u, RTT %.1f ms\n",
+                     block->fraction_lost * 100.0 / 256, block->cumulative_lost,
+                     block->jitter * 1000.0 / RTP_CLOCK_RATE, block->highest_seq, dest->rtt_us / 1000.0);
+        } else {
+            LOG_DEBUG("[RTCP] ssrc=0x%08x: loss %.1f%%, jitter %u, RTT %.1f ms\n", block->ssrc,
+                      block->fraction_lost * 100.0 / 256, block->jitter, dest->rtt_us / 1000.0);
+        }
+    }
+    fb->reports_received++;
+    fb->avg_rtcp_size += (length + RTCP_UDP_IP_OVERHEAD - fb->avg_rtcp_size) / 16;
+}
+
+// Pace at the lowest target of the destinations that still send feedback
+// (every destination gets the same stream, so the slowest path sets the rate)
+static void update_congestion_target(SenderFeedback *fb, int64_t now_ns) {
+    double target = 0;
+    for (int d = 0; d < fb->num_dests; d++) {
+        CcEstimator *cc = &fb->cc[d];
+        if (cc->feedback_received == 0 || now_ns - cc->last_feedback_ns > CC_STALE_NS) continue;
+        if (target == 0 || cc->target_bps < target) target = cc->target_bps;
+    }
+    fb->cc_next_update_ns = now_ns + CC_UPDATE_NS;
+    if (target == 0 || target == fb->cc_target_bps) return;
+
+    LOG_DEBUG("[CC] Target %.0f kbit/s (was %.0f)\n", target / 1000, fb->cc_target_bps / 1000);
+    fb->cc_target_bps = target;
+    if (target < fb->cc_lowest_bps) fb->cc_lowest_bps = target;
+    pacer_set_token_bucket(fb->pacer, target * fb->num_dests, fb->burst_bytes * fb->num_dests);
+}
+
+static long congestion_overuses(const SenderFeedback *fb) {
+    long overuses = 0;
+    for (int d = 0; d < fb->num_dests; d++) overuses += fb->cc[d].overuses;
+    return overuses;
+}
+
+// Congestion control feedback from one destination
+static void receive_congestion_feedback(SenderFeedback *fb, const unsigned char *packet, int length) {
+    int64_t delays_us[RTCP_CCFB_MAX_REPORTS];
+    uint32_t media_ssrc, report_timestamp;
+    uint16_t begin_seq;
+    int count = rtcp_unpack_ccfb(packet, length, &media_ssrc, &begin_seq, delays_us, RTCP_CCFB_MAX_REPORTS,
+                                 &report_timestamp);
+    if (count <= 0) return;
+    for (int d = 0; d < fb->num_dests; d++) {
+        RtpDestination *dest = &fb->dests[d];
+        if (dest->media.ssrc != media_ssrc) continue;
+        int64_t now_ns = pacer_now_ns();
+        CcEstimator *cc = &fb->cc[d];
+        int signal = cc->signal;
+        cc_estimator_on_feedback(cc, fb->cc_history, dest->media.seq, begin_seq, delays_us, count,
+                                 report_timestamp, dest->rtt_us, now_ns);
+        fb->feedback_received++;
+        if (cc->signal != signal) {
+            LOG_DEBUG("[CC] ssrc=0x%08x: %s, target %.0f kbit/s, acked %.0f kbit/s\n", media_ssrc,
+                      cc_signal_name(cc->signal), cc->target_bps / 1000, cc->acked_bps / 1000);
+        }
+        if (now_ns >= fb->cc_next_update_ns || cc->target_bps < fb->cc_target_bps) {
+            update_congestion_target(fb, now_ns);
+        }
+        return;
+    }
+}
+
+// Answer every NACK queued on the socket and take in receiver reports and
+// congestion control feedback.
+// Retransmissions spend tokens like any other packet, but are sent right
+// away: they are already late.
+static void serve_feedback(SenderFeedback *fb) {
+    unsigned char packet[RTCP_MAX_PACKET];
+    uint16_t seqs[RTCP_NACK_MAX_SEQS];
+    RtcpReport report;
+    int n;
+    while ((n = recv(fb->sockfd, packet, sizeof(packet), MSG_DONTWAIT)) >= 0) {
+        if (!rtcp_is_rtcp(packet, n)) continue;
+        if (fb->reports && rtcp_unpack_report(packet, n, &report) == 0) {
+            receive_receiver_report(fb, &report, n);
+            continue;
+        }
+        if (fb->cc && packet[1] == RTCP_PT_RTPFB && (packet[0] & 0x1F) == RTCP_FMT_CCFB) {
+            receive_congestion_feedback(fb, packet, n);
+            continue;
+        }
+
+        uint32_t media_ssrc;
+        int count = fb->history ? rtcp_unpack_nack(packet, n, &media_ssrc, seqs, RTCP_NACK_MAX_SEQS) : -1;
+        if (count < 0) continue;
+
+        RtpDestination *dest = NULL;
+        for (int d = 0; d < fb->num_dests && !dest; d++) {
+            if (fb->dests[d].media.ssrc == media_ssrc) dest = &fb->dests[d];
+        }
+        if (!dest) continue;
+        fb->history->nacks_received++;
+
+        long bytes = 0;
+        for (int i = 0; i < count; i++) {
+            bytes += send_rtx_packet(fb->sockfd, dest, fb->history, seqs[i]);
+        }
+        pacer_schedule(fb->pacer, pacer_now_ns(), (int)bytes);
+        LOG_DEBUG("[NACK] ssrc=0x%08x asked for %d packets from seq=%u\n", media_ssrc, count, seqs[0]);
+    }
+}
+
+// pacer_wait_until that serves feedback while it waits: poll the socket
+// until shortly before the deadline, then take the precise sleep. Sender
+// reports that fall due in the meantime go out on time.
+static void wait_serving_feedback(SenderFeedback *fb, int64_t deadline_ns) {
+    for (;;) {
+        int64_t now_ns = pacer_now_ns();
+        if (fb->reports && now_ns >= fb->next_report_ns) send_sender_reports(fb);
+        int64_t remaining_ms = (deadline_ns - now_ns) / 1000000;
+        if (remaining_ms < 2) break;
+        int64_t timeout_ms = remaining_ms - 1;
+        if (fb->reports && (fb->next_report_ns - now_ns) / 1000000 + 1 < timeout_ms) {
+            timeout_ms = (fb->next_report_ns - now_ns) / 1000000 + 1;
+        }
+        struct pollfd pfd = { fb->sockfd, POLLIN, 0 };
+        if (poll(&pfd, 1, (int)timeout_ms) > 0) {
+            serve_feedback(fb);
+        }
+    }
+    pacer_wait_until(fb->pacer, deadline_ns);
+}
 
 int main(int argc, char *argv[]) {
+    int64_t process_start_ns = pacer_now_ns();
+    int batch_mode = 0;
+    int use_uring = 0;        // Send each frame through io_uring (--io-uring)
+    int log_level = LOG_LEVEL_INFO;
+    int multicast_ttl = 1;
+    double rate_kbps = 0;     // Token-bucket bitrate, 0 = frame pacing only
+    long burst_bytes = PACKETS_PER_FRAME * (RTP_HEADER_SIZE + CHUNK_SIZE);
+    int micro_burst = 1;      // Packets released together in per-packet mode
+    int follow_input = 0;     // Stream a growing file or pipe
+    size_t window_bytes = MEDIA_WINDOW_SIZE;
+    int h264_mode = 0;        // Packetize the MP4's H.264 track per RFC 6184
+    int fec_scheme = FEC_SCHEME_NONE;
+    int fec_param = 0;        // L (XOR) or M (Reed-Solomon), 0 = default
+    int fec_block = FEC_DEFAULT_BLOCK;
+    int fec_group = 1;        // Frames per FEC block (a block also closes when full)
+    int nack_enabled = 0;     // Keep a history and answer NACKs with retransmissions
+    int rtx_history_size = RTX_DEFAULT_HISTORY;
+    int rtcp_enabled = 0;     // Periodic sender reports, receiver reports read back
+    int cc_enabled = 0;       // Pace at the rate the receivers' feedback allows
+    double cc_min_kbps = CC_DEFAULT_MIN_KBPS;
+    double cc_max_kbps = CC_DEFAULT_MAX_KBPS;
+    const char *rendition_paths[MAX_RENDITIONS];
+    int num_renditions = 1;   // The input, then --rendition files
+    const char *metrics_name = NULL;  // Publish live counters to /dev/shm/rtp-NAME
+    struct sockaddr_in *dest_addrs = (struct sockaddr_in *)malloc(MAX_DESTINATIONS * sizeof(struct sockaddr_in));
+    int num_dests = 0;
+
     // Open image file for reading
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <video_file> <receiver_ip> \n", argv[0]);
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <video_file> <receiver_ip[:port]> [--batch] [--dest IP[:PORT]]... "
+                "[--dest-file FILE] [--ttl N] [--rate KBPS] [--burst BYTES] [--micro-burst N] [--follow] [--window BYTES] [--h264] [--fec xor|xor2d|rs[:N]] [--fec-block PACKETS] [--fec-group FRAMES] [--nack] [--nack-history PACKETS] [--rtcp] [--cc] [--cc-min KBPS] [--cc-max KBPS] [--rendition FILE]... [--io-uring] [--metrics NAME] [--log-level LEVEL]\n", argv[0]);
         return 1;
     }
-    FILE *image_file = fopen(argv[1], "rb");
-    char *ip = argv[2];
-    if (!image_file) {
-        perror("Unable to open image file");
+    if (parse_destination(argv[2], &dest_addrs[num_dests++]) < 0) {
+        fprintf(stderr, "Invalid receiver address: %s\n", argv[2]);
         return 1;
     }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            batch_mode = 1;  // One sendmmsg per frame instead of one sendto per packet
+        } else if (strcmp(argv[i], "--io-uring") == 0) {
+            use_uring = 1;   // Frames are batched as with --batch, submitted with io_uring_enter
+            batch_mode = 1;
+        } else if (strcmp(argv[i], "--dest") == 0 && i + 1 < argc) {
+            // Extra receivers of the same stream (fan-out)
+            if (num_dests == MAX_DESTINATIONS || parse_destination(argv[++i], &dest_addrs[num_dests]) < 0) {
+                fprintf(stderr, "Invalid or too many destinations: %s\n", argv[i]);
+                return 1;
+            }
+            num_dests++;
+        } else if (strcmp(argv[i], "--dest-file") == 0 && i + 1 < argc) {
+            // One IP[:PORT] per line
+            FILE *dest_file = fopen(argv[++i], "r");
+            if (!dest_file) {
+                perror("Unable to open destination file");
+                return 1;
+            }
+            char line[128];
+            while (fgets(line, sizeof(line), dest_file)) {
+                line[strcspn(line, " \t\r\n#")] = '\0';
+                if (line[0] == '\0') continue;
+                if (num_dests == MAX_DESTINATIONS || parse_destination(line, &dest_addrs[num_dests]) < 0) {
+                    fprintf(stderr, "Invalid or too many destinations: %s\n", line);
+                    return 1;
+                }
+                num_dests++;
+            }
+            fclose(dest_file);
+        } else if (strcmp(argv[i], "--ttl") == 0 && i + 1 < argc) {
+            multicast_ttl = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate_kbps = atof(argv[++i]);
+            if (rate_kbps <= 0) {
+                fprintf(stderr, "Rate must be positive (kbit/s)\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            burst_bytes = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--micro-burst") == 0 && i + 1 < argc) {
+            micro_burst = atoi(argv[++i]);
+            if (micro_burst < 1) {
+                fprintf(stderr, "Micro-burst must be at least 1 packet\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--follow") == 0) {
+            follow_input = 1;  // Keep reading as the file grows (tail -f)
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window_bytes = atol(argv[++i]);
+            if (window_bytes < FRAME_BYTES) {
+                fprintf(stderr, "Window must hold at least one frame (%d bytes)\n", FRAME_BYTES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--h264") == 0) {
+            h264_mode = 1;  // One access unit per frame instead of fixed 10-packet frames
+        } else if (strcmp(argv[i], "--fec") == 0 && i + 1 < argc) {
+            fec_scheme = fec_parse_scheme(argv[++i], &fec_param);
+            if (fec_scheme < 0) {
+                fprintf(stderr, "FEC scheme must be xor, xor2d or rs, optionally with :N\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fec-block") == 0 && i + 1 < argc) {
+            fec_block = atoi(argv[++i]);
+            if (fec_block < 1 || fec_block > FEC_MAX_BLOCK) {
+                fprintf(stderr, "FEC block must be between 1 and %d packets\n", FEC_MAX_BLOCK);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fec-group") == 0 && i + 1 < argc) {
+            fec_group = atoi(argv[++i]);
+            if (fec_group < 1) {
+                fprintf(stderr, "FEC group must be at least 1 frame\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--nack") == 0) {
+            nack_enabled = 1;
+        } else if (strcmp(argv[i], "--nack-history") == 0 && i + 1 < argc) {
+            nack_enabled = 1;
+            rtx_history_size = atoi(argv[++i]);
+            if (rtx_history_size < 1 || rtx_history_size > 32768) {
+                fprintf(stderr, "NACK history must be between 1 and 32768 packets\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rtcp") == 0) {
+            rtcp_enabled = 1;
+        } else if (strcmp(argv[i], "--cc") == 0) {
+            cc_enabled = 1;
+        } else if ((strcmp(argv[i], "--cc-min") == 0 || strcmp(argv[i], "--cc-max") == 0) && i + 1 < argc) {
+            cc_enabled = 1;
+            double kbps = atof(argv[i + 1]);
+            if (kbps <= 0) {
+                fprintf(stderr, "Congestion control bounds must be positive (kbit/s)\n");
+                return 1;
+            }
+            if (strcmp(argv[i], "--cc-min") == 0) cc_min_kbps = kbps; else cc_max_kbps = kbps;
+            i++;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_name = argv[++i];
+            if (strlen(metrics_name) >= METRICS_NAME_MAX || strchr(metrics_name, '/')) {
+                fprintf(stderr, "Metrics name must be shorter than %d characters, without '/'\n", METRICS_NAME_MAX);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rendition") == 0 && i + 1 < argc) {
+            // The same asset at a lower bitrate, switched to under congestion
+            if (num_renditions == MAX_RENDITIONS) {
+                fprintf(stderr, "At most %d renditions\n", MAX_RENDITIONS);
+                return 1;
+            }
+            rendition_paths[num_renditions++] = argv[++i];
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = log_parse_level(argv[++i]);
+            if (log_level < 0) {
+                fprintf(stderr, "Log level must be one of error, warn, info, debug\n");
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    log_init(log_level);
 
-    // Get file size and allocate memory for image
-    fseek(image_file, 0, SEEK_END);
-    long file_size = ftell(image_file);
-    rewind(image_file);
-    unsigned char *buffer = (unsigned char *)malloc(file_size);
-    fread(buffer, 1, file_size, image_file);
+    // The input is mapped (or followed), never loaded up front, so the
+    // first packet goes out after the same setup whatever the file size
+    MediaSource source;
+    if (media_source_open(&source, argv[1], follow_input, window_bytes) < 0) {
+        return 1;
+    }
+
+    // H.264 mode reads the sample tables from the moov box, which may sit
+    // at the end of the file, so it needs the whole file mapped
+    Mp4VideoTrack track;
+    H264Packetizer packetizer;
+    if (h264_mode) {
+        if (source.follow) {
+            fprintf(stderr, "--h264 needs a regular MP4 file (not --follow or a pipe)\n");
+            return 1;
+        }
+        if (mp4_open_video_track(&track, source.map, source.map_size) < 0) {
+            return 1;
+        }
+        if (h264_packetizer_init(&packetizer) < 0) {
+            perror("Packetizer allocation failed");
+            return 1;
+        }
+    }
+
+    // Lower-bitrate renditions share the input's frame timeline: H.264 tracks
+    // with the same samples, or files cut into as many frames as the input
+    Rendition renditions[MAX_RENDITIONS];
+    MediaSource rendition_sources[MAX_RENDITIONS];
+    Mp4VideoTrack rendition_tracks[MAX_RENDITIONS];
+    double rendition_bitrates[MAX_RENDITIONS];  // Descending, 0 = unknown (--follow)
+    long num_frames = source.follow ? -1 : (media_source_size(&source) + FRAME_BYTES - 1) / FRAME_BYTES;
+    renditions[0].path = argv[1];
+    renditions[0].source = &source;
+    renditions[0].track = &track;
+    renditions[0].size = media_source_size(&source);
+    if (num_renditions > 1 && source.follow) {
+        fprintf(stderr, "--rendition needs regular files (not --follow or a pipe)\n");
+        return 1;
+    }
+    for (int r = 0; r < num_renditions; r++) {
+        Rendition *rendition = &renditions[r];
+        rendition_bitrates[r] = 0;
+        if (r > 0) {
+            rendition->path = rendition_paths[r];
+            rendition->source = &rendition_sources[r];
+            rendition->track = &rendition_tracks[r];
+            if (media_source_open(rendition->source, rendition->path, 0, window_bytes) < 0) return 1;
+            rendition->size = media_source_size(rendition->source);
+            if (h264_mode) {
+                if (mp4_open_video_track(rendition->track, rendition->source->map, rendition->source->map_size) < 0) {
+                    return 1;
+                }
+                if (rendition->track->num_samples != track.num_samples) {
+                    fprintf(stderr, "Rendition %s has %d samples, the input %d\n",
+                            rendition->path, rendition->track->num_samples, track.num_samples);
+                    return 1;
+                }
+            }
+        }
+        if (h264_mode) {
+            rendition_bitrates[r] = track_bitrate(rendition->track);
+        } else if (num_frames > 0) {
+            rendition_bitrates[r] = rendition->size * 8.0 * VIDEO_FPS / num_frames;
+        }
+        // Frames of a lower rendition must fit into the input's frame size
+        if (r > 0 && rendition_bitrates[r] >= rendition_bitrates[r - 1]) {
+            fprintf(stderr, "Renditions must follow the input in order of decreasing bitrate (%s)\n",
+                    rendition->path);
+            return 1;
+        }
+    }
+    int current_rendition = 0;
+    int64_t rendition_switched_ns = 0;
+    int rendition_switches = 0;
+    long rendition_overuses = 0;   // Overuse periods before the last switch
+    int64_t probe_interval_ns = RENDITION_PROBE_NS;  // Doubles after each failed probe
+    int last_switch_probe = 0;
 
     // Create UDP socket
     int sockfd;
-    struct sockaddr_in server_addr;
     sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("Socket creation failed");
         return 1;
     }
 
-    // Set up server address (receiver)
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(5000);  // Receiver port
-    server_addr.sin_addr.s_addr = inet_addr(ip);  // Localhost
+    // A frame's packets become SENDMSG requests submitted with one io_uring_enter
+    IoUring ring;
+    IoUring *uring = NULL;
+    if (use_uring) {
+        if (uring_init(&ring, RTP_URING_BATCH, 0) == 0) {
+            uring = &ring;
+        } else {
+            fprintf(stderr, "io_uring unavailable (%s) - using sendmmsg\n", strerror(errno));
+        }
+    }
+
+    // Receiver address (the first destination)
+    struct sockaddr_in server_addr = dest_addrs[0];
+
+    // Fan-out: every destination gets its own SSRC and sequence space,
+    // the payload is packetized once per frame and shared between them
+    srand(time(NULL) ^ getpid());  // Only for the RTCP interval jitter; SSRCs come from getrandom
+    RtpDestination *dests = (RtpDestination *)malloc(num_dests * sizeof(RtpDestination));
+    int multicast_dests = 0;
+    for (int d = 0; d < num_dests; d++) {
+        init_rtp_destination(&dests[d], &dest_addrs[d]);
+        if (h264_mode) dests[d].media.payload_type = RTP_PT_H264;
+        if (IN_MULTICAST(ntohl(dest_addrs[d].sin_addr.s_addr))) multicast_dests++;
+    }
+    if (multicast_dests > 0) {
+        unsigned char ttl = (unsigned char)multicast_ttl;
+        if (setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+            perror("IP_MULTICAST_TTL failed");
+        }
+    }
+    free(dest_addrs);
+
+    // Parity is computed once per block and shared by every destination
+    FecEncoder fec;
+    fec_kernels_init(NULL);
+    if (fec_scheme != FEC_SCHEME_NONE &&
+        fec_encoder_init(&fec, fec_scheme, fec_param, fec_block, h264_mode ? RTP_PT_H264 : RTP_PT_VIDEO) < 0) {
+        fprintf(stderr, "Invalid FEC configuration (at most %d columns or %d Reed-Solomon parity packets)\n",
+                FEC_MAX_COLUMNS, FEC_MAX_RS_PARITY);
+        return 1;
+    }
+
+    // Retransmissions are copied out of the history, never re-read from the input
+    RtxHistory history;
+    if (nack_enabled && rtx_history_init(&history, rtx_history_size) < 0) {
+        perror("Retransmission history allocation failed");
+        return 1;
+    }
+    // Congestion control takes its round trips from receiver reports
+    if (cc_enabled) rtcp_enabled = 1;
+    // Destinations carry their own SSRCs and sequence numbers, which FEC, NACK, RTCP and CC refer to
+    int fanout_path = num_dests > 1 || h264_mode || fec_scheme || nack_enabled || rtcp_enabled || metrics_name;
+
+    // One stream slot per destination (as many as fit)
+    MetricsSegment *metrics = NULL;
+    MetricsStream **dest_metrics = NULL;
+    int64_t metrics_published_ns = 0;
+    if (metrics_name) {
+        metrics = metrics_create(metrics_name, METRICS_ROLE_SENDER, 1);
+        dest_metrics = (MetricsStream **)calloc(num_dests, sizeof(MetricsStream *));
+        if (!metrics || !dest_metrics) return 1;
+        for (int d = 0; d < num_dests; d++) dest_metrics[d] = metrics_claim_stream(metrics, dests[d].media.ssrc, 0);
+    }
 
     // Calculate number of chunks (for dynamic chunking)
-    int num_chunks = (file_size / CHUNK_SIZE) + (file_size % CHUNK_SIZE != 0);  // Handle remainder
-    int num_frames = (num_chunks / PACKETS_PER_FRAME) + (num_chunks % PACKETS_PER_FRAME != 0);
-    printf("Number of chunks: %d\n", num_chunks);
-    printf("Simulating %d video frames at %d FPS (%d packets per frame)\n", num_frames, VIDEO_FPS, PACKETS_PER_FRAME);
+    long file_size = media_source_size(&source);
+    if (h264_mode) {
+        printf("H.264 track: %ux%u, %d samples, timescale %u, %d SPS / %d PPS\n",
+               track.width, track.height, track.num_samples, track.timescale, track.num_sps, track.num_pps);
+        printf("Packetization: RFC 6184 (Single NAL / FU-A, max payload %d bytes)\n", H264_MAX_PAYLOAD);
+    } else if (file_size >= 0) {
+        int num_chunks = (file_size / CHUNK_SIZE) + (file_size % CHUNK_SIZE != 0);  // Handle remainder
+        printf("Number of chunks: %d\n", num_chunks);
+        printf("Simulating %ld video frames at %d FPS (%d packets per frame)\n", num_frames, VIDEO_FPS, PACKETS_PER_FRAME);
+    } else {
+        printf("Following %s (read-ahead window %ld bytes)\n", argv[1], (long)source.window_size);
+        printf("Streaming video frames at %d FPS (%d packets per frame)\n", VIDEO_FPS, PACKETS_PER_FRAME);
+    }
     
+    // Every send is scheduled against an absolute deadline from the start time
+    Pacer pacer;
+    pacer_init(&pacer);
+    if (rate_kbps > 0) pacer_set_token_bucket(&pacer, rate_kbps * 1000.0, burst_bytes);
+    if (!batch_mode && num_dests == 1) pacer_set_micro_burst(&pacer, micro_burst);
+
     struct timeval start_time, current_time;
     gettimeofday(&start_time, NULL);
+    int64_t start_ns = pacer_now_ns();
+
+    SenderFeedback fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.sockfd = sockfd;
+    fb.dests = dests;
+    fb.num_dests = num_dests;
+    fb.pacer = &pacer;
+    fb.history = nack_enabled ? &history : NULL;
+    fb.reports = rtcp_enabled;
+    if (rtcp_enabled) {
+        char host[48];
+        if (gethostname(host, sizeof(host)) < 0) strcpy(host, "localhost");
+        host[sizeof(host) - 1] = '\0';
+        snprintf(fb.cname, sizeof(fb.cname), "sender-%d@%s", (int)getpid(), host);
+        // Nominal until the achieved bitrate is known
+        fb.session_bandwidth = rate_kbps > 0 ? rate_kbps * 125 : (double)FRAME_BYTES * VIDEO_FPS;
+        fb.avg_rtcp_size = RTCP_UDP_IP_OVERHEAD + 28 + 12 + strlen(fb.cname);
+        fb.initial = 1;
+        schedule_sender_report(&fb);
+    }
+    if (cc_enabled) {
+        // Start at the input's bitrate (or --rate) with some headroom; the
+        // estimates move from there as feedback arrives
+        double start_bps = rate_kbps > 0 ? rate_kbps * 1000.0
+                         : rendition_bitrates[0] > 0 ? rendition_bitrates[0] * 1.15
+                         : (double)FRAME_BYTES * 8 * VIDEO_FPS;
+        if (start_bps < cc_min_kbps * 1000) start_bps = cc_min_kbps * 1000;
+        if (start_bps > cc_max_kbps * 1000) start_bps = cc_max_kbps * 1000;
+        fb.cc_history = (CcSendHistory *)calloc(1, sizeof(CcSendHistory));
+        fb.cc = (CcEstimator *)malloc(num_dests * sizeof(CcEstimator));
+        if (!fb.cc_history || !fb.cc) {
+            perror("Congestion control allocation failed");
+            return 1;
+        }
+        for (int d = 0; d < num_dests; d++) {
+            cc_estimator_init(&fb.cc[d], start_bps, cc_min_kbps * 1000, cc_max_kbps * 1000);
+        }
+        fb.cc_target_bps = start_bps;
+        fb.cc_lowest_bps = start_bps;
+        fb.burst_bytes = burst_bytes;
+        pacer_set_token_bucket(&pacer, start_bps * num_dests, burst_bytes * num_dests);
+    }
     
-    // Random initial RTP timestamp (RTP best practice)
-    srand(time(NULL));
-    uint32_t base_timestamp = (uint32_t)(rand() & 0xFFFFFFFF);
+    // The single-destination paths send on the first destination's session,
+    // whose random timestamp base is the initial RTP timestamp
+    RtpSession *session = &dests[0].media;
     
-    printf("Initial RTP timestamp: %u\n", base_timestamp);
+    printf("Initial RTP timestamp: %u\n", session->timestamp_base);
     printf("RTP clock rate: 90000 Hz (standard for video)\n");
-    printf("Timestamp increment per frame: %d (90000/%d FPS)\n\n", 90000/VIDEO_FPS, VIDEO_FPS);
-    
-    for (int i = 0; i < num_chunks; i++) {
-        int current_frame = i / PACKETS_PER_FRAME;
+    if (h264_mode)
+        printf("Timestamps: sample presentation time (90000/%u of the track clock)\n\n", track.timescale);
+    else
+        printf("Timestamp increment per frame: %d (90000/%d FPS)\n\n", 90000/VIDEO_FPS, VIDEO_FPS);
     
-        // Correct timestamp
-        uint32_t frame_timestamp =
-            base_timestamp + current_frame * (RTP_CLOCK_RATE / VIDEO_FPS);
-    
-        int offset = i * CHUNK_SIZE;
-        int payload_size = (i == num_chunks - 1)
-                            ? (file_size - offset)
-                            : CHUNK_SIZE;
-    
-        // Marker bit = last packet of *frame*, not whole file
-        int is_last_in_frame = ((i + 1) % PACKETS_PER_FRAME == 0);
-    
-        int bytes_sent = send_rtp_packet_with_timestamp(
-            sockfd, &server_addr,
-            buffer + offset,
-            payload_size,
-            frame_timestamp,
-            is_last_in_frame
-        );
-        
-        if (bytes_sent < 0) {
-            fprintf(stderr, "Failed to send packet %d\n", i);
-            break;
+    if (fanout_path) {
+        printf("Send mode: fan-out to %d destinations (%d multicast, %s per frame)\n\n",
+               num_dests, multicast_dests, uring ? "io_uring_enter" : "sendmmsg");
+    } else if (uring) {
+        printf("Send mode: batched (io_uring_enter per frame)\n\n");
+    } else {
+        printf("Send mode: %s\n\n", batch_mode ? "batched (sendmmsg per frame)" : "per-packet (sendto)");
+    }
+    if (fec_scheme) {
+        printf("FEC: %s, %d %s, blocks of up to %d packets every %d frame(s), %s kernels\n\n",
+               fec_scheme_name(fec_scheme),
+               fec_scheme == FEC_SCHEME_RS ? fec.rs_parity : fec.columns,
+               fec_scheme == FEC_SCHEME_RS ? "parity packets" : "columns",
+               fec_block, fec_group, fec_kernel_name());
+    }
+    if (nack_enabled) {
+        printf("NACK: retransmitting from a history of the last %d packets\n\n", history.capacity);
+    }
+    if (rtcp_enabled) {
+        printf("RTCP: sender reports to every destination (CNAME %s), receiver reports read back\n\n", fb.cname);
+    }
+    if (metrics) {
+        printf("Metrics: /dev/shm/rtp-%s (read with ./rtpstat %s)\n\n", metrics_name, metrics_name);
+    }
+    if (cc_enabled) {
+        printf("Congestion control: delay gradient and loss from RFC 8888 feedback, start %.0f kbit/s (%.0f-%.0f)\n",
+               fb.cc_target_bps / 1000, cc_min_kbps, cc_max_kbps);
+        for (int r = 0; r < num_renditions; r++) {
+            printf("  rendition %d: %s, %.0f kbit/s\n", r, renditions[r].path, rendition_bitrates[r] / 1000);
         }
-    
-        printf("Sent pkt %d (frame=%d, ts=%u, M=%d, %d bytes)\n",
-               i, current_frame, frame_timestamp, is_last_in_frame, bytes_sent);
-    
-        // Spread packets evenly within the frame  
-        usleep(FRAME_DURATION_US / PACKETS_PER_FRAME);
-    
-        // After last packet of the frame, ensure we haven't fallen behind
-        if (is_last_in_frame) {
-            gettimeofday(&current_time, NULL);
-            long elapsed = (current_time.tv_sec - start_time.tv_sec) * 1000000 +
-                           (current_time.tv_usec - start_time.tv_usec);
-    
-            long expected = (long)(current_frame + 1) * FRAME_DURATION_US;
-    
-            if (elapsed < expected)
-                usleep(expected - elapsed);
+        printf("\n");
+    } else if (rate_kbps > 0) {
+        printf("Pacing: token bucket at %.0f kbit/s, burst %ld bytes\n\n", rate_kbps, burst_bytes);
+    }
+
+    long send_path_us = 0;  // Time spent inside the send calls only (excludes pacing sleeps)
+    long send_calls = 0;      // Media sends only, for the path comparison
+    int packets_sent = 0;
+    int frames_sent = 0;
+    long max_frame_send_us = 0;  // Longest time to get one frame out (fan-out)
+    int late_frames = 0;         // Frames that finished after the next frame was due
+    long fec_packets = 0;
+    int64_t first_packet_ns = 0;
+    long cpu_start_us = cpu_time_us();
+    RTPChunk chunks[PACKETS_PER_FRAME];
+
+    // Frames are cut straight out of the input as they are due: nothing is
+    // read ahead of the pacing schedule except the source's own read-ahead
+    for (int frame = 0; ; frame++) {
+        RTPChunk *frame_chunks = chunks;
+        int count = 0;
+        long frame_bytes = 0;
+        int64_t frame_release;
+        int64_t next_release;
+        // Media time of the frame; destinations add their own timestamp base
+        uint32_t media_timestamp = frame * (RTP_CLOCK_RATE / VIDEO_FPS);
+
+        // Renditions change only at frame boundaries (for H.264 at sync
+        // samples, where a decoder can start over): down as soon as the
+        // current one no longer fits, up once the last switch has settled
+        if (cc_enabled && num_renditions > 1 && (!h264_mode || frame < track.num_samples)) {
+            int64_t now = pacer_now_ns();
+            int want = cc_select_rendition(rendition_bitrates, num_renditions, current_rendition, fb.cc_target_bps);
+            if (want < current_rendition && now - rendition_switched_ns < RENDITION_HOLD_NS) want = current_rendition;
+            // A lower rendition leaves the estimate capped near what it sends:
+            // after a quiet spell, try the next one up and let the delay signal judge it
+            int probe = want == current_rendition && current_rendition > 0 &&
+                        now - rendition_switched_ns >= probe_interval_ns &&
+                        congestion_overuses(&fb) == rendition_overuses;
+            if (probe) want = current_rendition - 1;
+            if (want != current_rendition && h264_mode && !renditions[want].track->samples[frame].is_sync)
+                want = current_rendition;
+            if (want != current_rendition) {
+                LOG_INFO("Frame %d: rendition %d -> %d (target %.0f kbit/s%s)\n",
+                         frame, current_rendition, want, fb.cc_target_bps / 1000, probe ? ", probing" : "");
+                if (want > current_rendition && last_switch_probe && probe_interval_ns < 8 * RENDITION_PROBE_NS) {
+                    probe_interval_ns *= 2;
+                } else if (probe && last_switch_probe) {
+                    probe_interval_ns = RENDITION_PROBE_NS;  // The last probe held
+                }
+                if (probe) {
+                    for (int d = 0; d < num_dests; d++) cc_estimator_probe(&fb.cc[d], rendition_bitrates[want] * 1.15);
+                    update_congestion_target(&fb, now);
+                }
+                current_rendition = want;
+                rendition_switched_ns = now;
+                rendition_overuses = congestion_overuses(&fb);
+                last_switch_probe = probe;
+                rendition_switches++;
+            }
         }
+        Rendition *rendition = &renditions[current_rendition];
+
+        if (h264_mode) {
+            // One access unit per frame, sent at its decode time and stamped
+            // with its presentation time (they differ when B-frames reorder)
+            if (frame == track.num_samples) break;
+            Mp4Sample *sample = &track.samples[frame];
+            frame_release = start_ns + sample_time_ns(&track, sample->dts - track.samples[0].dts);
+            next_release = (frame + 1 < track.num_samples)
+                           ? start_ns + sample_time_ns(&track, track.samples[frame + 1].dts - track.samples[0].dts)
+                           : frame_release + FRAME_DURATION_NS;
+            media_timestamp = (uint32_t)(((int64_t)sample->dts + sample->cts_offset) * RTP_CLOCK_RATE / track.timescale);
+
+            // Timing follows the input; the payload comes from the current rendition
+            Mp4VideoTrack *coded = rendition->track;
+            Mp4Sample *coded_sample = &coded->samples[frame];
+            h264_packetizer_begin(&packetizer);
+            if (coded_sample->is_sync) {
+                // Parameter sets in-band before every IDR, so a receiver can join at any sync point
+                for (int i = 0; i < coded->num_sps; i++)
+                    h264_packetize_nal(&packetizer, coded->sps[i], coded->sps_size[i]);
+                for (int i = 0; i < coded->num_pps; i++)
+                    h264_packetize_nal(&packetizer, coded->pps[i], coded->pps_size[i]);
+            }
+            if (h264_packetize_sample(&packetizer, rendition->source->map + coded_sample->offset, coded_sample->size,
+                                      coded->nal_length_size) < 0) {
+                LOG_ERROR("Malformed H.264 sample %d\n", frame);
+                break;
+            }
+            frame_chunks = packetizer.chunks;
+            count = packetizer.count;
+            for (int c = 0; c < count; c++)
+                frame_bytes += RTP_HEADER_SIZE + frame_chunks[c].prefix_size + frame_chunks[c].payload_size;
+        } else {
+            long frame_offset = (long)frame * FRAME_BYTES;
+            long frame_size;
+            unsigned char *frame_data = media_source_get(&source, frame_offset, FRAME_BYTES, &frame_size);
+            if (frame_size <= 0) break;  // End of input
+            if (current_rendition > 0) {
+                // The same share of a lower rendition's file
+                long begin = frame * rendition->size / num_frames;
+                long end = (frame + 1) * rendition->size / num_frames;
+                frame_data = media_source_get(rendition->source, begin, end - begin, &frame_size);
+                if (frame_size <= 0) continue;  // No bytes of this rendition fall into the frame
+            }
+
+            // A live input that stalled restarts the schedule at this frame
+            // instead of bursting to catch up
+            frame_release = start_ns + frame * FRAME_DURATION_NS;
+            if (source.follow && pacer_now_ns() > frame_release + FRAME_DURATION_NS) {
+                start_ns = pacer_now_ns() - frame * FRAME_DURATION_NS;
+                frame_release = start_ns + frame * FRAME_DURATION_NS;
+            }
+            next_release = frame_release + FRAME_DURATION_NS;
+
+            // Split the frame into chunks; the payload is never copied
+            for (long offset = 0; offset < frame_size; offset += CHUNK_SIZE, count++) {
+                chunks[count].payload = frame_data + offset;
+                chunks[count].payload_size = (frame_size - offset < CHUNK_SIZE) ? (frame_size - offset) : CHUNK_SIZE;
+                // Marker bit = last packet of *frame*, not whole file
+                chunks[count].is_last_packet = current_rendition > 0 ? (offset + CHUNK_SIZE >= frame_size)
+                                                                     : (count == PACKETS_PER_FRAME - 1);
+                chunks[count].prefix_size = 0;
+                frame_bytes += RTP_HEADER_SIZE + chunks[count].payload_size;
+            }
+        }
+        int first_chunk = frame * PACKETS_PER_FRAME;
+
+        if (fanout_path) {
+            // The whole frame is due at its frame time (later if the token bucket is empty)
+            int64_t deadline = pacer_schedule(&pacer, frame_release, frame_bytes * num_dests);
+            if (nack_enabled || rtcp_enabled || cc_enabled) {
+                wait_serving_feedback(&fb, deadline);
+            } else {
+                pacer_wait_until(&pacer, deadline);
+            }
+
+            struct timeval send_start;
+            gettimeofday(&send_start, NULL);
+            long calls = count_send_calls(dests, num_dests, uring);
+            long parity_calls = 0;
+            int sent = 0;
+            if (fec_scheme) {
+                // A frame that does not fit into the open block is split across blocks;
+                // parity goes out as soon as its block closes
+                for (int c = 0; c < count; ) {
+                    int n = count - c;
+                    if (n > fec_encoder_space(&fec)) n = fec_encoder_space(&fec);
+                    if (uring) {
+                        sent += send_rtp_fanout_uring(uring, sockfd, dests, num_dests, frame_chunks + c, n, media_timestamp);
+                    } else {
+                        sent += send_rtp_fanout_with_timestamp(sockfd, dests, num_dests, frame_chunks + c, n, media_timestamp);
+                    }
+                    fec_encoder_add(&fec, frame_chunks + c, n, media_timestamp);
+                    c += n;
+                    if (fec_encoder_space(&fec) == 0 || (c == count && (frame + 1) % fec_group == 0)) {
+                        int parity = fec_encoder_finish(&fec);
+                        long parity_start = count_send_calls(dests, num_dests, uring);
+                        fec_packets += send_fec_parity(sockfd, dests, num_dests, &fec);
+                        parity_calls += count_send_calls(dests, num_dests, uring) - parity_start;
+                        // Parity spends tokens too: the next frame waits if it exceeded the rate
+                        pacer_schedule(&pacer, frame_release,
+                                       parity * (RTP_HEADER_SIZE + FEC_HEADER_SIZE + fec.unit_size) * num_dests);
+                        fec_encoder_begin(&fec);
+                    }
+                }
+            } else if (uring) {
+                sent = send_rtp_fanout_uring(uring, sockfd, dests, num_dests, frame_chunks, count, media_timestamp);
+            } else {
+                sent = send_rtp_fanout_with_timestamp(sockfd, dests, num_dests, frame_chunks, count, media_timestamp);
+            }
+            if (nack_enabled) rtx_history_add(&history, frame_chunks, count, media_timestamp);
+            if (cc_enabled) cc_history_add(fb.cc_history, frame_chunks, count, pacer_now_ns());
+            long frame_send_us = elapsed_since_us(&send_start);
+            send_path_us += frame_send_us;
+            send_calls += count_send_calls(dests, num_dests, uring) - calls - parity_calls;
+            packets_sent += sent;
+            if (frame_send_us > max_frame_send_us) max_frame_send_us = frame_send_us;
+            if (first_packet_ns == 0) first_packet_ns = pacer_now_ns();
+            fb.media_timestamp = media_timestamp;
+            fb.media_sent_ns = pacer_now_ns();
+            if (fb.media_sent_ns - first_packet_ns > FRAME_DURATION_NS) {
+                fb.session_bandwidth = pacer.bytes_paced * 1e9 / (fb.media_sent_ns - first_packet_ns) / num_dests;
+            }
+
+            LOG_DEBUG("Sent frame %d to %d destinations (%d packets)\n", frame, num_dests, sent);
+            if (metrics && fb.media_sent_ns - metrics_published_ns >= METRICS_INTERVAL_US * 1000LL) {
+                for (int d = 0; d < num_dests; d++) {
+                    if (dest_metrics[d]) publish_destination_metrics(dest_metrics[d], &dests[d], cc_enabled ? &fb.cc[d] : NULL,
+                                                                     fb.media_sent_ns);
+                }
+                metrics_published_ns = fb.media_sent_ns;
+            }
+
+            // Frames are paced against absolute deadlines, so a slow frame
+            // does not push every later frame back
+            if (pacer_now_ns() > next_release)
+                late_frames++;
+        } else if (batch_mode) {
+            uint32_t frame_timestamp = frame * (RTP_CLOCK_RATE / VIDEO_FPS);
+
+            // Whole frame goes out at once when it is due
+            pacer_wait_until(&pacer, pacer_schedule(&pacer, frame_release, frame_bytes));
+
+            struct timeval send_start;
+            gettimeofday(&send_start, NULL);
+            long calls = count_send_calls(dests, 1, uring);
+            int sent;
+            if (uring) {
+                sent = send_rtp_batch_uring(session, uring, sockfd, &server_addr, frame_chunks, count, frame_timestamp);
+            } else {
+                sent = send_rtp_batch_with_timestamp(session, sockfd, &server_addr, frame_chunks, count, frame_timestamp);
+            }
+            send_path_us += elapsed_since_us(&send_start);
+            send_calls += count_send_calls(dests, 1, uring) - calls;
+
+            if (sent > 0) packets_sent += sent;
+            if (sent < count) {
+                LOG_ERROR("Failed to send frame %d (%d of %d packets sent)\n", frame, sent > 0 ? sent : 0, count);
+                break;
+            }
+            if (first_packet_ns == 0) first_packet_ns = pacer_now_ns();
+
+            LOG_DEBUG("Sent frame %d (pkts %d-%d, ts=%u)\n",
+                   frame, first_chunk, first_chunk + count - 1, frame_timestamp);
+        } else {
+            // Media timestamp; the session adds its base
+            uint32_t frame_timestamp = frame * (RTP_CLOCK_RATE / VIDEO_FPS);
+            int failed = 0;
+            pacer_end_burst(&pacer);  // Micro-bursts stay within the frame
+
+            for (int c = 0; c < count; c++) {
+                // Spread packets evenly within the frame, each on its own absolute
+                // deadline; with a token bucket the bitrate spaces them instead
+                int64_t release = frame_release;
+                if (rate_kbps <= 0)
+                    release += c * (FRAME_DURATION_NS / PACKETS_PER_FRAME);
+                pacer_wait_until(&pacer, pacer_schedule(&pacer, release, RTP_HEADER_SIZE + frame_chunks[c].payload_size));
+
+                struct timeval send_start;
+                gettimeofday(&send_start, NULL);
+                long calls = session->send_calls;
+                int bytes_sent = send_rtp_packet_with_timestamp(
+                    session, sockfd, &server_addr,
+                    frame_chunks[c].payload,
+                    frame_chunks[c].payload_size,
+                    frame_timestamp,
+                    frame_chunks[c].is_last_packet
+                );
+                send_path_us += elapsed_since_us(&send_start);
+                send_calls += session->send_calls - calls;
+
+                if (bytes_sent < 0) {
+                    LOG_ERROR("Failed to send packet %d\n", first_chunk + c);
+                    failed = 1;
+                    break;
+                }
+                packets_sent++;
+                if (first_packet_ns == 0) first_packet_ns = pacer_now_ns();
+
+                LOG_DEBUG("Sent pkt %d (frame=%d, ts=%u, M=%d, %d bytes)\n",
+                       first_chunk + c, frame, frame_timestamp, frame_chunks[c].is_last_packet, bytes_sent);
+            }
+            if (failed) break;
+        }
+        frames_sent++;
     }
-    
+
+    // Protect the tail of the stream as well
+    if (fec_scheme && fec_encoder_finish(&fec) > 0) {
+        fec_packets += send_fec_parity(sockfd, dests, num_dests, &fec);
+    }
+    // The last frames can still be missing at the receivers, and their reports are still on the way
+    if (nack_enabled || rtcp_enabled || cc_enabled) {
+        wait_serving_feedback(&fb, pacer_now_ns() + FEEDBACK_LINGER_MS * 1000000LL);
+    }
+
+    log_shutdown();
 
     gettimeofday(&current_time, NULL);
     long total_time_ms = ((current_time.tv_sec - start_time.tv_sec) * 1000000 +
                           (current_time.tv_usec - start_time.tv_usec)) / 1000;
     printf("Video transmission completed in %ld ms (%.2f seconds)\n", total_time_ms, total_time_ms / 1000.0);
+    if (first_packet_ns > 0)
+        printf("Time to first packet: %.3f ms\n", (first_packet_ns - process_start_ns) / 1e6);
+
+    // Send-path cost, comparable between --batch and the per-packet path
+    printf("Send path: %d packets, %ld send syscalls, %.3f ms in send calls",
+           packets_sent, send_calls, send_path_us / 1000.0);
+    if (send_path_us > 0)
+        printf(" (%.0f packets/sec)", packets_sent * 1000000.0 / send_path_us);
+    printf("\n");
+    long other_calls = count_send_calls(dests, num_dests, uring) - send_calls;
+    if (other_calls > 0)
+        printf("Other send syscalls: %ld (FEC parity, retransmissions, RTCP)\n", other_calls);
+
+    // How closely the sends followed their schedule
+    double error_mean_us, error_p99_us, error_max_us;
+    pacer_error_stats(&pacer, &error_mean_us, &error_p99_us, &error_max_us);
+    printf("Pacing error vs schedule: mean %.1f us, p99 %.0f us, max %.1f us (%ld deadlines)\n",
+           error_mean_us, error_p99_us, error_max_us, pacer.samples);
+    if (total_time_ms > 0) {
+        printf("Achieved bitrate: %.0f kbit/s", pacer.bytes_paced * 8.0 / total_time_ms);
+        if (rate_kbps > 0)
+            printf(" (target %.0f kbit/s)", rate_kbps);
+        printf("\n");
+    }
+
+    long cpu_us = cpu_time_us() - cpu_start_us;
+    printf("CPU time: %.3f ms", cpu_us / 1000.0);
+    if (frames_sent > 0)
+        printf(" (%.1f us per destination per frame)", (double)cpu_us / num_dests / frames_sent);
+    printf("\n");
+    if (num_dests > 1) {
+        long send_errors = 0;
+        for (int d = 0; d < num_dests; d++) {
+            send_errors += dests[d].media.send_errors;
+        }
+        printf("Fan-out: %d destinations, slowest frame %.3f ms of %d ms budget, %d late frames, %ld send errors\n",
+               num_dests, max_frame_send_us / 1000.0, FRAME_DURATION_US / 1000, late_frames, send_errors);
+    }
+    if (fec_scheme) {
+        printf("FEC: %ld blocks, %ld parity packets sent (%.1f%% overhead)\n",
+               fec.blocks, fec_packets, packets_sent > 0 ? 100.0 * fec_packets / packets_sent : 0.0);
+        fec_encoder_destroy(&fec);
+    }
+    if (nack_enabled) {
+        printf("NACK: %ld requests, %ld packets retransmitted, %ld no longer in the history\n",
+               history.nacks_received, history.retransmitted, history.expired);
+        rtx_history_destroy(&history);
+    }
+    if (rtcp_enabled) {
+        // Latest report of each destination that sent one
+        int reporting = 0;
+        int measured = 0;
+        double rtt_sum_ms = 0, loss_sum = 0, jitter_sum_ms = 0;
+        long cumulative_lost = 0;
+        for (int d = 0; d < num_dests; d++) {
+            if (dests[d].reports_received == 0) continue;
+            reporting++;
+            loss_sum += dests[d].fraction_lost * 100.0 / 256;
+            jitter_sum_ms += dests[d].jitter * 1000.0 / RTP_CLOCK_RATE;
+            cumulative_lost += dests[d].cumulative_lost;
+            if (dests[d].rtt_us >= 0) {
+                measured++;
+                rtt_sum_ms += dests[d].rtt_us / 1000.0;
+            }
+        }
+        printf("RTCP: %ld sender reports sent, %ld receiver reports from %d of %d destinations\n",
+               fb.reports_sent, fb.reports_received, reporting, num_dests);
+        if (reporting > 0) {
+            printf("RTCP feedback%s: RTT %.1f ms, loss %.1f%% in the last interval (%ld packets in total), jitter %.2f ms\n",
+                   num_dests > 1 ? " (mean per destination)" : "",
+                   measured > 0 ? rtt_sum_ms / measured : 0.0, loss_sum / reporting,
+                   cumulative_lost, jitter_sum_ms / reporting);
+        }
+    }
+    if (metrics) {
+        // The segment goes away with the sender
+        metrics_destroy(metrics, metrics_name);
+        free(dest_metrics);
+    }
+    if (cc_enabled) {
+        long overuses = 0;
+        double acked_bps = 0;
+        for (int d = 0; d < num_dests; d++) {
+            overuses += fb.cc[d].overuses;
+            if (d == 0 || fb.cc[d].acked_bps < acked_bps) acked_bps = fb.cc[d].acked_bps;
+        }
+        printf("Congestion control: %ld feedback packets, target %.0f kbit/s at the end (lowest %.0f), "
+               "receiver got %.0f kbit/s, %ld overuse periods\n",
+               fb.feedback_received, fb.cc_target_bps / 1000, fb.cc_lowest_bps / 1000, acked_bps / 1000, overuses);
+        if (num_renditions > 1) {
+            printf("Renditions: %d switches, ended on %s\n", rendition_switches, renditions[current_rendition].path);
+        }
+        free(fb.cc_history);
+        free(fb.cc);
+    }
+    for (int r = 1; r < num_renditions; r++) {
+        if (h264_mode) mp4_close_video_track(renditions[r].track);
+        media_source_close(renditions[r].source);
+    }
+    if (h264_mode) {
+        printf("H.264: %d access units, %ld single NAL packets, %ld FU-A packets, %d late access units\n",
+               frames_sent, packetizer.single_nal_packets, packetizer.fu_a_packets, late_frames);
+        h264_packetizer_destroy(&packetizer);
+        mp4_close_video_track(&track);
+    }
 
     // Clean up and close socket
+    if (uring) uring_close(uring);
     close(sockfd);
-    free(buffer);
-    fclose(image_file);
+    free(dests);
+    media_source_close(&source);
 
     return 0;
 }
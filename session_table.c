@@ -0,0 +1,197 @@
+#include "session_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Multiplicative (Fibonacci) hash; SSRCs are random but cheap mixing keeps
+// sequential test SSRCs from clustering
+static inline uint32_t hash_ssrc(uint32_t ssrc) {
+    uint32_t h = ssrc * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+int session_table_init(SessionTable *table, int max_sessions) {
+    memset(table, 0, sizeof(SessionTable));
+    if (max_sessions <= 0) return -1;
+
+    uint32_t buckets = 16;
+    while (buckets < (uint32_t)max_sessions * 4) buckets <<= 1;  // SSRC and alias per session
+
+    table->keys = (uint32_t *)calloc(buckets, sizeof(uint32_t));
+    table->values = (int32_t *)malloc(buckets * sizeof(int32_t));
+    table->sessions = (Session *)calloc(max_sessions, sizeof(Session));
+    table->free_sessions = (int *)malloc(max_sessions * sizeof(int));
+    table->heap = (int *)malloc(max_sessions * sizeof(int));
+    if (!table->keys || !table->values || !table->sessions || !table->free_sessions || !table->heap) {
+        session_table_destroy(table);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < buckets; i++) {
+        table->values[i] = -1;
+    }
+    for (int i = 0; i < max_sessions; i++) {
+        table->free_sessions[i] = max_sessions - 1 - i;
+        table->sessions[i].heap_index = -1;
+    }
+    table->bucket_mask = buckets - 1;
+    table->free_count = max_sessions;
+    table->max_sessions = max_sessions;
+    return 0;
+}
+
+void session_table_destroy(SessionTable *table) {
+    free(table->keys);
+    free(table->values);
+    free(table->sessions);
+    free(table->free_sessions);
+    free(table->heap);
+    memset(table, 0, sizeof(SessionTable));
+}
+
+Session *session_table_lookup(SessionTable *table, uint32_t ssrc) {
+    uint32_t bucket = hash_ssrc(ssrc) & table->bucket_mask;
+    for (;;) {
+        int32_t index = table->values[bucket];
+        if (index < 0) return NULL;  // Hit an empty bucket: not present
+        if (table->keys[bucket] == ssrc) return &table->sessions[index];
+        bucket = (bucket + 1) & table->bucket_mask;
+    }
+}
+
+Session *session_table_insert(SessionTable *table, uint32_t ssrc) {
+    if (table->free_count == 0) return NULL;
+
+    uint32_t bucket = hash_ssrc(ssrc) & table->bucket_mask;
+    while (table->values[bucket] >= 0) {
+        if (table->keys[bucket] == ssrc) return &table->sessions[table->values[bucket]];
+        bucket = (bucket + 1) & table->bucket_mask;
+    }
+
+    int index = table->free_sessions[--table->free_count];
+    Session *session = &table->sessions[index];
+    memset(session, 0, sizeof(Session));
+    session->ssrc = ssrc;
+    session->deadline_us = -1;
+    session->heap_index = -1;
+
+    table->keys[bucket] = ssrc;
+    table->values[bucket] = index;
+    table->count++;
+    return session;
+}
+
+// Delete the bucket holding key -> index
+static void remove_key(SessionTable *table, uint32_t key, int index) {
+    uint32_t bucket = hash_ssrc(key) & table->bucket_mask;
+    while (table->values[bucket] != index || table->keys[bucket] != key) {
+        if (table->values[bucket] < 0) return;  // Not in the table
+        bucket = (bucket + 1) & table->bucket_mask;
+    }
+
+    // Backward-shift deletion: pull later entries of the probe run into the hole
+    uint32_t hole = bucket;
+    uint32_t next = (hole + 1) & table->bucket_mask;
+    while (table->values[next] >= 0) {
+        uint32_t home = hash_ssrc(table->keys[next]) & table->bucket_mask;
+        // Move the entry if its home bucket is not in (hole, next]
+        if (((next - home) & table->bucket_mask) >= ((next - hole) & table->bucket_mask)) {
+            table->keys[hole] = table->keys[next];
+            table->values[hole] = table->values[next];
+            hole = next;
+        }
+        next = (next + 1) & table->bucket_mask;
+    }
+    table->values[hole] = -1;
+}
+
+void session_table_remove(SessionTable *table, Session *session) {
+    if (session->heap_index >= 0) {
+        session->deadline_us = -1;
+        session_table_update_deadline(table, session);
+    }
+
+    int index = (int)(session - table->sessions);
+    remove_key(table, session->ssrc, index);
+    if (session->has_rtx_ssrc) remove_key(table, session->rtx_ssrc, index);
+
+    table->free_sessions[table->free_count++] = index;
+    table->count--;
+}
+
+int session_table_alias(SessionTable *table, Session *session, uint32_t alias) {
+    uint32_t bucket = hash_ssrc(alias) & table->bucket_mask;
+    while (table->values[bucket] >= 0) {
+        if (table->keys[bucket] == alias) return -1;
+        bucket = (bucket + 1) & table->bucket_mask;
+    }
+    table->keys[bucket] = alias;
+    table->values[bucket] = (int32_t)(session - table->sessions);
+    session->rtx_ssrc = alias;
+    session->has_rtx_ssrc = 1;
+    return 0;
+}
+
+static inline int64_t heap_key(SessionTable *table, int position) {
+    return table->sessions[table->heap[position]].deadline_us;
+}
+
+static void heap_swap(SessionTable *table, int a, int b) {
+    int tmp = table->heap[a];
+    table->heap[a] = table->heap[b];
+    table->heap[b] = tmp;
+    table->sessions[table->heap[a]].heap_index = a;
+    table->sessions[table->heap[b]].heap_index = b;
+}
+
+static void heap_sift_up(SessionTable *table, int position) {
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (heap_key(table, parent) <= heap_key(table, position)) break;
+        heap_swap(table, parent, position);
+        position = parent;
+    }
+}
+
+static void heap_sift_down(SessionTable *table, int position) {
+    for (;;) {
+        int smallest = position;
+        int left = 2 * position + 1;
+        int right = left + 1;
+        if (left < table->heap_size && heap_key(table, left) < heap_key(table, smallest)) smallest = left;
+        if (right < table->heap_size && heap_key(table, right) < heap_key(table, smallest)) smallest = right;
+        if (smallest == position) return;
+        heap_swap(table, smallest, position);
+        position = smallest;
+    }
+}
+
+void session_table_update_deadline(SessionTable *table, Session *session) {
+    int index = (int)(session - table->sessions);
+    int position = session->heap_index;
+
+    if (session->deadline_us < 0) {
+        // Drop from the heap: move the last entry into its place
+        if (position < 0) return;
+        int last = --table->heap_size;
+        if (position != last) {
+            heap_swap(table, position, last);
+            heap_sift_down(table, position);
+            heap_sift_up(table, position);
+        }
+        session->heap_index = -1;
+        return;
+    }
+
+    if (position < 0) {
+        position = table->heap_size++;
+        table->heap[position] = index;
+        session->heap_index = position;
+    }
+    heap_sift_up(table, position);
+    heap_sift_down(table, session->heap_index);
+}
+
+Session *session_table_earliest(SessionTable *table) {
+    if (table->heap_size == 0) return NULL;
+    return &table->sessions[table->heap[0]];
+}
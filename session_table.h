@@ -0,0 +1,83 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "jitter_buffer.h"
+#include "file_sink.h"
+#include "h264_depacketizer.h"
+#include "fec.h"
+#include "nack.h"
+#include "rtcp.h"
+#include "congestion.h"
+#include "metrics.h"
+
+#define DEFAULT_MAX_SESSIONS 1024  // Concurrent SSRCs when no limit is given
+
+// Per-stream receive state, keyed by SSRC
+typedef struct {
+    uint32_t ssrc;
+    JitterBuffer *jb;
+    RTPStats stats;
+    FileSink sink;
+    int has_sink;
+    int is_h264;             // Payload type 97: written out as an Annex-B stream
+    H264Depacketizer depacketizer;
+    FecDecoder *fec;         // Set once FEC is enabled or the first parity packet arrives
+    NackList *nack;          // Missing packets to request (--nack)
+    struct sockaddr_in peer; // Where the stream comes from (NACKs go back there)
+    uint8_t payload_type;
+    uint32_t rtx_ssrc;       // Retransmission stream, once associated (see session_table_alias)
+    int has_rtx_ssrc;
+    RtcpReception reception; // Loss and sequence state for receiver reports
+    int reports;             // Send RTCP receiver reports (--rtcp, or once the sender reports)
+    int reports_initial;     // No receiver report sent yet
+    int64_t next_report_us;
+    double avg_rtcp_size;    // Octets per compound RTCP packet, UDP/IP headers included
+    long reports_sent;
+    long sender_reports;
+    uint32_t sender_packet_count;  // As of the last sender report
+    CcArrivalLog *cc;        // Arrival times for congestion control feedback (--cc)
+    MetricsStream *metrics;  // Shared-memory slot (--metrics), NULL if none
+    int64_t metrics_published_us;
+    long total_bytes;
+    int64_t last_packet_us;  // Arrival of the most recent packet (jitter_now_us clock)
+    int64_t deadline_us;     // Next time this session needs attention, -1 = none
+    int heap_index;          // Position in the deadline heap, -1 if not queued
+    int touched;             // Received packets in the current batch
+} Session;
+
+// SSRC -> session map using open addressing (linear probing, backward-shift
+// deletion) over a power-of-two bucket array sized for a load factor <= 0.5.
+// Session records live in a fixed array allocated up front, so lookups,
+// inserts and removals never allocate. A session can also be found under
+// one alias, the SSRC of its RFC 4588 retransmission stream; buckets are
+// sized so the load factor stays <= 0.5 with every alias in place. A binary min-heap orders sessions by
+// deadline so the event loop finds the next one due in O(1).
+typedef struct {
+    uint32_t *keys;      // SSRC stored in each bucket
+    int32_t *values;     // Session index per bucket, -1 = empty
+    uint32_t bucket_mask;
+    Session *sessions;
+    int *free_sessions;  // Stack of unused session indices
+    int free_count;
+    int max_sessions;
+    int count;
+    int *heap;           // Session indices ordered by deadline_us
+    int heap_size;
+} SessionTable;
+
+int session_table_init(SessionTable *table, int max_sessions);
+void session_table_destroy(SessionTable *table);
+Session *session_table_lookup(SessionTable *table, uint32_t ssrc);
+// Returns a zeroed session for ssrc, or NULL if the table is full
+Session *session_table_insert(SessionTable *table, uint32_t ssrc);
+void session_table_remove(SessionTable *table, Session *session);
+// Make the session reachable under a second SSRC. Returns -1 if that SSRC is taken.
+int session_table_alias(SessionTable *table, Session *session, uint32_t alias);
+// Re-queue a session after its deadline_us changed (-1 removes it from the heap)
+void session_table_update_deadline(SessionTable *table, Session *session);
+// Session with the earliest deadline, or NULL if none is queued
+Session *session_table_earliest(SessionTable *table);
+
+#endif // SESSION_TABLE_H
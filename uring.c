@@ -0,0 +1,334 @@
+#include "uring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+_Static_assert(sizeof(struct io_uring_recvmsg_out) == URING_RECVMSG_OUT_SIZE, "io_uring_recvmsg_out size");
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(IoUring *ring, unsigned entries, unsigned cq_entries) {
+    memset(ring, 0, sizeof(IoUring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (cq_entries > 0) {
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+    }
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0) return -1;
+    // Waits with a timeout need IORING_ENTER_EXT_ARG (Linux 5.11)
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        close(fd);
+        errno = ENOSYS;
+        return -1;
+    }
+    ring->fd = fd;
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        uring_close(ring);
+        return -1;
+    }
+    void *cq_base = ring->sq_map;
+    if (!single_mmap) {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            uring_close(ring);
+            return -1;
+        }
+        cq_base = ring->cq_map;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_close(ring);
+        return -1;
+    }
+
+    unsigned char *sq = (unsigned char *)ring->sq_map;
+    unsigned char *cq = (unsigned char *)cq_base;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // SQ slot i always holds SQE i
+    for (unsigned i = 0; i < params.sq_entries; i++) ring->sq_array[i] = i;
+    return 0;
+}
+
+void uring_close(IoUring *ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map) munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map) munmap(ring->sq_map, ring->sq_map_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(IoUring));
+    ring->fd = -1;
+}
+
+// Next SQE, zeroed. A full SQ is submitted first to make room.
+static struct io_uring_sqe *get_sqe(IoUring *ring) {
+    if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        uring_submit(ring, 0, -1);
+        if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) return NULL;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqe_tail++;
+    ring->inflight++;
+    return sqe;
+}
+
+int uring_sendmsg(IoUring *ring, int fd, const struct msghdr *msg, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_recvmsg_multishot(IoUring *ring, int fd, struct msghdr *msg, int buf_group, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = (uint16_t)buf_group;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_write(IoUring *ring, int fd, const void *buf, unsigned length, uint64_t offset,
+                int buf_index, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return -1;
+    sqe->opcode = buf_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = length;
+    sqe->off = offset;
+    if (buf_index >= 0) sqe->buf_index = (uint16_t)buf_index;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_cancel(IoUring *ring, uint64_t target, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_submit(IoUring *ring, unsigned wait_for, int64_t timeout_us) {
+    unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    if (to_submit == 0 && wait_for == 0) return 0;
+
+    unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void *argp = NULL;
+    size_t argsz = 0;
+    if (wait_for > 0 && timeout_us >= 0) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    ring->enters++;
+    int n = sys_io_uring_enter(ring->fd, to_submit, wait_for, flags, argp, argsz);
+    return n < 0 ? -1 : 0;
+}
+
+unsigned uring_unqueue(IoUring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned withdrawn = ring->sqe_tail - head;
+    ring->sqe_tail = head;
+    __atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+    ring->inflight -= withdrawn;
+    return withdrawn;
+}
+
+int uring_peek(IoUring *ring, UringCompletion *completion) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+    completion->user_data = cqe->user_data;
+    completion->res = cqe->res;
+    completion->more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    completion->buffer_id = (cqe->flags & IORING_CQE_F_BUFFER) ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    if (!completion->more) ring->inflight--;
+    return 1;
+}
+
+int uring_register_buffer(IoUring *ring, void *base, size_t length) {
+    struct iovec iov = { base, length };
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) return -1;
+    ring->buffers_registered = 1;
+    return 0;
+}
+
+int uring_buf_ring_init(IoUring *ring, UringBufRing *br, int group, unsigned entries) {
+    memset(br, 0, sizeof(UringBufRing));
+    br->size = entries * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, br->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return -1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = entries;
+    reg.bgid = (uint16_t)group;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(mem, br->size);
+        return -1;
+    }
+    br->br = (struct io_uring_buf_ring *)mem;
+    br->entries = entries;
+    br->group = group;
+    return 0;
+}
+
+void uring_buf_ring_add(UringBufRing *br, void *addr, unsigned length, uint16_t buffer_id) {
+    struct io_uring_buf *buf = &br->br->bufs[br->tail & (br->entries - 1)];
+    buf->addr = (uint64_t)(uintptr_t)addr;
+    buf->len = length;
+    buf->bid = buffer_id;
+    br->tail++;
+}
+
+void uring_buf_ring_publish(UringBufRing *br) {
+    __atomic_store_n(&br->br->tail, br->tail, __ATOMIC_RELEASE);
+}
+
+void uring_buf_ring_close(IoUring *ring, UringBufRing *br) {
+    if (!br->br) return;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = (uint16_t)br->group;
+    sys_io_uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(br->br, br->size);
+    memset(br, 0, sizeof(UringBufRing));
+}
+
+int uring_recvmsg_parse(void *buf, int length, const struct msghdr *msg, UringRecvmsg *out) {
+    unsigned header = URING_RECVMSG_OUT_SIZE + msg->msg_namelen + msg->msg_controllen;
+    if (length < (int)header) return -1;
+    struct io_uring_recvmsg_out *result = (struct io_uring_recvmsg_out *)buf;
+    unsigned char *base = (unsigned char *)buf + URING_RECVMSG_OUT_SIZE;
+    out->name = base;
+    out->namelen = result->namelen < msg->msg_namelen ? result->namelen : msg->msg_namelen;
+    out->control = base + msg->msg_namelen;
+    out->controllen = result->controllen < msg->msg_controllen ? result->controllen : msg->msg_controllen;
+    out->payload = base + msg->msg_namelen + msg->msg_controllen;
+    unsigned available = (unsigned)length - header;
+    out->payload_length = result->payloadlen < available ? result->payloadlen : available;
+    out->truncated = (result->flags & MSG_TRUNC) || result->payloadlen > available;
+    return 0;
+}
+
+#else
+
+// No io_uring on this platform: callers stay on their socket path
+int uring_init(IoUring *ring, unsigned entries, unsigned cq_entries) {
+    (void)entries;
+    (void)cq_entries;
+    memset(ring, 0, sizeof(IoUring));
+    ring->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+void uring_close(IoUring *ring) { (void)ring; }
+int uring_sendmsg(IoUring *ring, int fd, const struct msghdr *msg, uint64_t user_data) {
+    (void)ring; (void)fd; (void)msg; (void)user_data;
+    return -1;
+}
+int uring_recvmsg_multishot(IoUring *ring, int fd, struct msghdr *msg, int buf_group, uint64_t user_data) {
+    (void)ring; (void)fd; (void)msg; (void)buf_group; (void)user_data;
+    return -1;
+}
+int uring_write(IoUring *ring, int fd, const void *buf, unsigned length, uint64_t offset,
+                int buf_index, uint64_t user_data) {
+    (void)ring; (void)fd; (void)buf; (void)length; (void)offset; (void)buf_index; (void)user_data;
+    return -1;
+}
+int uring_cancel(IoUring *ring, uint64_t target, uint64_t user_data) {
+    (void)ring; (void)target; (void)user_data;
+    return -1;
+}
+int uring_submit(IoUring *ring, unsigned wait_for, int64_t timeout_us) {
+    (void)ring; (void)wait_for; (void)timeout_us;
+    errno = ENOSYS;
+    return -1;
+}
+unsigned uring_unqueue(IoUring *ring) { (void)ring; return 0; }
+int uring_peek(IoUring *ring, UringCompletion *completion) { (void)ring; (void)completion; return 0; }
+int uring_register_buffer(IoUring *ring, void *base, size_t length) { (void)ring; (void)base; (void)length; return -1; }
+int uring_buf_ring_init(IoUring *ring, UringBufRing *br, int group, unsigned entries) {
+    (void)ring; (void)br; (void)group; (void)entries;
+    return -1;
+}
+void uring_buf_ring_add(UringBufRing *br, void *addr, unsigned length, uint16_t buffer_id) {
+    (void)br; (void)addr; (void)length; (void)buffer_id;
+}
+void uring_buf_ring_publish(UringBufRing *br) { (void)br; }
+void uring_buf_ring_close(IoUring *ring, UringBufRing *br) { (void)ring; (void)br; }
+int uring_recvmsg_parse(void *buf, int length, const struct msghdr *msg, UringRecvmsg *out) {
+    (void)buf; (void)length; (void)msg; (void)out;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+// Minimal io_uring on raw syscalls (liburing is not needed): ring setup and
+// mapping, SQE preparation, completion reaping, registered buffers and
+// provided-buffer rings. SQEs are only queued in shared memory; uring_submit
+// hands everything queued to the kernel with one io_uring_enter, so a caller
+// can batch a whole event-loop iteration into one syscall.
+//
+// uring_init returns -1 where io_uring is missing, disabled
+// (kernel.io_uring_disabled, seccomp) or too old for provided-buffer rings
+// (Linux 5.19), and callers keep their socket path in that case.
+
+#define URING_RECVMSG_OUT_SIZE 16  // struct io_uring_recvmsg_out in front of each multishot recvmsg
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail;        // SQEs prepared; the kernel sees them from the next uring_submit
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;             // NULL when the kernel shares one mapping for both rings
+    size_t cq_map_size;
+    size_t sqes_size;
+    int buffers_registered;   // uring_register_buffer succeeded (buf_index 0)
+    long enters;              // io_uring_enter calls, for syscall counts
+    long inflight;            // Requests queued or running whose last completion was not reaped
+} IoUring;
+
+// One completion, decoded
+typedef struct {
+    uint64_t user_data;
+    int32_t res;
+    int more;                 // Multishot request stays armed
+    int buffer_id;            // Provided buffer used, -1 if none
+} UringCompletion;
+
+// Ring of buffers the kernel picks from for receives (IORING_REGISTER_PBUF_RING)
+typedef struct {
+    struct io_uring_buf_ring *br;
+    size_t size;
+    unsigned entries;         // Power of two
+    uint16_t tail;            // Local tail, published by uring_buf_ring_publish
+    int group;
+} UringBufRing;
+
+// Parts of a multishot recvmsg result inside its provided buffer
+typedef struct {
+    void *name;
+    unsigned namelen;
+    void *control;
+    unsigned controllen;
+    unsigned char *payload;
+    unsigned payload_length;  // Clamped to what the buffer held
+    int truncated;
+} UringRecvmsg;
+
+// cq_entries 0 keeps the kernel default of twice the SQ entries
+int uring_init(IoUring *ring, unsigned entries, unsigned cq_entries);
+void uring_close(IoUring *ring);
+
+// Queue operations. They return -1 only if the SQ stays full after
+// submitting what was queued.
+int uring_sendmsg(IoUring *ring, int fd, const struct msghdr *msg, uint64_t user_data);
+int uring_recvmsg_multishot(IoUring *ring, int fd, struct msghdr *msg, int buf_group, uint64_t user_data);
+// buf_index 0 writes from the buffer registered with uring_register_buffer, -1 from plain memory
+int uring_write(IoUring *ring, int fd, const void *buf, unsigned length, uint64_t offset,
+                int buf_index, uint64_t user_data);
+// Cancel the request queued with user_data target (e.g. a multishot recvmsg)
+int uring_cancel(IoUring *ring, uint64_t target, uint64_t user_data);
+
+// Submit everything queued and wait for wait_for completions, or until
+// timeout_us (relative, -1 = none) passes. Returns 0, or -1 with errno
+// (ETIME when the timeout passed first).
+int uring_submit(IoUring *ring, unsigned wait_for, int64_t timeout_us);
+// Withdraw the SQEs the kernel has not consumed yet (the last ones queued), e.g. after
+// uring_submit failed. They never run. Returns how many were withdrawn.
+unsigned uring_unqueue(IoUring *ring);
+// Take the next completion: 1 if there was one, 0 if the CQ is empty
+int uring_peek(IoUring *ring, UringCompletion *completion);
+
+// Register [base, base + length) as fixed buffer 0, for uring_write
+int uring_register_buffer(IoUring *ring, void *base, size_t length);
+
+int uring_buf_ring_init(IoUring *ring, UringBufRing *br, int group, unsigned entries);
+// Queue a buffer for the kernel; it sees it after uring_buf_ring_publish
+void uring_buf_ring_add(UringBufRing *br, void *addr, unsigned length, uint16_t buffer_id);
+void uring_buf_ring_publish(UringBufRing *br);
+void uring_buf_ring_close(IoUring *ring, UringBufRing *br);
+
+// Locate name, control data and payload of a multishot recvmsg completion.
+// msg is the template passed to uring_recvmsg_multishot. Returns -1 if the
+// result does not fit the buffer.
+int uring_recvmsg_parse(void *buf, int length, const struct msghdr *msg, UringRecvmsg *out);
+
+#endif // URING_H